@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <rpc/rpc.h>
 #include <rpc/pmap_clnt.h>      /* pmap_unset() */
@@ -44,6 +45,7 @@
 #include "down6.h"              /* down6_destroy() */
 #include "globals.h"
 #include "child_process_set.h"
+#include "hostCache.h"
 #include "inetutil.h"
 #include "registry.h"
 #include "remote.h"
@@ -51,6 +53,7 @@
 #include "rpcutil.h"  /* clnt_errmsg() */
 #include "up6.h"
 #include "uldb.h"
+#include "uphub.h"
 
 #ifdef NO_ATEXIT
 #include "atexit.h"
@@ -62,6 +65,20 @@
 
 static int portIsMapped = 0;
 static unsigned maxClients = 256;
+static unsigned hubCount = 0; /* number of upstream LDM hubs */
+static int listenSock = -1; /* socket on which the LDM server listens */
+
+/*
+ * Connections whose first request hasn't been examined. Only used if there are
+ * upstream LDM hubs.
+ */
+#define MAX_PENDING 128
+static struct {
+    struct sockaddr_in  raddr;  /* address of remote host */
+    time_t              start;  /* time of acceptance */
+    int                 sock;   /* connected socket */
+} pending[MAX_PENDING];
+static unsigned pendingCount = 0;
 
 static pid_t reap(
         pid_t pid,
@@ -280,6 +297,8 @@ static void cleanup(
          * Delete the upstream LDM database.
          */
         (void) uldb_delete(NULL);
+
+        hc_logStats(LOG_NOTICE);
     }
 
     /*
@@ -403,9 +422,13 @@ static void usage(
                     "\t                seconds (default is %d)\n"
                     "\t-n              Do nothing other than check the configuration-file\n"
                     "\t-t rpctimeo     Set LDM-5 RPC timeout to \"rpctimeo\" seconds\n"
-                    "\t                (default is %d)\n", av0,
+                    "\t                (default is %d)\n"
+                    "\t-E nhubs        Feed and notify downstream LDM-s from \"nhubs\"\n"
+                    "\t                multi-session upstream LDM processes rather\n"
+                    "\t                than a process per connection (default is 0,\n"
+                    "\t                maximum is %d)\n", av0,
             getLdmdConfigPath(), LDM_PORT, getQueuePath(), DEFAULT_OLDEST,
-            DEFAULT_RPCTIMEO);
+            DEFAULT_RPCTIMEO, UPHUB_MAX_HUBS);
 
     exit(1);
 }
@@ -571,50 +594,51 @@ static int create_ldm_tcp_svc(
 }
 
 /*
- * Handles an incoming RPC connection on a socket.  This method will fork(2)
- * a copy of this program, if appropriate, for handling incoming RPC messages.
+ * Closes the connections whose first request hasn't been examined.  Called by
+ * child processes, which mustn't keep those connections open.
+ */
+static void close_pending(
+        void)
+{
+    unsigned i;
+
+    for (i = 0; i < pendingCount; i++)
+        (void) close(pending[i].sock);
+
+    pendingCount = 0;
+}
+
+/*
+ * Initializes an upstream LDM hub process.
+ */
+static void init_hub(
+        void)
+{
+    close_pending();
+    (void) close(listenSock);
+    portIsMapped = 0; /* don't call pmap_unset() from child */
+}
+
+/*
+ * Serves an incoming RPC connection.  This method will fork(2) a copy of this
+ * program for handling incoming RPC messages.  The socket is closed in this
+ * process.
  *
- * sock           The socket with the incoming RPC connection.
+ * sock           The socket on which the LDM server listens.
+ * xp_sock        The socket with the incoming RPC connection.
+ * raddr          The address of the remote host.
  */
-static void handle_connection(
-        int sock)
+static void serve_connection(
+        int sock,
+        int xp_sock,
+        struct sockaddr_in* raddr)
 {
-    struct sockaddr_in raddr;
-    socklen_t len;
-    int xp_sock;
+    const socklen_t len = sizeof(*raddr);
     pid_t pid;
     SVCXPRT *xprt;
     int status = 1; /* EXIT_FAILURE assumed unless one_svc_run() success */
     peer_info* remote = get_remote();
 
-    again: len = sizeof(raddr);
-    (void) memset(&raddr, 0, len);
-
-    xp_sock = accept(sock, (struct sockaddr *) &raddr, &len);
-
-    (void) exitIfDone(0);
-
-    if (xp_sock < 0) {
-        if (errno == EINTR) {
-            errno = 0;
-            goto again;
-        }
-        /* else */
-        serror("accept");
-        return;
-    }
-
-    /*
-     * Don't bother continuing if no more clients are allowed.
-     */
-    if (cps_count() >= maxClients) {
-        setremote(&raddr, xp_sock);
-        unotice("Denying connection from [%s] because too many clients",
-                remote->astr);
-        (void) close(xp_sock);
-        return;
-    }
-
     pid = ldmfork();
     if (pid == -1) {
         log_add("Couldn't fork process to handle incoming connection");
@@ -636,11 +660,12 @@ static void handle_connection(
     }
     /* else child */
 
-    setremote(&raddr, xp_sock);
+    close_pending();
+    setremote(raddr, xp_sock);
 
     /* Access control */
     if (!lcf_isHostOk(remote)) {
-        ensureRemoteName(&raddr);
+        ensureRemoteName(raddr);
         if (!lcf_isHostOk(remote)) {
             if (remote->printname == remote->astr) {
                 unotice("Denying connection from [%s] because not "
@@ -657,7 +682,7 @@ static void handle_connection(
              */
             xprt = svcfd_create(xp_sock, remote->sendsz, remote->recvsz);
             if (xprt != NULL ) {
-                (void) memcpy(&xprt->xp_raddr, &raddr, len);
+                (void) memcpy(&xprt->xp_raddr, raddr, len);
                 xprt->xp_addrlen = (int) len;
                 svcerr_weakauth(xprt);
                 svc_destroy(xprt);
@@ -685,7 +710,7 @@ static void handle_connection(
     }
     /* hook up the remote address to the xprt. */
     /* xprt->xp_raddr = raddr; */
-    (void) memcpy(&xprt->xp_raddr, &raddr, len);
+    (void) memcpy(&xprt->xp_raddr, raddr, len);
     xprt->xp_addrlen = (int) len;
 
     if (!svc_register(xprt, LDMPROG, 4, ldmprog_4, 0)) {
@@ -747,22 +772,132 @@ static void handle_connection(
     exit(status);
 }
 
+/*
+ * Handles an incoming RPC connection on a socket.  If there are upstream LDM
+ * hubs, then the connection is added to the pending connections so that its
+ * first request can be examined; otherwise, it's served by a forked process.
+ *
+ * sock           The socket on which the LDM server listens.
+ */
+static void handle_connection(
+        int sock)
+{
+    struct sockaddr_in raddr;
+    socklen_t len;
+    int xp_sock;
+    peer_info* remote = get_remote();
+
+    again: len = sizeof(raddr);
+    (void) memset(&raddr, 0, len);
+
+    xp_sock = accept(sock, (struct sockaddr *) &raddr, &len);
+
+    (void) exitIfDone(0);
+
+    if (xp_sock < 0) {
+        if (errno == EINTR) {
+            errno = 0;
+            goto again;
+        }
+        /* else */
+        serror("accept");
+        return;
+    }
+
+    /*
+     * Don't bother continuing if no more clients are allowed.
+     */
+    if (cps_count() + uphub_getSessionCount() + pendingCount >= maxClients) {
+        setremote(&raddr, xp_sock);
+        unotice("Denying connection from [%s] because too many clients",
+                remote->astr);
+        (void) close(xp_sock);
+        return;
+    }
+
+    if (hubCount && xp_sock < FD_SETSIZE && pendingCount < MAX_PENDING) {
+        pending[pendingCount].raddr = raddr;
+        pending[pendingCount].start = time(NULL);
+        pending[pendingCount].sock = xp_sock;
+        pendingCount++;
+        return;
+    }
+
+    serve_connection(sock, xp_sock, &raddr);
+}
+
+/*
+ * Handles the pending connections that have a first request or that have
+ * waited too long for one.  A connection whose first request is a FEEDME or
+ * NOTIFYME is passed to an upstream LDM hub; every other connection is served
+ * by a forked process.  The name of the remote host isn't looked up here
+ * because that would stall the server.
+ *
+ * sock           The socket on which the LDM server listens.
+ * readfds        The descriptors that are ready for reading.
+ */
+static void handle_pending(
+        int sock,
+        fd_set* readfds)
+{
+    const time_t now = time(NULL);
+    unsigned i;
+
+    for (i = pendingCount; i-- > 0;) {
+        const int xp_sock = pending[i].sock;
+        struct sockaddr_in raddr = pending[i].raddr;
+        uphub_Request reqType;
+
+        if (FD_ISSET(xp_sock, readfds)) {
+            reqType = uphub_getRequestType(xp_sock);
+        }
+        else if (now - pending[i].start >= LDM_SELECT_TIMEO) {
+            reqType = UPHUB_REQ_OTHER;
+        }
+        else {
+            continue;
+        }
+
+        pending[i] = pending[--pendingCount];
+
+        if (reqType == UPHUB_REQ_CLOSED) {
+            (void) close(xp_sock);
+        }
+        else if (reqType == UPHUB_REQ_HUB && uphub_handOff(xp_sock) == 0) {
+            (void) close(xp_sock);
+        }
+        else {
+            if (reqType == UPHUB_REQ_HUB)
+                log_log(LOG_ERR); /* couldn't pass connection to hub */
+
+            serve_connection(sock, xp_sock, &raddr);
+        }
+    }
+}
+
 static void sock_svc(
         const int  sock)
 {
-    const int width = sock + 1;
-
     while (exitIfDone(0)) {
         int ready;
+        int width = sock + 1;
+        unsigned i;
         fd_set readfds;
         struct timeval stimeo;
 
-        stimeo.tv_sec = LDM_SELECT_TIMEO;
+        stimeo.tv_sec = pendingCount ? 1 : LDM_SELECT_TIMEO;
         stimeo.tv_usec = 0;
 
         FD_ZERO(&readfds);
         FD_SET(sock, &readfds);
 
+        for (i = 0; i < pendingCount; i++) {
+            FD_SET(pending[i].sock, &readfds);
+
+            if (pending[i].sock >= width)
+                width = pending[i].sock + 1;
+        }
+
         ready = select(width, &readfds, 0, 0, &stimeo);
 
         if (ready < 0) {
@@ -775,11 +910,16 @@ static void sock_svc(
                 exit(1);
             }
         }
-        else if (ready > 0) {
-            /*
-             * Do some work.
-             */
-            handle_connection(sock);
+        else {
+            if (ready > 0 && FD_ISSET(sock, &readfds)) {
+                /*
+                 * Do some work.
+                 */
+                handle_connection(sock);
+            }
+
+            if (pendingCount)
+                handle_pending(sock, &readfds);
         }
 
         /*
@@ -815,7 +955,7 @@ int main(
 
         opterr = 1;
 
-        while ((ch = getopt(ac, av, "I:vxl:nq:o:P:M:m:t:")) != EOF) {
+        while ((ch = getopt(ac, av, "I:vxl:nq:o:P:M:m:t:E:")) != EOF) {
             switch (ch) {
             case 'I': {
                 in_addr_t ipAddr = inet_addr(optarg);
@@ -899,6 +1039,17 @@ int main(
                     usage(av[0]);
                 }
                 break;
+            case 'E': {
+                int count = atoi(optarg);
+                if (count < 0 || count > UPHUB_MAX_HUBS) {
+                    (void) fprintf(stderr,
+                            "%s: invalid number of upstream LDM hubs %s\n",
+                            av[0], optarg);
+                    usage(av[0]);
+                }
+                hubCount = (unsigned) count;
+                break;
+            }
             case '?':
                 usage(av[0]);
                 break;
@@ -1042,6 +1193,14 @@ int main(
             exit(1);
         }
 
+        /*
+         * Create the hostname cache that's shared by the child processes.
+         * This process forks, so it mustn't have refresh threads.
+         */
+        if (hc_init())
+            log_log(LOG_WARNING);
+        hc_disableRefreshThreads();
+
         /*
          * Read the configuration file (downstream LDM-s are started).
          */
@@ -1052,7 +1211,28 @@ int main(
             exit(1);
         }
 
+        /*
+         * Compile the ALLOW and ACCEPT entries once for all child processes.
+         */
+        if (lcf_compileAcl()) {
+            log_log(LOG_ERR);
+            exit(1);
+        }
+
         if (lcf_isServerNeeded()) {
+            listenSock = sock;
+
+            if (hubCount) {
+                /*
+                 * Start the processes that feed and notify downstream LDM-s.
+                 */
+                udebug("main(): Starting %u upstream LDM hubs", hubCount);
+                if (uphub_startPool(hubCount, init_hub)) {
+                    log_log(LOG_ERR);
+                    exit(1);
+                }
+            }
+
             /*
              * Serve
              */
@@ -27,6 +27,7 @@
 #include "stdbool.h"
 #include "wordexp.h"
 
+#include <ctype.h>
 #include <limits.h>
 #include <regex.h>
 #include <stdlib.h>
@@ -39,6 +40,11 @@
 extern int yydebug;
 #endif
 
+/*
+ * Maximum number of connections among which a REQUEST can be divided.
+ */
+#define MAX_STRIPES     16
+
 static int      line = 0;
 static unsigned ldmPort = LDM_PORT;
 static int      execute = 1;
@@ -234,6 +240,50 @@ warnIfPathological(
 }
 
 
+/*
+ * Arguments:
+ *      rate            Pointer to the rate in bytes per second.  Set on
+ *                      success.
+ *      rateSpec        Rate in bytes per second with an optional "K", "M", or
+ *                      "G" suffix (e.g., "500K").  May not be NULL.
+ * Returns:
+ *      0               Success.
+ *      else            Failure.  "log_start()" called.
+ */
+static int
+decodeRate(
+    unsigned long* const        rate,
+    const char* const           rateSpec)
+{
+    char*               suffix;
+    unsigned long       value;
+    unsigned long       multiplier = 1;
+
+    if (!isdigit((unsigned char)*rateSpec)) {
+        log_start("Invalid rate \"%s\"", rateSpec);
+        return -1;
+    }
+
+    errno = 0;
+    value = strtoul(rateSpec, &suffix, 10);
+
+    switch (toupper((unsigned char)*suffix)) {
+        case 'K': multiplier = 1000; suffix++; break;
+        case 'M': multiplier = 1000000; suffix++; break;
+        case 'G': multiplier = 1000000000; suffix++; break;
+    }
+
+    if (errno || *suffix || (value && ULONG_MAX / value < multiplier)) {
+        log_start("Invalid rate \"%s\"", rateSpec);
+        return -1;
+    }
+
+    *rate = value * multiplier;
+
+    return 0;
+}
+
+
 /*
  * Arguments:
  *      feedtypeSpec    String specification of feedtype.  May not be NULL.
@@ -245,8 +295,10 @@ warnIfPathological(
  *                      may free upon return.
  *      notPattern      ERE that product-identifiers must NOT match in order for
  *                      the associated data-products to be transferred.  May
- *                      be null to indicate that such matching should be
- *                      disabled.  Caller may free upon return.
+ *                      be null or empty to indicate that such matching should
+ *                      be disabled.  Caller may free upon return.
+ *      rateSpec        Maximum sending-rate in bytes per second with an
+ *                      optional "K", "M", or "G" suffix or NULL for no limit.
  * Returns:
  *      0               Success.
  *      else            Failure.  "log_start()" called.
@@ -256,10 +308,18 @@ decodeAllowEntry(
     const char* const   feedtypeSpec,
     const char* const   hostPattern,
     const char* const   okPattern,
-    const char* const   notPattern)
+    const char*         notPattern,
+    const char* const   rateSpec)
 {
-    feedtypet   ft;
-    int         errCode = decodeFeedtype(&ft, feedtypeSpec);
+    feedtypet           ft;
+    unsigned long       maxRate = 0;
+    int                 errCode = decodeFeedtype(&ft, feedtypeSpec);
+
+    if (NULL != notPattern && 0 == *notPattern)
+        notPattern = NULL;
+
+    if (!errCode && NULL != rateSpec)
+        errCode = decodeRate(&maxRate, rateSpec);
 
     if (!errCode) {
         host_set*       hsp;
@@ -274,12 +334,13 @@ decodeAllowEntry(
             if (notPattern)
                 warnIfPathological(notPattern);
 
-            errObj = lcf_addAllow(ft, hsp, okPattern, notPattern);
+            errObj = lcf_addAllow(ft, hsp, okPattern, notPattern, maxRate);
 
             if (errObj) {
                 log_start("Couldn't add ALLOW entry: feedSet=%s, hostPat=%s, "
                         "okPat=\"%s\", notPat=\"%s\"",
-                        feedtypeSpec, hostPattern, okPattern, notPattern);
+                        feedtypeSpec, hostPattern, okPattern,
+                        notPattern ? notPattern : "");
                 lcf_freeHostSet(hsp);
                 errCode = -1;
             }
@@ -290,16 +351,60 @@ decodeAllowEntry(
 }
 
 
+/*
+ * Arguments:
+ *      feedtypeSpec    String specification of feedtype.  May not be NULL.
+ *      prodPattern     ERE of product-identifiers.  May not be NULL.
+ *      hostSpec        Specification of upstream host and optional port.  May
+ *                      not be NULL.  Modified.
+ *      stripeSpec      Number of connections among which to divide the
+ *                      request or NULL.  A non-numeric value is ignored for
+ *                      backward compatibility.
+ * Returns:
+ *      0               Success.
+ *      else            Failure.  "log_start()" called.
+ */
 static int
 decodeRequestEntry(
     const char* const   feedtypeSpec,
     const char* const   prodPattern,
-    char* const         hostSpec)
+    char* const         hostSpec,
+    const char* const   stripeSpec)
 {
     feedtypet   feedtype;
     regex_t*    regexp;
-    int         errCode =
-            decodeSelection(&feedtype, &regexp, feedtypeSpec, prodPattern);
+    unsigned    stripeCount = 1;
+    int         errCode = 0;
+
+    if (NULL != stripeSpec) {
+        if (!isdigit((unsigned char)*stripeSpec)) {
+            log_start("Ignoring 5th field of REQUEST entry: \"%s\"",
+                    stripeSpec);
+            log_log(LOG_WARNING);
+        }
+        else {
+            char*   suffix = "";
+            long    count;
+
+            errno = 0;
+            count = strtol(stripeSpec, &suffix, 10);
+
+            if (0 == errno && 0 == *suffix && 0 < count &&
+                    MAX_STRIPES >= count) {
+                stripeCount = (unsigned)count;
+            }
+            else {
+                log_start("Invalid number of stripes \"%s\" (maximum is %d)",
+                        stripeSpec, MAX_STRIPES);
+
+                errCode = EINVAL;
+            }
+        }
+    }
+
+    if (!errCode)
+        errCode = decodeSelection(&feedtype, &regexp, feedtypeSpec,
+                prodPattern);
 
     if (!errCode) {
         const char*    hostId = strtok(hostSpec, ":");
@@ -335,7 +440,7 @@ decodeRequestEntry(
         
             if (0 == errCode) {
                 if (errCode = lcf_addRequest(feedtype, prodPattern, hostId,
-                        localPort)) {
+                        localPort, stripeCount)) {
                 }
             } /* "localPort" set */
         } /* valid hostname */
@@ -541,21 +646,28 @@ accept_entry:   ACCEPT_K STRING STRING STRING
 
 allow_entry:    ALLOW_K STRING STRING
                 {
-                    int errCode = decodeAllowEntry($2, $3, ".*", NULL);
+                    int errCode = decodeAllowEntry($2, $3, ".*", NULL, NULL);
 
                     if (errCode)
                         return errCode;
                 }
                 | ALLOW_K STRING STRING STRING
                 {
-                    int errCode = decodeAllowEntry($2, $3, $4, NULL);
+                    int errCode = decodeAllowEntry($2, $3, $4, NULL, NULL);
 
                     if (errCode)
                         return errCode;
                 }
                 | ALLOW_K STRING STRING STRING STRING
                 {
-                    int errCode = decodeAllowEntry($2, $3, $4, $5);
+                    int errCode = decodeAllowEntry($2, $3, $4, $5, NULL);
+
+                    if (errCode)
+                        return errCode;
+                }
+                | ALLOW_K STRING STRING STRING STRING STRING
+                {
+                    int errCode = decodeAllowEntry($2, $3, $4, $5, $6);
 
                     if (errCode)
                         return errCode;
@@ -613,14 +725,14 @@ receive_entry:        RECEIVE_K STRING STRING
 
 request_entry:  REQUEST_K STRING STRING STRING
                 {
-                    int errCode = decodeRequestEntry($2, $3, $4);
+                    int errCode = decodeRequestEntry($2, $3, $4, NULL);
 
                     if (errCode)
                         return errCode;
                 }
                 | REQUEST_K STRING STRING STRING STRING
                 {
-                    int errCode = decodeRequestEntry($2, $3, $4);
+                    int errCode = decodeRequestEntry($2, $3, $4, $5);
 
                     if (errCode)
                         return errCode;
@@ -0,0 +1,703 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research. All rights
+ * reserved.
+ *
+ * See file COPYRIGHT in the top-level source-directory for legal conditions.
+ */
+
+/**
+ * @file futexRWLock.c
+ *
+ * A read/write lock in shared-memory that's based on atomic operations and,
+ * only when processes must wait, on futexes. It has the same API as the
+ * semaphore-based lock of semRWLock.c, which is used on systems without
+ * futexes, but an uncontended lock or unlock doesn't make a system-call.
+ *
+ * The lock-word contains the PID of the process that has the lock for writing
+ * (if any). Each process that uses the lock has a slot that contains its PID
+ * and whether it has the lock for reading; so, a reader only modifies its
+ * own slot and a writer waits for every slot to become idle. A process that
+ * dies while holding the lock is detected by the processes that wait on it,
+ * which release the lock. The implementation is thread-compatible but not
+ * thread-safe.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <log.h>
+
+#include "semRWLock.h"
+
+/**
+ * Bits of the lock-word and of a slot. PIDs are less than 2^22 on Linux.
+ */
+#define WORD_WRITER     0x40000000u     /* locked for writing by PID */
+#define WORD_WAITERS    0x80000000u     /* processes are waiting */
+#define WORD_PID        0x3fffffffu
+#define SLOT_READING    1u              /* process has read-lock */
+#define SLOT_WAITED     2u              /* writer is waiting for process */
+#define SLOT_SHIFT      2               /* PID is shifted by this */
+/**
+ * Maximum number of processes that can use a lock at the same time.
+ */
+#define NUM_SLOTS       1024
+/**
+ * Number of seconds between checks of whether the process that's being
+ * waited-on still exists.
+ */
+#define CHECK_INTERVAL  1
+
+/**
+ * The part of a lock that's in shared-memory.
+ */
+typedef struct {
+    uint32_t word; /* lock-word */
+    uint32_t numSlots; /* one more than the highest slot ever claimed */
+    uint32_t slots[NUM_SLOTS]; /* PID and state of each process or 0 */
+} Shared;
+
+/**
+ * This module's opaque type:
+ */
+struct srwl_Lock {
+    const char* isValid;
+    Shared* shared;
+    key_t key;
+    pid_t pid; /* the process that owns this structure */
+    int slot; /* index of the process's slot or -1 */
+    unsigned numReadLocks;
+    unsigned numWriteLocks;
+};
+
+/**
+ * Valid string.
+ */
+static const char* const VALID_STRING = __FILE__;
+
+/**
+ * Protection modes for the shared-memory.
+ */
+static mode_t read_write;
+static int isInitialized;
+
+/**
+ * Returns the name of the shared-memory object of a lock. Shared-memory
+ * objects have a namespace that's separate from that of System V IPC keys;
+ * so, the key can also be used for, e.g., the shared-memory segment that the
+ * lock protects.
+ */
+static void getName(
+        const key_t key /**< [in] IPC key of the lock */,
+        char* const name /**< [out] name buffer */,
+        const size_t size /**< [in] size of the name buffer */)
+{
+    (void) snprintf(name, size, "/ldm-srwl-%lx", (unsigned long) key);
+}
+
+/**
+ * Waits on a futex until it's woken, its value isn't the expected one, or
+ * CHECK_INTERVAL seconds have elapsed.
+ */
+static void futexWait(
+        uint32_t* const addr /**< [in] address of the futex */,
+        const uint32_t value /**< [in] expected value */)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = CHECK_INTERVAL;
+    timeout.tv_nsec = 0;
+
+    (void) syscall(SYS_futex, addr, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+/**
+ * Wakes every process that's waiting on a futex.
+ */
+static void futexWake(
+        uint32_t* const addr /**< [in] address of the futex */)
+{
+    (void) syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/**
+ * Indicates whether a process no longer exists.
+ *
+ * @retval 0    The process exists or might exist
+ * @retval 1    The process doesn't exist
+ */
+static int isDead(
+        const pid_t pid /**< [in] the process */)
+{
+    return kill(pid, 0) == -1 && ESRCH == errno;
+}
+
+/**
+ * Vets a lock structure.
+ *
+ * @retval RWL_SUCCESS  The lock structure is valid
+ * @retval RWL_INVALID  The lock structure is invalid. log_add() called.
+ */
+static srwl_Status vet(
+        srwl_Lock* const lock /**< [in/out] the lock structure to vet */)
+{
+    int status;
+
+    if (lock->isValid != VALID_STRING) {
+        LOG_ADD0("Invalid lock structure");
+
+        status = RWL_INVALID;
+    }
+    else {
+        const pid_t pid = getpid();
+
+        if (pid != lock->pid) {
+            /*
+             * This process must be a child process, which doesn't hold the
+             * parent's locks and must use its own slot.
+             */
+            lock->numReadLocks = 0;
+            lock->numWriteLocks = 0;
+            lock->slot = -1;
+            lock->pid = pid;
+        }
+
+        status = RWL_SUCCESS;
+    }
+
+    return status;
+}
+
+/**
+ * Claims a slot for the current process. Slots of processes that no longer
+ * exist are reclaimed if there's no free slot.
+ *
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_SYSTEM   Too many processes are using the lock. log_add()
+ *                      called.
+ */
+static srwl_Status claimSlot(
+        srwl_Lock* const lock /**< [in/out] the lock */)
+{
+    Shared* const  shared = lock->shared;
+    const uint32_t mine = (uint32_t) lock->pid << SLOT_SHIFT;
+    int            pass;
+
+    for (pass = 0; pass < 2; pass++) {
+        int i;
+
+        for (i = 0; i < NUM_SLOTS; i++) {
+            uint32_t value = __atomic_load_n(shared->slots + i,
+                    __ATOMIC_SEQ_CST);
+
+            if ((0 == value || (pass && isDead(value >> SLOT_SHIFT)))
+                    && __atomic_compare_exchange_n(shared->slots + i, &value,
+                            mine, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                uint32_t numSlots = __atomic_load_n(&shared->numSlots,
+                        __ATOMIC_SEQ_CST);
+
+                while (numSlots <= (uint32_t) i
+                        && !__atomic_compare_exchange_n(&shared->numSlots,
+                                &numSlots, i + 1, 0, __ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST))
+                    ;
+
+                lock->slot = i;
+                return RWL_SUCCESS;
+            }
+        }
+    }
+
+    LOG_ADD1("More than %d processes are using the lock", NUM_SLOTS);
+    return RWL_SYSTEM;
+}
+
+/**
+ * Releases the slot of the current process.
+ */
+static void releaseSlot(
+        srwl_Lock* const lock /**< [in/out] the lock */)
+{
+    if (0 <= lock->slot) {
+        uint32_t value = (uint32_t) lock->pid << SLOT_SHIFT;
+
+        (void) __atomic_compare_exchange_n(lock->shared->slots + lock->slot,
+                &value, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        lock->slot = -1;
+    }
+}
+
+/**
+ * Waits until the lock-word changes from a value in which the lock is held
+ * for writing. Releases the lock if the writer no longer exists.
+ */
+static void waitForWriter(
+        Shared* const shared /**< [in/out] the shared part of the lock */,
+        uint32_t value /**< [in] the observed value of the lock-word */)
+{
+    if (0 == (value & WORD_WAITERS)) {
+        if (!__atomic_compare_exchange_n(&shared->word, &value,
+                value | WORD_WAITERS, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            return; /* lock-word changed */
+
+        value |= WORD_WAITERS;
+    }
+
+    futexWait(&shared->word, value);
+
+    if (__atomic_load_n(&shared->word, __ATOMIC_SEQ_CST) == value
+            && isDead(value & WORD_PID)
+            && __atomic_compare_exchange_n(&shared->word, &value, 0, 0,
+                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        LOG_ADD1("Released write-lock of terminated process %lu",
+                (unsigned long) (value & WORD_PID));
+        log_log(LOG_WARNING);
+        futexWake(&shared->word);
+    }
+}
+
+/**
+ * Waits until no other process has the lock for reading. The current process
+ * must have the lock-word. Read-locks of processes that no longer exist are
+ * released.
+ */
+static void waitForReaders(
+        Shared* const shared /**< [in/out] the shared part of the lock */)
+{
+    const uint32_t numSlots = __atomic_load_n(&shared->numSlots,
+            __ATOMIC_SEQ_CST);
+    uint32_t       i;
+
+    for (i = 0; i < numSlots; i++) {
+        uint32_t* const slot = shared->slots + i;
+        uint32_t        value;
+
+        while ((value = __atomic_load_n(slot, __ATOMIC_SEQ_CST))
+                & SLOT_READING) {
+            if (0 == (value & SLOT_WAITED)) {
+                if (!__atomic_compare_exchange_n(slot, &value,
+                        value | SLOT_WAITED, 0, __ATOMIC_SEQ_CST,
+                        __ATOMIC_SEQ_CST))
+                    continue; /* slot changed */
+
+                value |= SLOT_WAITED;
+            }
+
+            futexWait(slot, value);
+
+            if (__atomic_load_n(slot, __ATOMIC_SEQ_CST) == value
+                    && isDead(value >> SLOT_SHIFT)
+                    && __atomic_compare_exchange_n(slot, &value, 0, 0,
+                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                LOG_ADD1("Released read-lock of terminated process %lu",
+                        (unsigned long) (value >> SLOT_SHIFT));
+                log_log(LOG_WARNING);
+            }
+        }
+    }
+}
+
+/**
+ * Marks the slot of the current process as reading or not and wakes a writer
+ * that's waiting for it.
+ */
+static void setReading(
+        srwl_Lock* const lock /**< [in/out] the lock */,
+        const int reading /**< [in] whether the process is reading */)
+{
+    uint32_t* const slot = lock->shared->slots + lock->slot;
+    const uint32_t  value = ((uint32_t) lock->pid << SLOT_SHIFT)
+            | (reading ? SLOT_READING : 0);
+
+    if (__atomic_exchange_n(slot, value, __ATOMIC_SEQ_CST) & SLOT_WAITED)
+        futexWake(slot);
+}
+
+/**
+ * Initializes a lock.
+ *
+ * @retval RWL_SUCCESS  Success.
+ * @retval RWL_EXIST    "create" is false and the shared-memory doesn't exist.
+ *                      log_add() called.
+ * @retval RWL_SYSTEM   System error. log_add() called.
+ */
+static srwl_Status initLock(
+        const int create /**< [in] Whether to create the lock. If true, then
+         any previous lock will be deleted. */,
+        int key /**< [in] IPC key for the lock */,
+        srwl_Lock** const lock /**< [out] address of pointer to lock */)
+{
+    srwl_Status status;
+    srwl_Lock* lck;
+
+    if (!isInitialized) {
+        mode_t um = umask(0);
+
+        umask(um);
+
+        read_write = 0666 & ~um;
+        isInitialized = 1;
+    }
+
+    lck = (srwl_Lock*) malloc(sizeof(srwl_Lock));
+
+    if (NULL == lck) {
+        LOG_SERROR1("Couldn't allocate %lu bytes for lock",
+                (unsigned long) sizeof(srwl_Lock));
+        status = RWL_SYSTEM;
+    }
+    else {
+        char name[32];
+        int  fd;
+
+        getName(key, name, sizeof(name));
+
+        if (create) {
+            (void) shm_unlink(name);
+            fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, read_write);
+        }
+        else {
+            fd = shm_open(name, O_RDWR, read_write);
+        }
+
+        if (-1 == fd) {
+            LOG_SERROR1("Couldn't open shared-memory \"%s\"", name);
+            status = (!create && ENOENT == errno) ? RWL_EXIST : RWL_SYSTEM;
+        }
+        else {
+            Shared* shared;
+
+            if (create && ftruncate(fd, sizeof(Shared))) {
+                LOG_SERROR1("Couldn't set size of shared-memory \"%s\"", name);
+                status = RWL_SYSTEM;
+            }
+            else if ((shared = (Shared*) mmap(NULL, sizeof(Shared),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))
+                    == MAP_FAILED) {
+                LOG_SERROR1("Couldn't map shared-memory \"%s\"", name);
+                status = RWL_SYSTEM;
+            }
+            else {
+                /* A new object is zero-filled, which is an unlocked lock */
+                lck->shared = shared;
+                lck->key = key;
+                lck->slot = -1;
+                lck->pid = getpid();
+                lck->isValid = VALID_STRING;
+                lck->numReadLocks = 0;
+                lck->numWriteLocks = 0;
+                *lock = lck;
+                status = RWL_SUCCESS;
+            }
+
+            if (status && create)
+                (void) shm_unlink(name);
+
+            (void) close(fd);
+        }
+
+        if (status)
+            free(lck);
+    } /* "lck" allocated */
+
+    return status;
+}
+
+/**
+ * Frees the resources of a lock structure.
+ */
+static void freeLock(
+        srwl_Lock* const lock /**< [in] the lock */)
+{
+    releaseSlot(lock);
+    (void) munmap((void*) lock->shared, sizeof(Shared));
+    lock->isValid = NULL;
+    free(lock);
+}
+
+/**
+ * Creates a read/write lock. Any previous lock is deleted.
+ *
+ * @param key           [in] IPC key for the lock
+ * @param lock          [out] address of pointer to lock
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_SYSTEM   System error. See "errno". log_add() called.
+ */
+srwl_Status srwl_create(
+        int key,
+        srwl_Lock** const lock)
+{
+    return initLock(1, key, lock);
+}
+
+/**
+ * Gets an existing read/write lock.
+ *
+ * @param key   [in] IPC key for the lock
+ * @param lock  [out] Address of the pointer to the lock
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_EXIST    The lock doesn't exist. log_add() called.
+ * @retval RWL_SYSTEM   System error. log_add() called.
+ */
+srwl_Status srwl_get(
+        const key_t key,
+        srwl_Lock** const lock)
+{
+    return initLock(0, key, lock);
+}
+
+/**
+ * Unconditionally deletes a read/write lock -- including the shared-memory
+ * on which the lock is based. Lock can no longer be used after this function
+ * returns.
+ *
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_INVALID  The lock is invalid. log_add() called.
+ * @retval RWL_SYSTEM   System error. log_add() called. The resulting state
+ *                      of "*lock" is unspecified.
+ */
+srwl_Status srwl_delete(
+        srwl_Lock* const lock /**< [in] pointer to the lock or NULL */)
+{
+    srwl_Status status = vet(lock);
+
+    if (RWL_SUCCESS == status) {
+        char name[32];
+
+        getName(lock->key, name, sizeof(name));
+
+        if (shm_unlink(name)) {
+            LOG_SERROR1("Couldn't delete shared-memory \"%s\"", name);
+            status = RWL_SYSTEM;
+        }
+        else {
+            freeLock(lock);
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Unconditionally deletes a read/write lock by IPC key. The shared-memory on
+ * which the lock is based is deleted.
+ *
+ * @param key           The IPC key
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_EXIST    The key has no associated read/write lock
+ * @retval RWL_SYSTEM   System error. log_add() called.
+ */
+srwl_Status srwl_deleteByKey(
+        const key_t key)
+{
+    int  status;
+    char name[32];
+
+    getName(key, name, sizeof(name));
+
+    if (shm_unlink(name) == 0) {
+        status = RWL_SUCCESS;
+    }
+    else {
+        LOG_SERROR1("Couldn't delete shared-memory \"%s\"", name);
+        status = (ENOENT == errno) ? RWL_EXIST : RWL_SYSTEM;
+    }
+
+    return status;
+}
+
+/**
+ * Frees resources associated with a read/write lock. Does not delete the
+ * shared-memory on which the lock is based. The lock can not be used after
+ * this function returns.
+ *
+ * @retval RWL_SUCCESS  Success or "lock" was NULL
+ * @retval RWL_EXIST    The lock is locked. log_add() called.
+ * @retval RWL_SYSTEM   System error. See "errno". log_add() called. The state
+ *                      of "*lock" is unspecified.
+ */
+srwl_Status srwl_free(
+        srwl_Lock* const lock /**< [in] pointer to the lock or NULL */)
+{
+    srwl_Status status = RWL_SUCCESS;
+
+    if (NULL == lock) {
+        status = RWL_SUCCESS;
+    }
+    else {
+        status = vet(lock);
+
+        if (RWL_SUCCESS == status) {
+            if (0 != lock->numWriteLocks || 0 != lock->numReadLocks) {
+                LOG_ADD3("Lock is locked: key=%#lx, numReadLocks=%u, "
+                "numWriteLocks=%u", (unsigned long)lock->key,
+                        lock->numReadLocks, lock->numWriteLocks);
+                status = RWL_EXIST;
+            }
+
+            if (RWL_SUCCESS == status)
+                freeLock(lock);
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Locks a read/write lock for writing. Waits until the lock is available.
+ * Reentrant.
+ *
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_INVALID  Lock structure is invalid. log_add() called.
+ * @retval RWL_EXIST    Lock is locked for reading and the current process is
+ *                      the one that created it. log_add() called.
+ * @retval RWL_SYSTEM   System error. See "errno". log_add() called. Resulting
+ *                      state of the lock is unspecified.
+ */
+srwl_Status srwl_writeLock(
+        srwl_Lock* const lock /**< [in/out] the lock to be locked */)
+{
+    srwl_Status status = vet(lock);
+
+    if (RWL_SUCCESS == status) {
+        if (0 < lock->numReadLocks) {
+            LOG_ADD1("Lock is locked for reading; key=%#lx",
+                    (unsigned long)lock->key);
+            status = RWL_EXIST;
+        }
+        else if (0 < lock->numWriteLocks) {
+            lock->numWriteLocks++;
+            status = RWL_SUCCESS;
+        }
+        else {
+            Shared* const  shared = lock->shared;
+            const uint32_t mine = WORD_WRITER | (uint32_t) lock->pid;
+            uint32_t       value = 0;
+
+            while (!__atomic_compare_exchange_n(&shared->word, &value, mine,
+                    0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                waitForWriter(shared, value);
+                value = 0;
+            }
+
+            waitForReaders(shared);
+
+            lock->numWriteLocks = 1;
+            status = RWL_SUCCESS;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Locks a read/write lock for reading. Waits until the lock is available.
+ * Reentrant.
+ *
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_INVALID  Lock structure is invalid. log_add() called.
+ * @retval RWL_EXIST    Lock is locked for writing and the current process is
+ *                      the one that created it. log_add() called.
+ * @retval RWL_SYSTEM   System error. See "errno". log_add() called. Resulting
+ *                      state of the lock is unspecified.
+ */
+srwl_Status srwl_readLock(
+        srwl_Lock* const lock /**< [in/out] the lock to be locked */)
+{
+    srwl_Status status = vet(lock);
+
+    if (RWL_SUCCESS == status) {
+        if (0 < lock->numWriteLocks) {
+            LOG_ADD1("Lock is locked for writing; key=%#lx",
+                    (unsigned long)lock->key);
+            status = RWL_EXIST;
+        }
+        else if (0 < lock->numReadLocks) {
+            lock->numReadLocks++;
+            status = RWL_SUCCESS;
+        }
+        else if (0 > lock->slot && (status = claimSlot(lock)) != 0) {
+            LOG_ADD1("Couldn't lock for reading; key=%#lx",
+                    (unsigned long)lock->key);
+        }
+        else {
+            Shared* const shared = lock->shared;
+
+            for (;;) {
+                uint32_t value;
+
+                /*
+                 * The slot is marked before the lock-word is examined and a
+                 * writer does the opposite; so, one of them sees the other.
+                 */
+                setReading(lock, 1);
+
+                value = __atomic_load_n(&shared->word, __ATOMIC_SEQ_CST);
+
+                if (0 == (value & WORD_WRITER))
+                    break;
+
+                setReading(lock, 0);
+                waitForWriter(shared, value);
+            }
+
+            lock->numReadLocks = 1;
+            status = RWL_SUCCESS;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Unlocks a read/write lock. Must be called as many times as the lock was
+ * locked before the lock will be truly unlocked.
+ *
+ * @retval RWL_SUCCESS  Success
+ * @retval RWL_INVALID  Lock structure is invalid. log_add() called.
+ * @retval RWL_SYSTEM   System error. See "errno". log_add() called. Resulting
+ *                      state of the lock is unspecified.
+ */
+srwl_Status srwl_unlock(
+        srwl_Lock* const lock /**< [in/out] the lock to be unlocked */)
+{
+    srwl_Status status = vet(lock);
+
+    if (RWL_SUCCESS == status) {
+        if (1 < lock->numWriteLocks) {
+            lock->numWriteLocks--;
+        }
+        else if (1 == lock->numWriteLocks) {
+            Shared* const shared = lock->shared;
+
+            if (__atomic_exchange_n(&shared->word, 0, __ATOMIC_SEQ_CST)
+                    & WORD_WAITERS)
+                futexWake(&shared->word);
+
+            lock->numWriteLocks--;
+        }
+        else if (1 < lock->numReadLocks) {
+            lock->numReadLocks--;
+        }
+        else if (1 == lock->numReadLocks) {
+            setReading(lock, 0);
+            lock->numReadLocks--;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,674 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * This module caches the results of hostname and IP address lookups in
+ * anonymous shared memory.  The top-level LDM server creates the cache before
+ * it forks, so a downstream host that reconnects -- or many that reconnect at
+ * once after a network outage -- is resolved once rather than once per
+ * connection.
+ *
+ * The cache is a fixed-size, open-addressed hash table.  An entry is found
+ * within HC_PROBES slots of its hash; if none of them is free, the least
+ * recently resolved one is replaced.  The table is protected by a robust,
+ * process-shared mutex that's never held during a lookup, so a process that
+ * dies while holding it doesn't block the others.
+ *
+ * An entry is fresh for its time-to-live.  For another time-to-live after
+ * that, it's returned as-is while one process refreshes it on a detached
+ * thread.  A refresh that fails because the resolver is temporarily
+ * unavailable doesn't replace a successful entry.
+ *
+ * The time-to-lives are the registry parameters /server/host-cache/ttl and
+ * /server/host-cache/negative-ttl.  A zero /server/host-cache/ttl makes the
+ * lookups use the resolver directly.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hostCache.h"
+#include "log.h"
+#include "registry.h"
+#include "timestamp.h"
+#include "ulog.h"
+
+#define HC_CAPACITY             2048    /* number of entries */
+#define HC_PROBES               8       /* maximum slots searched */
+#define HC_NAME_MAX             255     /* maximum length of a hostname */
+#define HC_REFRESH_TIMEOUT      60      /* seconds before a refresh is retried */
+
+typedef enum {
+    ENTRY_EMPTY = 0,
+    ENTRY_BY_ADDR,                      /* key is "addr"; value is "name" */
+    ENTRY_BY_NAME                       /* key is "name"; value is "addrs" */
+} EntryType;
+
+typedef struct {
+    EntryType           type;
+    int                 status;         /* lookup status */
+    time_t              resolved;       /* time of lookup */
+    time_t              expires;        /* time when stale */
+    time_t              refreshStart;   /* start of refresh or 0 */
+    in_addr_t           addr;
+    unsigned            addrCount;
+    in_addr_t           addrs[HC_MAX_ADDRS];
+    char                name[HC_NAME_MAX+1];
+} Entry;
+
+typedef struct {
+    pthread_mutex_t     mutex;
+    hc_Stats            stats;
+    Entry               entries[HC_CAPACITY];
+} Cache;
+
+/*
+ * Key and value of a lookup.
+ */
+typedef struct {
+    EntryType           type;
+    int                 status;
+    in_addr_t           addr;
+    unsigned            addrCount;
+    in_addr_t           addrs[HC_MAX_ADDRS];
+    char                name[HC_NAME_MAX+1];
+} Lookup;
+
+static Cache*           cache;
+static int              initFailed;
+static unsigned         hcTtl;
+static unsigned         hcNegativeTtl;
+static int              hcIsSet;
+static pid_t            noRefreshPid;   /* process that mustn't refresh */
+
+/*
+ * Obtains the time-to-lives from the registry if they haven't been set.
+ */
+static void
+hc_ensureConfig(void)
+{
+    if (!hcIsSet) {
+        hcTtl = reg_getUintOrDefault(REG_HOST_CACHE_TTL, 3600);
+        hcNegativeTtl = reg_getUintOrDefault(REG_HOST_CACHE_NEGATIVE_TTL, 60);
+        hcIsSet = 1;
+    }
+}
+
+/*
+ * Locks the cache.  Recovers the mutex if its holder died.
+ */
+static void
+hc_lock(void)
+{
+    if (EOWNERDEAD == pthread_mutex_lock(&cache->mutex))
+        (void)pthread_mutex_consistent(&cache->mutex);
+}
+
+static void
+hc_unlock(void)
+{
+    (void)pthread_mutex_unlock(&cache->mutex);
+}
+
+/*
+ * Returns the hash of a lookup's key.
+ */
+static unsigned
+lookup_hash(
+    const Lookup* const lookup)
+{
+    unsigned    hash;
+
+    if (ENTRY_BY_ADDR == lookup->type) {
+        hash = (unsigned)lookup->addr * 2654435761u;
+    }
+    else {
+        const unsigned char*    cp;
+
+        hash = 2166136261u;                     /* FNV-1a */
+        for (cp = (const unsigned char*)lookup->name; *cp; cp++) {
+            hash ^= (unsigned)(*cp | 0x20);     /* hostnames ignore case */
+            hash *= 16777619u;
+        }
+    }
+
+    return hash % HC_CAPACITY;
+}
+
+/*
+ * Indicates if an entry is for a lookup's key.
+ */
+static int
+entry_matches(
+    const Entry* const  entry,
+    const Lookup* const lookup)
+{
+    return entry->type == lookup->type &&
+            (ENTRY_BY_ADDR == lookup->type
+                ? entry->addr == lookup->addr
+                : strcasecmp(entry->name, lookup->name) == 0);
+}
+
+/*
+ * Returns the entry for a lookup's key.  The cache must be locked.
+ *
+ * Arguments:
+ *      lookup          The lookup.
+ *      replace         Whether or not to return the entry that should be
+ *                      replaced if there's no entry for the key.
+ * Returns:
+ *      NULL            There's no entry for the key and "replace" is false.
+ *      else            The entry.
+ */
+static Entry*
+hc_find(
+    const Lookup* const lookup,
+    const int           replace)
+{
+    const unsigned      hash = lookup_hash(lookup);
+    Entry*              victim = NULL;
+    unsigned            i;
+
+    for (i = 0; i < HC_PROBES; i++) {
+        Entry* const    entry = cache->entries + (hash + i) % HC_CAPACITY;
+
+        if (ENTRY_EMPTY == entry->type)
+            return replace ? entry : NULL;
+        if (entry_matches(entry, lookup))
+            return entry;
+        if (NULL == victim || entry->resolved < victim->resolved)
+            victim = entry;
+    }
+
+    return replace ? victim : NULL;
+}
+
+/*
+ * Returns the time-to-live of an entry with a given status.
+ */
+static unsigned
+ttlOf(
+    const int   status)
+{
+    return 0 == status ? hcTtl : hcNegativeTtl;
+}
+
+/*
+ * Sets a lookup's value from the resolver.
+ */
+static void
+lookup_resolve(
+    Lookup* const       lookup)
+{
+    int status;
+
+    if (ENTRY_BY_ADDR == lookup->type) {
+        struct sockaddr_in      sockAddr;
+
+        (void)memset(&sockAddr, 0, sizeof(sockAddr));
+        sockAddr.sin_family = AF_INET;
+        sockAddr.sin_addr.s_addr = lookup->addr;
+
+        status = getnameinfo((struct sockaddr*)&sockAddr, sizeof(sockAddr),
+                lookup->name, sizeof(lookup->name), NULL, 0, NI_NAMEREQD);
+    }
+    else {
+        struct addrinfo         hints;
+        struct addrinfo*        addrInfo;
+
+        (void)memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+
+        status = getaddrinfo(lookup->name, NULL, &hints, &addrInfo);
+
+        if (0 == status) {
+            const struct addrinfo*      ai;
+
+            lookup->addrCount = 0;
+
+            for (ai = addrInfo; ai && lookup->addrCount < HC_MAX_ADDRS;
+                    ai = ai->ai_next) {
+                const in_addr_t addr =
+                    ((struct sockaddr_in*)ai->ai_addr)->sin_addr.s_addr;
+                unsigned        i;
+
+                for (i = 0; i < lookup->addrCount; i++)
+                    if (lookup->addrs[i] == addr)
+                        break;
+                if (i == lookup->addrCount)
+                    lookup->addrs[lookup->addrCount++] = addr;
+            }
+
+            freeaddrinfo(addrInfo);
+        }
+    }
+
+    lookup->status =
+        0 == status             ? 0 :
+        EAI_NONAME == status    ? ENOENT :
+#ifdef EAI_NODATA
+        EAI_NODATA == status    ? ENOENT :
+#endif
+        EAI_AGAIN == status     ? EAGAIN :
+        EAI_MEMORY == status    ? ENOMEM :
+        EAI_SYSTEM == status    ? errno :
+                                  ENOSYS;
+}
+
+/*
+ * Sets a lookup's value from the resolver and saves it in the cache if the
+ * cache exists.
+ */
+static void
+hc_resolve(
+    Lookup* const       lookup)
+{
+    timestampt          start;
+    timestampt          stop;
+    double              latency;
+
+    (void)set_timestamp(&start);
+    lookup_resolve(lookup);
+    (void)set_timestamp(&stop);
+
+    latency = d_diff_timestamp(&stop, &start);
+
+    if (cache) {
+        hc_Stats* const stats = &cache->stats;
+        const time_t    now = time(NULL);
+        double          limit = 0.001;
+        unsigned        i;
+
+        hc_lock();
+
+        stats->lookups++;
+        if (lookup->status)
+            stats->failures++;
+        stats->totalLatency += latency;
+        if (latency > stats->maxLatency)
+            stats->maxLatency = latency;
+        for (i = 0; i < HC_NUM_LATENCIES - 1 && latency >= limit; i++)
+            limit *= 10;
+        stats->latencies[i]++;
+
+        if (hcTtl) {
+            Entry* const        entry = hc_find(lookup, 1);
+
+            if (EAGAIN == lookup->status && entry_matches(entry, lookup) &&
+                    0 == entry->status) {
+                /* Keep the successful entry and retry later */
+                entry->expires = now + hcNegativeTtl;
+            }
+            else {
+                entry->type = lookup->type;
+                entry->status = lookup->status;
+                entry->resolved = now;
+                entry->expires = now + ttlOf(lookup->status);
+                entry->addr = lookup->addr;
+                entry->addrCount = lookup->addrCount;
+                (void)memcpy(entry->addrs, lookup->addrs,
+                        sizeof(entry->addrs));
+                (void)strcpy(entry->name, lookup->name);
+            }
+
+            entry->refreshStart = 0;
+        }
+
+        hc_unlock();
+    }
+}
+
+/*
+ * Refreshes an entry.  Executed on a detached thread.
+ */
+static void*
+hc_refresh(
+    void* const arg)
+{
+    Lookup* const       lookup = (Lookup*)arg;
+
+    hc_resolve(lookup);
+    free(lookup);
+
+    return NULL;
+}
+
+/*
+ * Starts refreshing an entry on a detached thread.
+ */
+static void
+hc_startRefresh(
+    const Lookup* const lookup)
+{
+    Lookup* const       copy = (Lookup*)malloc(sizeof(Lookup));
+
+    if (NULL == copy) {
+        LOG_SERROR0("Couldn't allocate host-cache refresh");
+        log_log(LOG_WARNING);
+    }
+    else {
+        pthread_attr_t  attr;
+        pthread_t       thread;
+        sigset_t        sigSet;
+        sigset_t        origSigSet;
+        int             status;
+
+        *copy = *lookup;
+
+        /*
+         * Signals are handled by the calling thread only.
+         */
+        (void)pthread_attr_init(&attr);
+        (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        (void)sigfillset(&sigSet);
+        (void)pthread_sigmask(SIG_BLOCK, &sigSet, &origSigSet);
+        status = pthread_create(&thread, &attr, hc_refresh, copy);
+        (void)pthread_sigmask(SIG_SETMASK, &origSigSet, NULL);
+        (void)pthread_attr_destroy(&attr);
+
+        if (status) {
+            LOG_ERRNUM0(status, "Couldn't create host-cache refresh thread");
+            log_log(LOG_WARNING);
+            free(copy);
+        }
+    }
+}
+
+/*
+ * Sets a lookup's value from the cache or, if necessary, the resolver.
+ */
+static void
+hc_lookup(
+    Lookup* const       lookup)
+{
+    int isCached = 0;
+    int refresh = 0;
+
+    hc_ensureConfig();
+
+    if (hcTtl && (cache || 0 == hc_init())) {
+        const time_t    now = time(NULL);
+        Entry*          entry;
+
+        hc_lock();
+
+        entry = hc_find(lookup, 0);
+
+        if (entry && now < entry->expires + (time_t)ttlOf(entry->status)) {
+            lookup->status = entry->status;
+            lookup->addrCount = entry->addrCount;
+            (void)memcpy(lookup->addrs, entry->addrs, sizeof(lookup->addrs));
+            (void)strcpy(lookup->name, entry->name);
+            isCached = 1;
+
+            if (now < entry->expires) {
+                if (entry->status) {
+                    cache->stats.negativeHits++;
+                }
+                else {
+                    cache->stats.hits++;
+                }
+            }
+            else {
+                cache->stats.staleHits++;
+
+                if (getpid() != noRefreshPid && (0 == entry->refreshStart ||
+                        now - entry->refreshStart >= HC_REFRESH_TIMEOUT)) {
+                    entry->refreshStart = now;
+                    cache->stats.refreshes++;
+                    refresh = 1;
+                }
+            }
+        }
+        else {
+            cache->stats.misses++;
+        }
+
+        hc_unlock();
+    }
+
+    if (!isCached) {
+        hc_resolve(lookup);
+    }
+    else if (refresh) {
+        hc_startRefresh(lookup);
+    }
+}
+
+/**
+ * Sets the time-to-live of the cache entries instead of obtaining them from
+ * the registry.
+ *
+ * @param ttl           [in] Time-to-live, in seconds, of the entries of
+ *                      successful lookups.  0 disables the cache.
+ * @param negativeTtl   [in] Time-to-live, in seconds, of the entries of failed
+ *                      lookups.
+ */
+void
+hc_setConfig(
+    const unsigned      ttl,
+    const unsigned      negativeTtl)
+{
+    hcTtl = ttl;
+    hcNegativeTtl = negativeTtl;
+    hcIsSet = 1;
+
+    if (cache) {
+        hc_lock();
+        (void)memset(cache->entries, 0, sizeof(cache->entries));
+        hc_unlock();
+    }
+}
+
+/**
+ * Creates the cache if it doesn't exist.  The cache is shared with processes
+ * that are subsequently forked.  Idempotent.  Called by the lookup functions
+ * if necessary.
+ *
+ * @retval 0            Success.
+ * @return              System error code.  log_start() called.  The lookup
+ *                      functions will use the resolver directly.
+ */
+int
+hc_init(void)
+{
+    pthread_mutexattr_t attr;
+    Cache*              newCache;
+    int                 status;
+
+    if (cache)
+        return 0;
+    if (initFailed)
+        return ENOMEM;
+
+    newCache = (Cache*)mmap(NULL, sizeof(Cache), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANON, -1, 0);
+
+    if (MAP_FAILED == newCache) {
+        status = errno;
+        LOG_SERROR0("Couldn't allocate shared memory for host cache");
+    }
+    else {
+        (void)pthread_mutexattr_init(&attr);
+        (void)pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        (void)pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        status = pthread_mutex_init(&newCache->mutex, &attr);
+        (void)pthread_mutexattr_destroy(&attr);
+
+        if (status) {
+            LOG_ERRNUM0(status, "Couldn't initialize host-cache mutex");
+            (void)munmap(newCache, sizeof(Cache));
+        }
+        else {
+            cache = newCache;       /* mapping is zero-filled */
+        }
+    }
+
+    if (status)
+        initFailed = 1;
+
+    return status;
+}
+
+/**
+ * Prevents the calling process, but not the processes that it subsequently
+ * forks, from refreshing expired entries on a separate thread.
+ */
+void
+hc_disableRefreshThreads(void)
+{
+    noRefreshPid = getpid();
+}
+
+/**
+ * Indicates if lookups are cached, i.e., if the time-to-live isn't zero and the
+ * cache exists.
+ *
+ * @retval 0            Lookups use the resolver directly.
+ * @retval 1            Lookups are cached.
+ */
+int
+hc_isEnabled(void)
+{
+    hc_ensureConfig();
+
+    return hcTtl && NULL != cache;
+}
+
+/**
+ * Returns the name of the host that has a given IP address.
+ *
+ * @param addr          [in] The IP address in network byte order.
+ * @param name          [out] The name of the host.  Set on and only on
+ *                      success.
+ * @param size          [in] The size of "name" in bytes.  The name is
+ *                      truncated if necessary.
+ * @retval 0            Success.
+ * @retval ENOENT       The IP address doesn't resolve to a hostname.
+ * @retval EAGAIN       The resolver is temporarily unavailable.
+ * @return              Other resolver or system error code.
+ */
+int
+hc_getName(
+    const in_addr_t     addr,
+    char* const         name,
+    const size_t        size)
+{
+    Lookup      lookup;
+
+    lookup.type = ENTRY_BY_ADDR;
+    lookup.addr = addr;
+    lookup.addrCount = 0;
+    lookup.name[0] = 0;
+
+    hc_lookup(&lookup);
+
+    if (0 == lookup.status && size > 0) {
+        (void)strncpy(name, lookup.name, size);
+        name[size-1] = 0;
+    }
+
+    return lookup.status;
+}
+
+/**
+ * Returns the IP addresses of a host.
+ *
+ * @param name          [in] The name of the host.
+ * @param addrs         [out] The IP addresses in network byte order.  Must
+ *                      have room for HC_MAX_ADDRS addresses.  Set on and only
+ *                      on success.
+ * @param count         [out] The number of IP addresses.  Set on and only on
+ *                      success.
+ * @retval 0            Success.
+ * @retval ENOENT       The hostname doesn't resolve to an IPv4 address.
+ * @retval EAGAIN       The resolver is temporarily unavailable.
+ * @return              Other resolver or system error code.
+ */
+int
+hc_getAddrs(
+    const char* const   name,
+    in_addr_t* const    addrs,
+    unsigned* const     count)
+{
+    Lookup      lookup;
+
+    if (strlen(name) > HC_NAME_MAX)
+        return ENOENT;
+
+    lookup.type = ENTRY_BY_NAME;
+    lookup.addr = 0;
+    lookup.addrCount = 0;
+    (void)strcpy(lookup.name, name);
+
+    hc_lookup(&lookup);
+
+    if (0 == lookup.status) {
+        if (0 == lookup.addrCount)
+            return ENOENT;
+
+        (void)memcpy(addrs, lookup.addrs, lookup.addrCount * sizeof(in_addr_t));
+        *count = lookup.addrCount;
+    }
+
+    return lookup.status;
+}
+
+/**
+ * Returns the cache metrics.
+ *
+ * @param stats         [out] The metrics.  Cleared if the cache doesn't exist.
+ */
+void
+hc_getStats(
+    hc_Stats* const     stats)
+{
+    if (NULL == cache) {
+        (void)memset(stats, 0, sizeof(*stats));
+    }
+    else {
+        hc_lock();
+        *stats = cache->stats;
+        hc_unlock();
+    }
+}
+
+/**
+ * Logs the cache metrics.
+ *
+ * @param level         [in] The logging level (e.g., LOG_NOTICE).
+ */
+void
+hc_logStats(
+    const int           level)
+{
+    hc_Stats    stats;
+    const unsigned long* const n = stats.latencies;
+
+    hc_getStats(&stats);
+
+    LOG_START5("Host cache: %lu hits, %lu negative hits, %lu stale hits, "
+            "%lu misses, %lu refreshes", stats.hits, stats.negativeHits,
+            stats.staleHits, stats.misses, stats.refreshes);
+    LOG_ADD4("Resolver: %lu lookups, %lu failed, mean %.3f s, max %.3f s",
+            stats.lookups, stats.failures,
+            stats.lookups ? stats.totalLatency / stats.lookups : 0.0,
+            stats.maxLatency);
+    LOG_ADD6("Resolver latencies: <1ms %lu, <10ms %lu, <100ms %lu, <1s %lu, "
+            "<10s %lu, >=10s %lu", n[0], n[1], n[2], n[3], n[4], n[5]);
+    log_log(level);
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * This header-file specifies the API for the cache of hostname and IP address
+ * lookups.  The cache is in shared memory so that the processes that are
+ * forked after it's created (e.g., by the top-level LDM server) use the
+ * results of each other's lookups.  Entries expire after a time-to-live;
+ * failed lookups are also cached, but for a shorter time.  An expired entry is
+ * still returned for another time-to-live while it's refreshed on a separate
+ * thread so that a slow resolver doesn't delay the caller.
+ */
+
+#ifndef HOST_CACHE_H
+#define HOST_CACHE_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of IP addresses returned for a hostname.
+ */
+#define HC_MAX_ADDRS    8
+
+/**
+ * Number of buckets in the histogram of resolver latencies.  Bucket i counts
+ * the lookups that took less than 10^(i-3) seconds; the last bucket counts the
+ * rest.
+ */
+#define HC_NUM_LATENCIES        6
+
+/**
+ * Cache metrics.  They're totals over all the processes that share the cache.
+ */
+typedef struct {
+    unsigned long       hits;           /**< Unexpired successful entries */
+    unsigned long       negativeHits;   /**< Unexpired failed entries */
+    unsigned long       staleHits;      /**< Expired entries being refreshed */
+    unsigned long       misses;         /**< Lookups by the caller */
+    unsigned long       refreshes;      /**< Lookups on a separate thread */
+    unsigned long       lookups;        /**< Resolver lookups */
+    unsigned long       failures;       /**< Failed resolver lookups */
+    double              totalLatency;   /**< Sum of resolver latencies in s */
+    double              maxLatency;     /**< Maximum resolver latency in s */
+    unsigned long       latencies[HC_NUM_LATENCIES]; /**< Latency histogram */
+} hc_Stats;
+
+/**
+ * Sets the time-to-live of the cache entries instead of obtaining them from
+ * the registry.
+ *
+ * @param ttl           [in] Time-to-live, in seconds, of the entries of
+ *                      successful lookups.  0 disables the cache.
+ * @param negativeTtl   [in] Time-to-live, in seconds, of the entries of failed
+ *                      lookups.
+ */
+void
+hc_setConfig(
+    const unsigned      ttl,
+    const unsigned      negativeTtl);
+
+/**
+ * Creates the cache if it doesn't exist.  The cache is shared with processes
+ * that are subsequently forked.  Idempotent.  Called by the lookup functions
+ * if necessary.
+ *
+ * @retval 0            Success.
+ * @return              System error code.  log_start() called.  The lookup
+ *                      functions will use the resolver directly.
+ */
+int
+hc_init(void);
+
+/**
+ * Prevents the calling process, but not the processes that it subsequently
+ * forks, from refreshing expired entries on a separate thread: such a thread
+ * can hold a lock (e.g., of the memory allocator) while it waits on the
+ * resolver, and a process forked at that moment would never be able to
+ * acquire it.  The calling process leaves the refreshing of an expired entry
+ * to another process and looks it up itself once the entry can no longer be
+ * returned.  Should be called by a process that forks.
+ */
+void
+hc_disableRefreshThreads(void);
+
+/**
+ * Indicates if lookups are cached, i.e., if the time-to-live isn't zero and the
+ * cache exists.
+ *
+ * @retval 0            Lookups use the resolver directly.
+ * @retval 1            Lookups are cached.
+ */
+int
+hc_isEnabled(void);
+
+/**
+ * Returns the name of the host that has a given IP address.
+ *
+ * @param addr          [in] The IP address in network byte order.
+ * @param name          [out] The name of the host.  Set on and only on
+ *                      success.
+ * @param size          [in] The size of "name" in bytes.  The name is
+ *                      truncated if necessary.
+ * @retval 0            Success.
+ * @retval ENOENT       The IP address doesn't resolve to a hostname.
+ * @retval EAGAIN       The resolver is temporarily unavailable.
+ * @return              Other resolver or system error code.
+ */
+int
+hc_getName(
+    const in_addr_t     addr,
+    char* const         name,
+    const size_t        size);
+
+/**
+ * Returns the IP addresses of a host.
+ *
+ * @param name          [in] The name of the host.
+ * @param addrs         [out] The IP addresses in network byte order.  Must
+ *                      have room for HC_MAX_ADDRS addresses.  Set on and only
+ *                      on success.
+ * @param count         [out] The number of IP addresses.  Set on and only on
+ *                      success.
+ * @retval 0            Success.
+ * @retval ENOENT       The hostname doesn't resolve to an IPv4 address.
+ * @retval EAGAIN       The resolver is temporarily unavailable.
+ * @return              Other resolver or system error code.
+ */
+int
+hc_getAddrs(
+    const char* const   name,
+    in_addr_t* const    addrs,
+    unsigned* const     count);
+
+/**
+ * Returns the cache metrics.
+ *
+ * @param stats         [out] The metrics.  Cleared if the cache doesn't exist.
+ */
+void
+hc_getStats(
+    hc_Stats* const     stats);
+
+/**
+ * Logs the cache metrics.
+ *
+ * @param level         [in] The logging level (e.g., LOG_NOTICE).
+ */
+void
+hc_logStats(
+    const int           level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
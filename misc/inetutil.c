@@ -10,6 +10,7 @@
 #include <config.h>
 
 #include "error.h"
+#include "hostCache.h"
 #include "ulog.h"
 #include "ldm.h"
 #include "ldmprint.h"
@@ -173,7 +174,7 @@ ghostname(void)
 /*
  * Returns a string identifying the Internet host referred to by an Internet
  * address. If the hostname lookup fails, then the "dotted quad" form of the
- * address is returned.
+ * address is returned.  Lookups are cached (see hostCache.h).
  * Arguments:
  *      paddr   Pointer to the Internet address structure.
  * Returns:
@@ -183,30 +184,28 @@ const char*
 hostbyaddr(
     const struct sockaddr_in* const     paddr)
 {
-    struct hostent*     hp;
+    static char         name[MAXHOSTNAMELEN];
     const char*         identifier;
-    struct in_addr      addr;
     timestampt          start;
     timestampt          stop;
     double              elapsed;
     ErrorObj*           error;
-
-    addr.s_addr = paddr->sin_addr.s_addr;
+    int                 status;
 
     (void)set_timestamp(&start);
-    hp = gethostbyaddr((char *)&addr, sizeof (addr), AF_INET);
+    status = hc_getName(paddr->sin_addr.s_addr, name, sizeof(name));
     (void)set_timestamp(&stop);
 
     elapsed = d_diff_timestamp(&stop, &start);
 
-    if(hp == NULL) {
+    if (status) {
         identifier = inet_ntoa(paddr->sin_addr);
         error = ERR_NEW2(0, NULL,
             "Couldn't resolve \"%s\" to a hostname in %g seconds",
             identifier, elapsed);
     }
     else {
-        identifier = hp->h_name;
+        identifier = name;
 
         if (elapsed < RESOLVER_TIME_THRESHOLD && !ulogIsVerbose()) {
             error = NULL;
@@ -261,31 +260,24 @@ addrbyhost(
         timestampt      start;
         timestampt      stop;
         double          elapsed;
-        ErrorObj*        error;
-        struct hostent* hp;
+        ErrorObj*       error;
+        in_addr_t       addrs[HC_MAX_ADDRS];
+        unsigned        count;
         
         (void)set_timestamp(&start);
-        hp = gethostbyname(id);
+        errCode = hc_getAddrs(id, addrs, &count);
         (void)set_timestamp(&stop);
 
         elapsed = d_diff_timestamp(&stop, &start);
 
-        if (hp == NULL) {
+        if (errCode) {
             error = ERR_NEW2(0, NULL,
                 "Couldn't resolve \"%s\" to an Internet address in %g seconds",
                 id, elapsed);
             errCode = -1;               /* failure */
         }
-        else if (hp->h_addrtype != AF_INET) {
-            err_log_and_free(
-                ERR_NEW1(0, NULL, "\"%s\" isn't an Internet host identifier",
-                    id),
-                ERR_WARNING);
-            error = NULL;
-            errCode = -1;               /* failure */
-        } else {
-            (void) memcpy((char *)&paddr->sin_addr, hp->h_addr_list[0],
-                (size_t)hp->h_length);
+        else {
+            paddr->sin_addr.s_addr = addrs[0];
 
             if (elapsed < RESOLVER_TIME_THRESHOLD && !ulogIsVerbose()) {
                 error = NULL;
@@ -314,7 +306,8 @@ addrbyhost(
 
 /*
  * Indicates if a host identifier has a given IP address.
- * Potentially lengthy operation.
+ * Potentially lengthy operation unless the hostname is cached (see
+ * hostCache.h).
  * Arguments:
  *      id              Name of the host or dotted-quad IP address.
  *      targetAddr      Target IP address.
@@ -323,8 +316,7 @@ addrbyhost(
  * Returns:
  *      NULL    Success.  See *hasAddress for the result.
  *      else    An error occurred.  *hasAddress is not set.  Error codes:
- *                      1       gethostbyname() failure
- *                      2       "id" isn't an Internet host identifier
+ *                      1       Hostname lookup failure
  */
 ErrorObj*
 hostHasIpAddress(
@@ -345,39 +337,34 @@ hostHasIpAddress(
         timestampt              start;
         timestampt              stop;
         double                  elapsed;
-        const struct hostent*   hp;
+        in_addr_t               addrs[HC_MAX_ADDRS];
+        unsigned                count;
+        int                     status;
 
         (void)set_timestamp(&start);
-        hp = gethostbyname(id);
+        status = hc_getAddrs(id, addrs, &count);
         (void)set_timestamp(&stop);
 
         elapsed = d_diff_timestamp(&stop, &start);
 
-        if (hp == NULL) {
+        if (status) {
             error = ERR_NEW2(1, 
-                ERR_NEW(h_errno, NULL,
-                    h_errno == HOST_NOT_FOUND   ? "host not found" :
-                    h_errno == NO_DATA          ? "no data on host" :
-                    h_errno == NO_RECOVERY      ? "unrecoverable server error" :
-                    h_errno == TRY_AGAIN        ? "hostname lookup timeout" :
-                                                  "unknown error"),
+                ERR_NEW(status, NULL,
+                    status == ENOENT            ? "host not found" :
+                    status == EAGAIN            ? "hostname lookup timeout" :
+                                                  strerror(status)),
             "Couldn't resolve \"%s\" to an Internet address in %g seconds",
                 id, elapsed);
         }
-        else if (hp->h_addrtype != AF_INET) {
-            error = ERR_NEW1(2, NULL,
-                "\"%s\" isn't an Internet host identifier", id);
-        } else {
-            const struct in_addr* const*        in_addr_pp;
-
-            for (in_addr_pp = (const struct in_addr* const*)hp->h_addr_list;
-                     *in_addr_pp != NULL;
-                     in_addr_pp++) {
-                if ((*in_addr_pp)->s_addr == targetAddr)
+        else {
+            unsigned    i;
+
+            for (i = 0; i < count; i++) {
+                if (addrs[i] == targetAddr)
                     break;
             }
 
-            *hasAddress = *in_addr_pp != NULL;
+            *hasAddress = i < count;
 
             if (elapsed >= RESOLVER_TIME_THRESHOLD || ulogIsVerbose()) {
                 err_log_and_free(
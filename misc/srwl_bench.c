@@ -0,0 +1,219 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research. All rights
+ * reserved.
+ *
+ * See file COPYRIGHT in the top-level source-directory for legal conditions.
+ */
+
+/*
+ * Microbenchmark of the read/write lock of semRWLock.h. Processes repeatedly
+ * lock the lock for reading or writing, read or increment a counter in
+ * shared-memory, and unlock the lock. The counter is verified at the end. Run
+ * both "srwl_bench", which uses the lock that the package was configured to
+ * use, and "srwl_bench_sem", which uses the semaphore-based lock, to compare
+ * them.
+ *
+ * Usage: srwl_bench [-p procs] [-n count] [-r percent] [-d dir]
+ *
+ *     -p procs    Maximum number of processes (default 4). The benchmark is
+ *                 run for 1, 2, 4, ... up to this number.
+ *     -n count    Number of locks per process (default 200000).
+ *     -r percent  Percentage of locks that are for reading (default 90).
+ *     -d dir      Directory for the file that keys the lock (default /tmp).
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <log.h>
+#include <ulog.h>
+
+#include "semRWLock.h"
+
+/*
+ * Shared-memory of the processes:
+ */
+typedef struct {
+    unsigned long       counter;        /* incremented under the write-lock */
+    unsigned long       writes;         /* number of write-locks */
+} Shared;
+
+/*
+ * Returns the current time in seconds.
+ */
+static double
+now(void)
+{
+    struct timeval      tv;
+
+    (void)gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Locks and unlocks the lock.  Exits.
+ */
+static void
+runLocker(
+    srwl_Lock* const            lock,
+    volatile Shared* const      shared,
+    const unsigned              count,
+    const unsigned              readPercent)
+{
+    unsigned            i;
+    unsigned long       sum = 0;
+    unsigned long       writes = 0;
+
+    srandom((unsigned)getpid());
+
+    for (i = 0; i < count; i++) {
+        const int       reading = (unsigned)random() % 100 < readPercent;
+
+        if (reading ? srwl_readLock(lock) : srwl_writeLock(lock)) {
+            log_log(LOG_ERR);
+            _exit(1);
+        }
+
+        if (reading) {
+            sum += shared->counter;
+        }
+        else {
+            shared->counter++;
+            writes++;
+        }
+
+        if (srwl_unlock(lock)) {
+            log_log(LOG_ERR);
+            _exit(1);
+        }
+    }
+
+    (void)__sync_fetch_and_add(&shared->writes, writes);
+    _exit(sum == (unsigned long)-1); /* uses "sum" */
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char*         dir = "/tmp";
+    unsigned            maxProcs = 4;
+    unsigned            count = 200000;
+    unsigned            readPercent = 90;
+    unsigned            nprocs;
+    char                path[256];
+    int                 ch;
+    int                 fd;
+    int                 stat;
+    int                 status = 0;
+    key_t               key;
+    srwl_Lock*          lock;
+    volatile Shared*    shared;
+
+    (void)openulog("srwl_bench", LOG_NOTIME | LOG_IDENT, LOG_LDM, "-");
+    (void)setulogmask(LOG_UPTO(LOG_WARNING));
+
+    while ((ch = getopt(argc, argv, "p:n:r:d:")) != -1) {
+        switch (ch) {
+        case 'p':
+            maxProcs = (unsigned)atoi(optarg);
+            break;
+        case 'n':
+            count = (unsigned)atoi(optarg);
+            break;
+        case 'r':
+            readPercent = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-p procs] [-n count] [-r percent] [-d dir]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    (void)snprintf(path, sizeof(path), "%s/srwl_bench-%d", dir,
+            (int)getpid());
+
+    if ((fd = open(path, O_WRONLY | O_CREAT, 0600)) < 0) {
+        serror("Couldn't create \"%s\"", path);
+        return 1;
+    }
+    (void)close(fd);
+
+    key = ftok(path, 1);
+    shared = (volatile Shared*)mmap(NULL, sizeof(Shared),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if ((key_t)-1 == key || MAP_FAILED == (void*)shared) {
+        serror("Couldn't initialize");
+        (void)unlink(path);
+        return 1;
+    }
+
+    if (srwl_create(key, &lock)) {
+        log_log(LOG_ERR);
+        (void)unlink(path);
+        return 1;
+    }
+
+    for (nprocs = 1; nprocs <= maxProcs; nprocs *= 2) {
+        double          start = now();
+        double          duration;
+        unsigned        n;
+
+        shared->counter = 0;
+        shared->writes = 0;
+        (void)fflush(stdout);
+
+        for (n = 0; n < nprocs; n++) {
+            pid_t       pid = fork();
+
+            if (pid < 0) {
+                serror("fork() failure");
+                status = 1;
+                break;
+            }
+            if (0 == pid)
+                runLocker(lock, shared, count, readPercent);
+        }
+
+        while (wait(&stat) > 0) {
+            if (!WIFEXITED(stat) || WEXITSTATUS(stat))
+                status = 1;
+        }
+
+        duration = now() - start;
+
+        if (shared->counter != shared->writes) {
+            (void)fprintf(stderr, "Lost writes: counter=%lu, writes=%lu\n",
+                    shared->counter, shared->writes);
+            status = 1;
+        }
+        if (status)
+            break;
+
+        (void)printf("%2u processes, %u%% reads: %u locks in %.3f s, "
+                "%.0f locks/s\n", nprocs, readPercent, nprocs * count,
+                duration, nprocs * count / duration);
+    }
+
+    (void)srwl_delete(lock);
+    (void)unlink(path);
+
+    return status;
+}
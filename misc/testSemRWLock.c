@@ -242,6 +242,47 @@ static void test_multiple_read(void) {
     CU_ASSERT_EQUAL(status, RWL_SUCCESS);
 }
 
+static void test_dead_holder(void) {
+    srwl_Lock* lock;
+    int       status;
+    int       forWriting;
+
+    status = srwl_create(key, &lock);
+    CU_ASSERT_EQUAL(status, RWL_SUCCESS);
+
+    /* A lock held by a terminated process is released */
+    for (forWriting = 0; forWriting <= 1; forWriting++) {
+        pid_t pid = fork();
+
+        CU_ASSERT_NOT_EQUAL(pid, -1);
+        if (0 == pid) {
+            /* Child */
+            _exit(RWL_SUCCESS == (forWriting
+                    ? srwl_writeLock(lock)
+                    : srwl_readLock(lock)) ? 0 : 1);
+        }
+        else {
+            /* Parent */
+            int stat;
+
+            status = waitpid(pid, &stat, 0);
+            CU_ASSERT_NOT_EQUAL(status, -1);
+            CU_ASSERT_TRUE(WIFEXITED(stat));
+            CU_ASSERT_EQUAL(WEXITSTATUS(stat), 0);
+
+            status = srwl_writeLock(lock);
+            CU_ASSERT_EQUAL(status, RWL_SUCCESS);
+            log_clear();
+
+            status = srwl_unlock(lock);
+            CU_ASSERT_EQUAL(status, RWL_SUCCESS);
+        }
+    }
+
+    status = srwl_delete(lock);
+    CU_ASSERT_EQUAL(status, RWL_SUCCESS);
+}
+
 int main(
         const int argc,
         const char* const * argv)
@@ -260,6 +301,7 @@ int main(
             CU_ADD_TEST(testSuite, test_read_lock);
             CU_ADD_TEST(testSuite, test_multiple_write);
             CU_ADD_TEST(testSuite, test_multiple_read);
+            CU_ADD_TEST(testSuite, test_dead_holder);
 
             if (-1 == openulog(progname, 0, LOG_LOCAL0, "-")) {
                 (void) fprintf(stderr, "Couldn't open logging system\n");
@@ -6,6 +6,7 @@
  */
 #include "config.h"
 
+#include "hostCache.h"
 #include "inetutil.h"
 #include "ldmprint.h"
 #include "log.h"
@@ -19,6 +20,7 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <syslog.h>
+#include <unistd.h>
 
 static int
 setup(void)
@@ -60,6 +62,62 @@ test_getDottedDecimal(void)
 }
 
 
+static void
+test_hostCache(void)
+{
+    struct sockaddr_in  addr;
+    hc_Stats            stats;
+    in_addr_t           addrs[HC_MAX_ADDRS];
+    unsigned            count;
+    char                name[256];
+    int                 status;
+
+    hc_setConfig(2, 2);
+    status = hc_init();
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+
+    status = addrbyhost("localhost", &addr);
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+    CU_ASSERT_EQUAL(addr.sin_addr.s_addr, inet_addr("127.0.0.1"));
+    status = addrbyhost("localhost", &addr);
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+    CU_ASSERT_EQUAL(addr.sin_addr.s_addr, inet_addr("127.0.0.1"));
+
+    status = hc_getName(inet_addr("127.0.0.1"), name, sizeof(name));
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+    status = hc_getName(inet_addr("127.0.0.1"), name, sizeof(name));
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+
+    status = hc_getAddrs("nonexistent.invalid", addrs, &count);
+    CU_ASSERT_NOT_EQUAL(status, 0);
+    CU_ASSERT_EQUAL(hc_getAddrs("nonexistent.invalid", addrs, &count), status);
+
+    hc_getStats(&stats);
+    CU_ASSERT_EQUAL(stats.misses, 3);
+    CU_ASSERT_EQUAL(stats.hits, 2);
+    CU_ASSERT_EQUAL(stats.negativeHits, 1);
+    CU_ASSERT_EQUAL(stats.lookups, 3);
+    CU_ASSERT_EQUAL(stats.failures, 1);
+
+    /* An expired entry is returned while it's refreshed */
+    (void)sleep(3);
+    status = addrbyhost("localhost", &addr);
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+    CU_ASSERT_EQUAL(addr.sin_addr.s_addr, inet_addr("127.0.0.1"));
+    (void)sleep(1);
+
+    hc_getStats(&stats);
+    CU_ASSERT_EQUAL(stats.staleHits, 1);
+    CU_ASSERT_EQUAL(stats.refreshes, 1);
+    CU_ASSERT_EQUAL(stats.lookups, 4);
+
+    status = addrbyhost("localhost", &addr);
+    CU_ASSERT_EQUAL_FATAL(status, 0);
+    hc_getStats(&stats);
+    CU_ASSERT_EQUAL(stats.hits, 3);
+}
+
+
 #if WANT_MULTICAST
 static void
 test_sa_getInetSockAddr(void)
@@ -153,6 +211,7 @@ main(
 
         if (NULL != testSuite) {
             CU_ADD_TEST(testSuite, test_getDottedDecimal);
+            CU_ADD_TEST(testSuite, test_hostCache);
 #           if WANT_MULTICAST
                 CU_ADD_TEST(testSuite, test_sa_getInetSockAddr);
                 CU_ADD_TEST(testSuite, test_sa_getInet6SockAddr);
@@ -5127,6 +5127,8 @@ pq_create(const char *path, mode_t mode,
                 status = errno;
                 goto unwind_new;
         }
+        /* programs executed by the calling process don't need the queue */
+        (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
         pq->fd = fd;
         
         status = ctl_init(pq, align);
@@ -5190,6 +5192,8 @@ pq_open(
             status = errno;
         }
         else {
+            /* programs executed by the calling process don't need the queue */
+            (void)fcntl(pq->fd, F_SETFD, FD_CLOEXEC);
             status = ctl_gopen(pq, path);
 
             if (!status) {
@@ -5853,56 +5857,44 @@ vetCreationTime(
 
 
 /*
- * Insert at rear of queue
- * (Don't signal process group.)
+ * Inserts a product at the rear of the queue.  The control-section must be
+ * write-locked.
  *
  * Returns:
  *      ENOERR  Success.
- *      EINVAL  Invalid argument.
+ *      EACCES  The queue is read-only.
  *      PQUEUE_DUP      Product already exists in the queue.
  *      PQUEUE_BIG      Product is too large to insert in the queue.
  */
-int
-pq_insertNoSig(pqueue *pq, const product *prod)
+static int
+insertLocked(pqueue *pq, const product *prod)
 {
         int status = ENOERR;
         size_t extent;
         void *vp = NULL;
         sxelem *sxep;
-        
-        assert(pq != NULL);
-        assert(prod != NULL);
 
         if(fIsSet(pq->pflags, PQ_READONLY)) {
-                udebug("pq_insertNoSig(): queue is read-only");
+                udebug("insertLocked(): queue is read-only");
                 return EACCES;
         }
 
         if (prod->info.sz > pq_getDataSize(pq)) {
-                udebug("pq_insertNoSig(): product is too big");
+                udebug("insertLocked(): product is too big");
                 return PQUEUE_BIG;
         }
 
-        /*
-         * Write lock pq->ctl.
-         */
-        status = ctl_get(pq, RGN_WRITE);
-        if(status != ENOERR) {
-                udebug("pq_insertNoSig(): ctl_get() failure");
-                return status;
-        }
-
         extent = xlen_product(prod);
         status = rpqe_new(pq, extent, prod->info.signature, &vp, &sxep);
         if(status != ENOERR) {
-                udebug("pq_insertNoSig(): rpqe_new() failure");
-                goto unwind_ctl;
+                udebug("insertLocked(): rpqe_new() failure");
+                return status;
         }
 
                                                 /* cast away const'ness */
         if(xproduct(vp, extent, XDR_ENCODE, (product *)prod) == 0)
         {
-                udebug("pq_insertNoSig(): xproduct() failure");
+                udebug("insertLocked(): xproduct() failure");
                 status = EIO;
                 goto unwind_rgn;
         }
@@ -5910,7 +5902,7 @@ pq_insertNoSig(pqueue *pq, const product *prod)
         assert(pq->tqp != NULL && tq_HasSpace(pq->tqp));
         status = tq_add(pq->tqp, sxep->offset);
         if(status != ENOERR) {
-                udebug("pq_insertNoSig(): tq_add() failure");
+                udebug("insertLocked(): tq_add() failure");
                 goto unwind_rgn;
         }
 
@@ -5920,14 +5912,115 @@ pq_insertNoSig(pqueue *pq, const product *prod)
         /*FALLTHROUGH*/
 unwind_rgn:
         (void) rgn_rel(pq, sxep->offset, status == ENOERR ? RGN_MODIFIED : 0);
+        return status;
+}
+
+
+/*
+ * Insert at rear of queue
+ * (Don't signal process group.)
+ *
+ * Returns:
+ *      ENOERR  Success.
+ *      EINVAL  Invalid argument.
+ *      PQUEUE_DUP      Product already exists in the queue.
+ *      PQUEUE_BIG      Product is too large to insert in the queue.
+ */
+int
+pq_insertNoSig(pqueue *pq, const product *prod)
+{
+        int status = ENOERR;
+        
+        assert(pq != NULL);
+        assert(prod != NULL);
+
+        if(fIsSet(pq->pflags, PQ_READONLY)) {
+                udebug("pq_insertNoSig(): queue is read-only");
+                return EACCES;
+        }
+
+        if (prod->info.sz > pq_getDataSize(pq)) {
+                udebug("pq_insertNoSig(): product is too big");
+                return PQUEUE_BIG;
+        }
+
+        /*
+         * Write lock pq->ctl.
+         */
+        status = ctl_get(pq, RGN_WRITE);
+        if(status != ENOERR) {
+                udebug("pq_insertNoSig(): ctl_get() failure");
+                return status;
+        }
+
+        status = insertLocked(pq, prod);
 
-        /*FALLTHROUGH*/
-unwind_ctl:
         (void) ctl_rel(pq, RGN_MODIFIED);
         return status;
 }
 
 
+/*
+ * Inserts a sequence of products at the rear of the queue under a single
+ * lock of the control-section and sends one SIGCONT to the process group if
+ * any product was inserted.  This amortizes the cost of locking and
+ * signaling over many small products.
+ *
+ * Arguments:
+ *      pq              Pointer to the product-queue.
+ *      prods           Pointer to the products.
+ *      count           Number of products.
+ *      statuses        Pointer to "count" insertion statuses.  Set on
+ *                      successful return to ENOERR, PQUEUE_DUP, PQUEUE_BIG,
+ *                      or another error code for the corresponding product.
+ * Returns:
+ *      ENOERR          Success.  "statuses" is set.
+ *      else            <errno.h> error code.  The control-section couldn't be
+ *                      locked and no product was inserted.
+ */
+int
+pq_insertBatch(
+        pqueue* const           pq,
+        const product* const    prods,
+        const size_t            count,
+        int* const              statuses)
+{
+        int status;
+        int inserted = 0;
+        size_t i;
+
+        assert(pq != NULL);
+        assert(prods != NULL || count == 0);
+        assert(statuses != NULL || count == 0);
+
+        if (count == 0)
+                return ENOERR;
+
+        /*
+         * Write lock pq->ctl.
+         */
+        status = ctl_get(pq, RGN_WRITE);
+        if(status != ENOERR) {
+                udebug("pq_insertBatch(): ctl_get() failure");
+                return status;
+        }
+
+        for (i = 0; i < count; i++) {
+                statuses[i] = insertLocked(pq, prods + i);
+
+                if (statuses[i] == ENOERR)
+                        inserted = 1;
+        }
+
+        (void) ctl_rel(pq, RGN_MODIFIED);
+
+        if (inserted)
+                (void)kill(0, SIGCONT);
+
+        return ENOERR;
+}
+
+
 /*
  * Insert at rear of queue, send SIGCONT to process group
  *
@@ -85,61 +85,39 @@ exec_prodput(
             waitOnChild = 1;            /* => wait for child */
             argc--; argv++;
         }
+        else if (strcmp(argv[0], "-reuse") == 0) {
+            /*
+             * The command reads its arguments from its standard input stream
+             * and is kept running for subsequent invocations.
+             */
+            argc--; argv++;
+            if (argc < 1) {
+                uerror("EXEC -reuse: no command");
+                return -1;
+            }
+            return exec_reuse(argc, argv) ? -1 : 1;
+        }
 
-        pid = ldmfork();
+        /*
+         * It is assumed that the standard input, output, and error streams
+         * are correctly established and should not be modified.
+         */
+        pid = fl_spawn(argv, -1, 0);
         if (-1 == pid) {
-            LOG_SERROR0("Couldn't fork EXEC process");
+            LOG_ADD1("Couldn't execute command \"%s\"", argv[0]);
             log_log(LOG_ERR);
         }
         else {
-            if (0 == pid) {
-                /*
-                 * Child process.
-                 *
-                 * Detach the child process from the parents process group??
-                 *
-                 * (void) setpgid(0,0);
-                 */
-                const unsigned  ulogOptions = ulog_get_options();
-                const char*     ulogIdent = getulogident();
-                const unsigned  ulogFacility = getulogfacility();
-                const char*     ulogPath = getulogpath();
-
-                (void)signal(SIGTERM, SIG_DFL);
-                (void)pq_close(pq);
-
-                /*
-                 * It is assumed that the standard input, output, and error
-                 * streams are correctly established and should not be
-                 * modified.
-                 */
-
-                /*
-                 * Don't let the child process get any inappropriate privileges.
-                 */
-                endpriv();
-
-                (void) execvp(argv[0], argv);
-                openulog(ulogIdent, ulogOptions, ulogFacility, ulogPath);
-                LOG_SERROR1("Couldn't execute command \"%s\"", argv[0]);
-                log_log(LOG_ERR);
-                exit(EXIT_FAILURE);
-            }                           /* child process */
-            else {
-                /*
-                 * Parent process.
-                 */
-                (void)cm_add_argv(execMap, pid, argv);
+            (void)cm_add_argv(execMap, pid, argv);
 
-                if (!waitOnChild) {
-                    udebug("    exec %s[%d]", argv[0], pid);
-                }
-                else {
-                    udebug("    exec -wait %s[%d]", argv[0], pid);
-                    (void)reap(pid, 0);
-                }
+            if (!waitOnChild) {
+                udebug("    exec %s[%d]", argv[0], pid);
+            }
+            else {
+                udebug("    exec -wait %s[%d]", argv[0], pid);
+                (void)reap(pid, 0);
             }
-        }                               /* child-process forked */
+        }                               /* child-process started */
     }                                   /* child-process map allocated */
 
     return -1 == pid ? -1 : 1;
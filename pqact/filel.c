@@ -20,8 +20,14 @@
 #include <sys/sem.h>                                          
 #include <sys/shm.h>                                          
 #include <sys/stat.h>
+#include <sys/uio.h> /* writev() */
 #include <fcntl.h> /* O_RDONLY et al */
+#include <time.h>
 #include <unistd.h> /* access, lseek */
+#include <poll.h>
+#ifdef HAVE_POSIX_SPAWNP
+#include <spawn.h>
+#endif
 #include <signal.h>
 #include <errno.h>
 
@@ -57,6 +63,7 @@ union semun {
 #include "ulog.h"
 #include "pbuf.h"
 #include "pq.h"
+#include "timestamp.h"
 
 extern pqueue*     pq;
 extern ChildMap*   execMap;
@@ -72,6 +79,18 @@ static unsigned    shared_size;
 static unsigned    queue_counter = 0;
 static unsigned    largest_queue_element = 0;
 static union semun semarg;
+/*
+ * Maximum time, in seconds, that output to FILE and STDIOFILE entries can be
+ * held back in order to coalesce it. 0 means that output isn't coalesced.
+ */
+static unsigned    writeLatency = 0;
+static time_t      groupSyncTime = 0;
+static bool        groupSyncDue = false;
+/*
+ * Maximum amount of memory, in bytes, for data that a decoder hasn't yet
+ * read from its PIPE. 0 means that writing to a full pipe blocks.
+ */
+static size_t      pipeBacklog = 0;
 
 #ifndef NO_DB
 
@@ -152,17 +171,39 @@ union f_handle {
 };
 typedef union f_handle f_handle;
 
+/*
+ * Size, in bytes, of the buffer of a FILE entry whose output is coalesced.
+ */
+#ifndef PENDING_SIZE
+#define PENDING_SIZE 16384
+#endif
+
+/**
+ * Output of a FILE entry that hasn't yet been written to the file.
+ */
+typedef struct {
+    size_t len;                 ///< Number of pending bytes
+    char   buf[PENDING_SIZE];   ///< Pending bytes
+} pendbuf;
+
 /**
  * An entry in a list of entries, each of which has a open output.
  */
 struct fl_entry {
     struct fl_entry* next;
     struct fl_entry* prev;
+    struct fl_entry* keyNext;           // next entry in same key-bucket
+    struct fl_entry* pidNext;           // next entry in same PID-bucket
     struct fl_ops*   ops;
     f_handle         handle;
+    pendbuf*         pending;           // coalesced FILE output or NULL
+    struct dbbatch*  batch;             // uncommitted DBFILE puts or NULL
     unsigned long    private;           // pid, hstat*, R/W flg
     int              flags;
     ft_t             type;
+    unsigned long    hash;              // hash of type and path
+    unsigned long    uses;              // products since opened
+    unsigned         reopens;           // times reopened after closing
     char             path[PATH_MAX];    // PATH_MAX includes NUL
 };
 typedef struct fl_entry fl_entry;
@@ -222,6 +263,54 @@ static struct fl {
 #define TO_HEAD(entry) \
         if(thefl->head != entry) fl_makeHead(entry)
 
+/**
+ * Hash index of the open-file list. Entries are indexed by their type and
+ * normalized command arguments (i.e., their `path` field) and, for PIPE
+ * entries, by the PID of the decoder. The number of buckets is a power of two
+ * and grows with the number of entries in the list.
+ */
+static struct fl_index {
+    fl_entry** keyBuckets;
+    fl_entry** pidBuckets;
+    unsigned   nbuckets;
+} theIndex = { NULL, NULL, 0 };
+
+#define FL_INDEX_MIN_BUCKETS 64
+
+/**
+ * Statistics on the open-file list.
+ */
+static struct fl_stats {
+    unsigned long hits;         ///< Lookups that found an open entry
+    unsigned long misses;       ///< Lookups that had to open a new entry
+    unsigned long lruEvictions; ///< Entries closed because the list was full
+    unsigned long reopens;      ///< Entries opened again after being closed
+    unsigned long fileWrites;   ///< write(2) calls made for FILE entries
+    unsigned long fileBytes;    ///< Bytes written for FILE entries
+    unsigned long groupSyncs;   ///< Group syncs of coalesced output
+    unsigned long deferredSyncs;///< `-flush`-es performed by group syncs
+    unsigned long dbPuts;       ///< Products put into DBFILE entries
+    unsigned long dbCommits;    ///< Stores of DBFILE puts (batched or not)
+    double        dbCommitTime; ///< Total duration of `dbCommits` in seconds
+    double        dbCommitMax;  ///< Longest duration of a DBFILE commit
+} flStats = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0 };
+
+/**
+ * Recently closed entries, for counting how often an entry is reopened. The
+ * slot of an entry is determined by its hash value; a collision overwrites
+ * the slot, so the counts are a lower bound.
+ */
+#define FL_CLOSED_SLOTS 1024
+static struct fl_closed {
+    unsigned long hash;         ///< Hash value of the entry or 0
+    unsigned      reopens;      ///< Times the entry had been reopened
+} closedEntries[FL_CLOSED_SLOTS];
+
+/**
+ * Whether or not fl_logStats() logs every entry.
+ */
+static bool entryStats = false;
+
 /**
  * Frees an open-file entry -- releasing all resources including closing the
  * associated output.
@@ -351,6 +440,184 @@ dump_fl(void)
 }
 #endif
 
+/*
+ * Forward reference
+ */
+static int argcat(
+        char* buf,
+        int   len,
+        int   argc,
+        char** argv);
+
+/**
+ * Returns the hash value of an entry type and normalized command arguments.
+ *
+ * @param[in] type  Type of entry.
+ * @param[in] key   Normalized command arguments (i.e., the `path` field of
+ *                  the corresponding entry).
+ * @return          Hash value.
+ */
+static unsigned long
+fl_hash(
+        const ft_t        type,
+        const char* const key)
+{
+    unsigned long        hash = 2166136261UL ^ (unsigned long)type; // FNV-1a
+    const unsigned char* cp;
+
+    for (cp = (const unsigned char*)key; *cp; cp++)
+        hash = (hash ^ *cp) * 16777619UL;
+
+    return hash;
+}
+
+/**
+ * Returns the normalized command arguments of a given type of entry. The
+ * result is what the entry's "open" function puts into the `path` field and
+ * what its "cmp" function compares against.
+ *
+ * @param[in]  type  Type of entry.
+ * @param[in]  argc  Number of command arguments.
+ * @param[in]  argv  Command arguments.
+ * @param[out] buf   Buffer for the result. Must have at least `PATH_MAX`
+ *                   bytes.
+ * @return           Normalized command arguments. Might be `buf`.
+ */
+static const char*
+fl_key(
+        const ft_t   type,
+        const int    argc,
+        char** const argv,
+        char* const  buf)
+{
+    if (PIPE == type) {
+        (void)argcat(buf, PATH_MAX - 1, argc, argv);
+        return buf;
+    }
+#if !defined(NO_DB) && defined(USE_GDBM)
+    if (FT_DB == type)
+        return argv[0];
+#endif
+
+    return argv[argc - 1];
+}
+
+/**
+ * Returns the index of the PID-bucket of a process.
+ *
+ * @param[in] pid  Process identifier.
+ * @return         Index of the corresponding PID-bucket.
+ */
+static unsigned
+fl_pidBucket(
+        const unsigned long pid)
+{
+    return (unsigned)((pid * 2654435761UL) & (theIndex.nbuckets - 1));
+}
+
+/**
+ * Adds an entry to the hash index.
+ *
+ * @param[in] entry  The entry to be added. Its `hash` field must be set.
+ * @pre              {The entry is not in the index.}
+ */
+static void
+fl_indexAdd(
+        fl_entry* const entry)
+{
+    fl_entry** bucket = theIndex.keyBuckets +
+            (entry->hash & (theIndex.nbuckets - 1));
+
+    entry->keyNext = *bucket;
+    *bucket = entry;
+
+    if (PIPE == entry->type) {
+        bucket = theIndex.pidBuckets + fl_pidBucket(entry->private);
+        entry->pidNext = *bucket;
+        *bucket = entry;
+    }
+}
+
+/**
+ * Removes an entry from the hash index.
+ *
+ * @param[in] entry  The entry to be removed.
+ * @pre              {The entry is in the index.}
+ */
+static void
+fl_indexRemove(
+        fl_entry* const entry)
+{
+    fl_entry** link = theIndex.keyBuckets +
+            (entry->hash & (theIndex.nbuckets - 1));
+
+    for (; *link != NULL; link = &(*link)->keyNext) {
+        if (*link == entry) {
+            *link = entry->keyNext;
+            break;
+        }
+    }
+    entry->keyNext = NULL;
+
+    if (PIPE == entry->type) {
+        for (link = theIndex.pidBuckets + fl_pidBucket(entry->private);
+                *link != NULL; link = &(*link)->pidNext) {
+            if (*link == entry) {
+                *link = entry->pidNext;
+                break;
+            }
+        }
+        entry->pidNext = NULL;
+    }
+}
+
+/**
+ * Ensures that the hash index has at least as many buckets as there will be
+ * entries in the open-file list. Rebuilds the index if necessary.
+ *
+ * @param[in] count  Number of entries that the index must accommodate.
+ * @retval    0      Success.
+ * @retval    -1     Out of memory. `serror()` called. The index is unchanged.
+ */
+static int
+fl_indexReserve(
+        const unsigned count)
+{
+    unsigned   nbuckets = theIndex.nbuckets ? theIndex.nbuckets
+            : FL_INDEX_MIN_BUCKETS;
+    fl_entry** keyBuckets;
+    fl_entry** pidBuckets;
+    fl_entry*  entry;
+
+    while (nbuckets < count)
+        nbuckets <<= 1;
+
+    if (nbuckets == theIndex.nbuckets)
+        return 0;
+
+    keyBuckets = calloc(nbuckets, sizeof(fl_entry*));
+    pidBuckets = calloc(nbuckets, sizeof(fl_entry*));
+
+    if (keyBuckets == NULL || pidBuckets == NULL) {
+        serror("fl_indexReserve(): Couldn't allocate %u-bucket index",
+                nbuckets);
+        free(keyBuckets);
+        free(pidBuckets);
+        return -1;
+    }
+
+    free(theIndex.keyBuckets);
+    free(theIndex.pidBuckets);
+    theIndex.keyBuckets = keyBuckets;
+    theIndex.pidBuckets = pidBuckets;
+    theIndex.nbuckets = nbuckets;
+
+    for (entry = thefl->head; entry != NULL; entry = entry->next)
+        fl_indexAdd(entry);
+
+    return 0;
+}
+
 /**
  * Finds the entry in the list corresponding to a given type of entry and
  * command arguments.
@@ -367,10 +634,19 @@ fl_find(
         const int    argc,
         char** const argv)
 {
-    fl_entry *entry = NULL;
+    fl_entry*     entry;
+    char          buf[PATH_MAX];
+    unsigned long hash;
+
+    if (theIndex.nbuckets == 0)
+        return NULL;
+
+    hash = fl_hash(type, fl_key(type, argc, argv, buf));
 
-    for (entry = thefl->head; entry != NULL ; entry = entry->next) {
-        if (entry->type == type && entry->ops->cmp(entry, argc, argv) == 0)
+    for (entry = theIndex.keyBuckets[hash & (theIndex.nbuckets - 1)];
+            entry != NULL; entry = entry->keyNext) {
+        if (entry->hash == hash && entry->type == type &&
+                entry->ops->cmp(entry, argc, argv) == 0)
             break;
     }
 
@@ -405,6 +681,13 @@ fl_removeAndFree(
                     TYPE_NAME[entry->type], entry->path);
         }
 
+        struct fl_closed* const closed =
+                closedEntries + entry->hash % FL_CLOSED_SLOTS;
+
+        closed->hash = entry->hash;
+        closed->reopens = entry->reopens;
+
+        fl_indexRemove(entry);
         fl_remove(entry);
         entry_free(entry);
     }
@@ -430,6 +713,16 @@ fl_sync(
     if (nentries == -1) /* sync everyone */
         nentries = thefl->size;
 
+    if (writeLatency) {
+        time_t now = time(NULL);
+
+        if (now >= groupSyncTime) {
+            groupSyncDue = true;
+            groupSyncTime = now + writeLatency;
+            flStats.groupSyncs++;
+        }
+    }
+
     fl_entry *entry, *prev;
     for (entry = thefl->tail; entry != NULL && nentries >= 0;
             entry = prev, nentries--) {
@@ -440,6 +733,106 @@ fl_sync(
                 fl_removeAndFree(entry, DR_ERROR); // public so remove
         }
     }
+
+    groupSyncDue = false;
+}
+
+/**
+ * Writes all coalesced output of FILE and STDIOFILE entries, performs all
+ * deferred `-flush` operations, and commits all batched DBFILE puts
+ * regardless of the write-latency. Should be called when there are no more
+ * data-products to process.
+ */
+void
+fl_syncPending(void)
+{
+    groupSyncTime = 0;
+    groupSyncDue = true;
+    fl_sync(-1, 0);
+}
+
+/*
+ * Forward reference
+ */
+static int pipe_sync(
+        fl_entry* entry,
+        int       block);
+
+/**
+ * Writes backlogged data to decoder PIPE-s as the decoders read it. Returns
+ * when all backlogs have been written or the timeout expires. An entry whose
+ * pipe fails is removed from the list.
+ *
+ * @param[in] timeout  Maximum time to wait in seconds.
+ * @return             Amount of data, in bytes, still backlogged.
+ */
+size_t
+fl_drainPipes(
+        const unsigned timeout)
+{
+    const time_t   stop = time(NULL) + timeout;
+    size_t         backlog = 0;
+    struct pollfd* fds = NULL;
+    fl_entry**     entries = NULL;
+    int            size = 0;
+    int            nready;
+    int            i;
+
+    for (;;) {
+        fl_entry* entry;
+        int       nfds = 0;
+        int       remaining = (int)(stop - time(NULL));
+
+        if (size < thefl->size) {
+            struct pollfd* newFds = realloc(fds,
+                    thefl->size * sizeof(struct pollfd));
+            fl_entry**     newEntries = newFds == NULL ? NULL :
+                    realloc(entries, thefl->size * sizeof(fl_entry*));
+
+            if (newFds != NULL)
+                fds = newFds;
+            if (newEntries == NULL) {
+                serror("fl_drainPipes(): Couldn't allocate poll list");
+                break;
+            }
+            entries = newEntries;
+            size = thefl->size;
+        }
+
+        backlog = 0;
+        for (entry = thefl->head; entry != NULL; entry = entry->next) {
+            if (PIPE == entry->type && entry->handle.pbuf != NULL) {
+                size_t n = pbuf_backlog(entry->handle.pbuf);
+
+                if (n > 0) {
+                    backlog += n;
+                    fds[nfds].fd = entry->handle.pbuf->pfd;
+                    fds[nfds].events = POLLOUT;
+                    fds[nfds].revents = 0;
+                    entries[nfds++] = entry;
+                }
+            }
+        }
+
+        if (nfds == 0 || remaining <= 0)
+            break;
+
+        nready = poll(fds, nfds, remaining * 1000);
+        if (nready == 0 || (nready < 0 && errno != EINTR))
+            break;
+
+        for (i = 0; nready > 0 && i < nfds; i++) {
+            if (fds[i].revents) {
+                if (pipe_sync(entries[i], 0) != ENOERR)
+                    fl_removeAndFree(entries[i], DR_ERROR);
+            }
+        }
+    }
+
+    free(fds);
+    free(entries);
+
+    return backlog;
 }
 
 /**
@@ -506,15 +899,35 @@ fl_getEntry(
         dump_fl();
 #endif
         wasCreated = false;
+        flStats.hits++;
     }
     else {
         assert(maxEntries > 0);
 
-        if (thefl->size >= maxEntries)
+        flStats.misses++;
+
+        if (thefl->size >= maxEntries) {
             fl_closeLru(0);
+            flStats.lruEvictions++;
+        }
 
-        entry = entry_new(type, argc, argv);
+        if (fl_indexReserve(thefl->size + 1)) {
+            entry = NULL;
+        }
+        else {
+            entry = entry_new(type, argc, argv);
+        }
         if (NULL != entry) {
+            struct fl_closed* closed;
+
+            entry->hash = fl_hash(type, entry->path);
+            closed = closedEntries + entry->hash % FL_CLOSED_SLOTS;
+            if (closed->hash == entry->hash) {
+                entry->reopens = closed->reopens + 1;
+                closed->hash = 0;
+                flStats.reopens++;
+            }
+            fl_indexAdd(entry);
             fl_addToHead(entry);
 #ifdef FL_DEBUG
             dump_fl();
@@ -523,8 +936,11 @@ fl_getEntry(
         }
     }
 
-    if (entry && isNew)
-        *isNew = wasCreated;
+    if (entry) {
+        entry->uses++;
+        if (isNew)
+            *isNew = wasCreated;
+    }
 
     return entry;
 }
@@ -543,7 +959,11 @@ fl_findByPid(
 {
     fl_entry* entry;
 
-    for (entry = thefl->tail; entry != NULL ; entry = entry->prev) {
+    if (theIndex.nbuckets == 0)
+        return NULL;
+
+    for (entry = theIndex.pidBuckets[fl_pidBucket(pid)]; entry != NULL;
+            entry = entry->pidNext) {
         if (pid == entry->private)
             break;
     }
@@ -551,6 +971,63 @@ fl_findByPid(
     return entry;
 }
 
+/**
+ * Logs statistics on the open-file list at the NOTICE level.
+ */
+void
+fl_logStats(void)
+{
+    unsigned long lookups = flStats.hits + flStats.misses;
+
+    unotice("Open-file list: entries=%d, buckets=%u, hits=%lu, misses=%lu, "
+            "hit-rate=%.1f%%, LRU-evictions=%lu, reopens=%lu", thefl->size,
+            theIndex.nbuckets, flStats.hits, flStats.misses,
+            lookups ? 100.0 * flStats.hits / lookups : 0.0,
+            flStats.lruEvictions, flStats.reopens);
+    unotice("FILE output: write-calls=%lu, bytes=%lu, bytes/call=%.1f, "
+            "group-syncs=%lu, deferred-flushes=%lu", flStats.fileWrites,
+            flStats.fileBytes, flStats.fileWrites
+                ? (double)flStats.fileBytes / flStats.fileWrites : 0.0,
+            flStats.groupSyncs, flStats.deferredSyncs);
+    if (flStats.dbPuts)
+        unotice("DBFILE output: puts=%lu, commits=%lu, puts/commit=%.1f, "
+                "mean-commit-latency=%.6f s, max-commit-latency=%.6f s",
+                flStats.dbPuts, flStats.dbCommits, flStats.dbCommits
+                    ? (double)flStats.dbPuts / flStats.dbCommits : 0.0,
+                flStats.dbCommits
+                    ? flStats.dbCommitTime / flStats.dbCommits : 0.0,
+                flStats.dbCommitMax);
+
+    fl_entry* entry;
+    for (entry = thefl->head; entry != NULL; entry = entry->next) {
+        const pbuf* const pb = entry->handle.pbuf;
+
+        if (PIPE == entry->type && pb != NULL &&
+                (entryStats || pb->stalls || pb->maxbacklog))
+            unotice("PIPE pid=%lu: uses=%lu, reopens=%u, backlog=%lu, "
+                    "max-backlog=%lu, stalls=%lu, cmd=\"%s\"", entry->private,
+                    entry->uses, entry->reopens,
+                    (unsigned long)pbuf_backlog(pb),
+                    (unsigned long)pb->maxbacklog, pb->stalls, entry->path);
+        else if (entryStats && PIPE != entry->type)
+            unotice("%s: uses=%lu, reopens=%u, path=\"%s\"",
+                    TYPE_NAME[entry->type], entry->uses, entry->reopens,
+                    entry->path);
+    }
+}
+
+/**
+ * Enables or disables the logging of every entry by fl_logStats().
+ *
+ * @param[in] enable  Whether or not to log every entry.
+ */
+void
+fl_enableStats(
+        const int enable)
+{
+    entryStats = enable;
+}
+
 /**
  * Ensures that a given file descriptor will be closed upon execution of an
  * exec(2) family function.
@@ -581,6 +1058,9 @@ ensureCloseOnExec(
     return errObj;
 }
 
+static int unio_flushPending(
+        fl_entry* const entry);
+
 /**
  * Performs optional actions at the end of a product.
  *
@@ -614,9 +1094,21 @@ static int finishProduct(
         }
     }
 
-    status = syncflag
-            ? (*entry->ops->sync)(entry, syncflag)
-            : 0;
+    if (syncflag && writeLatency && !closeflag && UNIXIO == entry->type) {
+        /*
+         * The held-back output is written now so that later actions on the
+         * file see all of it; only the fsync(2) is deferred to the next group
+         * sync.
+         */
+        status = unio_flushPending(entry);
+        if (0 == status)
+            entry->flags |= FL_NEEDS_SYNC | FL_SYNC_DEFERRED;
+    }
+    else {
+        status = syncflag
+                ? (*entry->ops->sync)(entry, syncflag)
+                : 0;
+    }
 
     if (0 == status && closeflag)
         fl_removeAndFree(entry, DR_CLOSE);
@@ -770,6 +1262,22 @@ static int unio_open(
             strncpy(entry->path, path, PATH_MAX);
             entry->path[PATH_MAX - 1] = 0; /* just in case */
 
+            if (writeLatency && !(entry->flags & (FL_OVERWRITE | FL_EDEX))) {
+                /*
+                 * Overwritten and EDEX files aren't coalesced because their
+                 * content must be complete when the action returns.
+                 */
+                entry->pending = Alloc(1, pendbuf);
+
+                if (entry->pending == NULL) {
+                    serror("unio_open(): Couldn't allocate output buffer");
+                    error = 1;
+                }
+                else {
+                    entry->pending->len = 0;
+                }
+            }
+
             udebug("    unio_open: %d %s", entry->handle.fd, entry->path);
         } /* output-file set to close_on_exec */
 
@@ -782,16 +1290,137 @@ static int unio_open(
     return writeFd;
 }
 
+/**
+ * Writes a vector of buffers to the file of a FILE entry. Handles partial
+ * writes.
+ *
+ * @param[in] entry   The entry.
+ * @param[in] iov     The buffers. Modified.
+ * @param[in] iovcnt  Number of buffers.
+ * @retval    0       Success.
+ * @retval    -1      Failure. `serror()` called.
+ */
+static int unio_writev(
+        fl_entry* const entry,
+        struct iovec*   iov,
+        int             iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t nwrote = writev(entry->handle.fd, iov, iovcnt);
+
+        if (-1 == nwrote) {
+            if (EINTR != errno) {
+                /*
+                 * According to the UNIX standard, errno should not be set
+                 * to EINTR because the SA_RESTART option was specified to
+                 * sigaction(3) for most signals that could occur.  The
+                 * OSF/1 operating system is non-conforming in this regard,
+                 * however.  For a discussion of the SA_RESTART option, see
+                 * http://www.opengroup.org/onlinepubs/007908799/xsh/sigaction.html
+                 */
+                serror("unio_writev(): writev() error: \"%s\"", entry->path);
+                return -1;
+            }
+            continue;
+        }
+
+        flStats.fileWrites++;
+        flStats.fileBytes += nwrote;
+
+        for (; iovcnt > 0 && (size_t)nwrote >= iov->iov_len; iov++, iovcnt--)
+            nwrote -= iov->iov_len;
+
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + nwrote;
+            iov->iov_len -= nwrote;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Writes the coalesced output of a FILE entry to its file.
+ *
+ * @param[in] entry  The entry.
+ * @retval    0      Success or nothing to write.
+ * @retval    -1     Failure. `serror()` called. The output is discarded.
+ */
+static int unio_flushPending(
+        fl_entry* const entry)
+{
+    int status = 0;
+
+    if (entry->pending != NULL && entry->pending->len > 0) {
+        struct iovec iov;
+
+        iov.iov_base = entry->pending->buf;
+        iov.iov_len = entry->pending->len;
+        status = unio_writev(entry, &iov, 1);
+        entry->pending->len = 0;
+    }
+
+    return status;
+}
+
+/**
+ * Writes data to a FILE entry. If the entry's output is coalesced, then the
+ * data is appended to the entry's buffer and the buffer is written only when
+ * it's full; otherwise, the data is written immediately.
+ *
+ * @param[in] entry  The entry.
+ * @param[in] data   The data.
+ * @param[in] sz     Amount of data in bytes.
+ * @retval    0      Success.
+ * @retval    -1     Failure. `serror()` called.
+ */
+static int unio_emit(
+        fl_entry* const entry,
+        const void*     data,
+        const size_t    sz)
+{
+    pendbuf* const pend = entry->pending;
+    struct iovec   iov[2];
+    int            iovcnt = 0;
+
+    if (pend != NULL) {
+        if (pend->len + sz <= sizeof(pend->buf)) {
+            (void)memcpy(pend->buf + pend->len, data, sz);
+            pend->len += sz;
+            return 0;
+        }
+
+        /*
+         * Write the buffer and the data with one system-call.
+         */
+        iov[iovcnt].iov_base = pend->buf;
+        iov[iovcnt++].iov_len = pend->len;
+        pend->len = 0;
+    }
+
+    iov[iovcnt].iov_base = (void*)data; // cast away `const`
+    iov[iovcnt++].iov_len = sz;
+
+    return unio_writev(entry, iov, iovcnt);
+}
+
 static void unio_close(
         fl_entry *entry)
 {
     udebug("    unio_close: %d", entry->handle.fd);
     if (entry->handle.fd != -1) {
+        (void)unio_flushPending(entry);
+#ifdef HAVE_FSYNC
+        if ((entry->flags & FL_SYNC_DEFERRED) && fsync(entry->handle.fd))
+            serror("fsync: %s", entry->path);
+#endif
         if (close(entry->handle.fd) == -1) {
             serror("close: %s", entry->path);
         }
     }
 
+    free(entry->pending);
+    entry->pending = NULL;
     entry->handle.fd = -1;
 }
 
@@ -806,7 +1435,10 @@ static int unio_sync(
      */
     int status = 0;
     udebug("    unio_sync: %d %s", entry->handle.fd, block ? "" : "non-block");
-    if (block) {
+    if (block || groupSyncDue)
+        status = unio_flushPending(entry);
+    if (status == 0 && (block ||
+            (groupSyncDue && (entry->flags & FL_SYNC_DEFERRED)))) {
 #ifdef HAVE_FSYNC
         if (entry->handle.fd != -1)
             status = fsync(entry->handle.fd);
@@ -814,7 +1446,9 @@ static int unio_sync(
             serror("fsync: %s", entry->path);
         }
 #endif
-        entry->flags &= ~FL_NEEDS_SYNC;
+        if (!block)
+            flStats.deferredSyncs++;
+        entry->flags &= ~(FL_NEEDS_SYNC | FL_SYNC_DEFERRED);
     }
     return status;
 }
@@ -832,29 +1466,7 @@ static int unio_put(
         TO_HEAD(entry);
         udebug("    unio_dbufput: %d", entry->handle.fd);
 
-        do {
-            ssize_t nwrote = write(entry->handle.fd, data, sz);
-
-            if (-1 != nwrote) {
-                sz -= nwrote;
-                data = (char*) data + nwrote;
-            }
-            else {
-                if (EINTR != errno) {
-                    /*
-                     * According to the UNIX standard, errno should not be set
-                     * to EINTR because the SA_RESTART option was specified to
-                     * sigaction(3) for most signals that could occur.  The
-                     * OSF/1 operating system is non-conforming in this regard,
-                     * however.  For a discussion of the SA_RESTART option, see
-                     * http://www.opengroup.org/onlinepubs/007908799/xsh/sigaction.html
-                     */
-                    serror("unio_put(): write() error: \"%s\"", entry->path);
-                    errCode = -1;
-                    break;
-                }
-            }
-        } while (0 < sz);
+        errCode = unio_emit(entry, data, sz);
 
         if (0 == errCode) {
             entry->flags |= FL_NEEDS_SYNC;
@@ -890,7 +1502,7 @@ static int unio_putcreation(
     int status;
 #if SIZEOF_UINT64_T*CHAR_BIT == 64
     uint64_t uint64 = (uint64_t) creation->tv_sec;
-    status = write(entry->handle.fd, (void*) &uint64, (u_int) sizeof(uint64_t));
+    status = unio_emit(entry, (void*) &uint64, (u_int) sizeof(uint64_t));
 #else
     uint32_t lower32 = (uint32_t) creation->tv_sec;
 #   if SIZEOF_LONG*CHAR_BIT <= 32
@@ -906,13 +1518,13 @@ static int unio_putcreation(
     uint32_t first32 = lower32;
     uint32_t second32 = upper32;
 #   endif
-    status = write(entry->handle.fd, (void*) &first32, (u_int) sizeof(uint32_t));
+    status = unio_emit(entry, (void*) &first32, (u_int) sizeof(uint32_t));
     if (status != -1) {
-        status = write(entry->handle.fd, (void*) &second32,
+        status = unio_emit(entry, (void*) &second32,
                 (u_int) sizeof(uint32_t));
         if (status != -1) {
             int32_t int32 = (int32_t) creation->tv_usec;
-            status = write(entry->handle.fd, (void*) &int32,
+            status = unio_emit(entry, (void*) &int32,
                     (u_int) sizeof(int32_t));
         }
     }
@@ -958,16 +1570,16 @@ static int unio_putmeta(
                 + (4 + originLen);
     int status;
 
-    status = write(entry->handle.fd, (void*) &totalLen, (u_int) sizeof(totalLen));
+    status = unio_emit(entry, (void*) &totalLen, (u_int) sizeof(totalLen));
     if (status == -1)
         return errno;
 
-    status = write(entry->handle.fd, (void*) &info->signature,
+    status = unio_emit(entry, (void*) &info->signature,
             (u_int) sizeof(info->signature));
     if (status == -1)
         return errno;
 
-    status = write(entry->handle.fd, (void*) &sz, (u_int) sizeof(sz));
+    status = unio_emit(entry, (void*) &sz, (u_int) sizeof(sz));
     if (status == -1)
         return errno;
 
@@ -976,33 +1588,33 @@ static int unio_putmeta(
         return status;
 
     int32 = (int32_t) info->arrival.tv_usec;
-    status = write(entry->handle.fd, (void*) &int32, (u_int) sizeof(int32));
+    status = unio_emit(entry, (void*) &int32, (u_int) sizeof(int32));
     if (status == -1)
         return errno;
 
     uint32 = (uint32_t) info->feedtype;
-    status = write(entry->handle.fd, (void*) &uint32, (u_int) sizeof(uint32));
+    status = unio_emit(entry, (void*) &uint32, (u_int) sizeof(uint32));
     if (status == -1)
         return errno;
 
     uint32 = (uint32_t) info->seqno;
-    status = write(entry->handle.fd, (void*) &uint32, (u_int) sizeof(uint32));
+    status = unio_emit(entry, (void*) &uint32, (u_int) sizeof(uint32));
     if (status == -1)
         return errno;
 
-    status = write(entry->handle.fd, (void*) &identLen, (u_int) sizeof(identLen));
+    status = unio_emit(entry, (void*) &identLen, (u_int) sizeof(identLen));
     if (status == -1)
         return errno;
 
-    status = write(entry->handle.fd, (void*) info->ident, identLen);
+    status = unio_emit(entry, (void*) info->ident, identLen);
     if (status == -1)
         return errno;
 
-    status = write(entry->handle.fd, (void*) &originLen, (u_int) sizeof(originLen));
+    status = unio_emit(entry, (void*) &originLen, (u_int) sizeof(originLen));
     if (status == -1)
         return errno;
 
-    status = write(entry->handle.fd, (void*) info->origin, originLen);
+    status = unio_emit(entry, (void*) info->origin, originLen);
 
     return status == -1 ? errno : ENOERR;
 }
@@ -1236,11 +1848,15 @@ static int stdio_sync(
     int status = 0;
     udebug("    stdio_sync: %d",
             entry->handle.stream ? fileno(entry->handle.stream) : -1);
+    if (writeLatency && !block && !groupSyncDue)
+        return 0; // coalescing output
     if (fflush(entry->handle.stream) == EOF) {
         serror("fflush: %s", entry->path);
         status = -1;
     }
-    entry->flags &= ~FL_NEEDS_SYNC;
+    if (!block && (entry->flags & FL_SYNC_DEFERRED))
+        flStats.deferredSyncs++;
+    entry->flags &= ~(FL_NEEDS_SYNC | FL_SYNC_DEFERRED);
     return status;
 }
 
@@ -1411,6 +2027,145 @@ void endpriv(
     /* else warn??? or set to nobody??? */
 }
 
+/*
+ * Executes a program in a child process of the LDM. Unless the process has
+ * privileges that endpriv() must relinquish in the child, posix_spawnp() is
+ * used so that the address-space of this process -- which contains the
+ * product-queue and the tables of the pattern/action entries -- isn't
+ * duplicated; otherwise, ldmfork() and execvp() are used.
+ *
+ * Arguments:
+ *      argv            NULL-terminated command-line of the program. argv[0]
+ *                      is the pathname or filename of the program.
+ *      stdinFd         File descriptor to become the standard input stream of
+ *                      the program or -1 to inherit this process's.
+ *      newGroup        Whether or not to make the program a process-group
+ *                      leader.
+ * Returns:
+ *      -1              Failure. "log_start()" called.
+ *      else            PID of the child process.
+ */
+pid_t fl_spawn(
+        char* const argv[],
+        const int   stdinFd,
+        const int   newGroup)
+{
+    pid_t pid = -1;
+
+    assert(argv[0] != NULL && *argv[0] != 0);
+
+    if (reg_close())
+        return -1;
+
+#ifdef HAVE_POSIX_SPAWNP
+    if (getuid() == geteuid()) {
+        posix_spawn_file_actions_t actions;
+        posix_spawnattr_t          attr;
+        int                        status;
+
+        if ((status = posix_spawn_file_actions_init(&actions)) != 0) {
+            LOG_ERRNUM0(status, "Couldn't initialize spawn file-actions");
+        }
+        else {
+            if ((status = posix_spawnattr_init(&attr)) != 0) {
+                LOG_ERRNUM0(status, "Couldn't initialize spawn attributes");
+            }
+            else {
+                if (stdinFd != -1 && stdinFd != STDIN_FILENO) {
+                    status = posix_spawn_file_actions_adddup2(&actions,
+                            stdinFd, STDIN_FILENO);
+                    if (status == 0)
+                        status = posix_spawn_file_actions_addclose(&actions,
+                                stdinFd);
+                    if (status)
+                        LOG_ERRNUM2(status, "Couldn't add dup2(%d,%d) to "
+                                "spawn file-actions", stdinFd, STDIN_FILENO);
+                }
+                if (status == 0 && newGroup) {
+                    status = posix_spawnattr_setflags(&attr,
+                            POSIX_SPAWN_SETPGROUP);
+                    if (status == 0)
+                        status = posix_spawnattr_setpgroup(&attr, 0);
+                    if (status)
+                        LOG_ERRNUM0(status, "Couldn't set spawn process-group");
+                }
+                if (status == 0) {
+                    extern char** environ;
+
+                    status = posix_spawnp(&pid, argv[0], &actions, &attr,
+                            argv, environ);
+                    if (status) {
+                        LOG_ERRNUM1(status, "Couldn't spawn \"%s\"",
+                                argv[0]);
+                        pid = -1;
+                    }
+                    else if (ulogIsVerbose()) {
+                        LOG_ADD2("Executing \"%s\"[%d]", argv[0], pid);
+                        log_log(LOG_INFO);
+                    }
+                }
+
+                (void)posix_spawnattr_destroy(&attr);
+            }
+
+            (void)posix_spawn_file_actions_destroy(&actions);
+        }
+
+        return pid;
+    }
+#endif
+
+    pid = ldmfork();
+
+    if (0 == pid) {
+        /*
+         * Child process.
+         */
+        const unsigned  ulogOptions = ulog_get_options();
+        const char*     ulogIdent = getulogident();
+        const unsigned  ulogFacility = getulogfacility();
+        const char*     ulogPath = getulogpath();
+
+        (void) signal(SIGTERM, SIG_DFL );
+        (void) pq_close(pq);
+        pq = NULL;
+
+        if (newGroup && setpgid(0, 0) == -1) {
+            LOG_SERROR0("Couldn't make child a process-group leader");
+            log_log(LOG_WARNING);
+        }
+
+        /*
+         * It is assumed that the standard output and error streams are
+         * correctly established and should not be modified.
+         */
+        if (stdinFd != -1 && stdinFd != STDIN_FILENO) {
+            if (-1 == dup2(stdinFd, STDIN_FILENO)) {
+                LOG_SERROR2("Couldn't dup2(%d,%d)", stdinFd, STDIN_FILENO);
+                log_log(LOG_ERR);
+                exit(EXIT_FAILURE);
+            }
+            (void) close(stdinFd);
+        }
+
+        /*
+         * Don't let the child process get any inappropriate privileges.
+         */
+        endpriv();
+        if (ulogIsVerbose()) {
+            LOG_ADD1("Executing \"%s\"", argv[0]);
+            log_log(LOG_INFO);
+        }
+        (void) execvp(argv[0], argv);
+        openulog(ulogIdent, ulogOptions, ulogFacility, ulogPath);
+        LOG_SERROR1("Couldn't execute \"%s\"", argv[0]);
+        log_log(LOG_ERR);
+        exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
 /* 
  * Open a pipe to a child decoder process.
  *
@@ -1489,107 +2244,55 @@ static int pipe_open(
                     ERR_FAILURE);
         }
         else {
-            pid_t pid = ldmfork();
+            /*
+             * The child process is made its own process-group leader to
+             * isolate it from signals sent to the LDM process-group (e.g.,
+             * SIGCONTs, SIGINTs, and SIGTERMs).
+             */
+            pid_t pid = fl_spawn(av, pfd[0], 1);
 
             if (-1 == pid) {
-                LOG_ADD0("Couldn't fork PIPE process");
+                LOG_ADD1("Couldn't execute decoder \"%s\"", av[0]);
                 log_log(LOG_ERR);
             }
             else {
-                if (0 == pid) {
-                    /*
-                     * Child process.
-                     */
-                    (void) signal(SIGTERM, SIG_DFL );
-                    (void) pq_close(pq);
-                    pq = NULL;
-
-                    /*
-                     * This process is made its own process-group leader to
-                     * isolate it from signals sent to the LDM process-group
-                     * (e.g., SIGCONTs, SIGINTs, and SIGTERMs).
-                     */
-                    if (setpgid(0, 0) == -1) {
-                        LOG_SERROR0(
-                                "Couldn't make decoder a process-group leader");
-                        log_log(LOG_WARNING);
-                    }
-
-                    /*
-                     * It is assumed that the standard output and error streams
-                     * are correctly established and should not be modified.
-                     */
-
-                    /*
-                     * Associate the standard input stream with the
-                     * read-end of the pipe.
-                     */
-                    if (STDIN_FILENO != pfd[0]) {
-                        if (-1 == dup2(pfd[0], STDIN_FILENO)) {
-                            LOG_SERROR2("Couldn't dup2(%d,%d)",
-                                    pfd[0], STDIN_FILENO), log_log(LOG_ERR);
-                        }
-                        else {
-                            (void) close(pfd[0]);
-
-                            pfd[0] = STDIN_FILENO;
-                        }
-                    }
-
-                    if (STDIN_FILENO == pfd[0]) {
-                        const unsigned  ulogOptions = ulog_get_options();
-                        const char*     ulogIdent = getulogident();
-                        const unsigned  ulogFacility = getulogfacility();
-                        const char*     ulogPath = getulogpath();
-
-                        endpriv();
-                        if (ulogIsVerbose()) {
-                            LOG_ADD1("Executing decoder \"%s\"", av[0]);
-                            log_log(LOG_INFO);
-                        }
-                        (void) execvp(av[0], &av[0]);
-                        openulog(ulogIdent, ulogOptions, ulogFacility, ulogPath);
-                        LOG_SERROR1("Couldn't execute decoder \"%s\"", av[0]);
-                        log_log(LOG_ERR);
-                    }
-
-                    exit(EXIT_FAILURE);
-                } /* child process */
-                else {
-                    /*
-                     * Parent process.
-                     *
-                     * Close the read-end of the pipe because it won't be used.
-                     */
-                    (void) close(pfd[0]);
+                /*
+                 * Close the read-end of the pipe because it won't be used.
+                 */
+                (void) close(pfd[0]);
+                pfd[0] = -1;
 
-                    /*
-                     * Create a pipe-buffer with pfd[1] as the output file
-                     * descriptor.
-                     */
+                /*
+                 * Create a pipe-buffer with pfd[1] as the output file
+                 * descriptor.
+                 */
 #ifdef PIPE_BUF
-                    entry->handle.pbuf = new_pbuf(pfd[1], PIPE_BUF);
+                entry->handle.pbuf = new_pbuf(pfd[1], PIPE_BUF);
 #else
-                    entry->handle.pbuf = new_pbuf(pfd[1], _POSIX_PIPE_BUF);
+                entry->handle.pbuf = new_pbuf(pfd[1], _POSIX_PIPE_BUF);
 #endif
-                    if (NULL == entry->handle.pbuf) {
-                        LOG_SERROR0("Couldn't create pipe-buffer");
-                        log_log(LOG_ERR);
-                    }
-                    else {
-                        entry->private = pid;
-                        writeFd = pfd[1]; /* success */
+                if (NULL == entry->handle.pbuf) {
+                    LOG_SERROR0("Couldn't create pipe-buffer");
+                    log_log(LOG_ERR);
+                }
+                else {
+                    if (pipeBacklog)
+                        (void)pbuf_set_backlog(entry->handle.pbuf,
+                                pipeBacklog);
 
-                        argcat(entry->path, PATH_MAX - 1, argc, argv);
-                        udebug("    pipe_open: %d %d", writeFd, pid);
-                    }
-                } /* parent process */
-            } /* fork() success */
+                    entry->private = pid;
+                    writeFd = pfd[1]; /* success */
+
+                    argcat(entry->path, PATH_MAX - 1, argc, argv);
+                    udebug("    pipe_open: %d %d", writeFd, pid);
+                }
+            } /* child process started */
         } /* write-end of pipe is FD_CLOEXEC */
 
         if (-1 == writeFd) {
             (void) close(pfd[1]);
-            (void) close(pfd[0]);
+            if (-1 != pfd[0])
+                (void) close(pfd[0]);
         }
     } /* pipe() success */
 
@@ -2107,9 +2810,350 @@ int xpipe_prodput(
 
     return finishProduct(argc, argv, entry);
 }
+/*
+ * Executes a command by means of a reusable child process. The process is
+ * started by the first invocation and is kept running like a PIPE decoder;
+ * the arguments of each invocation are written to its standard input stream
+ * as one line of space-separated words.
+ *
+ * Arguments:
+ *      argc    Number of arguments. Must be positive.
+ *      argv    Pointer to pointers to arguments. argv[0] is the program to
+ *              execute; the rest are written to it.
+ * Returns:
+ *      0       Success.
+ *      -1      Failure. An error-message is logged.
+ */
+int exec_reuse(
+        int          argc,
+        char** const argv)
+{
+    char       line[PATH_MAX + 1];
+    char*      key[3];
+    int        len;
+    int        status;
+    bool       isNew;
+    fl_entry*  entry;
+
+    assert(argc > 0);
+
+    len = argcat(line, sizeof(line) - 2, argc - 1, argv + 1);
+    if (len >= sizeof(line) - 2) {
+        uerror("exec_reuse: arguments of \"%s\" are too long", argv[0]);
+        return -1;
+    }
+    line[len++] = '\n';
+
+    /*
+     * The "-reuse" option distinguishes the entry from a PIPE entry of the
+     * same program and is ignored by pipe_open().
+     */
+    key[0] = "-reuse";
+    key[1] = argv[0];
+    key[2] = NULL;
+
+    entry = fl_getEntry(PIPE, 2, key, &isNew);
+    if (entry == NULL)
+        return -1;
+    udebug("    exec_reuse: %d %s", entry->handle.pbuf->pfd, argv[0]);
+
+    status = pipe_put(entry, argv[0], line, len);
+    if (EPIPE == status && !isNew) {
+        /*
+         * The command terminated after a previous invocation. Start it again
+         * -- once.
+         */
+        fl_removeAndFree(entry, DR_ERROR);
+        unotice("exec_reuse: trying again: %s", argv[0]);
+        entry = fl_getEntry(PIPE, 2, key, &isNew);
+        status = entry ? pipe_put(entry, argv[0], line, len) : -1;
+    }
+
+    if (status && entry) {
+        fl_removeAndFree(entry, DR_ERROR);
+        return -1;
+    }
+
+    return status ? -1 : 0;
+}
 /* End PIPE */
 
 #ifndef NO_DB
+/*
+ * Minimum age, in seconds, of the oldest put of a DBFILE batch at which the
+ * batch is committed if no write-latency was specified.
+ */
+#ifndef DB_BATCH_AGE
+#define DB_BATCH_AGE 1
+#endif
+
+/**
+ * A put into a DBFILE entry that hasn't been committed to the database. The
+ * key and data follow the structure in the same allocation.
+ */
+typedef struct {
+    char*  key;
+    void*  data;
+    size_t sz;
+} dbput;
+
+/**
+ * Puts into a DBFILE entry that are committed to the database as a group.
+ */
+struct dbbatch {
+    dbput*   puts;      ///< Uncommitted puts in order of arrival
+    unsigned count;     ///< Number of uncommitted puts
+    unsigned max;       ///< Number of puts at which the batch is committed
+    time_t   since;     ///< Time of the oldest uncommitted put
+};
+
+/*
+ * Forward reference
+ */
+static int ldmdb_put(
+        fl_entry*   entry,
+        const char* keystr,
+        const void* data,
+        size_t      sz);
+
+/**
+ * Accumulates the write-latency statistics of a commit to a DBFILE entry.
+ *
+ * @param[in] start  When the commit started.
+ */
+static void
+ldmdb_account(
+        const timestampt* const start)
+{
+    timestampt now;
+    double     duration;
+
+    (void)set_timestamp(&now);
+    duration = d_diff_timestamp(&now, start);
+    flStats.dbCommits++;
+    flStats.dbCommitTime += duration;
+    if (duration > flStats.dbCommitMax)
+        flStats.dbCommitMax = duration;
+}
+
+/**
+ * Stores a product in the database of a DBFILE entry and accumulates the
+ * write-latency statistics.
+ *
+ * @param[in] entry   The DBFILE entry.
+ * @param[in] keystr  The key.
+ * @param[in] data    The data.
+ * @param[in] sz      The size of the data in bytes.
+ * @retval    0       Success.
+ * @retval    -1      Failure.
+ */
+static int
+ldmdb_store(
+        fl_entry* const   entry,
+        const char* const keystr,
+        const void* const data,
+        const size_t      sz)
+{
+    timestampt start;
+    int        status;
+
+    (void)set_timestamp(&start);
+    status = ldmdb_put(entry, keystr, data, sz);
+    ldmdb_account(&start);
+
+    return status;
+}
+
+/**
+ * Commits the batched puts of a DBFILE entry to its database in the order in
+ * which they were made. Every put is attempted even if an earlier one fails,
+ * and each failure is logged. The batch is then emptied.
+ *
+ * @param[in] entry  The DBFILE entry.
+ * @retval    0      Success.
+ * @retval    -1     At least one put failed. An error-message is logged for
+ *                   each.
+ */
+static int
+ldmdb_commit(
+        fl_entry* const entry)
+{
+    struct dbbatch* const batch = entry->batch;
+    timestampt            start;
+    int                   status = 0;
+    unsigned              nfailed = 0;
+    unsigned              i;
+
+    if (batch == NULL || batch->count == 0)
+        return 0;
+
+    udebug("    ldmdb_commit: %s %u", entry->path, batch->count);
+    (void)set_timestamp(&start);
+
+    for (i = 0; i < batch->count; i++) {
+        dbput* const put = batch->puts + i;
+
+        if (ldmdb_put(entry, put->key, put->data, put->sz) == -1) {
+            uerror("ldmdb_commit: %s error for dbkey %s", entry->path,
+                    put->key);
+            nfailed++;
+        }
+        free(put->key);
+    }
+#ifdef USE_GDBM
+    if (nfailed < batch->count)
+        gdbm_sync(entry->handle.db);
+#endif
+
+    if (nfailed) {
+        uerror("ldmdb_commit: %s: %u of %u puts failed", entry->path, nfailed,
+                batch->count);
+        status = -1;
+    }
+
+    ldmdb_account(&start);
+
+    batch->count = 0;
+    entry->flags &= ~FL_NEEDS_SYNC;
+
+    return status;
+}
+
+/**
+ * Adds a put to the batch of a DBFILE entry. Commits the batch if it's full.
+ *
+ * @param[in] entry   The DBFILE entry.
+ * @param[in] keystr  The key.
+ * @param[in] data    The data.
+ * @param[in] sz      The size of the data in bytes.
+ * @retval    0       Success.
+ * @retval    -1      Failure. An error-message is logged.
+ */
+static int
+ldmdb_batchPut(
+        fl_entry* const   entry,
+        const char* const keystr,
+        const void* const data,
+        const size_t      sz)
+{
+    struct dbbatch* const batch = entry->batch;
+    const size_t          keylen = strlen(keystr) + 1;
+    dbput*                put = batch->puts + batch->count;
+
+    put->key = malloc(keylen + sz);
+    if (put->key == NULL) {
+        serror("ldmdb_batchPut: malloc failed");
+        return -1;
+    }
+    (void)memcpy(put->key, keystr, keylen);
+    put->data = put->key + keylen;
+    (void)memcpy(put->data, data, sz);
+    put->sz = sz;
+
+    if (batch->count++ == 0)
+        batch->since = time(NULL);
+    entry->flags |= FL_NEEDS_SYNC;
+
+    return batch->count >= batch->max ? ldmdb_commit(entry) : 0;
+}
+
+/**
+ * Sets the number of puts at which the batch of a DBFILE entry is committed.
+ *
+ * @param[in] entry  The DBFILE entry.
+ * @param[in] max    Number of puts. 1 disables batching.
+ * @retval    0      Success.
+ * @retval    -1     Failure. An error-message is logged.
+ */
+static int
+ldmdb_setBatch(
+        fl_entry* const entry,
+        const unsigned  max)
+{
+    struct dbbatch* batch = entry->batch;
+
+    if (batch != NULL && batch->max == max)
+        return 0;
+
+    if (ldmdb_commit(entry))
+        return -1;
+
+    if (max <= 1) {
+        if (batch != NULL) {
+            free(batch->puts);
+            free(batch);
+            entry->batch = NULL;
+        }
+        return 0;
+    }
+
+    if (batch == NULL) {
+        batch = Alloc(1, struct dbbatch);
+        if (batch == NULL) {
+            serror("ldmdb_setBatch: malloc failed");
+            return -1;
+        }
+        batch->puts = NULL;
+        batch->count = 0;
+        entry->batch = batch;
+    }
+
+    {
+        dbput* const puts = realloc(batch->puts, max * sizeof(dbput));
+
+        if (puts == NULL) {
+            serror("ldmdb_setBatch: malloc failed");
+            return -1;
+        }
+        batch->puts = puts;
+        batch->max = max;
+    }
+
+    return 0;
+}
+
+/**
+ * Commits the batch of a DBFILE entry, if it has one, and releases it.
+ *
+ * @param[in] entry  The DBFILE entry.
+ */
+static void
+ldmdb_endBatch(
+        fl_entry* const entry)
+{
+    if (entry->batch != NULL) {
+        (void)ldmdb_commit(entry);
+        free(entry->batch->puts);
+        free(entry->batch);
+        entry->batch = NULL;
+    }
+}
+
+/**
+ * Commits the batch of a DBFILE entry if the I/O may block, a group sync is
+ * due, or the oldest put is old enough.
+ *
+ * @param[in] entry  The DBFILE entry.
+ * @param[in] block  Whether or not the I/O may block.
+ * @retval    0      Success.
+ * @retval    -1     Failure. An error-message is logged.
+ */
+static int
+ldmdb_syncBatch(
+        fl_entry* const entry,
+        const int       block)
+{
+    const struct dbbatch* const batch = entry->batch;
+
+    if (batch == NULL || batch->count == 0)
+        return 0;
+
+    if (!block && !groupSyncDue && time(NULL) - batch->since <
+            (writeLatency ? (time_t)writeLatency : DB_BATCH_AGE))
+        return 0;
+
+    return ldmdb_commit(entry);
+}
 # ifdef USE_GDBM
 /* namespace conflict with gdbm_open, etc, so using prefix ldmdb_ */
 
@@ -2191,8 +3235,10 @@ static void ldmdb_close(
         fl_entry *entry)
 {
     udebug("    ldmdb_close: %s", entry->path);
-    if (entry->handle.db != NULL )
+    if (entry->handle.db != NULL ) {
+        ldmdb_endBatch(entry);
         gdbm_close(entry->handle.db);
+    }
     entry->private = 0;
     entry->handle.db = NULL;
 }
@@ -2232,9 +3278,12 @@ static int ldmdb_sync(
         fl_entry *entry,
         int block)
 {
-    /* there is no gdbm_sync */
+    /* only batched puts need syncing */
     udebug("    ldmdb_sync: %s", entry->handle.db ? entry->path : "");
-    entry->flags &= ~FL_NEEDS_SYNC;
+    if (ldmdb_syncBatch(entry, block))
+        return -1;
+    if (entry->batch == NULL || entry->batch->count == 0)
+        entry->flags &= ~FL_NEEDS_SYNC;
     return (0);
 }
 
@@ -2364,8 +3413,10 @@ static void
 ldmdb_close(fl_entry *entry)
 {
     udebug("    ldmdb_close: %s", entry->path);
-    if(entry->handle.db != NULL)
+    if(entry->handle.db != NULL) {
+        ldmdb_endBatch(entry);
         dbm_close(entry->handle.db);
+    }
     entry->private = 0;
     entry->handle.db = NULL;
 }
@@ -2380,10 +3431,13 @@ ldmdb_cmp(fl_entry *entry, int argc, char **argv)
 static int
 ldmdb_sync(fl_entry *entry, int block)
 {
-    /* there is no dbm_sync */
+    /* there is no dbm_sync; only batched puts need syncing */
     udebug("    ldmdb_sync: %s",
             entry->handle.db ? entry->path : "");
-    entry->flags &= ~FL_NEEDS_SYNC;
+    if(ldmdb_syncBatch(entry, block))
+        return -1;
+    if(entry->batch == NULL || entry->batch->count == 0)
+        entry->flags &= ~FL_NEEDS_SYNC;
     return(0);
 }
 
@@ -2464,6 +3518,7 @@ int ldmdb_prodput(
     const char *keystr;
     char *dblocksizep = NULL;
     char *gdbm_wrcreat = "2";
+    unsigned batchSize = 1;
 
     for (; ac > 1 && *av[0] == '-'; ac--, av++) {
         if (strncmp(*av, "-close", 3) == 0)
@@ -2473,6 +3528,14 @@ int ldmdb_prodput(
             av++;
             dblocksizep = *av;
         }
+        else if (strncmp(*av, "-batch", 3) == 0 && ac > 2) {
+            ac--;
+            av++;
+            if (atoi(*av) > 0)
+                batchSize = (unsigned)atoi(*av);
+            else
+                uerror("dbfile: -batch %s invalid", *av);
+        }
         else
             uerror("dbfile: Invalid argument %s", *av);
 
@@ -2494,6 +3557,11 @@ int ldmdb_prodput(
             return -1;
     }
 
+    if (ldmdb_setBatch(entry, batchSize)) {
+        fl_removeAndFree(entry, DR_ERROR);
+        return -1;
+    }
+
     ac--;
     av++;
 
@@ -2506,10 +3574,15 @@ int ldmdb_prodput(
         keystr = prod->info.ident;
     }
 
+    flStats.dbPuts++;
 #if DB_XPROD
-    status = ldmdb_put(entry, keystr, xp, xlen);
+    status = entry->batch
+            ? ldmdb_batchPut(entry, keystr, xp, xlen)
+            : ldmdb_store(entry, keystr, xp, xlen);
 #else
-    status = ldmdb_put(entry, keystr, prod->data, prod->info.sz);
+    status = entry->batch
+            ? ldmdb_batchPut(entry, keystr, prod->data, prod->info.sz)
+            : ldmdb_store(entry, keystr, prod->data, prod->info.sz);
 #endif
 
     if (status == -1) {
@@ -2567,6 +3640,13 @@ entry_new(
     entry->type = type;
     entry->next = NULL;
     entry->prev = NULL;
+    entry->keyNext = NULL;
+    entry->pidNext = NULL;
+    entry->hash = 0;
+    entry->uses = 0;
+    entry->reopens = 0;
+    entry->pending = NULL;
+    entry->batch = NULL;
     entry->path[0] = 0;
     entry->private = 0;
 
@@ -2610,6 +3690,40 @@ set_avail_fd_count(
     return error;
 }
 
+/**
+ * Sets the maximum time that output to FILE and STDIOFILE entries may be held
+ * back in order to coalesce many small writes into fewer system-calls. When
+ * enabled, the `-flush` option of those entries is also deferred and performed
+ * for all entries at once when the time expires.
+ *
+ * @param[in] seconds  Maximum latency in seconds. 0 disables coalescing, which
+ *                     is the default.
+ */
+void
+set_write_latency(
+        const unsigned seconds)
+{
+    writeLatency = seconds;
+    groupSyncTime = time(NULL) + seconds;
+}
+
+/**
+ * Makes writing to decoder PIPE-s non-blocking. Data that a decoder hasn't
+ * read is kept in memory, up to a maximum amount per PIPE, and then in a
+ * temporary file so that a slow decoder doesn't stall the processing of
+ * data-products for other entries. Only affects PIPE-s opened afterwards.
+ *
+ * @param[in] maxBytes  Maximum amount of memory, in bytes, per PIPE for
+ *                      unread data. 0 makes writes block, which is the
+ *                      default.
+ */
+void
+set_pipe_backlog(
+        const size_t maxBytes)
+{
+    pipeBacklog = maxBytes;
+}
+
 int set_shared_space(
         int shid,
         int semid,
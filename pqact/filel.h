@@ -20,6 +20,7 @@
 #define FL_METADATA 128	/* write data-product metadata */
 #define FL_NODATA 256 /* don't write data */
 #define FL_EDEX 512 /* send message to memory segment */
+#define FL_SYNC_DEFERRED 1024 /* "-flush" deferred to next group sync */
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,12 +40,20 @@ extern int xpipe_prodput( const product *prod, int argc, char **argv,
 extern int ldmdb_prodput( const product *prod, int argc, char **argv,
 	const void *xprod, size_t xlen);
 #endif /* !NO_DB */
+extern int exec_reuse(int argc, char **argv);
 extern pid_t reap(pid_t pid, int options);
 extern void fl_sync(int nentries, int block);
+extern void fl_syncPending(void);
+extern size_t fl_drainPipes(unsigned timeout);
 extern void fl_closeLru(int skipflags);
 extern void fl_closeAll(void);
+extern void fl_logStats(void);
+extern void fl_enableStats(int enable);
 extern void endpriv(void);
+extern pid_t fl_spawn(char *const argv[], int stdinFd, int newGroup);
 extern int set_avail_fd_count(unsigned fdCount);
+extern void set_write_latency(unsigned seconds);
+extern void set_pipe_backlog(size_t maxBytes);
 extern int set_shared_space(int shid, int semid, unsigned size);
 extern long openMax();
 
@@ -27,6 +27,7 @@
 #include "atofeedt.h"
 #include "ldmalloc.h"
 #include "RegularExpressions.h"
+#include "timestamp.h"
 #include "ulog.h"
 #include <stdio.h>
 
@@ -39,6 +40,28 @@
 
 #define PATSZ (MAXPATTERN+1)
 
+/*
+ * Number of bins of the action-latency histogram of an entry. The upper
+ * bounds of the bins are 10 us, 100 us, 1 ms, 10 ms, 100 ms, 1 s, and
+ * infinity.
+ */
+#define PALT_NBINS 7
+
+/*
+ * Statistics of a pattern/action entry. Only gathered if enabled by
+ * palt_enableStats() because it adds two clock readings per pattern
+ * evaluation and two per action.
+ */
+typedef struct {
+        unsigned long   products;       /* products that matched */
+        unsigned long   failures;       /* actions that failed */
+        double          bytes;          /* data of matching products */
+        double          matchTime;      /* seconds in regexec() */
+        double          actionTime;     /* seconds in the action */
+        double          actionMax;      /* longest action in seconds */
+        unsigned long   latency[PALT_NBINS]; /* action-latency histogram */
+} palt_stats;
+
 struct palt {    /* "Pattern Action Line" */
         struct palt *next;
         struct palt *prev;
@@ -48,6 +71,11 @@ struct palt {    /* "Pattern Action Line" */
         regmatch_t *pmatchp;
         actiont action;         /* action proc to execute */
         char *private;                  /* storage for args */
+        char *line;                     /* entry as read, for reloading */
+        struct palt *origin;    /* unchanged entry of previous table */
+        int claimed;            /* entry of previous table is reused */
+        int lineno;             /* line number in configuration-file */
+        palt_stats stats;       /* statistics if enabled */
 };
 typedef struct palt palt;
 
@@ -63,6 +91,8 @@ free_palt(palt *pal)
         }
         if(pal->private != NULL)
                 free(pal->private);
+        if(pal->line != NULL)
+                free(pal->line);
         free(pal);
 }
 
@@ -85,6 +115,11 @@ new_palt(void)
  */
 static palt *paList = 0; /* the only one */
 
+/*
+ * Whether or not statistics are gathered for each entry.
+ */
+static int paltStats = 0;
+
 
 /*
  * remove an entry from the linked list and Free it
@@ -392,11 +427,56 @@ err:
 }
 
 
+/*
+ * Returns the entry of the current table that was read from the same
+ * configuration-file entry as a given string and that hasn't already been
+ * claimed. The search starts after the previously claimed entry because
+ * reloaded configuration-files are usually mostly unchanged.
+ *
+ * Arguments:
+ *      line    The configuration-file entry.
+ *      hint    Pointer to the previously claimed entry or NULL. Set to the
+ *              returned entry.
+ * Returns:
+ *      NULL    No such entry.
+ *      else    The entry, which is marked as claimed.
+ */
+static palt *
+claim_palt(const char *line,
+        palt **hint)
+{
+        palt *start = (*hint != NULL && (*hint)->next != NULL)
+                ? (*hint)->next : paList;
+        palt *pal = start;
+
+        while(pal != NULL)
+        {
+                if(!pal->claimed && pal->line != NULL
+                                && strcmp(pal->line, line) == 0)
+                {
+                        pal->claimed = 1;
+                        *hint = pal;
+                        return pal;
+                }
+                pal = (pal->next != NULL) ? pal->next : paList;
+                if(pal == start)
+                        break;
+        }
+        return NULL;
+}
+
+
 /*
  * Read & parse pattern / action file into a newly allocated palt*. 
  * If all goes well, free the old global palt *paList and set it to the
  * new list.
  *
+ * Entries that are unchanged from the current list keep their compiled
+ * pattern; only new or modified entries are compiled.  The open-file list
+ * isn't affected, so decoders and open files of unchanged actions continue
+ * to be used.  Because this function is called between data-products, the
+ * new list applies from the next data-product on.
+ *
  * Arguments:
  *      path    The pathname of the configuration-file
  *
@@ -420,12 +500,16 @@ readPatFile(const char *path)
         palt*   pal = NULL;
         palt*   begin = NULL;
         palt*   othr = NULL;
+        palt*   tail = NULL;
+        palt*   hint = NULL;
+        int     reused = 0;
 
         linenumber = 1;
         status = 0;
 
         for (;;) {
             char        buf[512];
+            char*       line;
             int         len = pal_line(buf, sizeof(buf), fp);
 
             if (len <= -2) {
@@ -436,7 +520,36 @@ readPatFile(const char *path)
             if (len <= 0)
                 break;                  /* EOF */
 
-            if ((pal = new_palt_fromStr(buf)) == NULL) {
+            if ((line = strdup(buf)) == NULL) {
+                serror("readPatFile: malloc failed");
+                status = -2;
+                break;
+            }
+
+            if ((othr = claim_palt(line, &hint)) != NULL) {
+                /*
+                 * Unchanged entry: its contents are transferred from the
+                 * current list only if the new list is adopted.
+                 */
+                if ((pal = new_palt()) != NULL) {
+                    pal->origin = othr;
+                    reused++;
+                }
+                free(line);
+            }
+            else {
+                if ((pal = new_palt_fromStr(buf)) == NULL) {
+                    free(line);
+                }
+                else {
+                    pal->line = line;
+                }
+            }
+
+            if (pal != NULL)
+                pal->lineno = linenumber;
+
+            if (pal == NULL) {
                 status = -2;
                 break;
             }
@@ -445,11 +558,11 @@ readPatFile(const char *path)
                 begin = pal;
             }
             else {
-                othr->next = pal;
-                pal->prev = othr;
+                tail->next = pal;
+                pal->prev = tail;
             }
 
-            othr = pal;
+            tail = pal;
             status++;
         }
 
@@ -464,8 +577,35 @@ readPatFile(const char *path)
                 free_palt(pal);
                 pal = othr;
             }
+            for (pal = paList; pal != NULL; pal = pal->next)
+                pal->claimed = 0;
         }
         else {
+            /*
+             * Transfer the contents of unchanged entries from the old list
+             * to the new list.
+             */
+            for (pal = begin; pal != NULL; pal = pal->next) {
+                palt*   orig = pal->origin;
+
+                if (orig != NULL) {
+                    palt*       next = pal->next;
+                    palt*       prev = pal->prev;
+                    int         lineno = pal->lineno;
+
+                    *pal = *orig;
+                    pal->next = next;
+                    pal->prev = prev;
+                    pal->lineno = lineno;
+                    pal->origin = NULL;
+                    pal->claimed = 0;
+
+                    orig->pmatchp = NULL;
+                    orig->private = NULL;
+                    orig->line = NULL;
+                }
+            }
+
             /*
              * Free old list and replace with new list.
              */
@@ -477,7 +617,8 @@ readPatFile(const char *path)
 
             pal = paList = begin;
 
-            uinfo("Successfully read configuration-file \"%s\"", path);
+            uinfo("Successfully read configuration-file \"%s\": "
+                    "%d entries, %d unchanged", path, status, reused);
         }
 
         (void)fclose(fp);
@@ -1238,6 +1379,39 @@ prodAction(product *prod, palt *pal, const void *xprod, size_t xlen)
 }
 
 
+/*
+ * Accumulates the statistics of an entry whose action was just performed.
+ */
+static void
+palt_account(palt *pal,
+        const timestampt *start,
+        const prod_info *infop,
+        int status)
+{
+        palt_stats*     stats = &pal->stats;
+        timestampt      now;
+        double          duration;
+        double          bound;
+        int             bin;
+
+        (void) set_timestamp(&now);
+        duration = d_diff_timestamp(&now, start);
+
+        stats->products++;
+        stats->bytes += infop->sz;
+        if(status < 0)
+                stats->failures++;
+        stats->actionTime += duration;
+        if(duration > stats->actionMax)
+                stats->actionMax = duration;
+
+        for(bin = 0, bound = 1e-5; bin < PALT_NBINS - 1 && duration >= bound;
+                        bin++, bound *= 10)
+                ;
+        stats->latency[bin]++;
+}
+
+
 /*
  * Loop thru the pattern / action table, applying actions
  */
@@ -1252,6 +1426,9 @@ processProduct(const prod_info *infop, const void *datap,
         int             status = 0;
         int             did_something = 0;
         product         prod;
+        timestampt      start;
+        timestampt      stop;
+        int             matched;
 
         if(ulogIsVerbose())
                 uinfo("%s", s_prod_info(NULL, 0, infop, ulogIsDebug()));
@@ -1259,24 +1436,37 @@ processProduct(const prod_info *infop, const void *datap,
         for(pal = paList; pal != NULL; pal = next)
         {
                 next = pal->next;
+
+                if(!(infop->feedtype & pal->feedtype))
+                        continue;
+
+                if(paltStats)
+                        (void) set_timestamp(&start);
+                matched = regexec(&pal->prog, infop->ident,
+                                pal->prog.re_nsub +1,  pal->pmatchp, 0) == 0;
+                if(paltStats)
+                {
+                        (void) set_timestamp(&stop);
+                        pal->stats.matchTime += d_diff_timestamp(&stop, &start);
+                }
+
                 /*
                  * If the feedtype matches AND ((the product ID matches the
                  * regular expression) OR (the pattern is "_ELSE_" AND nothing
                  * has been done to this product yet AND the first char of
                  * the ident isn't '_'))
                  */
-                if((infop->feedtype & pal->feedtype)
-                   && ((regexec(&pal->prog, infop->ident,
-                                pal->prog.re_nsub +1,  pal->pmatchp,
-                                        0) == 0)
+                if(matched
                        || (strcmp(pal->pattern, "^_ELSE_$") == 0
                            && did_something == 0
-                           && infop->ident[0] != '_')))
+                           && infop->ident[0] != '_'))
                 {
                         /* A hit, do something */
                         prod.info = *infop;
                         prod.data = (void *)datap; /* cast away const */
                         status = prodAction(&prod, pal, xprod, xlen);
+                        if(paltStats)
+                                palt_account(pal, &stop, infop, status);
                         did_something++;
                         if(status < 0
                                 && (pal->action.flags & LDM_ACT_TRANSIENT))
@@ -1291,6 +1481,91 @@ processProduct(const prod_info *infop, const void *datap,
 }
 
 
+/*
+ * Enables or disables the gathering of statistics for each entry of the
+ * pattern/action table. Enabling resets nothing; statistics of an entry are
+ * kept while the entry is unchanged by rereading the configuration-file.
+ */
+void
+palt_enableStats(int enable)
+{
+        paltStats = enable;
+}
+
+
+/*
+ * Compares entries by the time spent on them, most time first.
+ */
+static int
+palt_timeCmp(const void *a, const void *b)
+{
+        const palt_stats* sa = &(*(const palt* const*)a)->stats;
+        const palt_stats* sb = &(*(const palt* const*)b)->stats;
+        double ta = sa->matchTime + sa->actionTime;
+        double tb = sb->matchTime + sb->actionTime;
+
+        return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+
+/*
+ * Logs the statistics of each entry of the pattern/action table that has
+ * matched a product, most time-consuming first, and the time spent on
+ * pattern evaluation by all entries at the NOTICE level. Does nothing if
+ * statistics aren't enabled.
+ */
+void
+palt_logStats(void)
+{
+        palt*           pal;
+        palt**          pals;
+        int             npal = 0;
+        int             i;
+        double          matchTime = 0;
+
+        if(!paltStats)
+                return;
+
+        for(pal = paList; pal != NULL; pal = pal->next)
+                npal++;
+
+        pals = Alloc(npal ? npal : 1, palt*);
+        if(pals == NULL)
+        {
+                serror("palt_logStats: malloc failed");
+                return;
+        }
+
+        for(npal = 0, pal = paList; pal != NULL; pal = pal->next)
+        {
+                matchTime += pal->stats.matchTime;
+                if(pal->stats.products)
+                        pals[npal++] = pal;
+        }
+        qsort(pals, npal, sizeof(palt*), palt_timeCmp);
+
+        unotice("Pattern/action entries: matched=%d, pattern-time=%.6f s",
+                npal, matchTime);
+
+        for(i = 0; i < npal; i++)
+        {
+                const palt_stats* stats = &pals[i]->stats;
+                const unsigned long* h = stats->latency;
+
+                unotice("Line %d: %s: products=%lu, bytes=%.0f, failures=%lu, "
+                        "pattern-time=%.6f s, action-time=%.6f s, "
+                        "max=%.6f s, latency<10us:%lu <100us:%lu <1ms:%lu "
+                        "<10ms:%lu <100ms:%lu <1s:%lu >=1s:%lu",
+                        pals[i]->lineno, s_actiont(&pals[i]->action),
+                        stats->products, stats->bytes, stats->failures,
+                        stats->matchTime, stats->actionTime, stats->actionMax,
+                        h[0], h[1], h[2], h[3], h[4], h[5], h[6]);
+        }
+
+        free(pals);
+}
+
+
 /*
  * Create and process an (auto) empty product
  * whose ident is ident.
@@ -10,16 +10,22 @@ extern "C" int processProduct(const prod_info *infop, const void *datap,
 	const void *xprod, size_t len,
 	void *otherargs);
 extern "C" void dummyprod(char *ident);
+extern "C" void palt_enableStats(int enable);
+extern "C" void palt_logStats(void);
 #elif defined(__STDC__)
 extern int readPatFile(const char *path);
 extern int processProduct(const prod_info *infop, const void *datap,
 	void *xprod, size_t len,
 	void *otherargs);
 extern void dummyprod(char *ident);
+extern void palt_enableStats(int enable);
+extern void palt_logStats(void);
 #else /* Old Style C */
 extern int readPatFile();
 extern int processProduct();
 extern void dummyprod();
+extern void palt_enableStats();
+extern void palt_logStats();
 #endif
 
 #endif /* !_PALT_H_ */
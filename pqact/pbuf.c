@@ -25,6 +25,8 @@ free_pbuf(pbuf *buf)
 {
         if(buf == NULL)
                 return;
+        if(buf->spill != NULL)
+                (void)fclose(buf->spill);
         free(buf->base);
         free(buf);
 }
@@ -54,23 +56,229 @@ new_pbuf(
         buf->base = Alloc(bufsize, char);
         if(buf->base == NULL)
                 goto err;
+        buf->start = buf->base;
         buf->ptr = buf->base;
         buf->upperbound = buf->base + bufsize;
+        buf->maxsize = 0;
+        buf->spill = NULL;
+        buf->spilloff = 0;
+        buf->spillend = 0;
+        buf->stalls = 0;
+        buf->maxbacklog = 0;
         return buf;
 err:
         free(buf);
         return NULL;
 }
 
-/* returns 0 or errno on error */
+/**
+ * Makes a pipe-buffer non-blocking: data that can't be written to the pipe
+ * immediately is kept in memory, which grows as necessary up to a maximum
+ * size, and then in a temporary file. Consequently, pbuf_write() never blocks.
+ *
+ * @param[in] buf      Pipe buffer.
+ * @param[in] maxsize  Maximum amount of memory, in bytes, for data that
+ *                     couldn't be written. 0 restores blocking writes.
+ * @retval    0        Success.
+ */
 int
-pbuf_flush(
+pbuf_set_backlog(
+        pbuf*           buf,
+        size_t          maxsize)
+{
+        buf->maxsize = maxsize;
+        return 0;
+}
+
+/**
+ * Returns the amount of data in a pipe-buffer that hasn't been written to the
+ * pipe.
+ *
+ * @param[in] buf  Pipe buffer.
+ * @return         Number of unwritten bytes in memory and in the temporary
+ *                 file.
+ */
+size_t
+pbuf_backlog(
+        const pbuf*     buf)
+{
+        return (size_t)(buf->ptr - buf->start) +
+            (size_t)(buf->spillend - buf->spilloff);
+}
+
+/*
+ * Moves the unwritten data to the beginning of the storage.
+ */
+static void
+compact(pbuf *buf)
+{
+        size_t len = (size_t)(buf->ptr - buf->start);
+
+        if(buf->start != buf->base) {
+                /* could be an overlapping copy */
+                memmove(buf->base, buf->start, len);
+                buf->start = buf->base;
+                buf->ptr = buf->base + len;
+        }
+}
+
+/*
+ * Refills the empty storage of a pipe-buffer from its temporary file.
+ *
+ * Sets "*nreadp" to the number of bytes read.
+ * Returns 0 or errno on error. If the temporary file is shorter than the
+ * backlog it should contain, then the rest of the backlog is discarded and EIO
+ * is returned.
+ */
+static int
+refill(
+    pbuf*               buf,
+    size_t*             nreadp)
+{
+        int status = ENOERR;
+        size_t nread = 0;
+
+        if(buf->spill != NULL && buf->spilloff < buf->spillend) {
+                size_t len = (size_t)(buf->spillend - buf->spilloff);
+                size_t size = (size_t)(buf->upperbound - buf->base);
+
+                if(len > size)
+                        len = size;
+                if(fseek(buf->spill, buf->spilloff, SEEK_SET) == -1) {
+                        serror("pbuf refill: fseek() failure");
+                        status = errno;
+                }
+                else {
+                        while(nread < len) {
+                                size_t n = fread(buf->base + nread, 1,
+                                        len - nread, buf->spill);
+
+                                if(n == 0)
+                                        break;
+                                nread += n;
+                        }
+                        if(nread < len) {
+                                if(ferror(buf->spill)) {
+                                        serror("pbuf refill: fread() failure");
+                                        status = errno ? errno : EIO;
+                                        clearerr(buf->spill);
+                                }
+                                else {
+                                        uerror("pbuf refill: temporary file is "
+                                                "%ld bytes shorter than the "
+                                                "backlog; discarding the rest "
+                                                "of the backlog",
+                                                (long)(buf->spillend -
+                                                buf->spilloff - nread));
+                                        buf->spillend = buf->spilloff + nread;
+                                        status = EIO;
+                                }
+                        }
+                }
+                buf->start = buf->base;
+                buf->ptr = buf->base + nread;
+                buf->spilloff += nread;
+
+                if(buf->spilloff >= buf->spillend) {
+                        /* temporary file is empty: reuse it from the start */
+                        rewind(buf->spill);
+                        (void)ftruncate(fileno(buf->spill), 0);
+                        buf->spilloff = buf->spillend = 0;
+                }
+        }
+
+        *nreadp = nread;
+        return status;
+}
+
+/*
+ * Appends data to the backlog of a non-blocking pipe-buffer. Data goes into
+ * memory unless the temporary file already contains data or the memory limit
+ * would be exceeded.
+ *
+ * Returns 0 or errno on error.
+ */
+static int
+enqueue(
+    pbuf*               buf,
+    const char*         ptr,
+    size_t              nbytes)
+{
+        size_t backlog;
+
+        if(buf->spillend == 0) {
+                size_t avail = (size_t)(buf->upperbound - buf->ptr);
+
+                if(nbytes > avail) {
+                        compact(buf);
+                        avail = (size_t)(buf->upperbound - buf->ptr);
+                }
+                if(nbytes > avail &&
+                        (size_t)(buf->upperbound - buf->base) < buf->maxsize) {
+                        size_t len = (size_t)(buf->ptr - buf->base);
+                        size_t size = 2 * (size_t)(buf->upperbound - buf->base);
+                        char*  base;
+
+                        if(size < len + nbytes)
+                                size = len + nbytes;
+                        if(size > buf->maxsize)
+                                size = buf->maxsize;
+
+                        base = realloc(buf->base, size);
+                        if(base != NULL) {
+                                buf->base = base;
+                                buf->start = base;
+                                buf->ptr = base + len;
+                                buf->upperbound = base + size;
+                                avail = size - len;
+                        }
+                }
+                if(avail > nbytes)
+                        avail = nbytes;
+
+                memcpy(buf->ptr, ptr, avail);
+                buf->ptr += avail;
+                ptr += avail;
+                nbytes -= avail;
+        }
+
+        if(nbytes > 0) {
+                if(buf->spill == NULL) {
+                        buf->spill = tmpfile();
+                        if(buf->spill == NULL) {
+                                int status = errno;
+                                serror("pbuf enqueue: Couldn't create "
+                                    "temporary file");
+                                return status;
+                        }
+                }
+                if(fseek(buf->spill, buf->spillend, SEEK_SET) == -1 ||
+                        fwrite(ptr, 1, nbytes, buf->spill) != nbytes ||
+                        fflush(buf->spill) == EOF) {
+                        int status = errno;
+                        serror("pbuf enqueue: Couldn't write %lu bytes to "
+                            "temporary file", (unsigned long)nbytes);
+                        return status;
+                }
+                buf->spillend += nbytes;
+        }
+
+        backlog = pbuf_backlog(buf);
+        if(backlog > buf->maxbacklog)
+                buf->maxbacklog = backlog;
+
+        return ENOERR;
+}
+
+/* writes the storage once; returns 0 or errno on error */
+static int
+flush_storage(
     pbuf*               buf,
     int                 block,          /* bool_t */
     unsigned int        timeo,          /* N.B. Not a struct timeval */
     const char* const   id)             /* destination identifier */
 {
-    size_t              len = (size_t)(buf->ptr - buf->base);
+    size_t              len = (size_t)(buf->ptr - buf->start);
     int                 changed = 0;
     int                 nwrote = 0;
     int                 status = ENOERR;        /* success */
@@ -93,7 +301,7 @@ pbuf_flush(
     if(block && timeo != 0)             /* (timeo == 0) => don't set alarm */
         SET_ALARM(timeo, flush_timeo);
 
-    nwrote = (int) write(buf->pfd, buf->base, len);
+    nwrote = (int) write(buf->pfd, buf->start, len);
     tmpErrno = errno;                   /* CLR_ALRM() can change "errno" */
 
     if(block && timeo != 0)
@@ -104,6 +312,7 @@ pbuf_flush(
             udebug("         pbuf_flush: EAGAIN on %d bytes", len);
 
             nwrote = 0;
+            buf->stalls++;
         }
         else {
             status = tmpErrno;
@@ -118,20 +327,18 @@ pbuf_flush(
         /* wrote the whole buffer */
         udebug("         pbuf_flush: wrote  %d bytes", nwrote);
 
+        buf->start = buf->base;
         buf->ptr = buf->base;
         len = 0;
     }
     else if(nwrote > 0) {
-        /* partial write, just shift the buffer by the amount written */
+        /* partial write, just advance past the amount written */
         udebug("         pbuf_flush: partial write %d of %d bytes",
             nwrote, len);
 
         len -= nwrote;
-
-        /* could be an overlapping copy */
-        memmove(buf->base, buf->base + nwrote, len);
-
-        buf->ptr = buf->base +len;
+        buf->start += nwrote;
+        buf->stalls++;
     }
 
     if(changed)
@@ -159,6 +366,30 @@ flush_timeo:
     return EAGAIN;
 }
 
+/* returns 0 or errno on error */
+int
+pbuf_flush(
+    pbuf*               buf,
+    int                 block,          /* bool_t */
+    unsigned int        timeo,          /* N.B. Not a struct timeval */
+    const char* const   id)             /* destination identifier */
+{
+    int                 status;
+    size_t              nread = 0;
+
+    /*
+     * Data in the temporary file is written after the storage is emptied.
+     */
+    do {
+        status = flush_storage(buf, block, timeo, id);
+        if (status != ENOERR || buf->start != buf->ptr)
+            break;
+        status = refill(buf, &nread);
+    } while (status == ENOERR && nread > 0);
+
+    return status;
+}
+
 /**
  * Writes to a pipe-buffer.
  *
@@ -180,7 +411,19 @@ pbuf_write(
 {
     size_t tlen;
 
+    if (buf->maxsize) {
+        /*
+         * Non-blocking pipe-buffer.
+         */
+        const int status = enqueue(buf, ptr, nbytes);
+
+        return status != ENOERR ? status : pbuf_flush(buf, 0, 0, id);
+    }
+
     while (nbytes > 0) {
+        if (buf->ptr == buf->upperbound)
+            compact(buf);
+
         tlen = (size_t)(buf->upperbound - buf->ptr);
         tlen = (nbytes < tlen) ? nbytes : tlen;
 
@@ -11,15 +11,26 @@
 #define ENOERR 0
 #endif /*!ENOERR */
 
+#include <stdio.h>
+
 typedef struct {
 	int pfd;
 	char *base; /* actual storage */
+	char *start; /* first unwritten byte */
 	char *ptr; /* current position */
 	char *upperbound; /* base + bufsize */
+	size_t maxsize; /* max storage before spilling; 0 => blocking writes */
+	FILE *spill; /* overflow of the storage or NULL */
+	long spilloff; /* offset of first unwritten byte in "spill" */
+	long spillend; /* offset of end of data in "spill" */
+	unsigned long stalls; /* number of times the pipe was full */
+	size_t maxbacklog; /* largest number of unwritten bytes */
 } pbuf;
 
 
 #ifdef __cplusplus
+extern "C" int pbuf_set_backlog(pbuf *buf, size_t maxsize);
+extern "C" size_t pbuf_backlog(const pbuf *buf);
 extern "C" void free_pbuf(pbuf *buf);
 extern "C" pbuf * new_pbuf(int pfd, size_t bufsize);
 extern "C" int pbuf_flush(
@@ -34,6 +45,8 @@ extern "C" int pbuf_write(
     unsigned int        timeo,          /* N.B. Not a struct timeval */
     const char* const   id);
 #elif defined(__STDC__)
+extern int pbuf_set_backlog(pbuf *buf, size_t maxsize);
+extern size_t pbuf_backlog(const pbuf *buf);
 extern void free_pbuf(pbuf *buf);
 extern pbuf * new_pbuf(int pfd, size_t bufsize);
 extern int pbuf_flush(
@@ -48,6 +61,8 @@ extern int pbuf_write(
     unsigned int        timeo,          /* N.B. Not a struct timeval */
     const char* const   id);
 #else /* Old Style C */
+extern int pbuf_set_backlog();
+extern size_t pbuf_backlog();
 extern void free_pbuf();
 extern pbuf * new_pbuf();
 extern int pbuf_flush();
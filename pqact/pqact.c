@@ -53,6 +53,7 @@
 #endif
 
 static volatile int     hupped = 0;
+static volatile int     statsRequested = 0;
 static const char*      conffilename = 0;
 static int              shmid = -1;
 static int              semid = -1;
@@ -61,6 +62,15 @@ static key_t            semkey;
 timestampt              oldestCursor;
 timestampt              currentCursor;
 int                     currentCursorSet = 0;
+static signaturet       currentSignature;
+static int              currentSignatureSet = 0;
+
+/*
+ * Interval, in seconds, between checkpoints of the position in the queue
+ */
+#ifndef CHECKPOINT_INTERVAL
+#define CHECKPOINT_INTERVAL 30
+#endif
 
 #ifndef DEFAULT_INTERVAL
 #define DEFAULT_INTERVAL 15
@@ -82,6 +92,47 @@ int                     currentCursorSet = 0;
 int pipe_timeo = DEFAULT_PIPE_TIMEO;
 
 
+/*
+ * Saves the insertion-time and signature of the last, successfully-processed
+ * data-product so that the next invocation can start after it. Output that
+ * is still held back by the write-latency (-w) is written first so that the
+ * saved position never gets ahead of the data on disk.
+ */
+static void
+checkpoint(void)
+{
+        fl_syncPending();
+
+        if (stateWrite(&currentCursor,
+                currentSignatureSet ? &currentSignature : NULL) < 0) {
+            log_add("Couldn't save insertion-time of last processed "
+                "data-product");
+            log_log(LOG_ERR);
+        }
+}
+
+
+/*
+ * Processes a data-product and remembers its signature for the next
+ * checkpoint.
+ */
+static int
+processAndRemember(
+        const prod_info*        infop,
+        const void*             datap,
+        void*                   xprod,
+        size_t                  xlen,
+        void*                   otherargs)
+{
+        int status = processProduct(infop, datap, xprod, xlen, otherargs);
+
+        (void)memcpy(currentSignature, infop->signature, sizeof(signaturet));
+        currentSignatureSet = 1;
+
+        return status;
+}
+
+
 /*
  * called at exit
  */
@@ -106,11 +157,7 @@ cleanup(void)
             (void)set_timestamp(&now);
             unotice("Behind by %g s", d_diff_timestamp(&now, &currentCursor));
 
-            if (stateWrite(&currentCursor) < 0) {
-                log_add("Couldn't save insertion-time of last processed "
-                    "data-product");
-                log_log(LOG_ERR);
-            }
+            checkpoint();
         }
 
         while (reap(-1, WNOHANG) > 0)
@@ -153,7 +200,7 @@ signal_handler(int sig)
                 done = 1;
                 return;
         case SIGUSR1 :
-                /* TODO? stats */
+                statsRequested = 1;
                 return;
         case SIGUSR2 :
                 rollulogpri();
@@ -220,6 +267,9 @@ usage(
                 "(SIGUSR2 cycles)");
         (void)uerror(
                 "\t-x           Log DEBUG-level messages (SIGUSR2 cycles)");
+        (void)uerror(
+                "\t-m           Measure each configuration-file entry and "
+                "output (SIGUSR1 logs)");
         (void)uerror(
                 "\t-l logfile   Log to \"logfile\" (default: use system "
                 "logging daemon)");
@@ -240,6 +290,10 @@ usage(
                 "\t-t timeo     Set write timeout for PIPE subprocs to \"timeo\" secs (default: %d)", DEFAULT_PIPE_TIMEO);
         (void)uerror(
                 "\t-o offset    Start with products arriving \"offset\" seconds before now (default: 0)");
+        (void)uerror(
+                "\t-b backlog   Don't block on PIPE-s; keep up to \"backlog\" unread bytes per PIPE in memory (default: 0)");
+        (void)uerror(
+                "\t-w latency   Coalesce FILE and STDIOFILE output for up to \"latency\" secs (default: 0)");
         (void)uerror(
                 "\tconfig_file  Pathname of configuration-file (default: "
                 "\"%s\")", getPqactConfigPath());
@@ -265,6 +319,9 @@ main(int ac, char *av[])
         int logmask = LOG_UPTO(LOG_NOTICE);
         const char* progname = ubasename(av[0]);
         unsigned logopts = LOG_CONS|LOG_PID;
+        int writeLatency = 0;
+        unsigned long pipeBacklog = 0;
+        time_t checkpointTime = time(NULL) + CHECKPOINT_INTERVAL;
 
         /*
          * Setup default logging before anything else.
@@ -303,7 +360,7 @@ main(int ac, char *av[])
 
             opterr = 1;
 
-            while ((ch = getopt(ac, av, "vxel:d:f:q:o:p:i:t:")) != EOF) {
+            while ((ch = getopt(ac, av, "vxmel:d:f:q:o:p:i:t:w:b:")) != EOF) {
                 switch (ch) {
                 case 'v':
                         logmask |= LOG_UPTO(LOG_INFO);
@@ -313,6 +370,10 @@ main(int ac, char *av[])
                         logmask |= LOG_MASK(LOG_DEBUG);
                         (void) setulogmask(logmask);
                         break;
+                case 'm':
+                        palt_enableStats(1);
+                        fl_enableStats(1);
+                        break;
                 case 'e':
                         key = ftok("/etc/rc.d/rc.local",'R');
                         semkey = ftok("/etc/rc.d/rc.local",'e');
@@ -370,6 +431,26 @@ main(int ac, char *av[])
                 case 'p':
                         spec.pattern = optarg;
                         break;
+                case 'b': {
+                        char* end;
+                        pipeBacklog = strtoul(optarg, &end, 0);
+                        if(*end != 0 || *optarg == '-')
+                        {
+                                uerror("%s: invalid PIPE backlog %s",
+                                        progname, optarg);
+                                usage(progname);
+                        }
+                        break;
+                }
+                case 'w':
+                        writeLatency = atoi(optarg);
+                        if(writeLatency <= 0 && *optarg != '0')
+                        {
+                                uerror("%s: invalid write latency %s",
+                                        progname, optarg);
+                                usage(progname);
+                        }
+                        break;
                 default:
                         usage(progname);
                         break;
@@ -490,6 +571,16 @@ main(int ac, char *av[])
             /*NOTREACHED*/
         }
 
+        /*
+         * Inform the "filel" module about how long output may be coalesced.
+         */
+        set_write_latency(writeLatency);
+
+        /*
+         * Inform the "filel" module about how much unread data a PIPE may have.
+         */
+        set_pipe_backlog(pipeBacklog);
+
         /*
          * Inform the "filel" module of the shared memory segment
          */
@@ -575,13 +666,15 @@ main(int ac, char *av[])
         }                               /* no time-offset specified */
         else
         {
-            int needFromTime = 1;
+            int         needFromTime = 1;
+            signaturet  signature;
 
             /*
-             * Try getting the time of the last, successfully-processed
-             * data-product from the previous invocation.
+             * Try getting the time and signature of the last,
+             * successfully-processed data-product from the previous
+             * invocation.
              */
-            status = stateRead(&clss.from);
+            status = stateRead(&clss.from, &signature);
 
             if (status == 0) {
                 timestampt      now;
@@ -594,13 +687,29 @@ main(int ac, char *av[])
                     log_log(LOG_WARNING);
                 }
                 else {
-                    char        buf[80];
-
-                    (void)strftime(buf, sizeof(buf), "%Y-%m-%d %T",
-                        gmtime(&clss.from.tv_sec));
-                    unotice("Starting from insertion-time %s.%06lu UTC", buf,
-                        (unsigned long)clss.from.tv_usec);
-                    pq_cset(pq, &clss.from);
+                    static const signaturet zeroSig;
+
+                    if (memcmp(signature, zeroSig, sizeof(signaturet)) != 0 &&
+                            pq_setCursorFromSignature(pq, signature) == 0) {
+                        /*
+                         * The cursor is at the last processed data-product.
+                         * The time filter must be permissive because
+                         * subsequently-inserted data-products can have
+                         * earlier creation-times.
+                         */
+                        unotice("Starting after data-product %s",
+                            s_signaturet(NULL, 0, signature));
+                        clss.from = TS_ZERO;
+                    }
+                    else {
+                        char    buf[80];
+
+                        (void)strftime(buf, sizeof(buf), "%Y-%m-%d %T",
+                            gmtime(&clss.from.tv_sec));
+                        unotice("Starting from insertion-time %s.%06lu UTC",
+                            buf, (unsigned long)clss.from.tv_usec);
+                        pq_cset(pq, &clss.from);
+                    }
 
                     needFromTime = 0;
                 }
@@ -669,7 +778,13 @@ main(int ac, char *av[])
                 hupped = 0;
             }
 
-            status = pq_sequence(pq, TV_GT, &clss, processProduct, 0);
+            if (statsRequested) {
+                palt_logStats();
+                fl_logStats();
+                statsRequested = 0;
+            }
+
+            status = pq_sequence(pq, TV_GT, &clss, processAndRemember, 0);
 
             if (status == 0) {
                 /*
@@ -698,6 +813,11 @@ main(int ac, char *av[])
                 if (status == PQUEUE_END) {
                     udebug("End of Queue");
 
+                    /*
+                     * Caught up: don't hold back any coalesced output.
+                     */
+                    fl_syncPending();
+
                     if (interval == 0)
                         break;
                 }
@@ -726,7 +846,12 @@ main(int ac, char *av[])
                     /*NOTREACHED*/
                 }
 
-                (void)pq_suspend(interval);
+                /*
+                 * Feed backlogged decoders while waiting for new products but
+                 * check the queue at least once a second while doing so.
+                 */
+                if (fl_drainPipes(1) == 0)
+                    (void)pq_suspend(interval);
                 (void)exitIfDone(0);
             }                           /* data-product not processed */
 
@@ -735,6 +860,15 @@ main(int ac, char *av[])
              */
             fl_sync(-1, FALSE);
 
+            /*
+             * Periodically save the position in the queue so that a
+             * restart after an unclean termination doesn't reprocess much.
+             */
+            if (currentCursorSet && time(NULL) >= checkpointTime) {
+                checkpoint();
+                checkpointTime = time(NULL) + CHECKPOINT_INTERVAL;
+            }
+
             /*
              * Wait on any children which might have terminated.
              */
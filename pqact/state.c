@@ -17,6 +17,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "ldm.h"
+#include "ldmprint.h"
 #include "timestamp.h"
 #include "log.h"
 
@@ -97,6 +99,10 @@ stateInit(
  * ARGUMENTS:
  *      pqCursor        The product-queue cursor to have its time values set
  *                      from the state file.
+ *      signature       The signature of the last, successfully-processed
+ *                      data-product. Set to all zeros if the state file
+ *                      doesn't contain one (e.g., because it was written by
+ *                      an older version). May be NULL.
  * RETURNS:
  *      0       Success
  *      -1      Module not initialized.
@@ -105,7 +111,8 @@ stateInit(
  */
 int
 stateRead(
-    timestampt* const   pqCursor)
+    timestampt* const   pqCursor,
+    signaturet* const   signature)
 {
     int         status;
 
@@ -149,6 +156,16 @@ stateRead(
                     pqCursor->tv_sec = seconds;
                     pqCursor->tv_usec = microseconds;
                     status = 0;         /* success */
+
+                    if (signature != NULL) {
+                        char    sigStr[2*sizeof(signaturet)+1];
+
+                        if (fscanf(file, "%32s", sigStr) != 1 ||
+                                sigParse(sigStr, signature) < 0) {
+                            log_clear();
+                            (void)memset(signature, 0, sizeof(signaturet));
+                        }
+                    }
                 }                       /* read time */
             }                           /* read comments */
 
@@ -166,6 +183,8 @@ stateRead(
  * ARGUMENTS:
  *      pqCursor        The product-queue cursor to have its time values written
  *                      to the state file.
+ *      signature       The signature of the last, successfully-processed
+ *                      data-product or NULL.
  * RETURNS:
  *      0       Success
  *      -1      Module not initialized.
@@ -174,7 +193,8 @@ stateRead(
  */
 int
 stateWrite(
-    const timestampt* const     pqCursor)
+    const timestampt* const     pqCursor,
+    const signaturet* const     signature)
 {
     int         status;
 
@@ -194,9 +214,9 @@ stateWrite(
             status = -3;
 
             if (fputs(
-"# The following line contains the insertion-time of the last, successfully-\n"
-"# processed data-product.  Do not modify it unless you know exactly what\n"
-"# you're doing!\n", file) < 0) {
+"# The following lines contain the insertion-time and the signature of the\n"
+"# last, successfully-processed data-product.  Do not modify them unless you\n"
+"# know exactly what you're doing!\n", file) < 0) {
                 log_errno();
                 log_add("stateWrite(): Couldn't write comment to \"%s\"",
                     tmpStatePathname);
@@ -209,6 +229,17 @@ stateWrite(
                     log_add("stateWrite(): Couldn't write time to \"%s\"",
                         tmpStatePathname);
                 }
+                else if (signature != NULL && fprintf(file, "%s\n",
+                        s_signaturet(NULL, 0, *signature)) < 0) {
+                    log_errno();
+                    log_add("stateWrite(): Couldn't write signature to "
+                        "\"%s\"", tmpStatePathname);
+                }
+                else if (fflush(file) == EOF) {
+                    log_errno();
+                    log_add("stateWrite(): Couldn't flush \"%s\"",
+                        tmpStatePathname);
+                }
                 else {
                     if (rename(tmpStatePathname, statePathname) == -1) {
                         log_errno();
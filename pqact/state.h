@@ -7,6 +7,7 @@
 #ifndef STATE_H_INCLUDED
 #define STATE_H_INCLUDED
 
+#include "ldm.h"
 #include "timestamp.h"
 
 #ifdef __cplusplus
@@ -19,11 +20,13 @@ stateInit(
 
 int
 stateRead(
-    timestampt* const		pqCursor);
+    timestampt* const		pqCursor,
+    signaturet* const		signature);
 
 int
 stateWrite(
-    const timestampt* const	pqCursor);
+    const timestampt* const	pqCursor,
+    const signaturet* const	signature);
 
 #ifdef __cplusplus
 }
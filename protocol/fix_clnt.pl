@@ -17,7 +17,8 @@ while( <STDIN> ) {
 	next;
     }
 
-    if (/notification_6/ || /hereis_6/ || /blkdata_6/) {
+    if (/notification_6/ || /hereis_6/ || /blkdata_6/ ||
+            /hereis_batch_6/ || /hereis_zbatch_6/) {
 	$nullResultsProc = 1;
 	$zeroTimeout = 1;
     }
@@ -699,6 +699,8 @@ program LDMPROG {
 		void               HEREIS(product) = 1;
 		comingsoon_reply_t COMINGSOON(comingsoon_args) = 12;
 		void               BLKDATA(datapkt) = 13;
+		void               HEREIS_BATCH(product_batch) = 15;
+		void               HEREIS_ZBATCH(product_zbatch) = 16;
 	} = 6;
 #if WANT_MULTICAST
         version SEVEN {
@@ -755,7 +757,68 @@ program LDMPROG {
 %};
 %typedef struct product product;
 %
+%/*
+% * A sequence of small data-products sent in one HEREIS_BATCH message.  On
+% * the wire, the total size of the products' data and the number of products
+% * precede the products, each of which is encoded like a HEREIS argument.
+% * The upstream LDM keeps the products XDR-encoded as they are read from
+% * its product-queue ("xprods"); the downstream LDM decodes them into
+% * "prods", whose data is in the buffer of the "XDR-data" module.  A batch
+% * with no products is used to determine if the downstream LDM supports the
+% * message.
+% */
+%struct product_batch {
+%	u_int    nbytes;	/* total size of the products' data */
+%	u_int    count;		/* number of products */
+%	char*    xprods;	/* XDR-encoded products (encoding only) */
+%	u_int    xlen;		/* size of "xprods" in bytes */
+%	product* prods;		/* decoded products (decoding only) */
+%};
+%typedef struct product_batch product_batch;
+%
+%/*
+% * Maximum number of data-products in a HEREIS_BATCH message.
+% */
+%#define PRODUCT_BATCH_MAX 1024
+%
+%/*
+% * Maximum size, in bytes, of the XDR-encoded data-products of a HEREIS_BATCH
+% * message and, therefore, of the data of the data-products.
+% */
+%#define PRODUCT_BATCH_MAX_BYTES 262144
+%
+%/*
+% * Maximum size, in bytes, of the uncompressed and compressed batch of a
+% * HEREIS_ZBATCH message: the batch header followed by the encoded products.
+% */
+%#define PRODUCT_ZBATCH_MAX_BYTES (2*4 + PRODUCT_BATCH_MAX_BYTES)
+%
+%/*
+% * A compressed batch of data-products sent in one HEREIS_ZBATCH message.  On
+% * the wire, the compression method and the size of the uncompressed batch
+% * precede the compressed bytes, which are counted like an opaque array.  The
+% * uncompressed bytes are the encoding of a "product_batch".  The upstream LDM
+% * sets "zdata"; the downstream LDM decompresses and decodes the products into
+% * "batch".  A compressed batch whose uncompressed size is zero is used to
+% * determine if the downstream LDM supports the message and the method.
+% */
+%struct product_zbatch {
+%	u_int         method;	/* compression method (e.g., ZBATCH_ZLIB) */
+%	u_int         ulen;	/* size of the uncompressed batch in bytes */
+%	u_int         zlen;	/* size of "zdata" in bytes */
+%	char*         zdata;	/* compressed batch (encoding only) */
+%	product_batch batch;	/* decoded batch (decoding only) */
+%};
+%typedef struct product_zbatch product_zbatch;
+%
+%/*
+% * Compression methods of a HEREIS_ZBATCH message:
+% */
+%#define ZBATCH_ZLIB 1	/* zlib(3) "deflate" format */
+%
 %bool_t xdr_product(XDR *, product*);
+%bool_t xdr_product_batch(XDR *, product_batch*);
+%bool_t xdr_product_zbatch(XDR *, product_zbatch*);
 %bool_t xdr_dbuf(XDR* xdrs, dbuf* objp);
 #endif
 
@@ -763,6 +826,8 @@ program LDMPROG {
 %
 %
 %#include <stddef.h>
+%#include <stdlib.h>
+%#include <zlib.h>
 %
 %#include "ulog.h"
 %#include "xdr_data.h"
@@ -782,7 +847,7 @@ program LDMPROG {
 %				return (TRUE);
 %			}
 %			if (objp->data == NULL) {
-%				objp->data = xd_getBuffer(objp->info.sz);
+%				objp->data = xd_getProductBuffer(&objp->info);
 %				if(objp->data == NULL) {
 %					return (FALSE);
 %				}
@@ -801,6 +866,193 @@ program LDMPROG {
 %}
 %
 %
+%static void
+%free_batch_infos(product_batch* objp, u_int count)
+%{
+%	u_int	i;
+%
+%	for (i = 0; i < count; i++)
+%		xdr_free((xdrproc_t)xdr_prod_info, (char*)&objp->prods[i].info);
+%
+%	free(objp->prods);
+%	objp->prods = NULL;
+%}
+%
+%
+%bool_t
+%xdr_product_batch(XDR *xdrs, product_batch *objp)
+%{
+%	if (!xdr_u_int(xdrs, &objp->nbytes) || !xdr_u_int(xdrs, &objp->count)) {
+%		return (FALSE);
+%	}
+%
+%	switch (xdrs->x_op) {
+%
+%		case XDR_ENCODE:
+%			/*
+%			 * The products were XDR-encoded when they were added to
+%			 * the batch, so "xlen" is a multiple of 4.
+%			 */
+%			return (objp->xlen == 0 ||
+%				xdr_opaque(xdrs, objp->xprods, objp->xlen));
+%
+%		case XDR_DECODE: {
+%			u_int	i;
+%			char*	data;
+%			u_int	left = objp->nbytes;
+%
+%			objp->prods = NULL;
+%			if (objp->nbytes > PRODUCT_BATCH_MAX_BYTES) {
+%				uerror("xdr_product_batch(): too many bytes: %u",
+%					objp->nbytes);
+%				return (FALSE);
+%			}
+%			if (objp->count == 0) {
+%				return (objp->nbytes == 0);
+%			}
+%			if (objp->count > PRODUCT_BATCH_MAX) {
+%				uerror("xdr_product_batch(): too many products: %u",
+%					objp->count);
+%				return (FALSE);
+%			}
+%			objp->prods = calloc(objp->count, sizeof(product));
+%			data = xd_getBatchBuffer(left);
+%			if (objp->prods == NULL || (data == NULL && left > 0)) {
+%				serror("xdr_product_batch()");
+%				free(objp->prods);
+%				objp->prods = NULL;
+%				return (FALSE);
+%			}
+%			for (i = 0; i < objp->count; i++) {
+%				product* prod = objp->prods + i;
+%
+%				if (!xdr_prod_info(xdrs, &prod->info) ||
+%						prod->info.sz > left ||
+%						!xdr_opaque(xdrs, data, prod->info.sz)) {
+%					free_batch_infos(objp, i + 1);
+%					return (FALSE);
+%				}
+%				prod->data = data;
+%				data += prod->info.sz;
+%				left -= prod->info.sz;
+%			}
+%			if (left != 0) {
+%				uerror("xdr_product_batch(): products have %u "
+%					"fewer bytes than the batch",
+%					left);
+%				free_batch_infos(objp, objp->count);
+%				return (FALSE);
+%			}
+%			return (TRUE);
+%		}
+%
+%		case XDR_FREE:
+%			if (objp->prods != NULL)
+%				free_batch_infos(objp, objp->count);
+%			return (TRUE);
+%	}
+%	return (FALSE); /* never reached */
+%}
+%
+%
+%/*
+% * Ensures that a buffer that's reused by xdr_product_zbatch() can hold a
+% * given number of bytes.
+% */
+%static char*
+%zbatch_buffer(char** buf, u_int* size, u_int need)
+%{
+%	if (need > *size) {
+%		char* mem = realloc(*buf, need);
+%
+%		if (mem == NULL) {
+%			serror("xdr_product_zbatch(): couldn't allocate %u bytes",
+%				need);
+%			return (NULL);
+%		}
+%		*buf = mem;
+%		*size = need;
+%	}
+%	return (*buf);
+%}
+%
+%
+%bool_t
+%xdr_product_zbatch(XDR *xdrs, product_zbatch *objp)
+%{
+%	if (!xdr_u_int(xdrs, &objp->method) || !xdr_u_int(xdrs, &objp->ulen) ||
+%			!xdr_u_int(xdrs, &objp->zlen)) {
+%		return (FALSE);
+%	}
+%
+%	switch (xdrs->x_op) {
+%
+%		case XDR_ENCODE:
+%			return (objp->zlen == 0 ||
+%				xdr_opaque(xdrs, objp->zdata, objp->zlen));
+%
+%		case XDR_DECODE: {
+%			/*
+%			 * The buffers are kept between calls because a
+%			 * downstream LDM receives a steady stream of batches.
+%			 */
+%			static char*	zbuf;
+%			static u_int	zsize;
+%			static char*	ubuf;
+%			static u_int	usize;
+%			uLongf		ulen = objp->ulen;
+%			XDR		uxdrs;
+%			bool_t		ok;
+%
+%			(void)memset(&objp->batch, 0, sizeof(objp->batch));
+%			objp->zdata = NULL;
+%			if (objp->method != ZBATCH_ZLIB) {
+%				uerror("xdr_product_zbatch(): unknown compression "
+%					"method: %u", objp->method);
+%				return (FALSE);
+%			}
+%			if (objp->ulen > PRODUCT_ZBATCH_MAX_BYTES ||
+%					objp->zlen > PRODUCT_ZBATCH_MAX_BYTES) {
+%				uerror("xdr_product_zbatch(): batch too large: "
+%					"%u bytes compressed, %u uncompressed",
+%					objp->zlen, objp->ulen);
+%				return (FALSE);
+%			}
+%			if (objp->ulen == 0) {
+%				return (objp->zlen == 0);
+%			}
+%			if (zbatch_buffer(&zbuf, &zsize, objp->zlen) == NULL ||
+%					!xdr_opaque(xdrs, zbuf, objp->zlen) ||
+%					zbatch_buffer(&ubuf, &usize, objp->ulen) ==
+%						NULL) {
+%				return (FALSE);
+%			}
+%			if (uncompress((Bytef*)ubuf, &ulen, (Bytef*)zbuf,
+%					objp->zlen) != Z_OK || ulen != objp->ulen) {
+%				uerror("xdr_product_zbatch(): couldn't decompress "
+%					"%u bytes", objp->zlen);
+%				return (FALSE);
+%			}
+%			xdrmem_create(&uxdrs, ubuf, objp->ulen, XDR_DECODE);
+%			ok = xdr_product_batch(&uxdrs, &objp->batch);
+%			if (ok && xdr_getpos(&uxdrs) != objp->ulen) {
+%				uerror("xdr_product_zbatch(): %u bytes follow "
+%					"the batch",
+%					objp->ulen - xdr_getpos(&uxdrs));
+%				free_batch_infos(&objp->batch, objp->batch.count);
+%				ok = FALSE;
+%			}
+%			xdr_destroy(&uxdrs);
+%			return (ok);
+%		}
+%
+%		case XDR_FREE:
+%			return (xdr_product_batch(xdrs, &objp->batch));
+%	}
+%	return (FALSE); /* never reached */
+%}
+%
+%
 %bool_t
 %xdr_dbuf(XDR* xdrs, dbuf* objp)
 %{
@@ -5,6 +5,8 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "autoshift.h"
@@ -123,14 +125,13 @@ dh_setInfo(
 
 
 /*
- * Tries to write a data-product to the product-queue.  Calls savedInfo_set()
- * on success or if the data-product is already in the product-queue.  Calls
- * as_process().
+ * Handles the status of an attempt to write a data-product to the
+ * product-queue.  Calls savedInfo_set() on success or if the data-product is
+ * already in the product-queue.  Calls as_process().
  *
  * Arguments:
- *      pq              Pointer to product-queue structure.
+ *      error           Status of the attempt.
  *      info            Pointer to the product-information.
- *      data            Pointer to the product-data.
  *      wasHereis       Whether or not the data-product was received via a
  *                      HEREIS message.
  *      notifyAutoShift Whether or not to notify the autoshift module.
@@ -142,21 +143,13 @@ dh_setInfo(
  *      DOWN6_UNWANTED          Data-product already in product-queue.
  */
 int
-dh_saveDataProduct(
-    struct pqueue* const        pq,
+dh_handleInsertion(
+    int                         error,
     const prod_info* const      info,
-    void* const                 data,
     const int                   wasHereis,
     const int                   notifyAutoShift)
 {
     int     retCode = 0;                /* success */
-    int     error;
-    product newprod;
-
-    newprod.info = *info;
-    newprod.data = data;
-
-    error = pq_insert(pq, &newprod);
 
     if (!error) {
         if (ulogIsVerbose())
@@ -173,7 +166,7 @@ dh_saveDataProduct(
         }
         else {
             if (notifyAutoShift) {
-                error = as_process(1, info->sz);
+                error = as_process(1, info->sz, &info->arrival);
 
                 if (error) {
                     err_log_and_free(
@@ -223,7 +216,7 @@ dh_saveDataProduct(
         }
         else {
             if (notifyAutoShift) {
-                error = as_process(0, info->sz);
+                error = as_process(0, info->sz, &info->arrival);
 
                 if (error) {
                     err_log_and_free(
@@ -246,3 +239,133 @@ dh_saveDataProduct(
 
     return retCode;
 }
+
+
+/*
+ * Tries to write a data-product to the product-queue.  Calls savedInfo_set()
+ * on success or if the data-product is already in the product-queue.  Calls
+ * as_process().
+ *
+ * Arguments:
+ *      pq              Pointer to product-queue structure.
+ *      info            Pointer to the product-information.
+ *      data            Pointer to the product-data.
+ *      wasHereis       Whether or not the data-product was received via a
+ *                      HEREIS message.
+ *      notifyAutoShift Whether or not to notify the autoshift module.
+ * Returns:
+ *      0                       Success.
+ *      DOWN6_SYSTEM_ERROR      System failure.
+ *      DOWN6_PQ                Fatal product-queue failure.
+ *      DOWN6_PQ_BIG            Product is too big to insert into product-queue.
+ *      DOWN6_UNWANTED          Data-product already in product-queue.
+ */
+int
+dh_saveDataProduct(
+    struct pqueue* const        pq,
+    const prod_info* const      info,
+    void* const                 data,
+    const int                   wasHereis,
+    const int                   notifyAutoShift)
+{
+    product newprod;
+
+    newprod.info = *info;
+    newprod.data = data;
+
+    return dh_handleInsertion(pq_insert(pq, &newprod), info, wasHereis,
+        notifyAutoShift);
+}
+
+
+/*
+ * Commits a data-product whose data has been written directly into a region
+ * obtained from pqe_new().  Calls savedInfo_set() on success.  Calls
+ * as_process().
+ *
+ * Arguments:
+ *      pq              Pointer to product-queue structure.
+ *      info            Pointer to the product-information given to pqe_new().
+ *      index           Index of the region returned by pqe_new().
+ *      wasHereis       Whether or not the data-product was received via a
+ *                      HEREIS message.
+ *      notifyAutoShift Whether or not to notify the autoshift module.
+ * Returns:
+ *      0                       Success.
+ *      DOWN6_SYSTEM_ERROR      System failure.
+ *      DOWN6_PQ                Fatal product-queue failure.
+ */
+int
+dh_commitDataProduct(
+    struct pqueue* const        pq,
+    const prod_info* const      info,
+    const pqe_index             index,
+    const int                   wasHereis,
+    const int                   notifyAutoShift)
+{
+    return dh_handleInsertion(pqe_insert(pq, index), info, wasHereis,
+        notifyAutoShift);
+}
+
+
+/*
+ * Tries to write a sequence of data-products to the product-queue using a
+ * single queue operation.  Calls savedInfo_set() and as_process() for each
+ * data-product as dh_saveDataProduct() does.
+ *
+ * Arguments:
+ *      pq              Pointer to product-queue structure.
+ *      prods           Pointer to the data-products.
+ *      count           Number of data-products.
+ *      wasHereis       Whether or not the data-products were received via
+ *                      HEREIS-like messages.
+ *      notifyAutoShift Whether or not to notify the autoshift module.
+ * Returns:
+ *      0                       Success.  Individual data-products might have
+ *                              been duplicates or too big.
+ *      DOWN6_SYSTEM_ERROR      System failure.
+ *      DOWN6_PQ                Fatal product-queue failure.
+ */
+int
+dh_saveDataProducts(
+    struct pqueue* const        pq,
+    const product* const        prods,
+    const size_t                count,
+    const int                   wasHereis,
+    const int                   notifyAutoShift)
+{
+    int     retCode = 0;                /* success */
+    int*    statuses;
+    int     error;
+    size_t  i;
+
+    if (0 == count)
+        return 0;
+
+    statuses = malloc(count * sizeof(int));
+    if (NULL == statuses) {
+        uerror("Couldn't allocate %lu insertion-statuses: %s",
+            (unsigned long)count, strerror(errno));
+        return DOWN6_SYSTEM_ERROR;
+    }
+
+    error = pq_insertBatch(pq, prods, count, statuses);
+    if (error) {
+        uerror("pq_insertBatch() failed: %s", strerror(error));
+        retCode = DOWN6_PQ;
+    }
+    else {
+        for (i = 0; i < count; i++) {
+            int status = dh_handleInsertion(statuses[i], &prods[i].info,
+                wasHereis, notifyAutoShift);
+
+            if (status && DOWN6_UNWANTED != status && DOWN6_PQ_BIG != status
+                    && 0 == retCode)
+                retCode = status;
+        }
+    }
+
+    free(statuses);
+
+    return retCode;
+}
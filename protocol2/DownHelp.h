@@ -10,6 +10,13 @@ dh_setInfo(
     const prod_info* const	oldInfo,
     const char* const		hostId);
 
+int
+dh_handleInsertion(
+    int				error,
+    const prod_info* const	info,
+    const int			wasHereis,
+    const int			notifyAutoShift);
+
 int
 dh_saveDataProduct(
     struct pqueue*		pq,
@@ -18,4 +25,20 @@ dh_saveDataProduct(
     const int			wasHereis,
     const int			notifyAutoShift);
 
+int
+dh_commitDataProduct(
+    struct pqueue*		pq,
+    const prod_info* const	info,
+    const pqe_index		index,
+    const int			wasHereis,
+    const int			notifyAutoShift);
+
+int
+dh_saveDataProducts(
+    struct pqueue*		pq,
+    const product* const	prods,
+    const size_t		count,
+    const int			wasHereis,
+    const int			notifyAutoShift);
+
 #endif
@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -26,6 +27,8 @@ struct UpFilter {
     StringBuf*  strBuf;
     int         stringOutOfDate;
     unsigned    count;
+    unsigned    stripe;         /* stripe to pass */
+    unsigned    stripeCount;    /* number of stripes or 1 */
 };
 
 
@@ -64,6 +67,8 @@ upFilter_new(
             filt->head = NULL;
             filt->stringOutOfDate = 1;
             filt->count = 0;
+            filt->stripe = 0;
+            filt->stripeCount = 1;
             *upFilter = filt;
             errObj = NULL;              /* success */
         }
@@ -178,6 +183,28 @@ upFilter_getComponentCount(
 }
 
 
+/*
+ * Restricts an upstream filter to one stripe of a striped subscription.  A
+ * data-product belongs to the stripe given by its signature modulo the number
+ * of stripes so that the stripes are disjoint and about equally large.
+ *
+ * Arguments:
+ *      upFilter        Pointer to the upstream filter.
+ *      stripe          The stripe.  Shall be less than "stripeCount".
+ *      stripeCount     The number of stripes.  1 disables striping.
+ */
+void
+upFilter_setStripe(
+    UpFilter* const             upFilter,
+    const unsigned              stripe,
+    const unsigned              stripeCount)
+{
+    upFilter->stripe = stripe;
+    upFilter->stripeCount = stripeCount ? stripeCount : 1;
+    upFilter->stringOutOfDate = 1;
+}
+
+
 /*
  * Indicates whether or not an upstream filter matches the information on a
  * product.
@@ -198,6 +225,16 @@ upFilter_isMatch(
     int                 matches = 0;
     const Element*      elt;
 
+    if (upFilter->stripeCount > 1) {
+        const unsigned char* const      sig = info->signature;
+        const unsigned long             hash = ((unsigned long)sig[0] << 24) |
+            ((unsigned long)sig[1] << 16) | ((unsigned long)sig[2] << 8) |
+            sig[3];
+
+        if (hash % upFilter->stripeCount != upFilter->stripe)
+            return 0;
+    }
+
     for (elt = upFilter->head; elt != NULL; elt = elt->next) {
         /*
          * The feedtypes of the Element-s must be disjoint in order for the
@@ -261,6 +298,14 @@ upFilter_toString(
 
                 (void)strBuf_appendString(strBuf, "}");
 
+                if (upFilter->stripeCount > 1) {
+                    char        buf[64];
+
+                    (void)snprintf(buf, sizeof(buf), " stripe %u/%u",
+                        upFilter->stripe, upFilter->stripeCount);
+                    (void)strBuf_appendString(strBuf, buf);
+                }
+
                 upFilter->stringOutOfDate = 0;
             }                           /* string-buffer correctly started */
         }                               /* string representation out-of-date */
@@ -16,6 +16,19 @@ upFilter_addComponent(
     const Pattern* const	okPattern,
     const Pattern* const	notPattern);
 
+/*
+ * Restricts an UpFilter to one stripe of a striped subscription.
+ * Arguments:
+ *	upFilter	Pointer to the UpFilter.
+ *	stripe		The stripe.  Shall be less than "stripeCount".
+ *	stripeCount	The number of stripes.  1 disables striping.
+ */
+void
+upFilter_setStripe(
+    UpFilter* const		upFilter,
+    const unsigned		stripe,
+    const unsigned		stripeCount);
+
 int
 upFilter_isMatch(
     const UpFilter* const	upFilter,
@@ -3,6 +3,18 @@
  * <p>
  * See file COPYRIGHT in the top-level source-directory for copying and
  * redistribution conditions.
+ * <p>
+ * This module decides when a downstream LDM that's one of several receiving
+ * the same data should switch between primary and alternate transfer-mode.
+ * Every period, it compares the number of data-products that it inserted into
+ * the product-queue with the number that were already there.  If the LDM-s
+ * share a group (see as_newGroup()), then it also compares the median latency
+ * of its data-products with that of the other LDM-s of the group, and a
+ * difference greater than a threshold decides the matter.  The latencies are
+ * only compared if they're based on a minimum number of data-products;
+ * otherwise, the counts decide as they always have.  The period, the latency
+ * threshold, and that minimum are the registry parameters under
+ * /server/autoshift/; a period of 0 means twice the LDM server's interval.
  *
  * @author Steven R. Emmerson
  */
@@ -15,17 +27,22 @@
 #include <errno.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
 
 #include "ldm.h"
 #include "error.h"
+#include "log.h"
+#include "registry.h"
 #include "timestamp.h"
 #include "ulog.h"
 #include "globals.h"
 #include "remote.h"
+#include "autoshift.h"
 
 
 /**
@@ -158,6 +175,189 @@ q_removeHead(void)
 #define q_getNext(ptr)  ((void* const*)((Elt*)ptr)->next)
 
 
+/******************************************************************************
+ * Begin Configuration Module
+ ******************************************************************************/
+
+
+#define DEFAULT_LATENCY_THRESHOLD   1000    /* milliseconds */
+#define DEFAULT_MIN_PRODUCTS        10
+
+
+static unsigned     c_period;           /* seconds between decisions */
+static unsigned     c_latencyThreshold = DEFAULT_LATENCY_THRESHOLD; /* ms */
+static unsigned     c_minProducts = DEFAULT_MIN_PRODUCTS;
+static int          c_isSet;
+
+
+/**
+ * Obtains the configuration from the registry if it hasn't been set.
+ */
+static void
+c_ensureConfig(void)
+{
+    if (!c_isSet) {
+        c_period = reg_getUintOrDefault(REG_AUTOSHIFT_PERIOD, 0);
+        c_latencyThreshold = reg_getUintOrDefault(
+                REG_AUTOSHIFT_LATENCY_THRESHOLD, DEFAULT_LATENCY_THRESHOLD);
+        c_minProducts = reg_getUintOrDefault(REG_AUTOSHIFT_MIN_PRODUCTS,
+                DEFAULT_MIN_PRODUCTS);
+        c_isSet = 1;
+    }
+}
+
+
+/**
+ * Returns the period between decisions.
+ *
+ * @return      The period in seconds
+ */
+static double
+c_getPeriod(void)
+{
+    c_ensureConfig();
+
+    return c_period ? c_period : 2*interval; /* SWAG default */
+}
+
+
+/******************************************************************************
+ * Begin Group Module
+ *
+ * The latency summaries of the LDM processes receiving the same data are kept
+ * in memory that's shared by the processes.  Each process writes only its own
+ * member and reads the others without locking: a torn read can only cause a
+ * decision to be deferred or made one period late.
+ ******************************************************************************/
+
+
+/**
+ * The latency summary of one LDM process of a group
+ */
+typedef struct {
+    volatile double     latency;        /* median latency in seconds */
+    volatile unsigned   count;          /* number of data-products */
+    volatile int        isPrimary;      /* in primary transfer-mode? */
+    volatile time_t     time;           /* when set; 0 => not set */
+} Member;
+
+
+struct as_Group {
+    size_t              size;           /* size of the mapping in bytes */
+    unsigned            count;          /* number of members */
+    Member              members[1];     /* the members */
+};
+
+
+static as_Group*    g_group = NULL;     /* group of this LDM process */
+static unsigned     g_index;            /* index of this LDM process */
+
+
+/**
+ * Sets the mode of this LDM process in the group.
+ *
+ * @param isPrimary     Whether or not this LDM process is in primary data
+ *                      receive-mode
+ */
+static void
+g_setPrimary(
+    const int       isPrimary)
+{
+    if (g_group != NULL)
+        g_group->members[g_index].isPrimary = isPrimary;
+}
+
+
+/**
+ * Sets the latency summary of this LDM process in the group.
+ *
+ * @param latency       The median latency in seconds
+ * @param count         The number of data-products
+ */
+static void
+g_set(
+    const double    latency,
+    const unsigned  count)
+{
+    if (g_group != NULL) {
+        Member* const   member = g_group->members + g_index;
+
+        member->time = 0;
+        member->latency = latency;
+        member->count = count;
+        member->time = time(NULL);
+    }
+}
+
+
+/**
+ * Decides whether or not to switch on the basis of latency. The median
+ * latency of this LDM process is compared with the smallest median latency of
+ * the other LDM processes of the group whose summaries are recent and based on
+ * enough data-products -- or, if this process is in alternate mode, of those
+ * that are in primary mode. The latencies are measured against the same clock
+ * and the same data-products, so the clock of the origin doesn't matter.
+ *
+ * @param latency       The median latency of this LDM process in seconds
+ * @param primary       Whether or not this LDM process is in primary mode
+ * @retval 1            This LDM process should switch
+ * @retval 0            This LDM process shouldn't switch
+ * @retval -1           Latency doesn't decide: there's no group, there are no
+ *                      comparable members, latency-driven switching is
+ *                      disabled, or the difference is within the threshold
+ */
+static int
+g_decide(
+    const double    latency,
+    const int       primary)
+{
+    const double    threshold = c_latencyThreshold / 1000.0;
+    const time_t    oldest = time(NULL) - (time_t)(2*c_getPeriod());
+    double          best = -1;          /* smallest latency of others */
+    unsigned        i;
+
+    if (g_group == NULL || c_latencyThreshold == 0)
+        return -1;
+
+    for (i = 0; i < g_group->count; i++) {
+        const Member* const member = g_group->members + i;
+        const time_t        when = member->time;
+
+        if (i == g_index || when == 0 || when < oldest ||
+                member->count < c_minProducts ||
+                (!primary && !member->isPrimary))
+            continue;
+
+        if (best < 0 || member->latency < best)
+            best = member->latency;
+    }
+
+    if (best < 0)
+        return -1;
+
+    udebug("g_decide(): latency=%g s, best other=%g s, primary=%d",
+            latency, best, primary);
+
+    if (latency > best + threshold) {
+        /* Another LDM is faster */
+        if (primary)
+            uinfo("Median latency %g s exceeds that of another LDM (%g s)",
+                    latency, best);
+        return primary;
+    }
+
+    if (latency + threshold < best) {
+        /* This LDM is faster */
+        if (!primary)
+            uinfo("Median latency %g s is less than that of the primary LDM "
+                    "(%g s)", latency, best);
+        return !primary;
+    }
+
+    return -1;
+}
+
+
 /******************************************************************************
  * Begin Statistics Module
  ******************************************************************************/
@@ -168,6 +368,7 @@ q_removeHead(void)
  */
 typedef struct {
     timestampt          time;           /* when the entry was created */
+    double              latency;        /* latency in seconds; <0 => unknown */
     int                 wasAccepted;    /* if the data-product was inserted */
 } Entry;
 
@@ -176,6 +377,8 @@ static timestampt   s_prevCompTime;    /* time of previous computation */
 static unsigned     s_ldmCount = 1;    /* number of LDM-s receiving same data */
 static int          s_primary = 1;     /* LDM uses HEREIS exclusively? */
 static int          s_switch = 0;      /* LDM process should switch mode? */
+static double*      s_latencies;       /* buffer for computing the median */
+static size_t       s_maxLatencies;    /* capacity of "s_latencies" */
 
 
 /**
@@ -194,7 +397,8 @@ static int          s_switch = 0;      /* LDM process should switch mode? */
  * @param primary       Whether or not this LDM process is in primary data
  *                      receive-mode
  */
-#define s_setPrimary(primary)          (s_primary = primary)
+#define s_setPrimary(primary)          (g_setPrimary(primary), \
+                                        s_primary = primary)
 
 
 /**
@@ -239,6 +443,67 @@ s_reset(void)
 }
 
 
+/**
+ * Compares two latencies. Called by qsort().
+ */
+static int
+s_compareLatencies(
+    const void* const   a,
+    const void* const   b)
+{
+    const double    x = *(const double*)a;
+    const double    y = *(const double*)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+
+/**
+ * Returns the median latency of the entries in the queue.
+ *
+ * @param count         [in] The number of entries in the queue.
+ * @param median        [out] The median latency in seconds.
+ * @return              The number of entries with a known latency. "*median"
+ *                      is set only if this is positive.
+ * @retval 0            No entry has a known latency or out-of-memory.
+ */
+static unsigned
+s_getMedianLatency(
+    const unsigned  count,
+    double* const   median)
+{
+    void* const*    elt;
+    unsigned        n = 0;
+
+    if (count > s_maxLatencies) {
+        double* const   latencies = realloc(s_latencies,
+                count*sizeof(double));
+
+        if (latencies == NULL)
+            return 0;
+
+        s_latencies = latencies;
+        s_maxLatencies = count;
+    }
+
+    for (elt = q_getHead(); elt != NULL && n < count; elt = q_getNext(elt)) {
+        const double    latency = (*(const Entry* const*)elt)->latency;
+
+        if (latency >= 0)
+            s_latencies[n++] = latency;
+    }
+
+    if (n > 0) {
+        qsort(s_latencies, n, sizeof(double), s_compareLatencies);
+        *median = (n % 2)
+            ? s_latencies[n/2]
+            : (s_latencies[n/2-1] + s_latencies[n/2]) / 2;
+    }
+
+    return n;
+}
+
+
 /**
  * Processes the acceptance or rejection of a data-product. Only meaningful
  * if the number of LDM processes receiving the same data is greater than 1.
@@ -248,13 +513,16 @@ s_reset(void)
  *
  * @param accepted      [in] Whether or not this data-product was successfully
  *                      inserted into the product-queue
+ * @param arrival       [in] The creation-time of the data-product at its
+ *                      origin or NULL if unknown
  * @retval 0            Success
  * @retval ENOSYS       as_getLdmCount() <= 1
  * @retval ENOMEM       Out-of-memory
  */
 static int
 s_process(
-    const int       accepted)
+    const int               accepted,
+    const timestampt* const arrival)
 {
     int             status;
 
@@ -276,8 +544,14 @@ s_process(
             timestampt      now = *getTime();
 
             newestEntry->time = now;
+            newestEntry->latency = (arrival == NULL)
+                ? -1
+                : d_diff_timestamp(&now, arrival);
             newestEntry->wasAccepted = accepted;
 
+            if (newestEntry->latency < 0 && arrival != NULL)
+                newestEntry->latency = 0; /* origin's clock is ahead */
+
             if ((status = q_add(newestEntry)) == 0) {
                 void* const*    elt;
                 const double    period = d_diff_timestamp(&now, &s_prevCompTime);
@@ -297,7 +571,7 @@ s_process(
                 /*
                  * Has sufficient time elapsed for a performance comparison?
                  */
-                if (period < 2*interval) {  /* SWAG threshold */
+                if (period < c_getPeriod()) {
                     /* No */
                     s_switch = 0;
                     udebug("s_process(): period=%g s", period);
@@ -330,15 +604,32 @@ s_process(
                         /* Yes */
                         const double      rejectedMean = rejectedCount /
                                 (double)(s_ldmCount - 1);
-
-                        s_switch = s_primary
-                                    ? (acceptedCount <= rejectedMean)
-                                    : (acceptedCount >= rejectedMean);
+                        double            latency = 0;
+                        const unsigned    latencyCount = s_getMedianLatency(
+                                acceptedCount + rejectedCount, &latency);
+                        int               decision = -1;
+
+                        /*
+                         * Only a latency comparison needs the minimum: the
+                         * count-based rule is applied as it always was.
+                         */
+                        if (latencyCount > 0 &&
+                                latencyCount >= c_minProducts) {
+                            g_set(latency, latencyCount);
+                            decision = g_decide(latency, s_primary);
+                        }
+
+                        s_switch = (decision >= 0)
+                                    ? decision
+                                    : s_primary
+                                        ? (acceptedCount <= rejectedMean)
+                                        : (acceptedCount >= rejectedMean);
 
                         udebug("s_process(): period=%g s, #accept=%u, "
-                                "#reject=%u, #LDM-s=%u, primary=%d, switch=%d",
+                                "#reject=%u, #LDM-s=%u, primary=%d, "
+                                "latency-decision=%d, switch=%d",
                             period, acceptedCount, rejectedCount, s_ldmCount,
-                            s_primary, s_switch);
+                            s_primary, decision, s_switch);
                     }
 
                     s_prevCompTime = now;
@@ -361,6 +652,113 @@ s_process(
  ******************************************************************************/
 
 
+/**
+ * Sets the configuration instead of obtaining it from the registry.
+ *
+ * @param period            Time, in seconds, between decisions. 0 means twice
+ *                          the interval.
+ * @param latencyThreshold  Difference, in milliseconds, between the median
+ *                          latencies of two LDM-s of a group that decides
+ *                          which one should be primary. 0 disables
+ *                          latency-driven switching.
+ * @param minProducts       Minimum number of data-products with a known
+ *                          latency received during a period for latency to
+ *                          decide. Doesn't affect the count-based decision.
+ */
+void
+as_setConfig(
+    const unsigned  period,
+    const unsigned  latencyThreshold,
+    const unsigned  minProducts)
+{
+    c_period = period;
+    c_latencyThreshold = latencyThreshold;
+    c_minProducts = minProducts;
+    c_isSet = 1;
+}
+
+
+/**
+ * Returns a new group of LDM processes receiving the same data. The group is
+ * in memory that's shared with subsequently-forked processes, so it should be
+ * created before the processes are forked.
+ *
+ * @param count         The number of LDM processes in the group. Shall be
+ *                      positive.
+ * @retval NULL         Failure. log_start() called.
+ * @return              Pointer to the new group.
+ */
+as_Group*
+as_newGroup(
+    const unsigned  count)
+{
+    const size_t    size = sizeof(as_Group) + (count-1)*sizeof(Member);
+    as_Group*       group;
+
+    assert(count > 0);
+
+    group = (as_Group*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANON, -1, 0);
+
+    if (MAP_FAILED == group) {
+        LOG_SERROR1("Couldn't allocate shared memory for %u-member autoshift "
+                "group", count);
+        return NULL;
+    }
+
+    group->size = size;                 /* mapping is zero-filled */
+    group->count = count;
+
+    return group;
+}
+
+
+/**
+ * Frees a group of LDM processes. The memory is freed when all processes
+ * that share it have freed it or terminated.
+ *
+ * @param group         Pointer to the group or NULL.
+ */
+void
+as_freeGroup(
+    as_Group* const group)
+{
+    if (group != NULL) {
+        if (group == g_group)
+            g_group = NULL;
+
+        (void)munmap(group, group->size);
+    }
+}
+
+
+/**
+ * Makes this LDM process a member of a group. Its latency summary will be
+ * compared with those of the other members.
+ *
+ * @param group         Pointer to the group or NULL to not be a member of a
+ *                      group.
+ * @param index         The index of this LDM process in the group.
+ * @retval 0            Success
+ * @retval EINVAL       "index" is greater than or equal to the number of
+ *                      members in the group.
+ */
+int
+as_setGroup(
+    as_Group* const group,
+    const unsigned  index)
+{
+    if (group != NULL && index >= group->count)
+        return EINVAL;
+
+    g_group = group;
+    g_index = index;
+    g_setPrimary(s_isPrimary());
+
+    return 0;
+}
+
+
 /**
  * Sets the number of LDM-s receiving the same data.  If the number doesn't
  * equal the previous number, then "as_init()" is called.
@@ -409,18 +807,21 @@ as_init(
  * @param success       Whether or not the data-product was inserted into the
  *                      product-queue
  * @param size          Size of the data-product in bytes
+ * @param arrival       Creation-time of the data-product at its origin (i.e.,
+ *                      "prod_info.arrival") or NULL if unknown
  * @retval 0            Success
  * @retval ENOMEM       Out of memory
  */
 int
 as_process(
-    const int           success,
-    const size_t        size)
+    const int               success,
+    const size_t            size,
+    const timestampt* const arrival)
 {
     if (s_getLdmCount() == 1)
         return 0;
 
-    return s_process(success);
+    return s_process(success, arrival);
 }
 
 
@@ -3,10 +3,81 @@
 
 #include <stddef.h>
 
+#include "timestamp.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * A group of LDM processes receiving the same data that compare their
+ * latencies.
+ */
+typedef struct as_Group as_Group;
+
+/**
+ * Sets the configuration instead of obtaining it from the registry.
+ *
+ * @param period            Time, in seconds, between decisions. 0 means twice
+ *                          the interval.
+ * @param latencyThreshold  Difference, in milliseconds, between the median
+ *                          latencies of two LDM-s of a group that decides
+ *                          which one should be primary. 0 disables
+ *                          latency-driven switching.
+ * @param minProducts       Minimum number of data-products with a known
+ *                          latency received during a period for latency to
+ *                          decide. Doesn't affect the count-based decision.
+ */
+void
+as_setConfig(
+    unsigned    period,
+    unsigned    latencyThreshold,
+    unsigned    minProducts);
+
+
+/**
+ * Returns a new group of LDM processes receiving the same data. The group is
+ * in memory that's shared with subsequently-forked processes, so it should be
+ * created before the processes are forked.
+ *
+ * @param count         The number of LDM processes in the group. Shall be
+ *                      positive.
+ * @retval NULL         Failure. log_start() called.
+ * @return              Pointer to the new group.
+ */
+as_Group*
+as_newGroup(
+    unsigned    count);
+
+
+/**
+ * Frees a group of LDM processes. The memory is freed when all processes
+ * that share it have freed it or terminated.
+ *
+ * @param group         Pointer to the group or NULL.
+ */
+void
+as_freeGroup(
+    as_Group*   group);
+
+
+/**
+ * Makes this LDM process a member of a group. Its latency summary will be
+ * compared with those of the other members.
+ *
+ * @param group         Pointer to the group or NULL to not be a member of a
+ *                      group.
+ * @param index         The index of this LDM process in the group.
+ * @retval 0            Success
+ * @retval EINVAL       "index" is greater than or equal to the number of
+ *                      members in the group.
+ */
+int
+as_setGroup(
+    as_Group*   group,
+    unsigned    index);
+
+
 /**
  * Resets this module. Starts the clock on measuring performance.
  *
@@ -40,6 +111,8 @@ as_setLdmCount(
  * @param success       Whether or not the data-product was inserted into the
  *                      product-queue
  * @param size          Size of the data-product in bytes
+ * @param arrival       Creation-time of the data-product at its origin (i.e.,
+ *                      "prod_info.arrival") or NULL if unknown
  * @retval 0            Success
  * @retval ENOSYS       "as_setLdmCount()" not yet called
  * @retval ENOMEM       Out of memory
@@ -47,7 +120,8 @@ as_setLdmCount(
 int
 as_process(
     const int           success,
-    const size_t        size);
+    const size_t        size,
+    const timestampt*   arrival);
 
 /**
  * Indicates whether or not this LDM process should switch its data-product
@@ -0,0 +1,493 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * The harness that the transfer benchmarks share.  See bench_util.h.
+ */
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <rpc/rpc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "autoshift.h"
+#include "down6.h"
+#include "error.h"
+#include "globals.h"
+#include "inserter.h"
+#include "ldm.h"
+#include "pattern.h"
+#include "pq.h"
+#include "savedInfo.h"
+#include "timestamp.h"
+#include "ulog.h"
+#include "up6.h"
+#include "UpFilter.h"
+#include "bench_util.h"
+
+static prod_spec        allSpec = {ANY, ".*"};
+static prod_class_t     allClass = {{0, 0}, {0, 0}, {1, &allSpec}};
+
+/*
+ * Initializes a benchmark.
+ */
+void
+bench_init(
+    const char* const   progname,
+    const int           level)
+{
+    (void)openulog(progname, LOG_NOTIME | LOG_IDENT, LOG_LDM, "-");
+    (void)setulogmask(LOG_UPTO(level));
+    (void)signal(SIGPIPE, SIG_IGN);
+
+    allClass.to = TS_ENDT;
+}
+
+/*
+ * Sets the pathname of a temporary product-queue of a benchmark.
+ */
+void
+bench_setPath(
+    char* const         buf,
+    const size_t        size,
+    const char* const   dir,
+    const char* const   progname,
+    const char* const   which)
+{
+    (void)snprintf(buf, size, "%s/%s-%s-%d.pq", dir, progname, which,
+            (int)getpid());
+}
+
+/*
+ * Creates a product-queue and inserts data-products into it.
+ */
+int
+bench_fillQueue(
+    const char* const           path,
+    const unsigned              count,
+    const unsigned              size,
+    const char* const           origin,
+    const BenchSetProduct       setProduct,
+    void* const                 arg)
+{
+    pqueue*     pq;
+    char*       data = malloc(size);
+    char        ident[32];
+    product     prod;
+    unsigned    i;
+    int         status;
+
+    if (NULL == data)
+        return ENOMEM;
+
+    status = pq_create(path, 0666, PQ_DEFAULT, 0,
+            (off_t)count * (size + 256) + 1000000, count + 100, &pq);
+    if (status) {
+        uerror("Couldn't create product-queue \"%s\": %s", path,
+                strerror(status));
+        free(data);
+        return status;
+    }
+
+    (void)memset(data, 'x', size);
+
+    for (i = 0; i < count && 0 == status; i++) {
+        prod.info.origin = (char*)origin;
+        prod.info.feedtype = EXP;
+        prod.info.ident = ident;
+        prod.info.sz = size;
+        prod.data = data;
+        (void)set_timestamp(&prod.info.arrival);
+        prod.info.seqno = i;
+        (void)snprintf(ident, sizeof(ident), "product %u", i);
+        (void)memset(prod.info.signature, 0, sizeof(signaturet));
+        (void)memcpy(prod.info.signature, &i, sizeof(i));
+
+        if (NULL != setProduct && setProduct(&prod, i, arg))
+            continue;
+
+        status = pq_insert(pq, &prod);
+        if (status)
+            uerror("Couldn't insert product %u: %s", i, strerror(status));
+    }
+
+    (void)pq_close(pq);
+    free(data);
+
+    return status;
+}
+
+/*
+ * Relays bytes between the upstream LDM and the downstream LDM at a limited
+ * rate.  Doesn't return.
+ */
+void
+bench_runRelay(
+    const int           upSock,
+    const int           downSock,
+    const unsigned      rate,
+    const int           pipeFd)
+{
+    const size_t        chunk = rate / 100 ? rate / 100 : 1;
+    char*               buf = malloc(chunk > 65536 ? chunk : 65536);
+    unsigned long long  total = 0;
+    timestampt          start;
+    struct pollfd       fds[2];
+
+    if (NULL == buf)
+        exit(1);
+
+    fds[0].fd = upSock;
+    fds[0].events = POLLIN;
+    fds[1].fd = downSock;
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        ssize_t n;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (EINTR == errno)
+                continue;
+            break;
+        }
+
+        if (fds[1].revents) {
+            n = read(downSock, buf, 65536);
+
+            if (n <= 0 || write(upSock, buf, n) != n)
+                break;
+        }
+
+        if (fds[0].revents) {
+            timestampt  now;
+            double      ahead;
+
+            n = read(upSock, buf, chunk);
+
+            if (n <= 0 || write(downSock, buf, n) != n)
+                break;
+
+            if (0 == total)
+                (void)set_timestamp(&start); /* link starts with 1st byte */
+
+            total += n;
+            (void)set_timestamp(&now);
+            ahead = (double)total / rate - d_diff_timestamp(&now, &start);
+
+            if (ahead > 0) {
+                struct timespec delay;
+
+                delay.tv_sec = (time_t)ahead;
+                delay.tv_nsec = (long)((ahead - delay.tv_sec) * 1e9);
+                (void)nanosleep(&delay, NULL);
+            }
+        }
+    }
+
+    (void)write(pipeFd, &total, sizeof(total));
+    exit(0);
+}
+
+/*
+ * Runs the upstream LDM on a connected socket.  Doesn't return.
+ */
+static void
+runUpstream(
+    const int                   sock,
+    const struct sockaddr_in*   addr,
+    const char* const           pqPath,
+    const BenchConfig* const    config)
+{
+    UpFilter*   upFilter;
+    Pattern*    pat;
+    ErrorObj*   errObj;
+
+    if ((errObj = upFilter_new(&upFilter)) ||
+            (errObj = pat_new(&pat, ".*", 0)) ||
+            (errObj = upFilter_addComponent(upFilter, ANY, pat, NULL))) {
+        err_log_and_free(errObj, ERR_FAILURE);
+        exit(1);
+    }
+
+    if (NULL != config->setUp)
+        config->setUp(config->arg);
+
+    (void)up6_new_feeder(sock, "localhost", addr, &allClass, NULL, pqPath, 30,
+            upFilter, config->primary);
+    exit(0);
+}
+
+/*
+ * Runs the downstream LDM on a connected socket until the transfer is
+ * complete.
+ *
+ * Returns:
+ *      -1      Failure.
+ *      else    Duration of the transfer in seconds.
+ */
+static double
+runDownstream(
+    const int                   sock,
+    struct sockaddr_in* const   addr,
+    const char* const           pqPath,
+    const BenchConfig* const    config)
+{
+    double      duration = -1;
+    pqueue*     pq;
+    SVCXPRT*    xprt;
+    int         status = config->downSize
+            ? pq_create(pqPath, 0666, PQ_DEFAULT, 0, config->downSize,
+                    config->count + 100, &pq)
+            : pq_open(pqPath, PQ_DEFAULT, &pq);
+
+    if (status) {
+        uerror("Couldn't open product-queue \"%s\": %s", pqPath,
+                strerror(status));
+        return -1;
+    }
+
+    xprt = svcfd_create(sock, 0, MAX_RPC_BUF_NEEDED);
+
+    if (NULL == xprt || !svc_register(xprt, LDMPROG, SIX, ldmprog_6, 0)) {
+        uerror("Couldn't create RPC service");
+    }
+    else if (down6_init("localhost", addr, pqPath, pq) ||
+            down6_set_prod_class(&allClass)) {
+        uerror("Couldn't initialize downstream LDM");
+    }
+    else {
+        timestampt      start;
+        timestampt      stop;
+        fd_set          fds;
+
+        (void)as_setLdmCount(1);
+        as_init(1);
+        (void)savedInfo_set(NULL);
+        (void)set_timestamp(&start);
+
+        for (;;) {
+            struct timeval      timeout = {60, 0};
+            const prod_info*    info;
+            const int           insFd = ins_getFd();
+            int                 isDone;
+
+            FD_ZERO(&fds);
+            FD_SET(sock, &fds);
+            if (insFd >= 0)
+                FD_SET(insFd, &fds);
+
+            if (select((insFd > sock ? insFd : sock) + 1, &fds, NULL, NULL,
+                    &timeout) <= 0) {
+                uerror("Transfer stalled");
+                break;
+            }
+
+            if (insFd >= 0 && FD_ISSET(insFd, &fds) && ins_reap()) {
+                uerror("Insertion failed");
+                break;
+            }
+
+            if (FD_ISSET(sock, &fds)) {
+                svc_getreqsock(sock);
+
+                if (!FD_ISSET(sock, &svc_fdset)) {
+                    uerror("Connection closed");
+                    xprt = NULL;
+                    break;
+                }
+            }
+
+            if (NULL != config->isDone) {
+                isDone = config->isDone(pq, &start, config->arg);
+            }
+            else {
+                info = savedInfo_get();
+                isDone = NULL != info && info->seqno == config->count - 1;
+            }
+
+            if (isDone) {
+                (void)set_timestamp(&stop);
+                duration = d_diff_timestamp(&stop, &start);
+                break;
+            }
+        }
+
+        down6_destroy();
+    }
+
+    if (NULL != xprt)
+        svc_destroy(xprt);
+    (void)pq_close(pq);
+    if (config->downSize)
+        (void)unlink(pqPath);
+
+    return duration;
+}
+
+/*
+ * Returns the CPU time in a resource-usage structure in seconds.
+ */
+static double
+cpuTime(
+    const struct rusage* const  ru)
+{
+    return ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6 +
+            ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+}
+
+/*
+ * Transfers the data-products of a product-queue once over a new connection.
+ */
+int
+bench_transfer(
+    const char* const           upPath,
+    const char* const           downPath,
+    const BenchConfig* const    config,
+    BenchResult* const          result)
+{
+    const int           relayed = NULL != config->relay || config->rate > 0;
+    struct sockaddr_in  addr;
+    socklen_t           len = sizeof(addr);
+    int                 lsock = socket(AF_INET, SOCK_STREAM, 0);
+    int                 pair[2] = {-1, -1};
+    int                 fds[2] = {-1, -1};
+
+    (void)memset(result, 0, sizeof(*result));
+    result->duration = -1;
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    /*
+     * The accepted socket inherits the receive-buffer size, which must be set
+     * before the connection is established to limit the TCP window.
+     */
+    if (lsock >= 0 && config->rcvBuf > 0)
+        (void)setsockopt(lsock, SOL_SOCKET, SO_RCVBUF, &config->rcvBuf,
+                sizeof(config->rcvBuf));
+
+    if (lsock < 0 || bind(lsock, (struct sockaddr*)&addr, sizeof(addr)) ||
+            listen(lsock, 1) ||
+            getsockname(lsock, (struct sockaddr*)&addr, &len) ||
+            (relayed && (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) ||
+                    pipe(fds)))) {
+        serror("Couldn't create sockets");
+    }
+    else {
+        pid_t   upPid;
+        pid_t   relayPid = 0;
+
+        (void)fflush(stdout);           /* children call exit() */
+        upPid = fork();
+
+        if (0 == upPid) {
+            int sock = pair[0];
+
+            (void)close(lsock);
+
+            if (relayed) {
+                (void)close(pair[1]);
+            }
+            else if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+                    connect(sock, (struct sockaddr*)&addr, sizeof(addr))) {
+                serror("Couldn't connect to downstream LDM");
+                exit(1);
+            }
+
+            runUpstream(sock, &addr, upPath, config);
+        }
+
+        if (upPid > 0 && relayed && 0 == (relayPid = fork())) {
+            int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+            (void)close(lsock);
+            (void)close(pair[0]);
+            (void)close(fds[0]);
+
+            if (sock < 0 ||
+                    connect(sock, (struct sockaddr*)&addr, sizeof(addr))) {
+                serror("Couldn't connect to downstream LDM");
+                exit(1);
+            }
+
+            if (NULL != config->relay) {
+                config->relay(pair[1], sock, fds[1], config->arg);
+            }
+            else {
+                bench_runRelay(pair[1], sock, config->rate, fds[1]);
+            }
+            exit(0);
+        }
+
+        if (relayed) {
+            (void)close(pair[0]);
+            (void)close(pair[1]);
+            (void)close(fds[1]);
+        }
+
+        if (upPid < 0 || relayPid < 0) {
+            serror("fork() failure");
+
+            if (upPid > 0) {
+                (void)kill(upPid, SIGTERM);
+                (void)waitpid(upPid, NULL, 0);
+            }
+        }
+        else {
+            int             sock = accept(lsock, NULL, NULL);
+            struct rusage   before;
+            struct rusage   after;
+            struct rusage   upUsage;
+
+            (void)getrusage(RUSAGE_SELF, &before);
+
+            if (sock < 0) {
+                serror("accept() failure");
+            }
+            else {
+                result->duration = runDownstream(sock, &addr, downPath,
+                        config);
+            }
+
+            (void)getrusage(RUSAGE_SELF, &after);
+            result->downCpu = cpuTime(&after) - cpuTime(&before);
+
+            (void)kill(upPid, SIGTERM);
+            (void)wait4(upPid, NULL, 0, &upUsage);
+            result->upCpu = cpuTime(&upUsage);
+
+            if (relayed) {
+                /* The relay reports when the upstream LDM has closed */
+                if (read(fds[0], &result->linkBytes,
+                            sizeof(result->linkBytes)) !=
+                        sizeof(result->linkBytes))
+                    result->linkBytes = 0;
+
+                (void)kill(relayPid, SIGTERM);
+                (void)waitpid(relayPid, NULL, 0);
+            }
+        }
+    }
+
+    if (lsock >= 0)
+        (void)close(lsock);
+    if (fds[0] >= 0)
+        (void)close(fds[0]);
+
+    return result->duration < 0 ? -1 : 0;
+}
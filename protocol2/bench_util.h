@@ -0,0 +1,195 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * This header-file specifies the API of the harness that the transfer
+ * benchmarks (e.g., hereis_bench) share.  The harness feeds the data-products
+ * of one product-queue from an upstream LDM-6 process to a downstream LDM-6
+ * in the calling process over a loopback connection, optionally through a
+ * process that simulates the link.  A benchmark configures the parts it's
+ * about via a BenchConfig.
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "ldm.h"
+#include "pq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Adjusts a data-product before bench_fillQueue() inserts it.
+ *
+ * @param prod          [in/out] The data-product with the defaults of
+ *                      bench_fillQueue().  "prod->data" may be modified.
+ * @param index         [in] Origin-0 index of the data-product.
+ * @param arg           [in/out] The argument given to bench_fillQueue().
+ * @retval 0            Insert the data-product.
+ * @retval !0           Skip the data-product.
+ */
+typedef int (*BenchSetProduct)(
+    product* const      prod,
+    const unsigned      index,
+    void* const         arg);
+
+/*
+ * The configuration of a transfer by bench_transfer():
+ */
+typedef struct {
+    /*
+     * Number of data-products that the downstream LDM must receive.
+     */
+    unsigned    count;
+    /*
+     * Size in bytes of the downstream product-queue to create or 0 to open
+     * the existing one, which isn't deleted afterwards.
+     */
+    off_t       downSize;
+    /*
+     * Whether the upstream LDM uses the primary transfer-mode (HEREIS).
+     */
+    int         primary;
+    /*
+     * Size in bytes of the downstream socket's receive-buffer or 0 for the
+     * system default.
+     */
+    int         rcvBuf;
+    /*
+     * Rate in bytes per second of the upstream-to-downstream direction of
+     * the link relayed by bench_runRelay() or 0 for a direct connection.
+     * Ignored if "relay" is set.
+     */
+    unsigned    rate;
+    /*
+     * Configures the upstream LDM in its process before it starts or NULL.
+     */
+    void        (*setUp)(void* arg);
+    /*
+     * Relays between the upstream LDM's socket "upSock" and the downstream
+     * LDM's socket "downSock" until either is closed, optionally writing the
+     * number of relayed bytes as an "unsigned long long" to "pipeFd", and
+     * doesn't return; or NULL.
+     */
+    void        (*relay)(int upSock, int downSock, int pipeFd, void* arg);
+    /*
+     * Indicates whether the transfer is complete after the downstream LDM
+     * received something or NULL to wait for the data-product whose
+     * sequence-number is "count - 1".  "start" is when the transfer started.
+     */
+    int         (*isDone)(pqueue* pq, const timestampt* start, void* arg);
+    /*
+     * The argument of the above functions.
+     */
+    void*       arg;
+} BenchConfig;
+
+/*
+ * The measurements of a transfer by bench_transfer():
+ */
+typedef struct {
+    double              duration;       /* seconds until complete */
+    double              upCpu;          /* CPU seconds of the upstream LDM */
+    double              downCpu;        /* CPU seconds of the downstream LDM */
+    unsigned long long  linkBytes;      /* bytes relayed or 0 */
+} BenchResult;
+
+/**
+ * Initializes a benchmark: opens logging to the standard error stream at the
+ * given level, ignores SIGPIPE, and initializes the harness.
+ *
+ * @param progname      [in] Name of the benchmark.
+ * @param level         [in] The ulog(3) logging-level (e.g., LOG_NOTICE).
+ */
+void
+bench_init(
+    const char* const   progname,
+    const int           level);
+
+/**
+ * Sets the pathname of a temporary product-queue of a benchmark.
+ *
+ * @param buf           [out] The pathname.
+ * @param size          [in] Size of "buf" in bytes.
+ * @param dir           [in] Directory of the product-queue.
+ * @param progname      [in] Name of the benchmark.
+ * @param which         [in] Which product-queue (e.g., "up").
+ */
+void
+bench_setPath(
+    char* const         buf,
+    const size_t        size,
+    const char* const   dir,
+    const char* const   progname,
+    const char* const   which);
+
+/**
+ * Creates a product-queue and inserts data-products into it.  By default,
+ * data-product "i" is an EXP one of "size" 'x'-s whose identifier is
+ * "product i", whose sequence-number is "i", and whose signature is "i"
+ * followed by zeros.
+ *
+ * @param path          [in] Pathname of the product-queue.
+ * @param count         [in] Number of data-products.
+ * @param size          [in] Maximum size of a data-product in bytes.
+ * @param origin        [in] Origin of the data-products.
+ * @param setProduct    [in] Adjusts each data-product or NULL.
+ * @param arg           [in/out] Argument of "setProduct".
+ * @retval 0            Success.
+ * @return              Error code. uerror() called.
+ */
+int
+bench_fillQueue(
+    const char* const           path,
+    const unsigned              count,
+    const unsigned              size,
+    const char* const           origin,
+    const BenchSetProduct       setProduct,
+    void* const                 arg);
+
+/**
+ * Relays bytes between the upstream LDM and the downstream LDM, limiting the
+ * rate of the upstream-to-downstream direction from its first byte on, until
+ * the upstream LDM closes its connection.  Writes the number of relayed bytes
+ * to a pipe.  Doesn't return.
+ *
+ * @param upSock        [in] Socket of the upstream LDM.
+ * @param downSock      [in] Socket of the downstream LDM.
+ * @param rate          [in] Maximum rate in bytes per second.
+ * @param pipeFd        [in] Write end of the pipe.
+ */
+void
+bench_runRelay(
+    const int           upSock,
+    const int           downSock,
+    const unsigned      rate,
+    const int           pipeFd);
+
+/**
+ * Transfers the data-products of a product-queue once over a new connection.
+ *
+ * @param upPath        [in] Pathname of the upstream product-queue.
+ * @param downPath      [in] Pathname of the downstream product-queue.
+ * @param config        [in] Configuration of the transfer.
+ * @param result        [out] Measurements of the transfer.
+ * @retval 0            Success.
+ * @retval -1           Failure. uerror() called.
+ */
+int
+bench_transfer(
+    const char* const           upPath,
+    const char* const           downPath,
+    const BenchConfig* const    config,
+    BenchResult* const          result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Benchmark of the transfer of textual data-products from an upstream LDM-6
+ * to a downstream LDM-6 over a simulated slow link -- both with and without
+ * the compression of data-products into HEREIS_ZBATCH messages.  The link is
+ * a relay process that limits the rate of the upstream-to-downstream
+ * direction.  The CPU time of the upstream and downstream LDM-s is reported.
+ *
+ * Usage: compress_bench [-v] [-n count] [-s size] [-r rate] [-t threshold]
+ *                       [-d dir]
+ *
+ *     -v            Verbose logging.
+ *     -n count      Number of data-products (default 1000).
+ *     -s size       Size of each data-product in bytes (default 5000).
+ *     -r rate       Rate of the link in bytes per second (default 1000000).
+ *     -t threshold  Compression threshold in bytes (default 1024).
+ *     -d dir        Directory for the temporary product-queues (default
+ *                   /tmp).
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ldm.h"
+#include "ulog.h"
+#include "zbatch.h"
+#include "bench_util.h"
+
+/*
+ * The configuration of the upstream LDM:
+ */
+typedef struct {
+    int         compressing;
+    unsigned    threshold;
+} UpConfig;
+
+/*
+ * Fills a buffer with lines of text that resemble surface observations so
+ * that the data compresses about as well as real textual data-products.
+ */
+static void
+fillText(
+    char* const         buf,
+    const unsigned      size)
+{
+    static const char*  sky[] = {"CLR", "FEW", "SCT", "BKN", "OVC"};
+    unsigned            len = 0;
+
+    while (len < size) {
+        char    line[128];
+        int     n = snprintf(line, sizeof(line),
+                "METAR K%c%c%c %02d%02d%02dZ %03d%02dKT %dSM %s%03d %02d/%02d "
+                "A%04d RMK AO2 SLP%03d=\n",
+                'A' + rand() % 26, 'A' + rand() % 26, 'A' + rand() % 26,
+                1 + rand() % 28, rand() % 24, rand() % 60, 10 * (rand() % 36),
+                rand() % 30, 1 + rand() % 10, sky[rand() % 5],
+                10 * (rand() % 30), rand() % 35, rand() % 25,
+                2950 + rand() % 100, rand() % 1000);
+
+        if (n > (int)(size - len))
+            n = size - len;
+
+        (void)memcpy(buf + len, line, n);
+        len += n;
+    }
+}
+
+/*
+ * Makes a data-product textual.  Called by bench_fillQueue().
+ */
+/*ARGSUSED*/
+static int
+setProduct(
+    product* const      prod,
+    const unsigned      index,
+    void* const         arg)
+{
+    prod->info.feedtype = IDS|DDPLUS;
+    fillText(prod->data, prod->info.sz);
+
+    return 0;
+}
+
+/*
+ * Configures the upstream LDM.  Called by bench_transfer().
+ */
+static void
+setUp(
+    void* const arg)
+{
+    const UpConfig* const       upConfig = (UpConfig*)arg;
+
+    zb_setConfig(upConfig->compressing ? ANY : NONE, upConfig->threshold);
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char* dir = "/tmp";
+    unsigned    count = 1000;
+    unsigned    size = 5000;
+    unsigned    rate = 1000000;
+    char        upPath[256];
+    char        downPath[256];
+    UpConfig    upConfig;
+    BenchConfig config;
+    int         ch;
+    int         status = 0;
+
+    bench_init("compress_bench", LOG_NOTICE);
+    upConfig.threshold = 1024;
+
+    while ((ch = getopt(argc, argv, "vn:s:r:t:d:")) != -1) {
+        switch (ch) {
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'n':
+            count = (unsigned)atoi(optarg);
+            break;
+        case 's':
+            size = (unsigned)atoi(optarg);
+            break;
+        case 'r':
+            rate = (unsigned)atoi(optarg);
+            break;
+        case 't':
+            upConfig.threshold = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-v] [-n count] [-s size] [-r rate] "
+                    "[-t threshold] [-d dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == count || 0 == size || 0 == rate) {
+        (void)fprintf(stderr, "Count, size, and rate must be positive\n");
+        return 1;
+    }
+
+    bench_setPath(upPath, sizeof(upPath), dir, "compress_bench", "up");
+    bench_setPath(downPath, sizeof(downPath), dir, "compress_bench", "down");
+
+    srand(1);
+
+    if (bench_fillQueue(upPath, count, size, "compress_bench", setProduct,
+                NULL))
+        return 1;
+
+    (void)memset(&config, 0, sizeof(config));
+    config.count = count;
+    config.downSize = 100000000;
+    config.primary = 1;
+    config.rate = rate;
+    config.setUp = setUp;
+    config.arg = &upConfig;
+
+    for (upConfig.compressing = 0; upConfig.compressing <= 1;
+            upConfig.compressing++) {
+        BenchResult     result;
+
+        if (bench_transfer(upPath, downPath, &config, &result)) {
+            status = 1;
+        }
+        else {
+            (void)printf("%-12s %u products of %u bytes at %u bytes/s: "
+                    "%.3f s, %.0f products/s, %llu link bytes, "
+                    "CPU up %.3f s down %.3f s\n",
+                    upConfig.compressing ? "compressed" : "uncompressed",
+                    count, size, rate, result.duration,
+                    count / result.duration, result.linkBytes, result.upCpu,
+                    result.downCpu);
+        }
+    }
+
+    (void)unlink(upPath);
+
+    return status;
+}
@@ -19,6 +19,7 @@
 #include "DownHelp.h"
 #include "error.h"
 #include "globals.h"     /* inactive_timeo */
+#include "inserter.h"
 #include "remote.h"
 #include "ldm.h"         /* client-side LDM functions */
 #include "ldmprint.h"    /* s_prod_info() */
@@ -43,15 +44,179 @@ typedef enum {
 
 static struct pqueue* _pq;              /* product-queue */
 static prod_class_t*    _class;           /* product-class to accept */
-static char*          _datap;           /* BLKDATA area */
+static char*          _datap;           /* reserved product-queue region */
+static pqe_index      _index;           /* index of reserved region */
+static int            _reserved;        /* product-queue region reserved? */
 static prod_info*     _info;            /* product-info */
 static unsigned       _remaining;       /* remaining BLKDATA bytes */
 static int            _expectBlkdata;   /* expect BLKDATA message? */
 static int            _initialized;     /* module initialized? */
+static prod_info**    _batchInfos;      /* product-info of batched products */
+static product*       _batchProds;      /* batched products to insert */
+static unsigned       _batchMax;        /* capacity of batch arrays */
 static char           _upName[MAXHOSTNAMELEN+1];        /* upstream host name */
 static char           _dotAddr[DOTTEDQUADLEN];  /* dotted-quad IP address */
 
 
+/*
+ * Releases the product-queue region, if any, that was reserved for an
+ * incoming data-product whose data won't be committed.
+ */
+static void
+discardReservation(void)
+{
+    if (_reserved) {
+        int     error = pqe_discard(_pq, _index);
+
+        if (error)
+            uerror("Couldn't discard product-queue region: %s",
+                strerror(error));
+
+        _reserved = 0;
+    }
+}
+
+
+/*
+ * Returns the location into which the XDR layer should decode the data of a
+ * product received via a HEREIS message.  If the product is wanted, then a
+ * region is reserved in the product-queue so that the data is decoded
+ * directly into its final location; down6_hereis() commits or discards the
+ * region.  If data-products are inserted by the "inserter" module, then the
+ * data is decoded into that module's buffer instead.  Otherwise, NULL is
+ * returned and the data is decoded into the buffer of the "XDR-data" module.
+ *
+ * Arguments:
+ *      infop   Pointer to the metadata of the product.
+ * Returns:
+ *      NULL    Use the buffer of the "XDR-data" module.
+ *      else    Pointer to the reserved region or insertion buffer for the
+ *              product's data.
+ */
+static void*
+getHereisBuffer(
+    const prod_info*    infop)
+{
+    void*       datap;
+
+    if (!_initialized || NULL == _class)
+        return NULL;
+
+    if (_expectBlkdata) {
+        uwarn("%s:%d: Discarding incomplete product: %s", __FILE__, __LINE__,
+            s_prod_info(NULL, 0, _info, ulogIsDebug()));
+
+        _expectBlkdata = 0;
+    }
+    discardReservation();
+
+    if (0 == infop->sz || infop->sz > pq_getDataSize(_pq))
+        return NULL;
+
+    (void)set_timestamp(&_class->from);
+    _class->from.tv_sec -= max_latency;
+
+    if (!prodInClass(_class, infop))
+        return NULL;
+
+    if (ins_isRunning())
+        return ins_getBuffer(infop->sz);
+
+    dh_setInfo(_info, infop, _upName);
+
+    /*
+     * A failure is handled by down6_hereis() when the product is inserted
+     * the conventional way.
+     */
+    if (pqe_new(_pq, _info, &datap, &_index))
+        return NULL;
+
+    _reserved = 1;
+    _datap = datap;
+
+    return datap;
+}
+
+
+/*
+ * Returns the location into which the XDR layer should decode the data of a
+ * batch of products: the buffer of the "inserter" module if it's running, so
+ * that the data needn't be copied.  Otherwise, NULL is returned and the data
+ * is decoded into the buffer of the "XDR-data" module.
+ *
+ * Arguments:
+ *      size    Total size of the data in bytes.
+ * Returns:
+ *      NULL    Use the buffer of the "XDR-data" module.
+ *      else    Pointer to the insertion buffer.
+ */
+static void*
+getBatchBuffer(
+    const size_t        size)
+{
+    return _initialized && ins_isRunning() ? ins_getBuffer(size) : NULL;
+}
+
+
+/*
+ * Ensures that the arrays used to insert a batch of products can hold a given
+ * number of products.
+ *
+ * Arguments:
+ *      count   The number of products.
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory.
+ */
+static int
+ensureBatchCapacity(
+    const unsigned      count)
+{
+    if (count > _batchMax) {
+        prod_info**     infos = realloc(_batchInfos, count * sizeof(prod_info*));
+        product*        prods;
+
+        if (NULL == infos)
+            return ENOMEM;
+        _batchInfos = infos;
+
+        prods = realloc(_batchProds, count * sizeof(product));
+        if (NULL == prods)
+            return ENOMEM;
+        _batchProds = prods;
+
+        for (; _batchMax < count; _batchMax++) {
+            _batchInfos[_batchMax] = pi_new();
+
+            if (NULL == _batchInfos[_batchMax])
+                return ENOMEM;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Frees the arrays used to insert a batch of products.
+ */
+static void
+freeBatch(void)
+{
+    unsigned    i;
+
+    for (i = 0; i < _batchMax; i++)
+        pi_free(_batchInfos[i]);
+
+    free(_batchInfos);
+    free(_batchProds);
+
+    _batchInfos = NULL;
+    _batchProds = NULL;
+    _batchMax = 0;
+}
+
+
 /*******************************************************************************
  * Begin public API.
  ******************************************************************************/
@@ -86,6 +251,10 @@ int down6_init(
 
     _initialized = 0;
 
+    if (NULL != _pq)
+        discardReservation();
+    _reserved = 0;
+
     (void)strcpy(_dotAddr, inet_ntoa(upAddr->sin_addr));
     (void)strncpy(_upName, upName, sizeof(_upName)-1);
 
@@ -112,9 +281,14 @@ int down6_init(
         }
     }
 
-    if (!errCode)
+    if (!errCode) {
         _initialized = 1;
 
+        xd_setProductBufferFunc(getHereisBuffer);
+        xd_setBatchBufferFunc(getBatchBuffer);
+        (void)ins_start(pq);
+    }
+
     return errCode;
 }
 
@@ -201,7 +375,10 @@ prod_class_t *down6_get_prod_class()
 /*
  * Handles a product.  This function prints diagnostic messages via the ulog(3)
  * module.  On successful return, savedInfo_get() will return the metadata 
- * of the product.
+ * of the product.  If the "inserter" module is running, then the product is
+ * only queued for insertion: savedInfo_get() will return its metadata once
+ * it's been inserted, and a failure to insert it will be returned by a
+ * subsequent call.
  *
  * This function updates "_class->from".
  *
@@ -250,19 +427,47 @@ down6_hereis(
                         s_prod_info(NULL, 0, infop, ulogIsDebug())),
                     ERR_INFO);
             }
-            errCode = savedInfo_set(_info);
-            if (errCode) {
-                err_log_and_free(
-                    ERR_NEW1(0, NULL,
-                        "Couldn't save product-information: %s",
-                        savedInfo_strerror(errCode)),
-                    ERR_FAILURE);
+            if (_reserved && prod->data == _datap)
+                discardReservation();
 
-                errCode = DOWN6_SYSTEM_ERROR;
+            if (ins_isRunning()) {
+                /*
+                 * The product-information is saved after that of the
+                 * data-products that are still being inserted.
+                 */
+                errCode = ins_put(NULL, 0, 1, _info);
             }
             else {
-                errCode = DOWN6_UNWANTED;
+                errCode = savedInfo_set(_info);
+                if (errCode) {
+                    err_log_and_free(
+                        ERR_NEW1(0, NULL,
+                            "Couldn't save product-information: %s",
+                            savedInfo_strerror(errCode)),
+                        ERR_FAILURE);
+
+                    errCode = DOWN6_SYSTEM_ERROR;
+                }
             }
+
+            if (!errCode)
+                errCode = DOWN6_UNWANTED;
+        }
+        else if (ins_isRunning()) {
+            product     newprod;
+
+            newprod.info = *_info;
+            newprod.data = prod->data;
+
+            errCode = ins_put(&newprod, 1, 1, NULL);
+        }
+        else if (_reserved && prod->data == _datap) {
+            /*
+             * The XDR layer decoded the data directly into the region
+             * reserved by getHereisBuffer().
+             */
+            _reserved = 0;
+            errCode = dh_commitDataProduct(_pq, _info, _index, 1, 1);
         }
         else {
             errCode = dh_saveDataProduct(_pq, _info, prod->data, 1, 1);
@@ -273,6 +478,108 @@ down6_hereis(
 }
 
 
+/*
+ * Handles a batch of products that was received via a HEREIS_BATCH message.
+ * The wanted products are inserted into the product-queue using a single
+ * queue operation.  This function prints diagnostic messages via the ulog(3)
+ * module.  On successful return, savedInfo_get() will return the metadata of
+ * the last product in the batch -- once the batch has been inserted if the
+ * "inserter" module is running.
+ *
+ * This function updates "_class->from".
+ *
+ * Arguments:
+ *      batch        Pointer to the batch of data-products.
+ * Returns:
+ *      0                       Success.  Individual data-products might have
+ *                              been unwanted, duplicates, or too big.
+ *      DOWN6_PQ                Fatal problem with the product-queue.
+ *      DOWN6_SYSTEM_ERROR      System error.
+ *      DOWN6_UNINITIALIZED     Module not initialized.
+ */
+int
+down6_hereisBatch(
+    product_batch*      batch)
+{
+    int         errCode = 0;            /* success */
+
+    if (!_initialized) {
+        uerror("down6_hereisBatch(): Module not initialized");
+        errCode = DOWN6_UNINITIALIZED;
+    }
+    else if (ensureBatchCapacity(batch->count)) {
+        uerror("Couldn't allocate space for a batch of %u products: %s",
+            batch->count, strerror(ENOMEM));
+        errCode = DOWN6_SYSTEM_ERROR;
+    }
+    else {
+        unsigned        i;
+        unsigned        nwanted = 0;
+        int             lastIgnored = 0;
+
+        if (_expectBlkdata) {
+            uwarn("%s:%d: Discarding incomplete product: %s", __FILE__,
+                __LINE__, s_prod_info(NULL, 0, _info, ulogIsDebug()));
+
+            _expectBlkdata = 0;
+        }
+        discardReservation();
+
+        (void)set_timestamp(&_class->from);
+        _class->from.tv_sec -= max_latency;
+
+        for (i = 0; i < batch->count; i++) {
+            const prod_info*    infop = &batch->prods[i].info;
+
+            lastIgnored = !prodInClass(_class, infop);
+
+            if (!lastIgnored) {
+                dh_setInfo(_batchInfos[nwanted], infop, _upName);
+                _batchProds[nwanted].info = *_batchInfos[nwanted];
+                _batchProds[nwanted].data = batch->prods[i].data;
+                nwanted++;
+            }
+            else if (ulogIsVerbose()) {
+                uinfo("Ignoring %s product: %s",
+                    tvCmp(_class->from, infop->arrival, >)
+                        ? "too-old" : "unrequested",
+                    s_prod_info(NULL, 0, infop, ulogIsDebug()));
+            }
+        }
+
+        /*
+         * Remember the last product of the batch even though it wasn't
+         * wanted.
+         */
+        if (lastIgnored)
+            dh_setInfo(_info, &batch->prods[batch->count-1].info, _upName);
+
+        if (ins_isRunning()) {
+            errCode = ins_put(_batchProds, nwanted, 1,
+                lastIgnored ? _info : NULL);
+        }
+        else {
+            errCode = dh_saveDataProducts(_pq, _batchProds, nwanted, 1, 1);
+
+            if (!errCode && lastIgnored) {
+                errCode = savedInfo_set(_info);
+                if (errCode) {
+                    err_log_and_free(
+                        ERR_NEW1(0, NULL,
+                            "Couldn't save product-information: %s",
+                            savedInfo_strerror(errCode)),
+                        ERR_FAILURE);
+
+                    errCode = DOWN6_SYSTEM_ERROR;
+                }
+            }
+        }
+    }                                   /* module initialized */
+
+    return errCode;
+}
+
+
 /*
  * Handles a product notification.  This method should never be called.
  * An informational message is emitted via the ulog(3) module.
@@ -328,6 +635,13 @@ down6_comingsoon(
         uerror("down6_comingsoon(): Module not initialized");
         errCode = DOWN6_UNINITIALIZED;
     }
+    else if ((errCode = ins_drain()) != 0) {
+        /*
+         * The product-queue is only accessed here after the data-products
+         * received earlier have been inserted.
+         */
+        uerror("down6_comingsoon(): Couldn't insert earlier data-products");
+    }
     else {
         prod_info *infop = argp->infop;
 
@@ -337,6 +651,8 @@ down6_comingsoon(
 
             _expectBlkdata = 0;
         }
+        discardReservation();
+        xd_reset();
 
         (void)set_timestamp(&_class->from);
         _class->from.tv_sec -= max_latency;
@@ -371,27 +687,26 @@ down6_comingsoon(
             }
         }                                   /* product isn't in desired class */
         else {
-            pqe_index      idx;             /* product-queue index */
-
             /*
              * Reserve space for the data-product in the product-queue.
              */
-            errCode = pqe_new(_pq, _info, (void **)&_datap, &idx);
+            errCode = pqe_new(_pq, _info, (void **)&_datap, &_index);
 
             if (!errCode) {
                 /*
                  * The data-product isn't in the product-queue.  Setup for
-                 * receiving the product's data via BLKDATA messages.
+                 * receiving the product's data via BLKDATA messages.  The
+                 * region is held until all the data has arrived.
                  */
-                (void)pqe_discard(_pq, idx);
+                _reserved = 1;
                 _expectBlkdata = 1;
 
                 /*
-                 * Use the growable buffer of the "XDR-data" module as the
-                 * location into which the XDR layer will decode the data.
+                 * Have the XDR layer decode the data directly into the
+                 * reserved region.
                  */
                 _remaining = _info->sz;
-                _datap = xd_getBuffer(_remaining);
+                xd_setExternal(_datap, _remaining);
             }                           /* pqe_new() success */
             else if (errCode == EINVAL) {
                 /*
@@ -438,7 +753,8 @@ down6_comingsoon(
                      * argument packet as the amount of data.
                      */
                     int error = as_process(0,
-                        (size_t)(sizeof(InfoBuf) + 2*sizeof(u_int)));
+                        (size_t)(sizeof(InfoBuf) + 2*sizeof(u_int)),
+                        &infop->arrival);
 
                     if (error) {
                         err_log_and_free(
@@ -511,6 +827,7 @@ down6_blkdata(
                     uwarn(
                         "%s:%d: BLKDATA size too large: remaining %u; got %u",
                         __FILE__, __LINE__, _remaining, got);
+                    discardReservation();
                     xd_reset();
 
                     _expectBlkdata = 0;
@@ -519,12 +836,14 @@ down6_blkdata(
                 else {
                     /*
                      * The XDR layer has already decoded the packet's data into
-                     * the buffer of the "XDR-data" module.
+                     * the reserved product-queue region.
                      */
                     _remaining -= got;
 
                     if (0 == _remaining) {
-                        errCode = dh_saveDataProduct(_pq, _info, _datap, 0, 1);
+                        _reserved = 0;
+                        errCode = dh_commitDataProduct(_pq, _info, _index, 0,
+                            1);
                         _expectBlkdata = 0;
 
                         xd_reset();
@@ -545,6 +864,8 @@ down6_blkdata(
  */
 void down6_destroy()
 {
+    ins_stop();
+
     free_prod_class(_class);            /* NULL safe */
     _class = NULL;
 
@@ -554,10 +875,16 @@ void down6_destroy()
 
         _expectBlkdata = 0;
     }
+    discardReservation();
+    xd_setProductBufferFunc(NULL);
+    xd_setBatchBufferFunc(NULL);
+    xd_reset();
 
     pi_free(_info);                     /* NULL safe */
     _info = NULL;
 
+    freeBatch();
+
     _pq = NULL;
     _initialized = 0;
 }
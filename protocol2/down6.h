@@ -49,6 +49,10 @@ int
 down6_hereis(
     product*			prod);
 
+int
+down6_hereisBatch(
+    product_batch*		batch);
+
 int
 down6_notification(
     prod_info*			info);
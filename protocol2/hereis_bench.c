@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Loopback benchmark of the transfer of small data-products from an upstream
+ * LDM-6 to a downstream LDM-6 -- both with and without the batching of
+ * data-products into HEREIS_BATCH messages.
+ *
+ * Usage: hereis_bench [-v] [-n count] [-s size] [-d dir]
+ *
+ *     -v        Verbose logging.
+ *     -n count  Number of data-products (default 10000).
+ *     -s size   Size of each data-product in bytes (default 1000).
+ *     -d dir    Directory for the temporary product-queues (default /tmp).
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ldm.h"
+#include "ulog.h"
+#include "up6.h"
+#include "bench_util.h"
+
+/*
+ * Configures the upstream LDM.  Called by bench_transfer().
+ */
+static void
+setUp(
+    void* const arg)
+{
+    up6_setBatching(*(int*)arg);
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char* dir = "/tmp";
+    unsigned    count = 10000;
+    unsigned    size = 1000;
+    char        upPath[256];
+    char        downPath[256];
+    BenchConfig config;
+    int         ch;
+    int         batching;
+    int         status = 0;
+
+    bench_init("hereis_bench", LOG_NOTICE);
+
+    while ((ch = getopt(argc, argv, "vn:s:d:")) != -1) {
+        switch (ch) {
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'n':
+            count = (unsigned)atoi(optarg);
+            break;
+        case 's':
+            size = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-v] [-n count] [-s size] [-d dir]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == count || 0 == size) {
+        (void)fprintf(stderr, "Count and size must be positive\n");
+        return 1;
+    }
+
+    bench_setPath(upPath, sizeof(upPath), dir, "hereis_bench", "up");
+    bench_setPath(downPath, sizeof(downPath), dir, "hereis_bench", "down");
+
+    if (bench_fillQueue(upPath, count, size, "hereis_bench", NULL, NULL))
+        return 1;
+
+    (void)memset(&config, 0, sizeof(config));
+    config.count = count;
+    config.downSize = 100000000;
+    config.primary = 1;
+    config.setUp = setUp;
+    config.arg = &batching;
+
+    for (batching = 0; batching <= 1; batching++) {
+        BenchResult     result;
+
+        if (bench_transfer(upPath, downPath, &config, &result)) {
+            status = 1;
+        }
+        else {
+            (void)printf("%-8s %u products of %u bytes: %.3f s, "
+                    "%.0f products/s\n",
+                    batching ? "batched" : "single", count, size,
+                    result.duration, count / result.duration);
+        }
+    }
+
+    (void)unlink(upPath);
+
+    return status;
+}
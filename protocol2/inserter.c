@@ -0,0 +1,714 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This module inserts the data-products received by a downstream LDM into the
+ * product-queue on a separate thread.  Without it, the downstream LDM reads,
+ * decodes, and inserts one RPC message at a time, so every wait for the
+ * product-queue's lock (e.g., while pqact(1) holds a region or old
+ * data-products are being deleted) stops the reception of the connection.
+ *
+ * The receiving thread queues decoded data-products as "jobs" and continues
+ * reading; the insertion thread only calls pq_insert() or pq_insertBatch().
+ * The statuses of completed jobs are handled on the receiving thread, in the
+ * order received, by dh_handleInsertion(), so the "savedInfo" and "autoshift"
+ * modules and the logging are used by one thread as before.  A fatal status is
+ * returned by the next call to this module, after which the caller exits as it
+ * did when the insertion failed directly.
+ *
+ * The number of bytes of data-products awaiting insertion is bounded.  When
+ * the bound is reached, the receiving thread waits for the oldest job, which
+ * stops it from reading the connection and lets TCP flow-control throttle the
+ * upstream LDM as before.  The bound is the registry parameter
+ * /server/insertion-buffer; a bound of 0 makes each data-product wait for its
+ * insertion as it did before this module.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DownHelp.h"
+#include "down6.h"
+#include "error.h"
+#include "ldm.h"
+#include "log.h"
+#include "pq.h"
+#include "prod_info.h"
+#include "registry.h"
+#include "savedInfo.h"
+#include "ulog.h"
+#include "inserter.h"
+
+#define MAX_FREE        4       /* maximum number of unused jobs kept */
+
+/*
+ * Data-products to be inserted by a single queue operation.
+ */
+typedef struct job {
+    struct job*         next;           /* next job in the list */
+    product*            prods;          /* data-products to insert */
+    prod_info**         infos;          /* metadata of the data-products */
+    int*                statuses;       /* insertion statuses */
+    size_t              max;            /* capacity of the above arrays */
+    size_t              count;          /* number of data-products */
+    char*               data;           /* data of the data-products */
+    size_t              dataMax;        /* capacity of "data" */
+    size_t              nbytes;         /* number of bytes of data */
+    prod_info*          lastInfo;       /* metadata to save afterwards */
+    int                 saveLast;       /* save "lastInfo"? */
+    int                 wasHereis;      /* received via HEREIS-like message? */
+    int                 error;          /* pq_insertBatch() failure */
+    int                 done;           /* insertion completed? */
+} Job;
+
+static pthread_mutex_t  insMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   insCond = PTHREAD_COND_INITIALIZER;
+static pthread_t        insThread;
+static struct pqueue*   insPq;
+static int              insIsRunning;
+static int              insIsStopping;
+static Job*             insHead;        /* oldest outstanding job */
+static Job*             insTail;        /* newest outstanding job */
+static Job*             insNext;        /* next job to insert */
+static Job*             insFree;        /* unused jobs */
+static unsigned         insFreeCount;   /* number of unused jobs */
+static Job*             insCurrent;     /* job of ins_getBuffer() */
+static size_t           insBytes;       /* bytes in outstanding jobs */
+static size_t           insMaxBytes;
+static int              insIsSet;
+static int              insPipe[2] = {-1, -1};  /* completion notices */
+static int              insNotify;      /* write completion notice? */
+static int              insAtExit;      /* ins_stop() registered? */
+
+/*
+ * Obtains the maximum number of outstanding bytes from the registry if it
+ * hasn't been set.
+ */
+static void
+ins_ensureConfig(void)
+{
+    if (!insIsSet) {
+        insMaxBytes = reg_getUintOrDefault(REG_INSERTION_BUFFER, 16000000);
+        insIsSet = 1;
+    }
+}
+
+/*
+ * Frees a job.
+ */
+static void
+job_free(
+    Job* const  job)
+{
+    if (job) {
+        size_t  i;
+
+        for (i = 0; i < job->max; i++)
+            pi_free(job->infos[i]);
+
+        free(job->prods);
+        free(job->infos);
+        free(job->statuses);
+        free(job->data);
+        pi_free(job->lastInfo);
+        free(job);
+    }
+}
+
+/*
+ * Returns an empty job.
+ *
+ * Returns:
+ *      NULL    Out of memory.  An error-message is logged.
+ *      else    Pointer to the job.
+ */
+static Job*
+job_get(void)
+{
+    Job*        job = insCurrent;
+
+    if (job) {
+        insCurrent = NULL;
+    }
+    else {
+        (void)pthread_mutex_lock(&insMutex);
+        job = insFree;
+        if (job) {
+            insFree = job->next;
+            insFreeCount--;
+        }
+        (void)pthread_mutex_unlock(&insMutex);
+
+        if (NULL == job) {
+            job = calloc(1, sizeof(Job));
+
+            if (NULL == job) {
+                uerror("Couldn't allocate insertion job: %s",
+                    strerror(errno));
+                return NULL;
+            }
+        }
+    }
+
+    job->next = NULL;
+    job->count = 0;
+    job->nbytes = 0;
+    job->saveLast = 0;
+    job->error = 0;
+    job->done = 0;
+
+    return job;
+}
+
+/*
+ * Returns a job to the pool of unused jobs.
+ */
+static void
+job_release(
+    Job* const  job)
+{
+    (void)pthread_mutex_lock(&insMutex);
+
+    if (insFreeCount < MAX_FREE) {
+        job->next = insFree;
+        insFree = job;
+        insFreeCount++;
+        (void)pthread_mutex_unlock(&insMutex);
+    }
+    else {
+        (void)pthread_mutex_unlock(&insMutex);
+        job_free(job);
+    }
+}
+
+/*
+ * Ensures that a job can hold a given number of data-products and bytes of
+ * data.
+ *
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory.
+ */
+static int
+job_ensureCapacity(
+    Job* const          job,
+    const size_t        count,
+    const size_t        nbytes)
+{
+    if (count > job->max) {
+        product*        prods = realloc(job->prods, count * sizeof(product));
+        prod_info**     infos;
+        int*            statuses;
+
+        if (NULL == prods)
+            return ENOMEM;
+        job->prods = prods;
+
+        infos = realloc(job->infos, count * sizeof(prod_info*));
+        if (NULL == infos)
+            return ENOMEM;
+        job->infos = infos;
+
+        statuses = realloc(job->statuses, count * sizeof(int));
+        if (NULL == statuses)
+            return ENOMEM;
+        job->statuses = statuses;
+
+        for (; job->max < count; job->max++) {
+            job->infos[job->max] = pi_new();
+
+            if (NULL == job->infos[job->max])
+                return ENOMEM;
+        }
+    }
+
+    if (nbytes > job->dataMax) {
+        char*   data = realloc(job->data, nbytes);
+
+        if (NULL == data)
+            return ENOMEM;
+
+        job->data = data;
+        job->dataMax = nbytes;
+    }
+
+    return 0;
+}
+
+/*
+ * Inserts the data-products of queued jobs into the product-queue until told
+ * to stop.  Executes on the insertion thread.
+ */
+/*ARGSUSED*/
+static void*
+ins_run(
+    void* const arg)
+{
+    (void)pthread_mutex_lock(&insMutex);
+
+    for (;;) {
+        Job*    job;
+
+        while (NULL == insNext && !insIsStopping)
+            (void)pthread_cond_wait(&insCond, &insMutex);
+
+        job = insNext;
+        if (NULL == job)
+            break;
+        (void)pthread_mutex_unlock(&insMutex);
+
+        if (1 == job->count) {
+            job->statuses[0] = pq_insert(insPq, job->prods);
+        }
+        else if (job->count > 1) {
+            job->error = pq_insertBatch(insPq, job->prods, job->count,
+                job->statuses);
+        }
+
+        (void)pthread_mutex_lock(&insMutex);
+        job->done = 1;
+        insNext = job->next;
+        (void)pthread_cond_broadcast(&insCond);
+
+        if (insNotify) {
+            /*
+             * The receiving thread might be waiting in select(2).
+             */
+            (void)write(insPipe[1], "", 1);
+            insNotify = 0;
+        }
+    }
+
+    (void)pthread_mutex_unlock(&insMutex);
+
+    return NULL;
+}
+
+/*
+ * Handles the statuses of a completed job.  Executes on the receiving thread.
+ *
+ * Returns:
+ *      0                       Success.
+ *      DOWN6_SYSTEM_ERROR      System failure.
+ *      DOWN6_PQ                Fatal product-queue failure.
+ */
+static int
+job_handle(
+    Job* const  job)
+{
+    int         retCode = 0;
+    size_t      i;
+
+    if (job->error) {
+        uerror("pq_insertBatch() failed: %s", strerror(job->error));
+        retCode = DOWN6_PQ;
+    }
+    else {
+        for (i = 0; i < job->count; i++) {
+            int status = dh_handleInsertion(job->statuses[i],
+                &job->prods[i].info, job->wasHereis, 1);
+
+            if (status && DOWN6_UNWANTED != status && DOWN6_PQ_BIG != status
+                    && 0 == retCode)
+                retCode = status;
+        }
+    }
+
+    if (0 == retCode && job->saveLast) {
+        int     error = savedInfo_set(job->lastInfo);
+
+        if (error) {
+            err_log_and_free(
+                ERR_NEW1(0, NULL, "Couldn't save product-information: %s",
+                    savedInfo_strerror(error)),
+                ERR_FAILURE);
+
+            retCode = DOWN6_SYSTEM_ERROR;
+        }
+    }
+
+    return retCode;
+}
+
+/*
+ * Handles completed jobs in the order queued.
+ *
+ * Arguments:
+ *      maxBytes        Wait for jobs until no more than this many bytes are
+ *                      outstanding.
+ *      all             Wait for all jobs?
+ * Returns:
+ *      0                       Success.
+ *      DOWN6_SYSTEM_ERROR      System failure.
+ *      DOWN6_PQ                Fatal product-queue failure.
+ */
+static int
+ins_handle(
+    const size_t        maxBytes,
+    const int           all)
+{
+    int         retCode = 0;
+    char        buf[64];
+
+    while (read(insPipe[0], buf, sizeof(buf)) > 0)
+        ;                               /* discard completion notices */
+
+    (void)pthread_mutex_lock(&insMutex);
+
+    for (;;) {
+        Job*    job = insHead;
+        int     status;
+
+        if (NULL == job)
+            break;
+
+        if (!job->done) {
+            if (!all && insBytes <= maxBytes)
+                break;
+
+            (void)pthread_cond_wait(&insCond, &insMutex);
+            continue;
+        }
+
+        insHead = job->next;
+        if (NULL == insHead)
+            insTail = NULL;
+        insBytes -= job->nbytes;
+        (void)pthread_mutex_unlock(&insMutex);
+
+        status = job_handle(job);
+        if (status && 0 == retCode)
+            retCode = status;
+
+        job_release(job);
+        (void)pthread_mutex_lock(&insMutex);
+    }
+
+    (void)pthread_mutex_unlock(&insMutex);
+
+    return retCode;
+}
+
+/*
+ * Sets the maximum number of bytes that may be awaiting insertion.
+ */
+void
+ins_setConfig(
+    const size_t        maxBytes)
+{
+    insMaxBytes = maxBytes;
+    insIsSet = 1;
+}
+
+/*
+ * Starts the insertion thread if it's enabled and isn't already running.
+ */
+int
+ins_start(
+    struct pqueue* const        pq)
+{
+    ins_ensureConfig();
+
+    if (insIsRunning) {
+        if (pq != insPq) {
+            ins_stop();
+        }
+        else {
+            return 1;
+        }
+    }
+
+    if (0 == insMaxBytes)
+        return 0;
+
+    if (pipe(insPipe)) {
+        LOG_SERROR0("Couldn't create pipe for insertion thread");
+    }
+    else {
+        sigset_t        sigSet;
+        sigset_t        origSigSet;
+        int             status;
+        int             i;
+
+        for (i = 0; i < 2; i++) {
+            (void)fcntl(insPipe[i], F_SETFL,
+                fcntl(insPipe[i], F_GETFL) | O_NONBLOCK);
+            (void)fcntl(insPipe[i], F_SETFD, FD_CLOEXEC);
+        }
+
+        insPq = pq;
+        insIsStopping = 0;
+
+        /*
+         * Signals are handled by the receiving thread only.
+         */
+        (void)sigfillset(&sigSet);
+        (void)pthread_sigmask(SIG_BLOCK, &sigSet, &origSigSet);
+        status = pthread_create(&insThread, NULL, ins_run, NULL);
+        (void)pthread_sigmask(SIG_SETMASK, &origSigSet, NULL);
+
+        if (status) {
+            LOG_ERRNUM0(status, "Couldn't create insertion thread");
+            (void)close(insPipe[0]);
+            (void)close(insPipe[1]);
+            insPipe[0] = insPipe[1] = -1;
+        }
+        else {
+            if (!insAtExit) {
+                /*
+                 * Data-products that were received before the process exits
+                 * are inserted, as they would have been without the thread.
+                 */
+                (void)atexit(ins_stop);
+                insAtExit = 1;
+            }
+
+            insIsRunning = 1;
+            udebug("Inserting data-products on separate thread: "
+                "%lu-byte buffer", (unsigned long)insMaxBytes);
+
+            return 1;
+        }
+    }
+
+    log_add("Inserting data-products on receiving thread");
+    log_log(LOG_ERR);
+
+    return 0;
+}
+
+/*
+ * Indicates if the insertion thread is running.
+ */
+int
+ins_isRunning(void)
+{
+    return insIsRunning;
+}
+
+/*
+ * Returns a buffer into which the XDR layer can decode the data of a
+ * data-product.
+ */
+void*
+ins_getBuffer(
+    const size_t        size)
+{
+    if (NULL == insCurrent) {
+        insCurrent = job_get();
+
+        if (NULL == insCurrent)
+            return NULL;
+    }
+
+    if (job_ensureCapacity(insCurrent, 1, size)) {
+        uerror("Couldn't allocate %lu-byte insertion buffer: %s",
+            (unsigned long)size, strerror(ENOMEM));
+        return NULL;
+    }
+
+    return insCurrent->data;
+}
+
+/*
+ * Queues data-products for insertion into the product-queue.
+ */
+int
+ins_put(
+    const product* const        prods,
+    const size_t                count,
+    const int                   wasHereis,
+    const prod_info* const      lastInfo)
+{
+    int         retCode;
+    Job*        job;
+    size_t      nbytes = 0;
+    size_t      i;
+
+    for (i = 0; i < count; i++)
+        nbytes += prods[i].info.sz;
+
+    /*
+     * Waiting here for earlier jobs bounds the memory used and throttles the
+     * upstream LDM.
+     */
+    retCode = ins_handle(
+        insMaxBytes > nbytes ? insMaxBytes - nbytes : 0, 0);
+    if (retCode)
+        return retCode;
+
+    if (0 == count && NULL == lastInfo)
+        return 0;
+
+    if (0 == count) {
+        (void)pthread_mutex_lock(&insMutex);
+        job = insHead;
+        (void)pthread_mutex_unlock(&insMutex);
+
+        if (NULL == job) {
+            /*
+             * Nothing is outstanding; so, the metadata can be saved now.
+             */
+            int     error = savedInfo_set(lastInfo);
+
+            if (error) {
+                err_log_and_free(
+                    ERR_NEW1(0, NULL,
+                        "Couldn't save product-information: %s",
+                        savedInfo_strerror(error)),
+                    ERR_FAILURE);
+
+                retCode = DOWN6_SYSTEM_ERROR;
+            }
+
+            return retCode;
+        }
+    }
+
+    job = job_get();
+    if (NULL == job)
+        return DOWN6_SYSTEM_ERROR;
+
+    if (job_ensureCapacity(job, count, nbytes) ||
+            (lastInfo && NULL == job->lastInfo &&
+                NULL == (job->lastInfo = pi_new()))) {
+        uerror("Couldn't allocate insertion job for %lu data-products: %s",
+            (unsigned long)count, strerror(ENOMEM));
+        job_release(job);
+        return DOWN6_SYSTEM_ERROR;
+    }
+
+    if (count > 0 && NULL != job->data &&
+            (const char*)prods[0].data >= job->data &&
+            (const char*)prods[0].data < job->data + job->dataMax) {
+        /*
+         * The XDR layer decoded the data into the buffer of the job.
+         */
+        for (i = 0; i < count; i++) {
+            (void)pi_copy(job->infos[i], &prods[i].info);
+            job->prods[i].info = *job->infos[i];
+            job->prods[i].data = prods[i].data;
+        }
+    }
+    else {
+        char*   data = job->data;
+
+        for (i = 0; i < count; i++) {
+            (void)pi_copy(job->infos[i], &prods[i].info);
+            job->prods[i].info = *job->infos[i];
+            job->prods[i].data = data;
+            (void)memcpy(data, prods[i].data, prods[i].info.sz);
+            data += prods[i].info.sz;
+        }
+    }
+
+    job->count = count;
+    job->nbytes = nbytes;
+    job->wasHereis = wasHereis;
+
+    if (lastInfo) {
+        (void)pi_copy(job->lastInfo, lastInfo);
+        job->saveLast = 1;
+    }
+
+    (void)pthread_mutex_lock(&insMutex);
+    if (insTail) {
+        insTail->next = job;
+    }
+    else {
+        insHead = job;
+    }
+    insTail = job;
+    if (NULL == insNext)
+        insNext = job;
+    insBytes += nbytes;
+    (void)pthread_cond_broadcast(&insCond);
+    (void)pthread_mutex_unlock(&insMutex);
+
+    return 0;
+}
+
+/*
+ * Handles the data-products whose insertion has completed.
+ */
+int
+ins_reap(void)
+{
+    return insIsRunning ? ins_handle(~(size_t)0, 0) : 0;
+}
+
+/*
+ * Waits until all queued data-products have been inserted and handles them.
+ */
+int
+ins_drain(void)
+{
+    return insIsRunning ? ins_handle(0, 1) : 0;
+}
+
+/*
+ * Returns a file-descriptor that becomes ready for reading when insertions
+ * have completed.
+ */
+int
+ins_getFd(void)
+{
+    if (!insIsRunning)
+        return -1;
+
+    (void)pthread_mutex_lock(&insMutex);
+    if (insHead && insHead->done) {
+        /*
+         * Make the file-descriptor ready now.
+         */
+        (void)write(insPipe[1], "", 1);
+    }
+    else {
+        insNotify = 1;
+    }
+    (void)pthread_mutex_unlock(&insMutex);
+
+    return insPipe[0];
+}
+
+/*
+ * Inserts and handles all queued data-products and then stops the insertion
+ * thread.
+ */
+void
+ins_stop(void)
+{
+    if (insIsRunning) {
+        (void)ins_handle(0, 1); /* failures are logged */
+
+        (void)pthread_mutex_lock(&insMutex);
+        insIsStopping = 1;
+        (void)pthread_cond_broadcast(&insCond);
+        (void)pthread_mutex_unlock(&insMutex);
+
+        (void)pthread_join(insThread, NULL);
+
+        (void)close(insPipe[0]);
+        (void)close(insPipe[1]);
+        insPipe[0] = insPipe[1] = -1;
+
+        while (insFree) {
+            Job*        job = insFree;
+
+            insFree = job->next;
+            job_free(job);
+        }
+        insFreeCount = 0;
+
+        job_free(insCurrent);
+        insCurrent = NULL;
+
+        insIsRunning = 0;
+    }
+}
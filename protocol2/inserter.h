@@ -0,0 +1,140 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This header-file specifies the API for the module that inserts the
+ * data-products received by a downstream LDM into the product-queue on a
+ * separate thread so that the next RPC message can be received and decoded
+ * while the product-queue is busy.
+ */
+
+#ifndef INSERTER_H
+#define INSERTER_H
+
+#include <stddef.h>
+
+#include "ldm.h"
+#include "pq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets the maximum number of bytes of data-products that may be awaiting
+ * insertion instead of obtaining it from the registry.
+ *
+ * @param maxBytes      [in] The maximum number of bytes.  0 disables the
+ *                      insertion thread.
+ */
+void
+ins_setConfig(
+    const size_t        maxBytes);
+
+/**
+ * Starts the insertion thread if it's enabled and isn't already running.
+ * While the thread is running, the caller must not access the product-queue
+ * unless ins_drain() has returned since the last call to ins_put().
+ *
+ * @param pq            [in] The product-queue.
+ * @retval 0            The insertion thread isn't running.  Data-products
+ *                      should be inserted by the caller.
+ * @retval 1            The insertion thread is running.
+ */
+int
+ins_start(
+    struct pqueue* const        pq);
+
+/**
+ * Indicates if the insertion thread is running.
+ *
+ * @retval 0    The insertion thread isn't running.
+ * @retval 1    The insertion thread is running.
+ */
+int
+ins_isRunning(void);
+
+/**
+ * Returns a buffer into which the XDR layer can decode the data of a
+ * data-product so that ins_put() needn't copy it.  The buffer is valid until
+ * the next call to ins_put() or ins_getBuffer().
+ *
+ * @param size          [in] Size of the data in bytes.
+ * @retval NULL         Out of memory.
+ * @return              Pointer to the buffer.
+ */
+void*
+ins_getBuffer(
+    const size_t        size);
+
+/**
+ * Queues data-products for insertion into the product-queue.  The
+ * product-information is copied; so is the data unless it's in the buffer
+ * returned by ins_getBuffer().  Blocks while too many bytes are awaiting
+ * insertion, which stops the reception of messages and throttles the upstream
+ * LDM.  Completed insertions are handled as dh_saveDataProducts() handles them
+ * but in the order received and on the calling thread.
+ *
+ * @param prods         [in] The data-products.
+ * @param count         [in] The number of data-products.  May be zero.
+ * @param wasHereis     [in] Whether or not the data-products were received via
+ *                      HEREIS-like messages.
+ * @param lastInfo      [in] Metadata to be given to savedInfo_set() after the
+ *                      data-products have been handled or NULL.
+ * @retval 0                    Success.
+ * @retval DOWN6_SYSTEM_ERROR   System failure, now or in a previous insertion.
+ * @retval DOWN6_PQ             Fatal product-queue failure in a previous
+ *                              insertion.
+ */
+int
+ins_put(
+    const product* const        prods,
+    const size_t                count,
+    const int                   wasHereis,
+    const prod_info* const      lastInfo);
+
+/**
+ * Handles the data-products whose insertion has completed.  Doesn't block.
+ *
+ * @retval 0                    Success.
+ * @retval DOWN6_SYSTEM_ERROR   System failure.
+ * @retval DOWN6_PQ             Fatal product-queue failure.
+ */
+int
+ins_reap(void);
+
+/**
+ * Waits until all queued data-products have been inserted and handles them.
+ * On return, the caller may access the product-queue until the next call to
+ * ins_put().
+ *
+ * @retval 0                    Success.
+ * @retval DOWN6_SYSTEM_ERROR   System failure.
+ * @retval DOWN6_PQ             Fatal product-queue failure.
+ */
+int
+ins_drain(void);
+
+/**
+ * Returns a file-descriptor that becomes ready for reading when insertions
+ * have completed and ins_reap() should be called.  Must be called before each
+ * wait on the file-descriptor (e.g., via select(2)) because the insertion
+ * thread only writes to it when asked to.
+ *
+ * @retval -1   The insertion thread isn't running.
+ * @return      The file-descriptor.
+ */
+int
+ins_getFd(void);
+
+/**
+ * Inserts and handles all queued data-products and then stops the insertion
+ * thread.  Idempotent.
+ */
+void
+ins_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,10 +12,13 @@
 
 #include <arpa/inet.h>
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>             /* UINT_MAX */
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
 #include <rpc/rpc.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -24,7 +27,9 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <regex.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "abbr.h"
@@ -35,6 +40,7 @@
 #include "feedTime.h"
 #include "remote.h"
 #include "globals.h"            /* global "pq"; defined in ldmd.c */
+#include "hostCache.h"
 #include "inetutil.h"
 #include "ldm5_clnt.h"
 #include "ldmfork.h"
@@ -46,6 +52,7 @@
 #include "priv.h"
 #include "prod_class.h"
 #include "prod_info.h"
+#include "priority.h"
 #include "registry.h"
 #include "RegularExpressions.h"
 #include "requester6.h"
@@ -534,6 +541,14 @@ getPreviousProdInfo(
                         strlen(pattern));
                 }
             }
+            else if (prodSpec->pattern != NULL &&
+                    strncasecmp(prodSpec->pattern, "STRIPE=", 7) == 0) {
+                /*
+                 * Each stripe of a request has its own state.
+                 */
+                MD5Update(context, (unsigned char*)prodSpec->pattern,
+                    strlen(prodSpec->pattern));
+            }
         }
 
         MD5Final(hash, context);
@@ -688,6 +703,67 @@ struct requester {
 };
 typedef struct requester Requester;
 
+/*
+ * Interval, in milliseconds, between the starts of successive requesters.
+ */
+static unsigned         requestStagger = 100;
+static int              requestStaggerIsSet;
+/*
+ * Number of requesters that have been started.
+ */
+static unsigned         requesterCount;
+
+/*
+ * Obtains the interval between the starts of successive requesters from the
+ * registry if it hasn't been obtained.
+ */
+static void
+requester_ensureConfig(void)
+{
+    if (!requestStaggerIsSet) {
+        requestStagger = reg_getUintOrDefault(REG_REQUEST_STAGGER, 100);
+        requestStaggerIsSet = 1;
+    }
+}
+
+/**
+ * Returns the delay before the next requester starts. Successive requesters
+ * are staggered and jittered so that they don't resolve and contact their
+ * upstream LDM-s all at once.
+ *
+ * @return      The delay in milliseconds.
+ */
+static unsigned
+requester_nextDelay(void)
+{
+    const unsigned  index = requesterCount++;
+
+    requester_ensureConfig();
+
+    return requestStagger == 0
+        ? 0
+        : index * requestStagger + (unsigned)random() % requestStagger;
+}
+
+/**
+ * Sleeps before a requester starts. Returns early if the process should
+ * terminate.
+ *
+ * @param delay     [in] The amount of time to sleep in milliseconds.
+ */
+static void
+requester_delay(
+    const unsigned      delay)
+{
+    struct timespec     remaining;
+
+    remaining.tv_sec = delay / 1000;
+    remaining.tv_nsec = (long)(delay % 1000) * 1000000;
+
+    while (nanosleep(&remaining, &remaining) == -1 && errno == EINTR)
+        exitIfDone(0);
+}
+
 
 /**
  * Executes a requester.
@@ -702,6 +778,11 @@ typedef struct requester Requester;
  *                      primary (uses HEREIS) or not (uses COMINGSOON/BLKDATA).
  * @param serverCount   [in] The number of servers to which the same request
  *                      will be made.
+ * @param group         [in] The autoshift group of the requesters of the same
+ *                      request or NULL.
+ * @param member        [in] The index of the requester in "group".
+ * @param startDelay    [in] The amount of time, in milliseconds, to wait
+ *                      before starting.
  */
 static void
 requester_exec(
@@ -709,7 +790,10 @@ requester_exec(
     const unsigned      port,
     prod_class_t*       clssp,
     int                 isPrimary,
-    const unsigned      serverCount)
+    const unsigned      serverCount,
+    as_Group* const     group,
+    const unsigned      member,
+    const unsigned      startDelay)
 {
     int                 errCode = 0;    /* success */
     /*
@@ -731,10 +815,20 @@ requester_exec(
      */
     vetFromTime(&clssp->from, backoffTime);
 
+    srandom((unsigned)getpid());
+
+    if (startDelay) {
+        /* udebug() omits the identifier when logging to a file */
+        udebug("%s: Delaying start by %u ms", source, startDelay);
+        requester_delay(startDelay);
+        exitIfDone(0);
+    }
+
     unotice("Starting Up(%s): %s:%u %s", PACKAGE_VERSION, source, port,
         s_prod_class(NULL, 0, clssp));
 
     (void)as_setLdmCount(serverCount);
+    (void)as_setGroup(group, member);
 
     /*
      * Initialize the "savedInfo" module with the product-information
@@ -902,9 +996,12 @@ requester_exec(
 
                 if (doSleep) {
                     /*
-                     * Pause before reconnecting.
+                     * Pause before reconnecting. The pause is randomized
+                     * about its mean so that the downstream LDM-s of an
+                     * upstream LDM that went away don't all reconnect at once.
                      */
-                    const unsigned  sleepAmount = 2*interval;
+                    const unsigned  sleepAmount =
+                        interval + (unsigned)random() % (2*interval + 1);
 
                     uinfo("Sleeping %u seconds before retrying...", sleepAmount);
                     (void)sleep(sleepAmount);
@@ -937,6 +1034,11 @@ requester_exec(
  *                      COMINGSOON/BLKDATA).
  * @param serverCount   [in] The number of servers to which the same request will be
  *                      made.
+ * @param group         [in] The autoshift group of the requesters of the same
+ *                      request or NULL.
+ * @param member        [in] The index of the requester in "group".
+ * @param startDelay    [in] The amount of time, in milliseconds, that the
+ *                      requester waits before starting.
  * @retval 0            Success.
  * @retval -1           Failure.  errno is set.  "log_log()" called.
  */
@@ -946,7 +1048,10 @@ requester_spawn(
     const unsigned      port,
     prod_class_t*       clssp,
     const int           isPrimary,
-    const unsigned      serverCount)
+    const unsigned      serverCount,
+    as_Group* const     group,
+    const unsigned      member,
+    const unsigned      startDelay)
 {
         pid_t pid = ldmfork();
         if(pid == -1)
@@ -959,7 +1064,8 @@ requester_spawn(
         if(pid == 0)
         {
                 endpriv();
-                requester_exec(hostId, port, clssp, isPrimary, serverCount);
+                requester_exec(hostId, port, clssp, isPrimary, serverCount,
+                    group, member, startDelay);
                 /*NOTREACHED*/
         }
 
@@ -980,6 +1086,11 @@ requester_spawn(
  *                      (i.e., use COMINGSOON/BLKDATA).
  * @param serverCount   [in] The number of servers to which the same request will
  *                      be made.
+ * @param group         [in] The autoshift group of the requesters of the same
+ *                      request or NULL.
+ * @param member        [in] The index of the requester in "group".
+ * @param startDelay    [in] The amount of time, in milliseconds, that the
+ *                      requester waits before starting.
  * @retval NULL         Failure.  errno is set.
  * @return              Pointer to initialized requester structure.  The
  *                      associated requester is executing.
@@ -989,7 +1100,10 @@ requester_new(
     const ServerInfo*   server,
     prod_class_t*       clssp,
     const int           isPrimary,
-    const unsigned      serverCount)
+    const unsigned      serverCount,
+    as_Group* const     group,
+    const unsigned      member,
+    const unsigned      startDelay)
 {
     Requester*  reqstrp = (Requester*)malloc(sizeof(Requester));
 
@@ -1014,7 +1128,7 @@ requester_new(
             reqstrp->clssp = clssp;
             reqstrp->pid =
                 requester_spawn(reqstrp->source, reqstrp->port, reqstrp->clssp,
-                    isPrimary, serverCount);
+                    isPrimary, serverCount, group, member, startDelay);
         }                               /* "reqstrp->source" allocated */
 
         if (error) {
@@ -1031,7 +1145,8 @@ static Requester *requesters;
 
 /*
  * Creates a new requester and adds it to the list of requesters.  The new
- * requester is executing
+ * requester is executing but waits before connecting if requester starts are
+ * staggered (see requester_nextDelay()).
  *
  * Arguments:
  *      server          Pointer to information on the server to which to
@@ -1043,6 +1158,9 @@ static Requester *requesters;
  *                      COMINGSOON/BLKDATA).
  *      serverCount     The number of servers to which the same request will be
  *                      made.
+ *      group           The autoshift group of the requesters of the same
+ *                      request or NULL.
+ *      member          The index of the requester in "group".
  * Returns:
  *      0               Success.
  *      else            <errno.h> error-code.
@@ -1052,11 +1170,13 @@ requester_add(
     const ServerInfo*   server,
     prod_class_t*       clssp,
     const int           isPrimary,
-    unsigned            serverCount)
+    unsigned            serverCount,
+    as_Group* const     group,
+    const unsigned      member)
 {
     int         error = 0;              /* success */
-    Requester*  reqstrp =
-        requester_new(server, clssp, isPrimary, serverCount);
+    Requester*  reqstrp = requester_new(server, clssp, isPrimary, serverCount,
+        group, member, requester_nextDelay());
 
     if (reqstrp == NULL) {
         error = errno;
@@ -1079,6 +1199,230 @@ requester_add(
 }
 
 
+/******************************************************************************
+ * Upstream Host Resolution Module
+ ******************************************************************************/
+
+/*
+ * Maximum number of concurrent look-ups of upstream hosts.
+ */
+#define RESOLVE_THREADS 16
+/*
+ * Maximum amount of time, in seconds, to wait for the look-ups.
+ */
+#define RESOLVE_TIMEOUT 10
+
+/*
+ * The state of the look-ups. Static rather than on the stack because threads
+ * that are still waiting on the resolver when the caller stops waiting access
+ * it afterwards.
+ */
+static struct {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    const char**        hosts;      /* hosts to look-up */
+    unsigned            count;      /* number of hosts */
+    unsigned            next;       /* index of next host to look-up */
+    unsigned            resolved;   /* number of completed look-ups */
+    int                 abandoned;  /* caller stopped waiting? */
+} resolver = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+/**
+ * Looks-up upstream hosts until there are none left or the caller stops
+ * waiting. Executed on a detached thread.
+ *
+ * @param arg       [in] Ignored.
+ * @retval NULL     Always.
+ */
+static void*
+resolver_run(
+    void* const arg)
+{
+    (void)pthread_mutex_lock(&resolver.mutex);
+
+    while (!resolver.abandoned && resolver.next < resolver.count) {
+        char* const host = strdup(resolver.hosts[resolver.next++]);
+
+        (void)pthread_mutex_unlock(&resolver.mutex);
+
+        if (host != NULL) {
+            in_addr_t   addrs[HC_MAX_ADDRS];
+            unsigned    count;
+
+            /* The result is only wanted in the host cache */
+            (void)hc_getAddrs(host, addrs, &count);
+            free(host);
+        }
+
+        (void)pthread_mutex_lock(&resolver.mutex);
+        resolver.resolved++;
+        (void)pthread_cond_signal(&resolver.cond);
+    }
+
+    (void)pthread_mutex_unlock(&resolver.mutex);
+
+    return NULL;
+}
+
+/**
+ * Looks-up hosts concurrently. Returns when all the hosts have been looked-up
+ * or RESOLVE_TIMEOUT seconds have elapsed.
+ *
+ * @param hosts     [in] The hosts to look-up. The caller may free upon return.
+ * @param count     [in] The number of hosts.
+ * @return          The number of hosts that were looked-up.
+ */
+static unsigned
+resolver_resolve(
+    const char** const  hosts,
+    const unsigned      count)
+{
+    pthread_attr_t      attr;
+    sigset_t            sigSet;
+    sigset_t            origSigSet;
+    struct timespec     deadline;
+    unsigned            nthreads;
+    unsigned            resolved;
+
+    (void)pthread_mutex_lock(&resolver.mutex);
+    resolver.hosts = hosts;
+    resolver.count = count;
+    resolver.next = 0;
+    resolver.resolved = 0;
+    resolver.abandoned = 0;
+    (void)pthread_mutex_unlock(&resolver.mutex);
+
+    /*
+     * Signals are handled by the calling thread only.
+     */
+    (void)pthread_attr_init(&attr);
+    (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    (void)sigfillset(&sigSet);
+    (void)pthread_sigmask(SIG_BLOCK, &sigSet, &origSigSet);
+
+    for (nthreads = 0; nthreads < count && nthreads < RESOLVE_THREADS;
+            nthreads++) {
+        pthread_t   thread;
+        int         status = pthread_create(&thread, &attr, resolver_run,
+                NULL);
+
+        if (status) {
+            LOG_ERRNUM0(status, "Couldn't create host look-up thread");
+            log_log(LOG_WARNING);
+            break;
+        }
+    }
+
+    (void)pthread_sigmask(SIG_SETMASK, &origSigSet, NULL);
+    (void)pthread_attr_destroy(&attr);
+
+    (void)clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += RESOLVE_TIMEOUT;
+
+    (void)pthread_mutex_lock(&resolver.mutex);
+
+    while (nthreads > 0 && resolver.resolved < count) {
+        if (pthread_cond_timedwait(&resolver.cond, &resolver.mutex,
+                &deadline) == ETIMEDOUT)
+            break;
+    }
+
+    resolved = resolver.resolved;
+    resolver.abandoned = 1;
+    resolver.hosts = NULL;
+    (void)pthread_mutex_unlock(&resolver.mutex);
+
+    return resolved;
+}
+
+/**
+ * Looks-up hosts concurrently in a child process and waits for it. The
+ * results are shared via the host cache. The look-up threads only exist in
+ * the child process because the calling process forks downstream LDM-s and
+ * upstream LDM hubs afterwards, and a thread that's still blocked in the
+ * resolver might hold a lock (e.g., of the memory allocator) that a forked
+ * process would never be able to acquire. The child process is killed if it
+ * doesn't finish in time.
+ *
+ * @param hosts     [in] The hosts to look-up. The caller may free upon return.
+ * @param count     [in] The number of hosts.
+ * @return          The number of hosts that were looked-up.
+ */
+static unsigned
+resolver_resolveInChild(
+    const char** const  hosts,
+    const unsigned      count)
+{
+    unsigned    resolved = 0;
+    int         fds[2];
+    pid_t       pid;
+
+    if (pipe(fds)) {
+        LOG_SERROR0("Couldn't create pipe for host look-up process");
+        log_log(LOG_WARNING);
+        return 0;
+    }
+
+    pid = ldmfork();
+
+    if (-1 == pid) {
+        log_add("Couldn't fork host look-up process");
+        log_log(LOG_WARNING);
+    }
+    else if (0 == pid) {
+        (void)close(fds[0]);
+        resolved = resolver_resolve(hosts, count);
+        (void)write(fds[1], &resolved, sizeof(resolved));
+        _exit(0); /* ends any look-up thread; skips the server's exit handlers */
+    }
+    else {
+        struct pollfd   pfd;
+        timestampt      deadline;
+
+        (void)close(fds[1]);
+        fds[1] = -1;
+
+        /* The child process stops waiting after RESOLVE_TIMEOUT seconds */
+        (void)set_timestamp(&deadline);
+        deadline.tv_sec += RESOLVE_TIMEOUT + 1;
+
+        pfd.fd = fds[0];
+        pfd.events = POLLIN;
+
+        for (;;) {
+            timestampt  now;
+            double      remaining;
+            int         ready;
+
+            (void)set_timestamp(&now);
+            remaining = d_diff_timestamp(&deadline, &now);
+            ready = poll(&pfd, 1, remaining > 0 ? (int)(1000*remaining) : 0);
+
+            if (ready < 0 && EINTR == errno)
+                continue;
+
+            if (ready != 1 ||
+                    read(fds[0], &resolved, sizeof(resolved)) !=
+                        sizeof(resolved)) {
+                resolved = 0;
+                (void)kill(pid, SIGKILL);
+            }
+
+            break;
+        }
+
+        while (waitpid(pid, NULL, 0) == -1 && EINTR == errno)
+            ;
+    }
+
+    (void)close(fds[0]);
+    if (fds[1] >= 0)
+        (void)close(fds[1]);
+
+    return resolved;
+}
+
+
 /******************************************************************************
  * Subscription Module
  *****************************************************************************/
@@ -1588,111 +1932,684 @@ serverEntry_add(
 
 static ServerEntry*         serverEntries = NULL;
 
-/**
- * Adds server-information to the set of server-informations if it isn't already
- * present. Returns the corresponding entry.
- *
- * @param server        [in] Pointer to the server-information. Client may free
- *                      upon return.
- * @retval NULL         Failure. log_add() called.
- * @return              Pointer to the corresponding entry.
+/**
+ * Adds server-information to the set of server-informations if it isn't already
+ * present. Returns the corresponding entry.
+ *
+ * @param server        [in] Pointer to the server-information. Client may free
+ *                      upon return.
+ * @retval NULL         Failure. log_add() called.
+ * @return              Pointer to the corresponding entry.
+ */
+static ServerEntry*
+servers_addIfAbsent(
+        const ServerInfo* const server)
+{
+    ServerEntry*  entry;
+
+    for (entry = serverEntries; entry != NULL; entry = entry->next)
+        if (serverInfo_equal(server, entry->serverInfo))
+            return entry;
+
+    entry = serverEntry_new(server);
+
+    if (entry == NULL) {
+        LOG_ADD0("Couldn't create new server-entry");
+        return NULL;
+    }
+
+    entry->next = serverEntries;
+    serverEntries = entry;
+
+    return entry;
+}
+
+
+/**
+ * Frees the set of server-informations.
+ */
+static void
+servers_free(void)
+{
+    ServerEntry*    entry = serverEntries;
+
+    while (entry != NULL) {
+        ServerEntry*    next = entry->next;
+
+        serverEntry_free(entry);
+
+        entry = next;
+    }
+
+    serverEntries = NULL;
+}
+
+/******************************************************************************
+ * Host-Set Module
+ ******************************************************************************/
+
+static int
+contains(const host_set *hsp, const char *name, const char *dotAddr)
+{
+    int contains;
+
+    if (hsp->type == HS_NAME) {
+        contains = strcasecmp(name, hsp->cp) == 0;
+    }
+    else if (hsp->type == HS_DOTTED_QUAD) {
+        contains = strcmp(dotAddr, hsp->cp) == 0;
+    }
+    else if (hsp->type == HS_REGEXP) {
+        contains =
+            regexec(&hsp->rgx, dotAddr, 0, NULL, 0) == 0 ||
+            regexec(&hsp->rgx, name, 0, NULL, 0) == 0;
+    }
+    else {
+        contains = 0;
+    }
+
+    return contains;
+}
+
+
+/******************************************************************************
+ * Compiled Host-Set Module
+ *
+ * The host-sets of a list of ALLOW or ACCEPT entries are compiled so that the
+ * entries that match a host can be found without evaluating every host-set.
+ * A regular-expression of the form "^literal$" goes into a hash-table of exact
+ * names and addresses, one of the form "literal$" (e.g., "\.ucar\.edu$") into
+ * a hash-table of suffixes, and one of the form "^128\.117\." into a trie of
+ * address prefixes.  The remaining regular-expressions are combined into one
+ * so that a host that matches none of them is rejected by a single
+ * evaluation.  A match returns the indexes of the matching host-sets in
+ * ascending order so that the "first match" semantics of the entries is kept.
+ ******************************************************************************/
+
+#define ACL_TAG_NAME    'n'     /* HS_NAME host-set: matches the name */
+#define ACL_TAG_ADDR    'a'     /* HS_DOTTED_QUAD host-set: matches the address */
+#define ACL_TAG_REGEX   'r'     /* literal ERE: matches the name or address */
+
+/*
+ * Entry in a hash-table of literals.
+ */
+typedef struct aclLiteral {
+    struct aclLiteral*  next;
+    size_t              index;          /* index of the host-set */
+    char                tag;            /* ACL_TAG_* */
+    char                key[1];         /* lowercase literal */
+} AclLiteral;
+
+typedef struct {
+    AclLiteral**        buckets;
+    size_t              nbuckets;       /* power of two */
+} AclTable;
+
+/*
+ * Node of the trie of address prefixes.  A child corresponds to the next
+ * octet.
+ */
+typedef struct aclOctet {
+    struct aclOctet*    children[256];
+    size_t*             indexes;        /* host-sets that end here */
+    size_t              count;
+} AclOctet;
+
+typedef struct {
+    const host_set**    hostSets;
+    size_t              count;
+    AclTable            exact;
+    AclTable            suffixes;
+    AclOctet*           prefixes;       /* root of trie or NULL */
+    size_t*             others;         /* indexes of the other host-sets */
+    size_t              otherCount;
+    regex_t             combined;       /* union of the other host-sets */
+    int                 haveCombined;
+    unsigned*           marks;          /* for removing duplicate hits */
+    unsigned            generation;
+    size_t*             hits;           /* indexes of matching host-sets */
+    size_t              hitCount;
+} Acl;
+
+static unsigned
+aclTable_hash(
+    const int                   tag,
+    const char*                 key)
+{
+    unsigned    hash = 2166136261u ^ (unsigned)tag;     /* FNV-1a */
+
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static int
+aclTable_init(
+    AclTable* const             table,
+    const size_t                count)
+{
+    size_t      nbuckets = 16;
+
+    while (nbuckets < 2*count)
+        nbuckets *= 2;
+
+    table->buckets = (AclLiteral**)calloc(nbuckets, sizeof(AclLiteral*));
+
+    if (NULL == table->buckets)
+        return ENOMEM;
+
+    table->nbuckets = nbuckets;
+
+    return 0;
+}
+
+static void
+aclTable_free(
+    AclTable* const             table)
+{
+    if (table->buckets) {
+        size_t  i;
+
+        for (i = 0; i < table->nbuckets; i++) {
+            AclLiteral* lit = table->buckets[i];
+
+            while (lit) {
+                AclLiteral*     next = lit->next;
+
+                free(lit);
+                lit = next;
+            }
+        }
+
+        free(table->buckets);
+        table->buckets = NULL;
+    }
+}
+
+static int
+aclTable_add(
+    AclTable* const             table,
+    const int                   tag,
+    const char* const           key,
+    const size_t                index)
+{
+    AclLiteral* const   lit = (AclLiteral*)malloc(sizeof(AclLiteral) +
+            strlen(key));
+
+    if (NULL == lit)
+        return ENOMEM;
+
+    {
+        AclLiteral** const      head = table->buckets +
+            (aclTable_hash(tag, key) & (table->nbuckets - 1));
+
+        lit->index = index;
+        lit->tag = (char)tag;
+        (void)strcpy(lit->key, key);
+        lit->next = *head;
+        *head = lit;
+    }
+
+    return 0;
+}
+
+/*
+ * Marks the host-set with a given index as matching.
+ */
+static void
+acl_hit(
+    Acl* const                  acl,
+    const size_t                index)
+{
+    if (acl->marks[index] != acl->generation) {
+        acl->marks[index] = acl->generation;
+        acl->hits[acl->hitCount++] = index;
+    }
+}
+
+/*
+ * Marks the host-sets whose literal equals a given key.
+ */
+static void
+aclTable_match(
+    Acl* const                  acl,
+    const AclTable* const       table,
+    const int                   tag,
+    const char* const           key)
+{
+    const AclLiteral*   lit = table->buckets[aclTable_hash(tag, key) &
+        (table->nbuckets - 1)];
+
+    for (; lit; lit = lit->next) {
+        if (lit->tag == tag && strcmp(lit->key, key) == 0)
+            acl_hit(acl, lit->index);
+    }
+}
+
+static void
+aclOctet_free(
+    AclOctet* const             node)
+{
+    if (node) {
+        int     i;
+
+        for (i = 0; i < 256; i++)
+            aclOctet_free(node->children[i]);
+
+        free(node->indexes);
+        free(node);
+    }
+}
+
+/*
+ * Decodes the leading octet of a string if it's in canonical decimal form and
+ * followed by a period.
+ *
+ * Returns:
+ *      NULL    The string doesn't start with such an octet.
+ *      else    Pointer to the character after the period.  "*octet" is set.
+ */
+static const char*
+acl_decodeOctet(
+    const char*                 string,
+    int* const                  octet)
+{
+    int         value = 0;
+    int         ndigits = 0;
+
+    while (isdigit((unsigned char)string[ndigits])) {
+        value = 10*value + string[ndigits] - '0';
+
+        if (++ndigits > 3)
+            return NULL;
+    }
+
+    if (0 == ndigits || '.' != string[ndigits] || value > 255 ||
+            (ndigits > 1 && '0' == string[0]))
+        return NULL;
+
+    *octet = value;
+
+    return string + ndigits + 1;
+}
+
+/*
+ * Marks the host-sets whose address prefix a given string starts with.
+ */
+static void
+aclOctet_match(
+    Acl* const                  acl,
+    const char*                 string)
+{
+    const AclOctet*     node = acl->prefixes;
+    int                 octet;
+
+    while (node && (string = acl_decodeOctet(string, &octet)) != NULL) {
+        size_t  i;
+
+        if ((node = node->children[octet]) == NULL)
+            break;
+
+        for (i = 0; i < node->count; i++)
+            acl_hit(acl, node->indexes[i]);
+    }
+}
+
+/*
+ * Adds an address prefix (e.g., "128.117.") to the trie.
+ *
+ * Returns:
+ *      0               Success.
+ *      EINVAL          The prefix isn't one to three octets each followed by a
+ *                      period.
+ *      ENOMEM          Out-of-memory.
+ */
+static int
+aclOctet_add(
+    Acl* const                  acl,
+    const char*                 prefix,
+    const size_t                index)
+{
+    AclOctet*   node;
+    size_t*     indexes;
+    int         octets[3];
+    int         count = 0;
+    int         i;
+
+    while (*prefix) {
+        if (count == 3 ||
+                (prefix = acl_decodeOctet(prefix, octets + count)) == NULL)
+            return EINVAL;
+        count++;
+    }
+
+    if (0 == count)
+        return EINVAL;
+
+    if (NULL == acl->prefixes &&
+            NULL == (acl->prefixes = (AclOctet*)calloc(1, sizeof(AclOctet))))
+        return ENOMEM;
+
+    for (node = acl->prefixes, i = 0; i < count; i++) {
+        AclOctet**      child = node->children + octets[i];
+
+        if (NULL == *child &&
+                NULL == (*child = (AclOctet*)calloc(1, sizeof(AclOctet))))
+            return ENOMEM;
+
+        node = *child;
+    }
+
+    indexes = (size_t*)realloc(node->indexes,
+            (node->count + 1) * sizeof(size_t));
+    if (NULL == indexes)
+        return ENOMEM;
+
+    indexes[node->count++] = index;
+    node->indexes = indexes;
+
+    return 0;
+}
+
+/*
+ * Decodes a part of an extended regular-expression that matches only a
+ * literal string.  Only alphanumeric characters, '-', '_', and escaped special
+ * characters are accepted.
+ *
+ * Arguments:
+ *      spec    The part of the regular-expression.
+ *      len     The length of the part in bytes.
+ *      buf     The buffer for the lowercase literal.
+ *      size    The size of the buffer in bytes.
+ * Returns:
+ *      0       The part isn't such a literal.
+ *      1       The part is such a literal.  "buf" is set.
+ */
+static int
+acl_decodeLiteral(
+    const char*                 spec,
+    const size_t                len,
+    char* const                 buf,
+    const size_t                size)
+{
+    size_t      i;
+    size_t      n = 0;
+
+    for (i = 0; i < len; i++) {
+        int     c = (unsigned char)spec[i];
+
+        if ('\\' == c) {
+            if (++i == len || NULL == strchr(".^$*+?()[]{}|\\", spec[i]))
+                return 0;
+            c = (unsigned char)spec[i];
+        }
+        else if (!isalnum(c) && '-' != c && '_' != c) {
+            return 0;
+        }
+
+        if (n + 1 >= size)
+            return 0;
+
+        buf[n++] = (char)tolower(c);
+    }
+
+    buf[n] = 0;
+
+    return n > 0;
+}
+
+/*
+ * Adds a host-set to the compiled form.
+ *
+ * Returns:
+ *      0               Success.
+ *      ENOMEM          Out-of-memory.
+ */
+static int
+acl_add(
+    Acl* const                  acl,
+    const host_set* const       hsp,
+    const size_t                index)
+{
+    char        literal[HOSTNAMELEN];
+
+    if (HS_NAME == hsp->type || HS_DOTTED_QUAD == hsp->type) {
+        if (strlen(hsp->cp) < sizeof(literal)) {
+            size_t      i;
+
+            for (i = 0; hsp->cp[i]; i++)
+                literal[i] = (char)tolower((unsigned char)hsp->cp[i]);
+            literal[i] = 0;
+
+            return aclTable_add(&acl->exact,
+                    HS_NAME == hsp->type ? ACL_TAG_NAME : ACL_TAG_ADDR,
+                    HS_NAME == hsp->type ? literal : hsp->cp, index);
+        }
+    }
+    else if (HS_REGEXP == hsp->type) {
+        const char*     spec = hsp->cp;
+        size_t          len = strlen(spec);
+        const int       atStart = '^' == spec[0];
+        const int       atEnd = len > 1 && '$' == spec[len-1] &&
+            '\\' != spec[len-2];
+
+        if (atStart) {
+            spec++;
+            len--;
+        }
+        if (atEnd)
+            len--;
+
+        if (acl_decodeLiteral(spec, len, literal, sizeof(literal))) {
+            if (atStart && atEnd)
+                return aclTable_add(&acl->exact, ACL_TAG_REGEX, literal,
+                        index);
+            if (atEnd)
+                return aclTable_add(&acl->suffixes, ACL_TAG_REGEX, literal,
+                        index);
+            if (atStart) {
+                const int       status = aclOctet_add(acl, literal, index);
+
+                if (EINVAL != status)
+                    return status;
+            }
+        }
+    }
+    else {
+        return 0;                       /* matches nothing */
+    }
+
+    acl->others[acl->otherCount++] = index;
+
+    return 0;
+}
+
+/*
+ * Frees the compiled form of host-sets.  Idempotent.
+ */
+static void
+acl_free(
+    Acl* const                  acl)
+{
+    aclTable_free(&acl->exact);
+    aclTable_free(&acl->suffixes);
+    aclOctet_free(acl->prefixes);
+    if (acl->haveCombined)
+        regfree(&acl->combined);
+    free(acl->hostSets);
+    free(acl->others);
+    free(acl->marks);
+    free(acl->hits);
+    (void)memset(acl, 0, sizeof(*acl));
+}
+
+/*
+ * Combines the other regular-expressions into one.  If that fails, then they
+ * are evaluated individually.
  */
-static ServerEntry*
-servers_addIfAbsent(
-        const ServerInfo* const server)
+static void
+acl_combine(
+    Acl* const                  acl)
 {
-    ServerEntry*  entry;
+    size_t      len = 0;
+    size_t      i;
+    char*       spec;
 
-    for (entry = serverEntries; entry != NULL; entry = entry->next)
-        if (serverInfo_equal(server, entry->serverInfo))
-            return entry;
+    for (i = 0; i < acl->otherCount; i++)
+        len += strlen(acl->hostSets[acl->others[i]]->cp) + 3;
 
-    entry = serverEntry_new(server);
+    if (0 == len || NULL == (spec = (char*)malloc(len)))
+        return;
 
-    if (entry == NULL) {
-        LOG_ADD0("Couldn't create new server-entry");
-        return NULL;
+    *spec = 0;
+
+    for (i = 0; i < acl->otherCount; i++) {
+        char*   cp;
+
+        (void)strcat(spec, 0 == i ? "(" : "|(");
+        cp = spec + strlen(spec);
+        (void)strcpy(cp, acl->hostSets[acl->others[i]]->cp);
+        (void)re_vetSpec(cp);   /* as when the host-set was compiled */
+        (void)strcat(spec, ")");
     }
 
-    entry->next = serverEntries;
-    serverEntries = entry;
+    acl->haveCombined = 0 == regcomp(&acl->combined, spec,
+            REG_EXTENDED | REG_ICASE | REG_NOSUB);
 
-    return entry;
+    free(spec);
 }
 
-
-/**
- * Frees the set of server-informations.
+/*
+ * Compiles host-sets.
+ *
+ * Arguments:
+ *      acl             The compiled form.  Freed first.
+ *      hostSets        The host-sets.  Must exist until acl_free() is called.
+ *      count           The number of host-sets.
+ * Returns:
+ *      0               Success.
+ *      ENOMEM          Out-of-memory.  log_start() called.
  */
-static void
-servers_free(void)
+static int
+acl_compile(
+    Acl* const                  acl,
+    const host_set** const      hostSets,
+    const size_t                count)
 {
-    ServerEntry*    entry = serverEntries;
+    int         status = 0;
+    size_t      i;
 
-    while (entry != NULL) {
-        ServerEntry*    next = entry->next;
+    acl_free(acl);
 
-        serverEntry_free(entry);
+    acl->hostSets = hostSets;
+    acl->count = count;
 
-        entry = next;
+    if (aclTable_init(&acl->exact, count) ||
+            aclTable_init(&acl->suffixes, count) ||
+            NULL == (acl->others = (size_t*)malloc((count+1)*sizeof(size_t))) ||
+            NULL == (acl->hits = (size_t*)malloc((count+1)*sizeof(size_t))) ||
+            NULL == (acl->marks = (unsigned*)calloc(count+1,
+                sizeof(unsigned)))) {
+        status = ENOMEM;
     }
+    else {
+        for (i = 0; 0 == status && i < count; i++)
+            status = acl_add(acl, hostSets[i], i);
 
-    serverEntries = NULL;
-}
+        if (0 == status)
+            acl_combine(acl);
+    }
 
-/******************************************************************************
- * Host-Set Module
- ******************************************************************************/
+    if (status) {
+        LOG_START0("Couldn't compile access-control list");
+        acl->hostSets = NULL;               /* not owned on failure */
+        acl_free(acl);
+    }
 
-static int
-host_set_match(const peer_info *rmtip, const host_set *hsp)
-{
-        if(rmtip == NULL || hsp == NULL)
-                return 0;
-        if(rmtip->astr == hsp->cp || rmtip->name == hsp->cp)
-                return 1;
-        switch (hsp->type) {
-        case HS_NAME:
-                if(strcasecmp(rmtip->name, hsp->cp) == 0)
-                        return 1;
-                break;
-        case HS_DOTTED_QUAD:
-                if(strcmp(rmtip->astr, hsp->cp) == 0)
-                        return 1;
-                break;
-        case HS_REGEXP:
-                if(regexec(&hsp->rgx, rmtip->astr, 0, NULL, 0) == 0)
-                        return 1;
-                /* else */
-                if(regexec(&hsp->rgx, rmtip->name, 0, NULL, 0) == 0)
-                        return 1;
-                break;
-        }
-        return 0;
+    return status;
 }
 
-
 static int
-contains(const host_set *hsp, const char *name, const char *dotAddr)
+size_compare(
+    const void*                 a,
+    const void*                 b)
 {
-    int contains;
+    const size_t        x = *(const size_t*)a;
+    const size_t        y = *(const size_t*)b;
 
-    if (hsp->type == HS_NAME) {
-        contains = strcasecmp(name, hsp->cp) == 0;
-    }
-    else if (hsp->type == HS_DOTTED_QUAD) {
-        contains = strcmp(dotAddr, hsp->cp) == 0;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Returns the indexes of the host-sets that contain a host.
+ *
+ * Arguments:
+ *      acl             The compiled host-sets.
+ *      name            The name of the host.
+ *      dotAddr         The dotted-quad IP address of the host.
+ *      hits            Set to the indexes in ascending order.  Valid until the
+ *                      next call.
+ * Returns:
+ *                      The number of indexes.
+ */
+static size_t
+acl_match(
+    Acl* const                  acl,
+    const char* const           name,
+    const char* const           dotAddr,
+    const size_t** const        hits)
+{
+    char        lower[HOSTNAMELEN];
+    size_t      len = strlen(name);
+    const char* tail = len < sizeof(lower)
+        ? name
+        : name + len - (sizeof(lower) - 1);     /* suffixes are shorter */
+    size_t      i;
+
+    for (i = 0; tail[i]; i++)
+        lower[i] = (char)tolower((unsigned char)tail[i]);
+    lower[i] = 0;
+
+    acl->hitCount = 0;
+
+    if (0 == ++acl->generation) {
+        (void)memset(acl->marks, 0, acl->count * sizeof(unsigned));
+        acl->generation = 1;
     }
-    else if (hsp->type == HS_REGEXP) {
-        contains =
-            regexec(&hsp->rgx, dotAddr, 0, NULL, 0) == 0 ||
-            regexec(&hsp->rgx, name, 0, NULL, 0) == 0;
+
+    if (tail == name) {
+        aclTable_match(acl, &acl->exact, ACL_TAG_NAME, lower);
+        aclTable_match(acl, &acl->exact, ACL_TAG_REGEX, lower);
     }
-    else {
-        contains = 0;
+    aclTable_match(acl, &acl->exact, ACL_TAG_ADDR, dotAddr);
+    aclTable_match(acl, &acl->exact, ACL_TAG_REGEX, dotAddr);
+
+    for (i = 0; lower[i]; i++)
+        aclTable_match(acl, &acl->suffixes, ACL_TAG_REGEX, lower + i);
+    for (i = 0; dotAddr[i]; i++)
+        aclTable_match(acl, &acl->suffixes, ACL_TAG_REGEX, dotAddr + i);
+
+    aclOctet_match(acl, name);
+    aclOctet_match(acl, dotAddr);
+
+    if (acl->otherCount && (!acl->haveCombined ||
+            regexec(&acl->combined, dotAddr, 0, NULL, 0) == 0 ||
+            regexec(&acl->combined, name, 0, NULL, 0) == 0)) {
+        for (i = 0; i < acl->otherCount; i++) {
+            const size_t        index = acl->others[i];
+
+            if (contains(acl->hostSets[index], name, dotAddr))
+                acl_hit(acl, index);
+        }
     }
 
-    return contains;
+    qsort(acl->hits, acl->hitCount, sizeof(size_t), size_compare);
+    *hits = acl->hits;
+
+    return acl->hitCount;
 }
 
 
@@ -1704,7 +2621,9 @@ struct subEntry {
     struct subEntry*        next;
     Subscription*           subscription;
     const ServerInfo**      servers;
+    unsigned*               stripeCounts; /* number of stripes per server */
     unsigned                serverCount;
+    as_Group*               group;        /* autoshift group or NULL */
 };
 typedef struct subEntry SubEntry;
 
@@ -1732,7 +2651,9 @@ subEntry_new(
             entry->next = NULL;
             entry->subscription = subClone;
             entry->servers = NULL;
+            entry->stripeCounts = NULL;
             entry->serverCount = 0;
+            entry->group = NULL;
 
             return entry;
         } /* "entry" allocated */
@@ -1750,13 +2671,16 @@ subEntry_new(
  * @param entry         [in] The subscription entry.
  * @param server        [in] The server information. Client may free upon
  *                      return.
+ * @param stripeCount   [in] The number of connections to the server among
+ *                      which the subscription is divided.
  * @retval 0            Success.
  * @retval -1           Failure. log_add() called.
  */
 static int
 subEntry_add(
     SubEntry* const         entry,
-    const ServerInfo* const server)
+    const ServerInfo* const server,
+    const unsigned          stripeCount)
 {
     const ServerInfo** const    servers = (const ServerInfo**)realloc(
             entry->servers,
@@ -1766,17 +2690,27 @@ subEntry_add(
         LOG_SERROR0("Couldn't allocate new server-information array");
     }
     else {
-        const ServerInfo* const clone = serverInfo_clone(server);
+        unsigned* const stripeCounts = (unsigned*)realloc(entry->stripeCounts,
+                (size_t)((entry->serverCount+1)*sizeof(unsigned)));
 
-        if (clone != NULL) {
-            servers[entry->serverCount] = clone;
-            entry->servers = servers;
-            entry->serverCount++;
+        entry->servers = servers;
 
-            return 0;
-        } /* "clone" allocated */
+        if (NULL == stripeCounts) {
+            LOG_SERROR0("Couldn't allocate new stripe-count array");
+        }
+        else {
+            const ServerInfo* const clone = serverInfo_clone(server);
 
-        free(servers);
+            entry->stripeCounts = stripeCounts;
+
+            if (clone != NULL) {
+                servers[entry->serverCount] = clone;
+                stripeCounts[entry->serverCount] = stripeCount;
+                entry->serverCount++;
+
+                return 0;
+            } /* "clone" allocated */
+        } /* "stripeCounts" allocated */
     } /* "servers" allocated */
 
     return -1;
@@ -1784,24 +2718,54 @@ subEntry_add(
 
 
 /**
- * Starts a downstream LDM for each server of a subscription entry.
+ * Starts a downstream LDM for the primary server or for each alternate server
+ * of a subscription entry -- or, if the subscription to a server is striped,
+ * one for each stripe.  The downstream LDM of a stripe adds the
+ * product-specification {NONE, "STRIPE=<stripe>/<count>"} to its request so
+ * that the upstream LDM sends only the data-products of that stripe.
  *
- * @param entry     [in] The subscription entry.
- * @retval 0        Success.
- * @return          System error code. log_add() called.
+ * @param entry         [in] The subscription entry.
+ * @param alternates    [in] Whether to start the downstream LDM-s of the
+ *                      alternate servers rather than of the primary server.
+ * @retval 0            Success.
+ * @return              System error code. log_add() called.
  */
 static int
 subEntry_startRequester(
-        SubEntry* const entry)
+        SubEntry* const entry,
+        const int       alternates)
 {
     int         status = 0; /* success */
-    unsigned    serverIndex;
+    unsigned    serverIndex = alternates ? 1 : 0;
+    unsigned    serverEnd = alternates ? entry->serverCount : 1;
+
+    if (serverEnd > entry->serverCount)
+        serverEnd = entry->serverCount;
+
+    /*
+     * The downstream LDM-s of an unstriped subscription to several servers
+     * compare their latencies to decide which one should be primary. Those of
+     * a striped subscription don't because their stripes needn't correspond.
+     */
+    if (entry->group == NULL && entry->serverCount > 1) {
+        unsigned    i;
+
+        for (i = 0; i < entry->serverCount && entry->stripeCounts[i] <= 1; i++)
+            ;
+
+        if (i == entry->serverCount &&
+                (entry->group = as_newGroup(entry->serverCount)) == NULL) {
+            LOG_ADD0("Downstream LDM-s won't compare latencies");
+            log_log(LOG_WARNING);
+        }
+    }
 
-    for (serverIndex = 0; serverIndex < entry->serverCount; serverIndex++) {
+    for (; serverIndex < serverEnd; serverIndex++) {
         prod_class_t*       clssp;
         const ServerInfo*  requestServer = entry->servers[serverIndex];
+        const unsigned      stripeCount = entry->stripeCounts[serverIndex];
 
-        clssp = new_prod_class(1);
+        clssp = new_prod_class(stripeCount > 1 ? 2 : 1);
 
         if (clssp == NULL) {
             status = errno;
@@ -1829,9 +2793,27 @@ subEntry_startRequester(
                     LOG_ADD1("Couldn't compile pattern \"%s\"", sp->pattern);
                     status = EINVAL;
                 }
-                else {
+                else if (stripeCount <= 1) {
                     status = requester_add(requestServer, clssp,
-                            serverIndex == 0, entry->serverCount);
+                            serverIndex == 0, entry->serverCount, entry->group,
+                            serverIndex);
+                }
+                else {
+                    char        stripeSpec[32];
+                    unsigned    stripe;
+
+                    sp[1].feedtype = NONE;
+                    sp[1].pattern = stripeSpec;
+
+                    for (stripe = 0; stripe < stripeCount && !status;
+                            stripe++) {
+                        (void)snprintf(stripeSpec, sizeof(stripeSpec),
+                                "STRIPE=%u/%u", stripe, stripeCount);
+                        status = requester_add(requestServer, clssp,
+                                serverIndex == 0, entry->serverCount, NULL, 0);
+                    }
+
+                    sp[1].pattern = NULL; /* not allocated */
                 }
             } /* "sp->pattern" allocated */
 
@@ -1861,6 +2843,8 @@ subEntry_free(
         serverInfo_free(entry->servers[i]);
 
     free(entry->servers);
+    free(entry->stripeCounts);
+    as_freeGroup(entry->group);
     sub_free(entry->subscription);
     free(entry);
 }
@@ -1937,8 +2921,87 @@ subs_free(void)
 }
 
 
+/**
+ * Resolves the upstream hosts of the set of subscriptions concurrently so that
+ * the downstream LDM-s find them in the host cache (see hostCache.h) rather
+ * than each waiting on the resolver. Waits at most RESOLVE_TIMEOUT seconds;
+ * any remaining hosts are resolved by their downstream LDM-s.
+ */
+static void
+subs_resolveHosts(void)
+{
+    SubEntry*       entry;
+    const char**    hosts = NULL;
+    unsigned        count = 0;
+    unsigned        max = 0;
+
+    if (!hc_isEnabled())
+        return;
+
+    for (entry = subsHead; entry != NULL; entry = entry->next) {
+        unsigned    i;
+
+        for (i = 0; i < entry->serverCount; i++) {
+            const char* host = serverInfo_getHostId(entry->servers[i]);
+            unsigned    j;
+
+            for (j = 0; j < count && strcmp(hosts[j], host) != 0; j++)
+                ;
+
+            if (j < count)
+                continue; /* duplicate */
+
+            if (count == max) {
+                const char**    newHosts = (const char**)realloc(hosts,
+                        (max ? 2*max : 32) * sizeof(char*));
+
+                if (newHosts == NULL) {
+                    LOG_SERROR0("Couldn't allocate upstream host array");
+                    log_log(LOG_WARNING);
+                    free(hosts);
+                    return;
+                }
+
+                hosts = newHosts;
+                max = max ? 2*max : 32;
+            }
+
+            hosts[count++] = host;
+        }
+    }
+
+    if (count > 0) {
+        timestampt  start;
+        timestampt  stop;
+        unsigned    resolved;
+
+        (void)set_timestamp(&start);
+        resolved = resolver_resolveInChild(hosts, count);
+        (void)set_timestamp(&stop);
+
+        if (resolved < count) {
+            unotice("Looked-up %u of %u upstream hosts in %g seconds; "
+                    "downstream LDM-s will look-up the rest", resolved, count,
+                    d_diff_timestamp(&stop, &start));
+        }
+        else {
+            uinfo("Looked-up %u upstream hosts in %g seconds", count,
+                    d_diff_timestamp(&stop, &start));
+        }
+    }
+
+    free(hosts);
+}
+
 /**
  * Starts all downstream LDM-s necessary to satisfy the set of subscriptions.
+ * The upstream hosts are looked-up concurrently first. Then the downstream
+ * LDM-s are started in the following order: those of the subscriptions that
+ * include a high-priority feedtype (see priority.h) before the others and,
+ * within each group, those of the primary servers before those of the
+ * alternate servers. The configuration-file order is kept otherwise. The
+ * downstream LDM-s are staggered (see requester_nextDelay()) so that they
+ * don't all contact their upstream LDM-s at once.
  *
  * @retval 0        Success.
  * @return          System error code. log_add() called.
@@ -1946,14 +3009,30 @@ subs_free(void)
 static int
 subs_startRequesters(void)
 {
-    int status = ENOERR;
+    int         status = ENOERR;
+    int         pass;
 
-    SubEntry*   entry;
+    subs_resolveHosts();
 
-    for (entry = subsHead; entry != NULL; entry = entry->next) {
-        if ((status = subEntry_startRequester(entry)))
-            break;
+    requesterCount = 0;
+
+    for (pass = 0; pass < 4 && !status; pass++) {
+        const int   isHigh = pass < 2;
+        const int   alternates = pass % 2;
+        SubEntry*   entry;
+
+        for (entry = subsHead; entry != NULL; entry = entry->next) {
+            if (!prio_isHighFeedtype(sub_getFeedtype(entry->subscription)) ==
+                    !isHigh) {
+                if ((status = subEntry_startRequester(entry, alternates)))
+                    break;
+            }
+        }
     }
+
+    if (!status && requesterCount > 1 && requestStagger > 0)
+        unotice("Starting %u downstream LDM-s over %g seconds",
+                requesterCount, (requesterCount * requestStagger) / 1000.0);
 #if 0   /* DEBUG */
     {
         char buf[1984];
@@ -1977,13 +3056,16 @@ subs_startRequesters(void)
  * @param sub           [in] Subscription to be added. Client may free upon
  *                      return.
  * @param serverEntry   [in/out] Server entry to which to add the subscription.
+ * @param stripeCount   [in] Number of connections among which to divide the
+ *                      subscription.
  * @return 0            Success.
  * @return -1           Failure. log_add() called.
  */
 static int
 addRequest(
         Subscription* const sub,
-        ServerEntry* const  serverEntry)
+        ServerEntry* const  serverEntry,
+        const unsigned      stripeCount)
 {
     int             status = -1; /* failure */
     Subscription*   origSub = sub_clone(sub);
@@ -2019,7 +3101,7 @@ addRequest(
             }
             else {
                 if (subEntry_add(subEntry,
-                        serverEntry_getServerInfo(serverEntry))) {
+                        serverEntry_getServerInfo(serverEntry), stripeCount)) {
                     LOG_ADD0("Couldn't add server information to subscription "
                             "entry");
                 }
@@ -2202,6 +3284,7 @@ typedef struct AllowEntry {
     Pattern*                    okPattern;
     Pattern*                    notPattern;
     feedtypet                   ft;
+    unsigned long               maxRate;        /* bytes/s or 0 */
 } AllowEntry;
 static AllowEntry*          allowEntryHead = NULL;
 static AllowEntry*          allowEntryTail = NULL;
@@ -2231,6 +3314,120 @@ allowEntries_free(void)
 }
 
 
+/******************************************************************************
+ * Compiled ALLOW and ACCEPT Entries Module
+ *****************************************************************************/
+
+static Acl              allowAcl;
+static AllowEntry**     allowVec;       /* ALLOW entries by index */
+static Acl              acceptAcl;
+static AcceptEntry**    acceptVec;      /* ACCEPT entries by index */
+static int              aclsAreCompiled;
+
+/*
+ * Frees the compiled ALLOW and ACCEPT entries.  Idempotent.
+ */
+static void
+acls_free(void)
+{
+    acl_free(&allowAcl);
+    acl_free(&acceptAcl);
+    free(allowVec);
+    free(acceptVec);
+    allowVec = NULL;
+    acceptVec = NULL;
+    aclsAreCompiled = 0;
+}
+
+/**
+ * Compiles the host-sets of the ALLOW and ACCEPT entries so that the entries
+ * that match a host are found in a time that's nearly independent of the
+ * number of entries.  Should be called after the configuration-file has been
+ * read so that forked processes inherit the result; otherwise, it's called
+ * when first needed.
+ *
+ * @retval 0            Success.
+ * @retval ENOMEM       Out-of-memory.  log_start() called.
+ */
+int
+lcf_compileAcl(void)
+{
+    size_t              nallow = 0;
+    size_t              naccept = 0;
+    const host_set**    allowSets = NULL;
+    const host_set**    acceptSets = NULL;
+    AllowEntry*         allowEntry;
+    AcceptEntry*        acceptEntry;
+    int                 status;
+
+    acls_free();
+
+    for (allowEntry = allowEntryHead; allowEntry;
+            allowEntry = allowEntry->next)
+        nallow++;
+    for (acceptEntry = acceptEntries; acceptEntry;
+            acceptEntry = acceptEntry->next)
+        naccept++;
+
+    allowVec = (AllowEntry**)malloc((nallow+1) * sizeof(AllowEntry*));
+    acceptVec = (AcceptEntry**)malloc((naccept+1) * sizeof(AcceptEntry*));
+    allowSets = (const host_set**)malloc((nallow+1) * sizeof(host_set*));
+    acceptSets = (const host_set**)malloc((naccept+1) * sizeof(host_set*));
+
+    if (NULL == allowVec || NULL == acceptVec || NULL == allowSets ||
+            NULL == acceptSets) {
+        LOG_SERROR0("Couldn't allocate access-control list");
+        free(allowSets);
+        free(acceptSets);
+        status = ENOMEM;
+    }
+    else {
+        size_t  i;
+
+        for (i = 0, allowEntry = allowEntryHead; allowEntry;
+                allowEntry = allowEntry->next, i++) {
+            allowVec[i] = allowEntry;
+            allowSets[i] = allowEntry->hsp;
+        }
+        for (i = 0, acceptEntry = acceptEntries; acceptEntry;
+                acceptEntry = acceptEntry->next, i++) {
+            acceptVec[i] = acceptEntry;
+            acceptSets[i] = acceptEntry->hsp;
+        }
+
+        if ((status = acl_compile(&allowAcl, allowSets, nallow))) {
+            free(allowSets);
+            free(acceptSets);
+        }
+        else if ((status = acl_compile(&acceptAcl, acceptSets, naccept))) {
+            free(acceptSets);
+        }
+    }
+
+    if (status) {
+        acls_free();
+    }
+    else {
+        aclsAreCompiled = 1;
+    }
+
+    return status;
+}
+
+/*
+ * Ensures that the ALLOW and ACCEPT entries are compiled.
+ *
+ * Returns:
+ *      0               Success.
+ *      ENOMEM          Out-of-memory.  log_start() called.
+ */
+static int
+acls_ensureCompiled(void)
+{
+    return aclsAreCompiled ? 0 : lcf_compileAcl();
+}
+
+
 /******************************************************************************
  * EXEC Action Module
  ******************************************************************************/
@@ -2526,6 +3723,10 @@ lcf_getCommandLine(
  * @param pattern       [in] Pattern. Client may free upon return.
  * @param hostId        [in] Host identifier. Client may free upon return.
  * @param port          [in] Port number.
+ * @param stripeCount   [in] Number of connections among which to divide the
+ *                      data-products (e.g., to overcome the window-limit of a
+ *                      single TCP connection over a high-latency link).  1
+ *                      means a single connection.
  * @retval 0            Success.
  * @retval -1           System error. log_add() called.
  */
@@ -2534,7 +3735,8 @@ lcf_addRequest(
     const feedtypet     feedtype,
     const char* const   pattern,
     const char* const   hostId,
-    const unsigned      port)
+    const unsigned      port,
+    const unsigned      stripeCount)
 {
     int                 status = -1; /* failure */
     const ServerInfo*   server = serverInfo_new(hostId, port);
@@ -2555,7 +3757,7 @@ lcf_addRequest(
                 LOG_ADD0("Couldn't create new subscription object");
             }
             else {
-                status = addRequest(sub, serverEntry);
+                status = addRequest(sub, serverEntry, stripeCount);
 
                 sub_free(sub);
             } /* "sub" allocated */
@@ -2643,6 +3845,9 @@ lcf_freeHostSet(host_set *hsp)
  * @param notEre        [in] Pointer to the ERE that data-product identifiers
  *                      must not match or NULL if such matching should be
  *                      disabled.  Caller may free upon return.
+ * @param maxRate       [in] Maximum rate, in bytes per second, at which an
+ *                      upstream LDM controlled by the entry may send or 0 for
+ *                      no limit.
  * @retval NULL         Success.
  * @return              Failure error object.
  */
@@ -2651,7 +3856,8 @@ lcf_addAllow(
     const feedtypet             ft,
     host_set* const             hostSet,
     const char* const           okEre,
-    const char* const           notEre)
+    const char* const           notEre,
+    const unsigned long         maxRate)
 {
     ErrorObj*           errObj = NULL;  /* success */
     AllowEntry* const   entry = (AllowEntry*)malloc(sizeof(AllowEntry));
@@ -2684,6 +3890,7 @@ lcf_addAllow(
                 entry->okPattern = okPattern;
                 entry->notPattern = notPattern;
                 entry->ft = ft;
+                entry->maxRate = maxRate;
                 entry->next = NULL;
 
                 if (NULL == allowEntryHead) {
@@ -2695,6 +3902,7 @@ lcf_addAllow(
                     allowEntryTail = entry;
                 }
 
+                acls_free();
                 serverNeeded = true;
             }
 
@@ -2746,6 +3954,11 @@ lcf_reduceToAllowed(
     feedtypet        feedType[MAXHITS];  /* matching feed-types */
     prod_class_t*    inter;              /* want and allow intersection */
 
+    if (acls_ensureCompiled()) {
+        log_log(LOG_ERR);
+        return ENOMEM;
+    }
+
     /*
      * Find the number of matching entries in the ACL and save their
      * feed-types.
@@ -2759,20 +3972,21 @@ lcf_reduceToAllowed(
         nhits = 0;
     }
     else {
-        AllowEntry*     entry;                  /* ACL entry */
         char            dotAddr[DOTTEDQUADLEN]; /* dotted-quad IP address */
+        const size_t*   hits;                   /* matching ACL entries */
+        size_t          count;
+        size_t          i;
 
         (void)strcpy(dotAddr, inet_ntoa(*addr));
+        count = acl_match(&allowAcl, name, dotAddr, &hits);
 
-        for(entry = allowEntryHead; entry != NULL; entry = entry->next) {
-            if (contains(entry->hsp, name, dotAddr)) {
-                feedType[nhits++] = entry->ft;
+        for (i = 0; i < count; i++) {
+            feedType[nhits++] = allowVec[hits[i]]->ft;
 
-                if (nhits >= MAXHITS) {
-                    uerror("%s:%d: nhits (%u) >= MAXHITS (%d)",
-                        __FILE__, __LINE__, nhits, MAXHITS);
-                    break;
-                }
+            if (nhits >= MAXHITS) {
+                uerror("%s:%d: nhits (%u) >= MAXHITS (%d)",
+                    __FILE__, __LINE__, nhits, MAXHITS);
+                break;
             }
         }
     }
@@ -2917,19 +4131,29 @@ lcf_getUpstreamFilter(
     if ((errObj = upFilter_new(&filt))) {
         errObj = ERR_NEW(0, errObj, "Couldn't get new upstream filter");
     }
+    else if (acls_ensureCompiled()) {
+        log_log(LOG_ERR);
+        errObj = ERR_NEW(ENOMEM, NULL, "Couldn't compile access-control list");
+        upFilter_free(filt);
+    }
     else {
         int             i;
         char            dotAddr[DOTTEDQUADLEN];
-        AllowEntry*     entry;
+        const size_t*   hits;
+        size_t          count;
 
         (void)strcpy(dotAddr, inet_ntoa(*addr));
+        count = acl_match(&allowAcl, name, dotAddr, &hits);
 
         for (i = 0; i < want->psa.psa_len; ++i) {
-            for (entry = allowEntryHead; entry != NULL; entry = entry->next) {
-                feedtypet       feedtype =
+            size_t      j;
+
+            for (j = 0; j < count; j++) {
+                const AllowEntry* const entry = allowVec[hits[j]];
+                feedtypet               feedtype =
                     entry->ft & want->psa.psa_val[i].feedtype;
 
-                if (feedtype && contains(entry->hsp, name, dotAddr)) {
+                if (feedtype) {
                     if ((errObj = upFilter_addComponent(filt, feedtype,
                         entry->okPattern, entry->notPattern))) {
 
@@ -2940,8 +4164,8 @@ lcf_getUpstreamFilter(
                     }
 
                     break;              /* first match controls */
-                }                       /* feedtype & server-information match */
-            }                           /* ACL entry loop */
+                }                       /* feedtype match */
+            }                           /* matching ACL entry loop */
         }                               /* wanted product-specification loop */
 
         if (errObj) {
@@ -2962,6 +4186,58 @@ lcf_getUpstreamFilter(
 }
 
 
+/**
+ * Returns the maximum rate at which an upstream LDM may send to a downstream
+ * LDM.  The rate-limit of the first ALLOW entry that matches each wanted
+ * product-specification is considered and the smallest one is returned.
+ *
+ * @param name          [in] Pointer to the name of the downstream host.
+ * @param addr          [in] Pointer to the IP address of the downstream host.
+ * @param want          [in] Pointer to the class of products that the downstream
+ *                      host wants.
+ * @return              The maximum rate in bytes per second or 0 if there's no
+ *                      limit.
+ */
+unsigned long
+lcf_getMaxRate(
+    const char*                 name,
+    const struct in_addr*       addr,
+    const prod_class_t*         want)
+{
+    unsigned long   maxRate = 0;
+    int             i;
+    char            dotAddr[DOTTEDQUADLEN];
+    const size_t*   hits;
+    size_t          count;
+
+    if (acls_ensureCompiled()) {
+        log_log(LOG_ERR);
+        return 0;
+    }
+
+    (void)strcpy(dotAddr, inet_ntoa(*addr));
+    count = acl_match(&allowAcl, name, dotAddr, &hits);
+
+    for (i = 0; i < want->psa.psa_len; ++i) {
+        size_t  j;
+
+        for (j = 0; j < count; j++) {
+            const AllowEntry* const     entry = allowVec[hits[j]];
+
+            if (entry->ft & want->psa.psa_val[i].feedtype) {
+                if (entry->maxRate &&
+                        (0 == maxRate || entry->maxRate < maxRate))
+                    maxRate = entry->maxRate;
+
+                break;                  /* first match controls */
+            }
+        }                               /* matching ACL entry loop */
+    }                                   /* wanted product-specification loop */
+
+    return maxRate;
+}
+
+
 /**
  * Adds an ACCEPT entry.
  *
@@ -2991,8 +4267,10 @@ lcf_addAccept(
     int status = acceptEntries_add(&acceptEntries, ft, pattern, rgxp, hsp,
             isPrimary);
 
-    if (0 == status)
+    if (0 == status) {
+        acls_free();
         serverNeeded = true;
+    }
 
     return status;
 }
@@ -3084,22 +4362,29 @@ lcf_reduceToAcceptable(
     AcceptEntry*               hits[MAXHITS];
 
     if (NULL != acceptEntries) {
-        AcceptEntry       *ap;
+        const size_t*   indexes;
+        size_t          count;
+        size_t          i;
+
+        if (acls_ensureCompiled()) {
+            log_log(LOG_ERR);
+            return ENOMEM;
+        }
 
         /*
          * Find ACCEPT entries with matching identifiers.
          */
-        for (ap = acceptEntries; ap != NULL; ap = ap->next) {
-            if (contains(ap->hsp, name, dotAddr)) {
-                hits[nhits++] = ap;
+        count = acl_match(&acceptAcl, name, dotAddr, &indexes);
 
-                if (nhits >= MAXHITS) {
-                        uerror("nhits (%u) >= MAXHITS (%d)",
-                                nhits, MAXHITS);
-                        break;
-                }
+        for (i = 0; i < count; i++) {
+            hits[nhits++] = acceptVec[indexes[i]];
+
+            if (nhits >= MAXHITS) {
+                    uerror("nhits (%u) >= MAXHITS (%d)",
+                            nhits, MAXHITS);
+                    break;
             }
-        }                               /* ACCEPT entries loop */
+        }                               /* matching ACCEPT entries loop */
     }                                   /* ACCEPT list exists */
 
     prodClass = new_prod_class(nhits);  /* nhits may be 0 */
@@ -3196,6 +4481,21 @@ lcf_startRequesters(
     return subs_startRequesters();
 }
 
+/**
+ * Sets the interval between the starts of successive downstream LDM-s instead
+ * of obtaining it from the registry parameter /server/request-stagger.
+ *
+ * @param stagger       [in] The interval in milliseconds. 0 starts them all
+ *                      at once.
+ */
+void
+lcf_setRequestStagger(
+    const unsigned      stagger)
+{
+    requestStagger = stagger;
+    requestStaggerIsSet = 1;
+}
+
 
 /**
  * Indicates if a given host is allowed to connect in any fashion. First line
@@ -3208,25 +4508,18 @@ lcf_startRequesters(
 int
 lcf_isHostOk(const peer_info *rmtip)
 {
-        /* TODO: Does this need to be more efficient ? */
-        AcceptEntry*    acceptEntry;
-        AllowEntry*     allowEntry;
+        const size_t*   hits;
 
-        for (allowEntry = allowEntryHead;
-            allowEntry != NULL;
-            allowEntry = allowEntry->next)
-        {
-                if(host_set_match(rmtip, allowEntry->hsp))
-                        return 1;
-        }
-        for (acceptEntry = acceptEntries;
-            acceptEntry != NULL;
-            acceptEntry = acceptEntry->next)
+        if(rmtip == NULL)
+                return 0;
+        if(acls_ensureCompiled())
         {
-                if(host_set_match(rmtip, acceptEntry->hsp))
-                        return 1;
+                log_log(LOG_ERR);
+                return 0;
         }
-        return 0;
+
+        return acl_match(&allowAcl, rmtip->name, rmtip->astr, &hits) > 0 ||
+                acl_match(&acceptAcl, rmtip->name, rmtip->astr, &hits) > 0;
 }
 
 /**
@@ -3250,6 +4543,7 @@ lcf_free(void)
 {
     servers_free();
     subs_free();
+    acls_free();
     allowEntries_free();
     acceptEntries_free();
     serverNeeded = false;
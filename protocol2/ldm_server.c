@@ -35,12 +35,14 @@
 #include "inetutil.h"    /* hostbyaddr() */
 #include "ldm.h"         /* *_svc() functions */
 #include "ldmprint.h"    /* s_prod_class() */
+#include "pacer.h"       /* pacer_start() */
 #include "pq.h"
 #include "prod_class.h"  /* free_prod_class() */
 #include "ulog.h"
 #include "log.h"
 #include "UpFilter.h"
 #include "uldb.h"
+#include "uphub.h"       /* multi-session upstream LDM processes */
 
 #include "up6.h"         /* the pure "upstream" LDM module */
 
@@ -108,6 +110,62 @@ decodeSignature(
     return sig;
 }
 
+/*
+ * Decodes the stripe of a striped subscription from a product-specification
+ * of a product-class if it exists.  A downstream LDM that divides a
+ * subscription among several connections adds the product-specification
+ * {NONE, "STRIPE=<stripe>/<count>"} before any signature specification.
+ *
+ * Arguments:
+ *      prodClass       Pointer to the product-class.  Caller may free upon
+ *                      return.
+ *      stripe          Pointer to the stripe.  Set to 0 if the product-class
+ *                      doesn't contain a valid stripe specification.
+ *      stripeCount     Pointer to the number of stripes.  Set to 1 if the
+ *                      product-class doesn't contain a valid stripe
+ *                      specification.
+ * Returns:
+ *      0               The product-class doesn't contain a stripe
+ *                      specification.
+ *      1               The product-class contains a stripe specification.
+ */
+static int
+decodeStripe(
+        const prod_class_t* const prodClass,
+        unsigned* const stripe,
+        unsigned* const stripeCount)
+{
+    int i;
+
+    *stripe = 0;
+    *stripeCount = 1;
+
+    for (i = 0; i < prodClass->psa.psa_len; i++) {
+        const prod_spec* const spec = &prodClass->psa.psa_val[i];
+
+        if (NONE == spec->feedtype &&
+                strncasecmp("STRIPE=", spec->pattern, 7) == 0) {
+            unsigned    index;
+            unsigned    count;
+
+            if (sscanf(spec->pattern + 7, "%u/%u", &index, &count) != 2 ||
+                    0 == count || index >= count) {
+                err_log_and_free(
+                        ERR_NEW1(1, NULL, "Invalid stripe (%s)",
+                                spec->pattern + 7), ERR_NOTICE);
+            }
+            else {
+                *stripe = index;
+                *stripeCount = count;
+            }
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * Separates a product-class into a signature component and a non-signature
  * component.
@@ -143,9 +201,10 @@ separateProductClass(
     }
     else {
         const signaturet* sig = decodeSignature(prodClass);
+        unsigned stripe, stripeCount;
 
-        if (NULL != sig)
-            clss_scrunch(noSigClass); /* removes encoded signature */
+        if (NULL != sig || decodeStripe(prodClass, &stripe, &stripeCount))
+            clss_scrunch(noSigClass); /* removes encoded specifications */
 
         *noSigProdClass = noSigClass;
         *signature = sig;
@@ -158,7 +217,9 @@ separateProductClass(
 /**
  * Feeds or notifies a downstream LDM. This function returns either NULL or a
  * reply to be sent to the downstream LDM (e.g., a RECLASS message) or
- * terminates this process (hopefully after sending some data).
+ * terminates this process (hopefully after sending some data). If this process
+ * is an upstream LDM hub, then an honored subscription becomes a session of
+ * the hub and NULL is returned.
  * 
  * @param xprt          [in/out] Pointer to server-side transport handle.
  * @param want          [in] Pointer to subscription by downstream LDM.
@@ -187,6 +248,9 @@ feed_or_notify(
     UpFilter*               upFilter = NULL;
     fornme_reply_t*         reply = NULL;
     int                     isPrimary;
+    unsigned                stripe;
+    unsigned                stripeCount;
+    const unsigned          session = uphub_newSessionId();
     static fornme_reply_t   theReply;
     static prod_class_t*    uldbSub = NULL;
 
@@ -199,10 +263,16 @@ feed_or_notify(
         uldbSub = NULL;
     }
 
-    downName = strdup(hostbyaddr(&downAddr));
+    /*
+     * The name of the downstream host is already known if it was looked up by
+     * the resolver of an upstream LDM hub.
+     */
+    setremote(&downAddr, xprt->xp_sock);
+    ensureRemoteName(&downAddr);
+    downName = strdup(remote_name());
     if (NULL == downName) {
         LOG_ADD1("Couldn't duplicate downstream host name: \"%s\"",
-                hostbyaddr(&downAddr));
+                remote_name());
         log_log(LOG_ERR);
         svcerr_systemerr(xprt);
         goto return_or_exit;
@@ -238,6 +308,15 @@ feed_or_notify(
         goto free_orig_sub;
     }
 
+    /*
+     * Restrict the filter to the requested stripe of a striped subscription.
+     */
+    (void)decodeStripe(want, &stripe, &stripeCount);
+    if (stripeCount > 1) {
+        upFilter_setStripe(upFilter, stripe, stripeCount);
+        uinfo("Sending stripe %u of %u", stripe, stripeCount);
+    }
+
     /* TODO: adjust time? */
 
     /*
@@ -267,14 +346,16 @@ feed_or_notify(
      * Reduce the subscription according to existing subscriptions from the
      * same downstream host and terminate every previously-existing upstream
      * LDM process that's feeding (not notifying) a subset of the subscription
-     * to the same IP address.
+     * to the same IP address.  Other stripes of the same striped subscription
+     * don't count.
      *
      * The following relies on atexit()-registered cleanup for removal of the
-     * entry from the upstream LDM database.
+     * entry from the upstream LDM database.  If this process is an upstream
+     * LDM hub, then the entry is that of a session of this process.
      */
     isPrimary = maxHereis > UINT_MAX / 2;
-    status = uldb_addProcess(getpid(), 6, &downAddr, allowSub, &uldbSub,
-            isNotifier, isPrimary);
+    status = uldb_addStripedSession(getpid(), session, 6, &downAddr, allowSub,
+            &uldbSub, isNotifier, isPrimary, stripe, stripeCount);
     if (status) {
         LOG_ADD0("Couldn't add this process to the upstream LDM database");
         log_log(LOG_ERR);
@@ -294,7 +375,7 @@ feed_or_notify(
              * The downstream LDM is allowed less than it requested and was
              * entered into the upstream LDM database.
              */
-            (void)uldb_remove(getpid()); /* maybe next time */
+            (void)uldb_removeSession(getpid(), session); /* maybe next time */
 
             theReply.fornme_reply_t_u.prod_class = uldbSub;
         }
@@ -327,11 +408,37 @@ feed_or_notify(
         goto free_allow_sub;
     }
 
+    if (session) {
+        /*
+         * This process is an upstream LDM hub: the connection becomes one of
+         * its sessions once this request has been dispatched.
+         */
+        if (uphub_addSession(xprt, session, downName, &downAddr, uldbSub,
+                signature, upFilter, isNotifier, isPrimary)) {
+            LOG_ADD0("Couldn't add session to upstream LDM hub");
+            log_log(LOG_ERR);
+            (void)uldb_removeSession(getpid(), session);
+        }
+        else {
+            upFilter = NULL; /* now the hub's */
+        }
+
+        goto free_allow_sub;
+    }
+
     /*
      * Wait a second before sending anything to the downstream LDM.
      */
     (void) sleep(1);
 
+    /*
+     * Limit the sending-rate according to the ALLOW entries and the registry.
+     * An upstream LDM hub doesn't get here and isn't paced.
+     */
+    if (!isNotifier)
+        pacer_start(session, lcf_getMaxRate(downName, &downAddr.sin_addr,
+                uldbSub));
+
     status = isNotifier
             ? up6_new_notifier(xprt->xp_sock, downName, &downAddr, uldbSub,
                     signature, getQueuePath(), interval, upFilter)
@@ -369,7 +476,7 @@ feed_or_notify(
  * Sends a downstream LDM subscribed-to data-products.
  * <p>
  * This function will not normally return unless the request necessitates a
- * reply (e.g., RECLASS).
+ * reply (e.g., RECLASS) or this process is an upstream LDM hub.
  */
 fornme_reply_t *feedme_6_svc(
         feedpar_t *feedPar,
@@ -392,7 +499,7 @@ fornme_reply_t *feedme_6_svc(
  * Notifies a downstream LDM of subscribed-to data-products.
  * <p>
  * This function will not normally return unless the request necessitates a
- * reply (e.g., RECLASS).
+ * reply (e.g., RECLASS) or this process is an upstream LDM hub.
  */
 fornme_reply_t *notifyme_6_svc(
         prod_class_t* want,
@@ -594,6 +701,61 @@ void *hereis_6_svc(
     return NULL ; /* don't reply */
 }
 
+/*
+ * Handles a batch of data-products.  A batch without products is sent by an
+ * upstream LDM to determine if this LDM supports the HEREIS_BATCH message and
+ * is the only one that's replied to.
+ */
+void *hereis_batch_6_svc(
+        product_batch *batch,
+        struct svc_req *rqstp)
+{
+    static char probeReply; /* non-NULL result for xdr_void() */
+
+    if (batch->count == 0)
+        return &probeReply;
+
+    {
+        int error = down6_hereisBatch(batch);
+
+        if (error && DOWN6_UNWANTED != error && DOWN6_PQ_BIG != error) {
+            (void) svcerr_systemerr(rqstp->rq_xprt);
+            svc_destroy(rqstp->rq_xprt);
+            exit(error);
+        }
+    }
+
+    return NULL ; /* don't reply */
+}
+
+/*
+ * Handles a compressed batch of data-products, which was decompressed when it
+ * was decoded.  A compressed batch without content is sent by an upstream LDM
+ * to determine if this LDM supports the HEREIS_ZBATCH message and is the only
+ * one that's replied to.
+ */
+void *hereis_zbatch_6_svc(
+        product_zbatch *zbatch,
+        struct svc_req *rqstp)
+{
+    static char probeReply; /* non-NULL result for xdr_void() */
+
+    if (zbatch->ulen == 0)
+        return &probeReply;
+
+    if (zbatch->batch.count > 0) {
+        int error = down6_hereisBatch(&zbatch->batch);
+
+        if (error && DOWN6_UNWANTED != error && DOWN6_PQ_BIG != error) {
+            (void) svcerr_systemerr(rqstp->rq_xprt);
+            svc_destroy(rqstp->rq_xprt);
+            exit(error);
+        }
+    }
+
+    return NULL ; /* don't reply */
+}
+
 /*ARGSUSED1*/
 void *notification_6_svc(
         prod_info *info,
@@ -14,6 +14,7 @@
 #include <errno.h>
 #include <rpc/rpc.h>   /* svc_fdset */
 #include <signal.h>    /* sig_atomic_t */
+#include <stdlib.h>    /* exit() */
 #include <string.h>
 #include <sys/time.h>  /* fd_set */
 
@@ -23,6 +24,7 @@
 #include "autoshift.h"  /* asTimeToShift() */
 #include "timestamp.h"
 #include "globals.h"
+#include "inserter.h"   /* ins_getFd(), ins_reap() */
 #include "remote.h"
 
 
@@ -33,6 +35,11 @@
  *   3) as_shouldSwitch() returns true; or
  *   4) An error occurs.
  * <p>
+ * If data-products are being inserted into the product-queue on a separate
+ * thread (see inserter.h), then completed insertions are also handled here
+ * while the socket is idle. A fatal insertion failure terminates the process,
+ * as it does when the failure is returned to an RPC service function.
+ * <p>
  * This function uses the "log" module to accumulate messages.
  *
  * @param sock              The connected socket.
@@ -56,11 +63,13 @@ one_svc_run(
 {
     timestampt      canonicalTimeout;
     timestampt      selectTimeout;
+    timestampt      lastActivity;
     fd_set          fds;
 
     canonicalTimeout.tv_sec = timeout;
     canonicalTimeout.tv_usec = 0;
     selectTimeout = canonicalTimeout;
+    (void)set_timestamp(&lastActivity);
 
     FD_ZERO(&fds);
     FD_SET(sock, &fds);
@@ -69,16 +78,54 @@ one_svc_run(
         fd_set          readFds = fds;
         timestampt      before;
         int             selectStatus;
+        const int       insFd = ins_getFd();
+        const int       width = (insFd > sock ? insFd : sock) + 1;
+
+        if (insFd >= 0)
+            FD_SET(insFd, &readFds);
 
         (void)set_timestamp(&before);
 
-        selectStatus = select(sock+1, &readFds, 0, 0, &selectTimeout);
+        selectStatus = select(width, &readFds, 0, 0, &selectTimeout);
 
         (void)exitIfDone(0); /* handles SIGTERM reception */
 
         if (selectStatus == 0)
             return ETIMEDOUT;
 
+        if (selectStatus > 0 && insFd >= 0 && FD_ISSET(insFd, &readFds)) {
+            /*
+             * Data-products have been inserted into the product-queue.
+             */
+            int status = ins_reap();
+
+            if (status) {
+                log_add("one_svc_run(): Couldn't insert data-product");
+                log_log(LOG_ERR);
+                exit(status);
+            }
+
+            if (as_shouldSwitch())
+                return 0;
+
+            if (!FD_ISSET(sock, &readFds)) {
+                /*
+                 * No activity on the socket: adjust the select(2) timeout.
+                 */
+                timestampt      after;
+                timestampt      diff;
+
+                (void)set_timestamp(&after);
+                diff = diff_timestamp(&after, &lastActivity);
+                selectTimeout = diff_timestamp(&canonicalTimeout, &diff);
+
+                if (selectTimeout.tv_sec < 0)
+                    return ETIMEDOUT;
+
+                continue;
+            }
+        }
+
         if (selectStatus > 0) {
             /*
              * The socket is ready for reading.
@@ -99,6 +146,7 @@ one_svc_run(
                 return 0;
 
             selectTimeout = canonicalTimeout; /* reset select(2) timeout */
+            (void)set_timestamp(&lastActivity);
         } /* socket is read-ready */
         else {
             if (errno != EINTR) {
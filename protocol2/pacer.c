@@ -0,0 +1,135 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This module paces the data that an upstream LDM process sends to its
+ * downstream LDM.  The upstream LDM processes share a token-bucket for the
+ * global rate-limit in the upstream LDM database (see uldb(3)), which is also
+ * where each session's token-bucket and sending-rate are kept.  When
+ * several processes are backlogged, each reservation waits behind the
+ * previous ones, so the available bandwidth is shared among them in turn
+ * rather than being taken by the most aggressive downstream LDM.  The global
+ * rate-limit is the registry parameter /server/max-rate, in bytes per second;
+ * 0 disables pacing.
+ */
+
+#include "config.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "registry.h"
+#include "uldb.h"
+#include "ulog.h"
+#include "pacer.h"
+
+#define REPORT_INTERVAL 1.0     /* interval between unpaced updates in s */
+
+static unsigned long    pacerMaxRate;
+static int              pacerIsSet;
+static unsigned         pacerSession;
+static unsigned long    pacerSessionRate;
+static int              pacerIsStarted;
+static size_t           pacerUnreported;        /* bytes not yet in database */
+static time_t           pacerReportTime;        /* time of last update */
+
+/*
+ * Obtains the global rate-limit from the registry if it hasn't been set.
+ */
+static void
+pacer_ensureConfig(void)
+{
+    if (!pacerIsSet) {
+        pacerMaxRate = reg_getUintOrDefault(REG_MAX_RATE, 0);
+        pacerIsSet = 1;
+    }
+}
+
+/*
+ * Sets the global rate-limit instead of obtaining it from the registry.
+ */
+void
+pacer_setMaxRate(
+    const unsigned long maxRate)
+{
+    pacerMaxRate = maxRate;
+    pacerIsSet = 1;
+}
+
+/*
+ * Returns the global rate-limit.
+ */
+unsigned long
+pacer_getMaxRate(void)
+{
+    pacer_ensureConfig();
+
+    return pacerMaxRate;
+}
+
+/*
+ * Starts pacing the data that this process sends to a downstream LDM.
+ */
+void
+pacer_start(
+    const unsigned      session,
+    const unsigned long sessionRate)
+{
+    pacer_ensureConfig();
+
+    pacerSession = session;
+    pacerSessionRate = sessionRate;
+    pacerUnreported = 0;
+    pacerReportTime = time(NULL);
+    pacerIsStarted = 1;
+
+    if (pacerMaxRate || pacerSessionRate)
+        uinfo("Pacing: total limit %lu B/s, session limit %lu B/s",
+                pacerMaxRate, pacerSessionRate);
+}
+
+/*
+ * Accounts for data that's about to be sent and sleeps if necessary.
+ */
+void
+pacer_pace(
+    const size_t        nbytes)
+{
+    double      delay;
+
+    if (!pacerIsStarted)
+        return;
+
+    pacerUnreported += nbytes;
+
+    /*
+     * Without a rate-limit, only keep the sending-rate in the database current
+     * rather than locking the database for every data-product.
+     */
+    if (0 == pacerMaxRate && 0 == pacerSessionRate &&
+            difftime(time(NULL), pacerReportTime) < REPORT_INTERVAL)
+        return;
+
+    if (uldb_pace(getpid(), pacerSession, pacerUnreported, pacerMaxRate,
+            pacerSessionRate, &delay)) {
+        LOG_ADD0("Couldn't pace sending; no longer pacing");
+        log_log(LOG_ERR);
+        pacerIsStarted = 0;
+        return;
+    }
+
+    pacerUnreported = 0;
+    pacerReportTime = time(NULL);
+
+    if (delay > 0) {
+        struct timespec duration;
+
+        duration.tv_sec = (time_t)delay;
+        duration.tv_nsec = (long)((delay - duration.tv_sec) * 1e9);
+
+        if (ulogIsDebug())
+            udebug("Pacing: waiting %.3f s", delay);
+
+        (void)nanosleep(&duration, NULL);
+    }
+}
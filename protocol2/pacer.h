@@ -0,0 +1,68 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This header-file specifies the API for the pacing of the data that an
+ * upstream LDM process sends to its downstream LDM so that the upstream LDM
+ * processes, together, don't exceed a global rate-limit and each doesn't
+ * exceed the rate-limit of its ALLOW entry.
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets the global rate-limit instead of obtaining it from the registry.
+ *
+ * @param maxRate       [in] Maximum total rate, in bytes per second, at which
+ *                      the upstream LDM processes send data or 0 for no limit.
+ */
+void
+pacer_setMaxRate(
+    const unsigned long maxRate);
+
+/**
+ * Returns the global rate-limit.
+ *
+ * @return              Maximum total rate, in bytes per second, at which the
+ *                      upstream LDM processes send data or 0 if there's no
+ *                      limit.
+ */
+unsigned long
+pacer_getMaxRate(void);
+
+/**
+ * Starts pacing the data that this process sends to a downstream LDM. The
+ * process must have an entry in the upstream LDM database.
+ *
+ * @param session       [in] Session of the process in the upstream LDM
+ *                      database or 0.
+ * @param sessionRate   [in] Maximum rate, in bytes per second, at which data
+ *                      is sent to the downstream LDM or 0 for no limit.
+ */
+void
+pacer_start(
+    const unsigned      session,
+    const unsigned long sessionRate);
+
+/**
+ * Accounts for data that's about to be sent to the downstream LDM. Sleeps, if
+ * necessary, so that no rate-limit is exceeded. Returns early if a signal is
+ * caught. Updates the sending-rate in the upstream LDM database.
+ *
+ * @param nbytes        [in] Number of bytes about to be sent.
+ */
+void
+pacer_pace(
+    const size_t        nbytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Loopback benchmark of the transfer of data-products from an upstream LDM-6
+ * to a downstream LDM-6 whose product-queue is loaded -- both with and without
+ * inserting the data-products on a separate thread (see inserter.h).  The
+ * downstream product-queue is small enough that old data-products must be
+ * deleted, and other processes read it (like pqact(1)), write it (like
+ * another feed), and periodically hold its lock (like a process that's
+ * deleting a large data-product or waiting for the disk) during the transfer.
+ *
+ * Usage: pipeline_bench [-v] [-H] [-n count] [-s size] [-r readers]
+ *                       [-w writers] [-l ms] [-b bytes] [-d dir]
+ *
+ *     -v          Verbose logging.
+ *     -H          Send HEREIS rather than HEREIS_BATCH messages.
+ *     -n count    Number of data-products (default 20000).
+ *     -s size     Size of each data-product in bytes (default 10000).
+ *     -r readers  Number of reading processes (default 4).
+ *     -w writers  Number of other writing processes (default 1).
+ *     -l ms       Milliseconds of every 100 for which another process holds
+ *                 the product-queue's lock (default 20).  0 disables.
+ *     -b bytes    Size of the downstream socket's receive-buffer, which
+ *                 bounds the TCP window (default 262144).  0 means the
+ *                 system default.
+ *     -d dir      Directory for the temporary product-queues (default /tmp).
+ */
+#include "config.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "inserter.h"
+#include "ldm.h"
+#include "pq.h"
+#include "prod_class.h"
+#include "timestamp.h"
+#include "ulog.h"
+#include "up6.h"
+#include "bench_util.h"
+
+#define MAX_LOADERS     32
+
+static volatile sig_atomic_t    loaderDone;
+
+/*
+ * Handles SIGTERM in a loading process.
+ */
+/*ARGSUSED*/
+static void
+stopLoader(
+    int sig)
+{
+    loaderDone = 1;
+}
+
+/*
+ * Reads a data-product like a pqact(1) action does.
+ */
+/*ARGSUSED*/
+static int
+readProduct(
+    const prod_info*    info,
+    const void*         data,
+    void*               xprod,
+    size_t              size,
+    void*               arg)
+{
+    const unsigned char*        cp = data;
+    unsigned long*              sum = arg;
+    size_t                      i;
+
+    for (i = 0; i < info->sz; i += 64)
+        *sum += cp[i];
+
+    return 0;
+}
+
+/*
+ * Periodically holds the lock on the control-region of a product-queue until
+ * told to stop.  Doesn't return.
+ */
+static void
+runLocker(
+    const char* const   pqPath,
+    const unsigned      ms)
+{
+    struct flock        lock;
+    int                 fd = open(pqPath, O_RDWR);
+
+    (void)signal(SIGTERM, stopLoader);
+
+    if (fd < 0) {
+        serror("Couldn't open product-queue \"%s\"", pqPath);
+        _exit(1);
+    }
+
+    (void)memset(&lock, 0, sizeof(lock));
+    lock.l_whence = SEEK_SET;
+    lock.l_start = 0;
+    lock.l_len = 1;
+
+    while (!loaderDone) {
+        lock.l_type = F_WRLCK;
+        (void)fcntl(fd, F_SETLKW, &lock);
+        (void)usleep(ms * 1000);
+        lock.l_type = F_UNLCK;
+        (void)fcntl(fd, F_SETLK, &lock);
+        (void)usleep((100 - ms) * 1000);
+    }
+
+    _exit(0);
+}
+
+/*
+ * Loads a product-queue by reading it or by writing other data-products into
+ * it until told to stop.  Doesn't return.
+ */
+static void
+runLoader(
+    const char* const   pqPath,
+    const int           isWriter,
+    const unsigned      id,
+    const unsigned      size)
+{
+    pqueue*             pq;
+    unsigned long       sum = 0;
+    int                 status;
+
+    (void)signal(SIGTERM, stopLoader);
+
+    status = pq_open(pqPath, isWriter ? PQ_DEFAULT : PQ_READONLY, &pq);
+    if (status) {
+        uerror("Couldn't open product-queue \"%s\": %s", pqPath,
+                strerror(status));
+        _exit(1);
+    }
+
+    if (isWriter) {
+        char*           data = malloc(size);
+        char            ident[32];
+        product         prod;
+        unsigned        i;
+
+        if (NULL == data)
+            _exit(1);
+
+        (void)memset(data, 'y', size);
+        prod.info.origin = "pipeline_bench-writer";
+        prod.info.feedtype = EXP;
+        prod.info.ident = ident;
+        prod.info.sz = size;
+        prod.data = data;
+
+        for (i = 0; !loaderDone; i++) {
+            (void)set_timestamp(&prod.info.arrival);
+            prod.info.seqno = i;
+            (void)snprintf(ident, sizeof(ident), "other %u %u", id, i);
+            (void)memset(prod.info.signature, 0xff, sizeof(signaturet));
+            (void)memcpy(prod.info.signature, &i, sizeof(i));
+            (void)memcpy(prod.info.signature + sizeof(i), &id, sizeof(id));
+
+            (void)pq_insert(pq, &prod);
+            (void)usleep(1000);
+        }
+    }
+    else {
+        pq_cset(pq, &TS_ZERO);
+
+        while (!loaderDone) {
+            status = pq_sequence(pq, TV_GT, PQ_CLASS_ALL, readProduct, &sum);
+
+            if (PQUEUE_END == status) {
+                (void)usleep(1000);
+            }
+            else if (status && PQUEUE_DUP != status) {
+                /*
+                 * Deleted from under the cursor: start over from the oldest.
+                 */
+                pq_cset(pq, &TS_ZERO);
+            }
+        }
+    }
+
+    (void)pq_close(pq);
+    _exit(sum == 0xdeadbeef);   /* keeps the reading from being optimized */
+}
+
+/*
+ * Creates the downstream product-queue, which is small enough that old
+ * data-products must be deleted, and starts the processes that load it.
+ *
+ * Returns:
+ *      -1      Failure.
+ *      else    Number of loading processes.  "loaders" is set.
+ */
+static int
+startLoaders(
+    const char* const   pqPath,
+    const unsigned      count,
+    const unsigned      size,
+    const unsigned      nreaders,
+    const unsigned      nwriters,
+    const unsigned      lockMs,
+    pid_t* const        loaders)
+{
+    pqueue*     pq;
+    unsigned    nloaders = 0;
+    unsigned    i;
+    int         status = pq_create(pqPath, 0666, PQ_DEFAULT, 0,
+            (off_t)(count / 8 + 1) * size, count + 100, &pq);
+
+    if (status) {
+        uerror("Couldn't create product-queue \"%s\": %s", pqPath,
+                strerror(status));
+        return -1;
+    }
+
+    (void)pq_close(pq);
+    (void)fflush(stdout);
+
+    for (i = 0; i <= nreaders + nwriters && nloaders < MAX_LOADERS; i++) {
+        pid_t   pid;
+
+        if (i == nreaders + nwriters && (0 == lockMs || lockMs >= 100))
+            break;
+
+        pid = fork();
+
+        if (0 == pid) {
+            if (i == nreaders + nwriters)
+                runLocker(pqPath, lockMs);
+
+            runLoader(pqPath, i >= nreaders, i, size);
+        }
+        if (pid > 0)
+            loaders[nloaders++] = pid;
+    }
+
+    return nloaders;
+}
+
+/*
+ * Configures the upstream LDM.  Called by bench_transfer().
+ */
+static void
+setUp(
+    void* const arg)
+{
+    up6_setBatching(*(int*)arg);
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char* dir = "/tmp";
+    unsigned    count = 20000;
+    unsigned    size = 10000;
+    unsigned    nreaders = 4;
+    unsigned    nwriters = 1;
+    unsigned    lockMs = 20;
+    int         batching = 1;
+    char        upPath[256];
+    char        downPath[256];
+    BenchConfig config;
+    int         ch;
+    int         pipelined;
+    int         status = 0;
+
+    bench_init("pipeline_bench", LOG_NOTICE);
+    (void)memset(&config, 0, sizeof(config));
+    config.rcvBuf = 262144;
+
+    while ((ch = getopt(argc, argv, "vHn:s:r:w:l:b:d:")) != -1) {
+        switch (ch) {
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'H':
+            batching = 0;
+            break;
+        case 'n':
+            count = (unsigned)atoi(optarg);
+            break;
+        case 's':
+            size = (unsigned)atoi(optarg);
+            break;
+        case 'r':
+            nreaders = (unsigned)atoi(optarg);
+            break;
+        case 'w':
+            nwriters = (unsigned)atoi(optarg);
+            break;
+        case 'l':
+            lockMs = (unsigned)atoi(optarg);
+            break;
+        case 'b':
+            config.rcvBuf = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-v] [-H] [-n count] [-s size] [-r readers] "
+                    "[-w writers] [-l ms] [-b bytes] [-d dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == count || 0 == size) {
+        (void)fprintf(stderr, "Count and size must be positive\n");
+        return 1;
+    }
+
+    bench_setPath(upPath, sizeof(upPath), dir, "pipeline_bench", "up");
+    bench_setPath(downPath, sizeof(downPath), dir, "pipeline_bench", "down");
+
+    if (bench_fillQueue(upPath, count, size, "pipeline_bench", NULL, NULL))
+        return 1;
+
+    config.count = count;
+    config.primary = 1;
+    config.setUp = setUp;
+    config.arg = &batching;
+
+    for (pipelined = 0; pipelined <= 1; pipelined++) {
+        pid_t           loaders[MAX_LOADERS];
+        const int       nloaders = startLoaders(downPath, count, size,
+                nreaders, nwriters, lockMs, loaders);
+        BenchResult     result;
+        int             i;
+
+        if (nloaders < 0) {
+            status = 1;
+            break;
+        }
+
+        ins_setConfig(pipelined ? 16000000 : 0);
+
+        if (bench_transfer(upPath, downPath, &config, &result)) {
+            status = 1;
+        }
+        else {
+            (void)printf("%-11s %u products of %u bytes, %u readers, "
+                    "%u writers, %u%% locked: %.3f s, %.0f products/s, "
+                    "%.1f MB/s\n",
+                    pipelined ? "pipelined" : "unpipelined", count, size,
+                    nreaders, nwriters, lockMs < 100 ? lockMs : 0,
+                    result.duration, count / result.duration,
+                    (double)count * size / result.duration / 1e6);
+        }
+
+        for (i = 0; i < nloaders; i++) {
+            (void)kill(loaders[i], SIGTERM);
+            (void)waitpid(loaders[i], NULL, 0);
+        }
+
+        (void)unlink(downPath);
+    }
+
+    (void)unlink(upPath);
+
+    return status;
+}
@@ -0,0 +1,360 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This module classifies data-products into a high-priority class and a
+ * normal-priority class for an upstream LDM that reorders the data-products
+ * it sends so that high-priority ones (e.g., warnings) aren't delayed behind
+ * bulk ones (e.g., model output) when the downstream LDM falls behind.  It
+ * also accumulates the latency of the sent data-products for each class.  The
+ * classes are defined by the registry parameters /server/priority/feedtypes
+ * and /server/priority/pattern; the priority benchmark defines them itself.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atofeedt.h"
+#include "ldm.h"
+#include "log.h"
+#include "pq.h"
+#include "registry.h"
+#include "RegularExpressions.h"
+#include "timestamp.h"
+#include "ulog.h"
+#include "UpFilter.h"
+#include "priority.h"
+
+#define DEFAULT_WINDOW  64      /* default size of the reorder window */
+
+typedef struct {
+    unsigned long       count;  /* number of data-products sent */
+    double              sum;    /* sum of latencies in seconds */
+    double              max;    /* maximum latency in seconds */
+} Latency;
+
+static feedtypet        prioFeedtypes = NONE;
+static regex_t          prioRegex;
+static int              prioHasRegex;   /* "prioRegex" is compiled? */
+static unsigned         prioWindow = DEFAULT_WINDOW;
+static int              prioIsSet;
+static Latency          prioLatencies[2]; /* normal, high */
+
+/*
+ * Argument of prio_checkDeferrable():
+ */
+typedef struct {
+    const UpFilter*     upFilter;       /* upstream filter or NULL */
+    int                 isDeferrable;   /* the data-product is deferrable? */
+} DeferCheck;
+
+/*
+ * Compiles the pattern of the high-priority class.
+ *
+ * Arguments:
+ *      pattern         The ERE or NULL to match all product-identifiers.
+ * Returns:
+ *      0               Success.
+ *      EINVAL          "pattern" is invalid.  log_start() called.
+ *      ENOMEM          Out of memory.  log_start() called.
+ */
+static int
+prio_setPattern(
+    const char* const   pattern)
+{
+    if (prioHasRegex) {
+        regfree(&prioRegex);
+        prioHasRegex = 0;
+    }
+
+    if (NULL != pattern && strcmp(pattern, ".*") != 0) {
+        char*   vetted = strdup(pattern);
+
+        if (NULL == vetted) {
+            LOG_SERROR1("Couldn't duplicate pattern \"%s\"", pattern);
+            return ENOMEM;
+        }
+
+        (void)re_vetSpec(vetted);
+
+        if (regcomp(&prioRegex, vetted, REG_EXTENDED|REG_NOSUB)) {
+            LOG_START1("Invalid priority pattern \"%s\"", pattern);
+            free(vetted);
+            return EINVAL;
+        }
+
+        free(vetted);
+        prioHasRegex = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Obtains the configuration from the registry if it hasn't been set.
+ */
+static void
+prio_ensureConfig(void)
+{
+    if (!prioIsSet) {
+        char*       str = reg_getStringOrDefault(REG_PRIORITY_FEEDTYPES,
+                "NONE");
+
+        prioFeedtypes = NONE;
+
+        if (NULL != str) {
+            const int   status = strfeedtypet(str, &prioFeedtypes);
+
+            if (status) {
+                uerror("Invalid priority feedtypes \"%s\": %s", str,
+                        strfeederr(status));
+                prioFeedtypes = NONE;
+            }
+
+            free(str);
+        }
+
+        if (NONE != prioFeedtypes) {
+            str = reg_getStringOrDefault(REG_PRIORITY_PATTERN, ".*");
+
+            if (prio_setPattern(str)) {
+                LOG_ADD0("Not prioritizing data-products");
+                log_log(LOG_ERR);
+                prioFeedtypes = NONE;
+            }
+
+            free(str);
+
+            prioWindow = reg_getUintOrDefault(REG_PRIORITY_WINDOW,
+                    DEFAULT_WINDOW);
+        }
+
+        prioIsSet = 1;
+    }
+}
+
+/*
+ * Sets the configuration instead of obtaining it from the registry.
+ *
+ * Arguments:
+ *      feedtypes       Feedtypes of the high-priority data-products.  NONE
+ *                      disables prioritization.
+ *      pattern         ERE that the product-identifier of a high-priority
+ *                      data-product must match or NULL to match all.
+ *      window          Maximum number of normal-priority data-products that
+ *                      may be deferred.  0 disables prioritization.
+ * Returns:
+ *      0               Success.
+ *      EINVAL          "pattern" is invalid.  log_start() called.
+ *      ENOMEM          Out of memory.  log_start() called.
+ */
+int
+prio_setConfig(
+    const feedtypet     feedtypes,
+    const char* const   pattern,
+    const unsigned      window)
+{
+    int status = prio_setPattern(pattern);
+
+    prioFeedtypes = status ? NONE : feedtypes;
+    prioWindow = window;
+    prioIsSet = 1;
+
+    return status;
+}
+
+/*
+ * Indicates if the prioritization of data-products is enabled.
+ */
+int
+prio_isEnabled(void)
+{
+    prio_ensureConfig();
+
+    return NONE != prioFeedtypes && 0 < prioWindow;
+}
+
+/*
+ * Indicates if a data-product is in the high-priority class.
+ */
+int
+prio_isHigh(
+    const prod_info* const      info)
+{
+    prio_ensureConfig();
+
+    return 0 != (info->feedtype & prioFeedtypes) &&
+        (!prioHasRegex || regexec(&prioRegex, info->ident, 0, NULL, 0) == 0);
+}
+
+/*
+ * Indicates if a feedtype includes any of the high-priority feedtypes.
+ */
+int
+prio_isHighFeedtype(
+    const feedtypet     feedtype)
+{
+    prio_ensureConfig();
+
+    return 0 != (feedtype & prioFeedtypes);
+}
+
+/*
+ * Returns the size of the reorder window in data-products.
+ */
+unsigned
+prio_getWindow(void)
+{
+    prio_ensureConfig();
+
+    return prioWindow;
+}
+
+/*
+ * Determines whether a data-product would be deferred.  Called by
+ * pq_processProduct() and pq_sequence().
+ */
+static int
+prio_checkDeferrable(
+    const prod_info* const      info,
+    const void* const           data,
+    void* const                 xprod,
+    const size_t                size,
+    void* const                 arg)
+{
+    DeferCheck* const   check = (DeferCheck*)arg;
+
+    check->isDeferrable = !prio_isHigh(info) && (NULL == check->upFilter ||
+            upFilter_isMatch(check->upFilter, info));
+
+    return 0;
+}
+
+/*
+ * Moves the product-queue cursor of a resumed subscription back over the
+ * data-products that might have been deferred but not sent.
+ */
+int
+prio_backUpCursor(
+    pqueue* const               pq,
+    const signaturet            signature,
+    const prod_class_t* const   prodClass,
+    const UpFilter* const       upFilter)
+{
+    DeferCheck  check;
+    timestampt  resumePoint;
+    unsigned    count = 0;
+    int         moved = 0;
+    int         status;
+
+    if (!prio_isEnabled())
+        return 0;
+
+    check.upFilter = NULL;
+    check.isDeferrable = 0;
+    status = pq_processProduct(pq, signature, prio_checkDeferrable, &check);
+
+    if (status || check.isDeferrable)
+        return status;
+
+    pq_ctimestamp(pq, &resumePoint);
+    check.upFilter = upFilter;
+
+    while (count < prioWindow) {
+        timestampt  before;
+
+        pq_ctimestamp(pq, &before);
+        check.isDeferrable = 0;
+        status = pq_sequence(pq, TV_LT, prodClass, prio_checkDeferrable,
+                &check);
+
+        if (PQUEUE_END == status) {
+            status = 0;
+            break;
+        }
+
+        if (0 == status) {
+            moved = 1;
+
+            if (check.isDeferrable)
+                count++;
+        }
+        else if (EAGAIN == status || EACCES == status) {
+            timestampt  after;
+
+            pq_ctimestamp(pq, &after);
+
+            if (tvEqual(before, after))
+                break;          /* the cursor couldn't be moved */
+
+            /* The locked data-product isn't counted, to be safe */
+            moved = 1;
+        }
+        else {
+            break;
+        }
+    }
+
+    if (status) {
+        pq_cset(pq, &resumePoint);
+    }
+    else if (moved) {
+        timestampt  cursor;
+
+        /* Include the data-product at the cursor in a TV_GT scan */
+        pq_ctimestamp(pq, &cursor);
+        timestamp_decr(&cursor);
+        pq_cset(pq, &cursor);
+
+        uinfo("Resuming before %u possibly deferred data-products", count);
+    }
+
+    return status;
+}
+
+/*
+ * Accumulates the latency of a data-product that's being sent.
+ */
+void
+prio_noteSent(
+    const prod_info* const      info,
+    const int                   isHigh)
+{
+    Latency* const      lat = &prioLatencies[isHigh ? 1 : 0];
+    timestampt          now;
+    double              latency;
+
+    (void)set_timestamp(&now);
+    latency = d_diff_timestamp(&now, &info->arrival);
+
+    lat->count++;
+    lat->sum += latency;
+    if (latency > lat->max)
+        lat->max = latency;
+}
+
+/*
+ * Logs the latency statistics of each priority class and resets them.
+ */
+void
+prio_logLatencies(
+    const int                   level)
+{
+    const Latency* const        high = &prioLatencies[1];
+    const Latency* const        norm = &prioLatencies[0];
+
+    if (high->count || norm->count) {
+        ulog(level, "Latency: high-priority: %lu products, mean %.3f s, "
+                "max %.3f s; normal-priority: %lu products, mean %.3f s, "
+                "max %.3f s",
+                high->count, high->count ? high->sum/high->count : 0.0,
+                high->max,
+                norm->count, norm->count ? norm->sum/norm->count : 0.0,
+                norm->max);
+
+        (void)memset(prioLatencies, 0, sizeof(prioLatencies));
+    }
+}
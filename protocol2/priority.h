@@ -0,0 +1,137 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This header-file specifies the API for the priority classes of data-products
+ * that an upstream LDM uses to reorder the data-products that it sends to a
+ * downstream LDM.
+ */
+
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+#include "ldm.h"
+#include "pq.h"
+#include "UpFilter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets the configuration instead of obtaining it from the registry.
+ *
+ * @param feedtypes     [in] Feedtypes of the high-priority data-products. NONE
+ *                      disables prioritization.
+ * @param pattern       [in] ERE that the product-identifier of a high-priority
+ *                      data-product must match or NULL to match all. Caller
+ *                      may free upon return.
+ * @param window        [in] Maximum number of normal-priority data-products
+ *                      that may be deferred in favor of high-priority ones. 0
+ *                      disables prioritization.
+ * @retval 0            Success.
+ * @retval EINVAL       "pattern" is invalid. log_start() called.
+ * @retval ENOMEM       Out of memory. log_start() called.
+ */
+int
+prio_setConfig(
+    const feedtypet     feedtypes,
+    const char* const   pattern,
+    const unsigned      window);
+
+/**
+ * Indicates if the prioritization of data-products is enabled.
+ *
+ * @retval 0    Prioritization is disabled.
+ * @retval 1    Prioritization is enabled.
+ */
+int
+prio_isEnabled(void);
+
+/**
+ * Indicates if a data-product is in the high-priority class.
+ *
+ * @param info          [in] Metadata of the data-product.
+ * @retval 0            The data-product has normal priority.
+ * @retval 1            The data-product has high priority.
+ */
+int
+prio_isHigh(
+    const prod_info* const      info);
+
+/**
+ * Indicates if a feedtype includes any of the feedtypes of the high-priority
+ * class.  Used, for example, to start the downstream LDM-s of such feeds first.
+ *
+ * @param feedtype      [in] The feedtype.
+ * @retval 0            The feedtype has no high-priority feedtypes.
+ * @retval 1            The feedtype has high-priority feedtypes.
+ */
+int
+prio_isHighFeedtype(
+    const feedtypet             feedtype);
+
+/**
+ * Returns the maximum number of normal-priority data-products that may be
+ * deferred in favor of high-priority ones.
+ *
+ * @return  The size of the reorder window in data-products.
+ */
+unsigned
+prio_getWindow(void);
+
+/**
+ * Moves the product-queue cursor of a resumed subscription back over the
+ * data-products that the previous upstream LDM might have deferred but not
+ * sent.  A downstream LDM resumes after the last data-product it received.
+ * If that one had high priority, then older normal-priority data-products
+ * might still have been in the reorder window.  Deferred data-products are
+ * sent oldest-first, so they can only be among the last "window" deferrable
+ * data-products before the resume point; those of them that were sent are
+ * sent again and rejected downstream as duplicates.  Does nothing if
+ * prioritization is disabled or if the resume point has normal priority.
+ *
+ * @param pq            [in/out] The product-queue. Its cursor shall be at the
+ *                      resume point (see pq_setCursorFromSignature()). On
+ *                      success, a TV_GT scan from the cursor includes every
+ *                      data-product that might not have been sent.
+ * @param signature     [in] The signature of the resume point.
+ * @param prodClass     [in] The subscription.
+ * @param upFilter      [in] The upstream filter of the subscription or NULL.
+ * @retval 0            Success.
+ * @return              Product-queue error code (see pq_strerror()). The
+ *                      cursor is unchanged.
+ */
+int
+prio_backUpCursor(
+    pqueue* const               pq,
+    const signaturet            signature,
+    const prod_class_t* const   prodClass,
+    const UpFilter* const       upFilter);
+
+/**
+ * Accumulates the latency of a data-product that's being sent.
+ *
+ * @param info          [in] Metadata of the data-product.
+ * @param isHigh        [in] Whether the data-product has high priority.
+ */
+void
+prio_noteSent(
+    const prod_info* const      info,
+    const int                   isHigh);
+
+/**
+ * Logs the number of data-products sent and their mean and maximum latencies
+ * for each priority class since the previous call and resets the statistics.
+ * Does nothing if no data-product was sent.
+ *
+ * @param level         [in] The ulog(3) logging-level (e.g., LOG_INFO).
+ */
+void
+prio_logLatencies(
+    const int                   level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Benchmark of the delivery of high-priority data-products by an upstream
+ * LDM-6 to a downstream LDM-6 that has fallen behind -- both with and without
+ * prioritization.  The product-queue initially holds a backlog of large, bulk
+ * data-products interspersed with small, high-priority ones.  The connection
+ * is a relay process that limits the rate of the upstream-to-downstream
+ * direction.  The mean and maximum times until the data-products of each
+ * class are inserted into the downstream product-queue are reported.
+ *
+ * Usage: priority_bench [-v] [-n count] [-s size] [-k interval] [-r rate]
+ *                       [-w window] [-d dir]
+ *
+ *     -v            Verbose logging.
+ *     -n count      Number of data-products (default 1000).
+ *     -s size       Size of each bulk data-product in bytes (default 50000).
+ *     -k interval   Every interval-th data-product has high priority
+ *                   (default 20).
+ *     -r rate       Rate of the link in bytes per second (default 5000000).
+ *     -w window     Size of the reorder window in data-products (default 64).
+ *     -d dir        Directory for the temporary product-queues (default
+ *                   /tmp).
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ldm.h"
+#include "pq.h"
+#include "priority.h"
+#include "prod_class.h"
+#include "timestamp.h"
+#include "ulog.h"
+#include "bench_util.h"
+
+#define HIGH_FEEDTYPE   IDS             /* feedtype of high-priority products */
+#define HIGH_SIZE       1000            /* size of high-priority products */
+#define BULK_FEEDTYPE   HDS             /* feedtype of bulk products */
+
+typedef struct {
+    unsigned    count;
+    double      sum;
+    double      max;
+} Delay;
+
+/*
+ * The state of a transfer:
+ */
+typedef struct {
+    unsigned    count;          /* number of data-products */
+    unsigned    window;         /* size of the reorder window or 0 */
+    Delay       high;           /* delays of the high-priority products */
+    Delay       bulk;           /* delays of the bulk products */
+} Transfer;
+
+/*
+ * Makes every interval-th data-product a small, high-priority one and the
+ * others bulk ones.  Called by bench_fillQueue().
+ */
+static int
+setProduct(
+    product* const      prod,
+    const unsigned      index,
+    void* const         arg)
+{
+    const unsigned      interval = *(unsigned*)arg;
+
+    if (index % interval == interval - 1) {
+        prod->info.feedtype = HIGH_FEEDTYPE;
+        if (prod->info.sz > HIGH_SIZE)
+            prod->info.sz = HIGH_SIZE;
+        (void)sprintf(prod->info.ident, "WWUS %u", index);
+    }
+    else {
+        prod->info.feedtype = BULK_FEEDTYPE;
+        (void)sprintf(prod->info.ident, "bulk %u", index);
+    }
+
+    return 0;
+}
+
+/*
+ * Configures the upstream LDM.  Called by bench_transfer().
+ */
+static void
+setUp(
+    void* const arg)
+{
+    const unsigned      window = ((Transfer*)arg)->window;
+
+    (void)prio_setConfig(window ? HIGH_FEEDTYPE : NONE, NULL, window);
+}
+
+/*
+ * Returns the feedtype of a data-product.  Called by pq_sequence().
+ */
+/*ARGSUSED*/
+static int
+getFeedtype(
+    const prod_info* const      info,
+    const void* const           data,
+    void* const                 xprod,
+    const size_t                size,
+    void* const                 arg)
+{
+    *(feedtypet*)arg = info->feedtype;
+
+    return 0;
+}
+
+/*
+ * Accumulates the delays from the start of the transfer until the insertion
+ * of the data-products into a product-queue.
+ */
+static void
+getDelays(
+    pqueue* const               pq,
+    const timestampt* const     start,
+    Delay* const                high,
+    Delay* const                bulk)
+{
+    feedtypet   feedtype;
+
+    (void)memset(high, 0, sizeof(*high));
+    (void)memset(bulk, 0, sizeof(*bulk));
+    pq_cset(pq, &TS_ZERO);
+
+    while (0 == pq_sequence(pq, TV_GT, PQ_CLASS_ALL, getFeedtype, &feedtype)) {
+        timestampt      inserted;
+        Delay* const    delay = HIGH_FEEDTYPE == feedtype ? high : bulk;
+        double          secs;
+
+        pq_ctimestamp(pq, &inserted);
+        secs = d_diff_timestamp(&inserted, start);
+
+        delay->count++;
+        delay->sum += secs;
+        if (secs > delay->max)
+            delay->max = secs;
+    }
+}
+
+/*
+ * Indicates whether the downstream product-queue has all the data-products
+ * and, if so, gets their delays.  Called by bench_transfer().
+ */
+static int
+isDone(
+    pqueue* const               pq,
+    const timestampt* const     start,
+    void* const                 arg)
+{
+    Transfer* const     transfer = (Transfer*)arg;
+    size_t              nprods;
+
+    if (pq_stats(pq, &nprods, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                NULL) || nprods < transfer->count)
+        return 0;
+
+    getDelays(pq, start, &transfer->high, &transfer->bulk);
+
+    return 1;
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char* dir = "/tmp";
+    unsigned    count = 1000;
+    unsigned    size = 50000;
+    unsigned    interval = 20;
+    unsigned    rate = 5000000;
+    unsigned    window = 64;
+    char        upPath[256];
+    char        downPath[256];
+    Transfer    transfer;
+    BenchConfig config;
+    int         ch;
+    int         prioritizing;
+    int         status = 0;
+
+    bench_init("priority_bench", LOG_WARNING);
+
+    while ((ch = getopt(argc, argv, "vn:s:k:r:w:d:")) != -1) {
+        switch (ch) {
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'n':
+            count = (unsigned)atoi(optarg);
+            break;
+        case 's':
+            size = (unsigned)atoi(optarg);
+            break;
+        case 'k':
+            interval = (unsigned)atoi(optarg);
+            break;
+        case 'r':
+            rate = (unsigned)atoi(optarg);
+            break;
+        case 'w':
+            window = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-v] [-n count] [-s size] [-k interval] "
+                    "[-r rate] [-w window] [-d dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == count || 0 == size || 0 == interval || 0 == rate ||
+            0 == window) {
+        (void)fprintf(stderr,
+                "Count, size, interval, rate, and window must be positive\n");
+        return 1;
+    }
+
+    bench_setPath(upPath, sizeof(upPath), dir, "priority_bench", "up");
+    bench_setPath(downPath, sizeof(downPath), dir, "priority_bench", "down");
+
+    if (bench_fillQueue(upPath, count, size, "priority_bench", setProduct,
+                &interval))
+        return 1;
+
+    (void)memset(&config, 0, sizeof(config));
+    config.count = count;
+    config.downSize = (off_t)count * (size + 256) + 1000000;
+    config.primary = 1;
+    config.rate = rate;
+    config.setUp = setUp;
+    config.isDone = isDone;
+    config.arg = &transfer;
+    transfer.count = count;
+
+    for (prioritizing = 0; prioritizing <= 1; prioritizing++) {
+        BenchResult     result;
+
+        transfer.window = prioritizing ? window : 0;
+
+        if (bench_transfer(upPath, downPath, &config, &result)) {
+            status = 1;
+        }
+        else {
+            const Delay* const  high = &transfer.high;
+            const Delay* const  bulk = &transfer.bulk;
+
+            (void)printf("%-14s high-priority: %u products, mean %.3f s, "
+                    "max %.3f s; bulk: %u products, mean %.3f s, "
+                    "max %.3f s\n",
+                    prioritizing ? "prioritized" : "unprioritized",
+                    high->count, high->count ? high->sum / high->count : 0.0,
+                    high->max, bulk->count,
+                    bulk->count ? bulk->sum / bulk->count : 0.0, bulk->max);
+        }
+    }
+
+    (void)unlink(upPath);
+
+    return status;
+}
@@ -127,6 +127,26 @@ ensureRemoteName(
 }
 
 
+/*
+ * Sets the "name" member of the global structure "remote" to a name that was
+ * looked up by another process (e.g., the resolver of an upstream LDM hub), so
+ * that ensureRemoteName() doesn't look it up again.  Does nothing if the name is NULL or empty.
+ *
+ * Arguments:
+ *      name    Pointer to the name of the remote host or NULL.
+ */
+void
+setRemoteName(
+    const char* const   name)
+{
+    if (NULL != name && 0 != name[0]) {
+        (void)strncpy(remote.name, name, HOSTNAMELEN-1);
+        remote.name[HOSTNAMELEN-1] = 0;
+        remote.printname = remote.name;
+    }
+}
+
+
 const char *
 remote_name(void)
 {
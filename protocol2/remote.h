@@ -16,6 +16,8 @@ exern "C" {
 extern void free_remote_clss(void);
 extern void ensureRemoteName(
     const struct sockaddr_in* const     paddr);
+extern void setRemoteName(
+    const char* const                   name);
 extern void setremote(
     const struct sockaddr_in* const     paddr,
     const int                           sock);
@@ -0,0 +1,315 @@
+/**
+ * Copyright 2013 University Corporation for Atmospheric Research. All Rights
+ * reserved. See file COPYRIGHT in the top-level source-directory for copying
+ * and redistribution conditions.
+ *
+ * Compares the compiled host-sets of ALLOW entries with the evaluation of
+ * each host-set by itself.
+ */
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <libgen.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "ldm.h"
+#include "ldm_config_file.h"
+#include "log.h"
+#include "prod_class.h"
+#include "RegularExpressions.h"
+#include "ulog.h"
+
+typedef struct {
+    enum host_set_type  type;
+    const char*         spec;
+} Spec;
+
+typedef struct {
+    const char*         name;
+    const char*         addr;
+} Host;
+
+static const Spec specs[] = {
+    {HS_REGEXP,         "^uni\\.ucar\\.edu$"},      /* exact */
+    {HS_REGEXP,         "\\.ucar\\.edu$"},          /* suffix */
+    {HS_REGEXP,         "^128\\.117\\."},           /* octet prefix */
+    {HS_REGEXP,         "^128\\.117\\.140\\."},     /* longer octet prefix */
+    {HS_REGEXP,         "UCAR"},                    /* unanchored literal */
+    {HS_REGEXP,         "^idd\\..*\\.edu$"},        /* general */
+    {HS_REGEXP,         "^192\\.168\\.0\\.1$"},     /* exact address */
+    {HS_NAME,           "Motherlode.UCAR.edu"},
+    {HS_DOTTED_QUAD,    "10.0.0.1"},
+    {HS_REGEXP,         "^10\\.0\\."},
+    {HS_REGEXP,         "^1\\."},                   /* not "128." */
+    {HS_REGEXP,         "^12"},                     /* not a whole octet */
+    {HS_REGEXP,         "EDU$"},                    /* case-insensitive */
+    {HS_REGEXP,         "^(a|b)\\.example\\.com$"},
+    {HS_REGEXP,         "\\.Example\\.COM$"},
+    {HS_REGEXP,         "^10\\.0\\.0\\.1$"},        /* same as a previous one */
+    {HS_REGEXP,         "host-1_x"},
+    {HS_REGEXP,         "^01\\."},                  /* not a canonical octet */
+};
+#define NSPECS  (sizeof(specs)/sizeof(specs[0]))
+
+static const Host hosts[] = {
+    {"uni.ucar.edu",            "128.117.140.56"},
+    {"Motherlode.ucar.edu",     "128.117.15.9"},
+    {"idd.unidata.edu",         "192.168.0.1"},
+    {"a.example.com",           "10.0.0.1"},
+    {"A.EXAMPLE.COM",           "10.0.1.2"},
+    {"host-1_x.foo.org",        "1.2.3.4"},
+    {"nowhere.org",             "99.117.140.56"},
+    {"ucar",                    "12.0.0.1"},
+    {"c.example.com",           "128.11.7.1"},
+    {"UNI.UCAR.EDU.evil.org",   "10.10.0.1"},
+};
+#define NHOSTS  (sizeof(hosts)/sizeof(hosts[0]))
+
+static regex_t  regexes[NSPECS];
+
+static int setup(void)
+{
+    size_t  i;
+
+    for (i = 0; i < NSPECS; i++) {
+        if (HS_REGEXP == specs[i].type) {
+            char* const clone = strdup(specs[i].spec);
+
+            if (NULL == clone)
+                return -1;
+
+            (void)re_vetSpec(clone);
+            if (regcomp(regexes + i, clone, REG_EXTENDED|REG_ICASE|REG_NOSUB)) {
+                free(clone);
+                return -1;
+            }
+            free(clone);
+        }
+    }
+
+    return 0;
+}
+
+static int teardown(void)
+{
+    size_t  i;
+
+    for (i = 0; i < NSPECS; i++) {
+        if (HS_REGEXP == specs[i].type)
+            regfree(regexes + i);
+    }
+
+    lcf_free();
+
+    return 0;
+}
+
+/*
+ * Returns the entries whose host-set contains a host by evaluating each
+ * host-set as the uncompiled form does.
+ */
+static unsigned long expected(
+        const Host* const   host)
+{
+    unsigned long   mask = 0;
+    size_t          i;
+
+    for (i = 0; i < NSPECS; i++) {
+        int contains;
+
+        if (HS_NAME == specs[i].type) {
+            contains = strcasecmp(host->name, specs[i].spec) == 0;
+        }
+        else if (HS_DOTTED_QUAD == specs[i].type) {
+            contains = strcmp(host->addr, specs[i].spec) == 0;
+        }
+        else {
+            contains = regexec(regexes + i, host->addr, 0, NULL, 0) == 0 ||
+                    regexec(regexes + i, host->name, 0, NULL, 0) == 0;
+        }
+
+        if (contains)
+            mask |= 1ul << i;
+    }
+
+    return mask;
+}
+
+/*
+ * Adds the host-sets as ALLOW entries in a rotated order. The entry of
+ * host-set "i" has feedtype bit "i" and a maximum rate of "i+1".
+ */
+static void add_allows(
+        const size_t    rotation)
+{
+    size_t  n;
+
+    lcf_free();
+
+    for (n = 0; n < NSPECS; n++) {
+        const size_t    i = (n + rotation) % NSPECS;
+        host_set*       hsp;
+        ErrorObj*       errObj;
+
+        if (HS_REGEXP == specs[i].type) {
+            regex_t rgx;
+            char*   clone = strdup(specs[i].spec);
+
+            /* As the configuration-file parser does */
+            CU_ASSERT_PTR_NOT_NULL_FATAL(clone);
+            (void)re_vetSpec(clone);
+            CU_ASSERT_EQUAL_FATAL(regcomp(&rgx, clone,
+                    REG_EXTENDED|REG_ICASE|REG_NOSUB), 0);
+            free(clone);
+            clone = strdup(specs[i].spec);
+            CU_ASSERT_PTR_NOT_NULL_FATAL(clone);
+            hsp = lcf_newHostSet(HS_REGEXP, clone, &rgx);
+        }
+        else {
+            hsp = lcf_newHostSet(specs[i].type, specs[i].spec, NULL);
+        }
+        CU_ASSERT_PTR_NOT_NULL_FATAL(hsp);
+
+        errObj = lcf_addAllow((feedtypet)(1ul << i), hsp, ".*", NULL, i + 1);
+        CU_ASSERT_PTR_NULL_FATAL(errObj);
+    }
+}
+
+/*
+ * Returns the entries whose host-set contains a host according to the
+ * compiled host-sets.
+ */
+static unsigned long actual(
+        const Host* const   host)
+{
+    prod_class_t*   want = new_prod_class(NSPECS);
+    prod_class_t*   inter;
+    struct in_addr  addr;
+    unsigned long   mask = 0;
+    size_t          i;
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(want);
+    for (i = 0; i < NSPECS; i++) {
+        want->psa.psa_val[i].feedtype = (feedtypet)(1ul << i);
+        want->psa.psa_val[i].pattern = strdup(".*");
+        CU_ASSERT_PTR_NOT_NULL_FATAL(want->psa.psa_val[i].pattern);
+    }
+    clss_regcomp(want);
+
+    CU_ASSERT_NOT_EQUAL(inet_aton(host->addr, &addr), 0);
+    CU_ASSERT_EQUAL_FATAL(lcf_reduceToAllowed(host->name, &addr, want,
+            &inter), 0);
+
+    for (i = 0; i < inter->psa.psa_len; i++)
+        mask |= inter->psa.psa_val[i].feedtype;
+
+    free_prod_class(inter);
+    free_prod_class(want);
+
+    return mask;
+}
+
+/*
+ * Returns the index of the first entry in the given rotation whose host-set
+ * is in a mask or -1.
+ */
+static int first_in_rotation(
+        const unsigned long mask,
+        const size_t        rotation)
+{
+    size_t  n;
+
+    for (n = 0; n < NSPECS; n++) {
+        const size_t    i = (n + rotation) % NSPECS;
+
+        if (mask & (1ul << i))
+            return (int)i;
+    }
+
+    return -1;
+}
+
+static void test_expected(void)
+{
+    /* Guard the test itself against a vacuous comparison */
+    CU_ASSERT_EQUAL(expected(hosts + 0),
+            (1ul<<0)|(1ul<<1)|(1ul<<2)|(1ul<<3)|(1ul<<4)|(1ul<<11)|(1ul<<12));
+    CU_ASSERT_EQUAL(expected(hosts + 5), (1ul<<10)|(1ul<<16));
+    CU_ASSERT_EQUAL(expected(hosts + 6), 0);
+}
+
+static void test_matches(void)
+{
+    size_t  rotation;
+
+    for (rotation = 0; rotation < NSPECS; rotation++) {
+        size_t  h;
+
+        add_allows(rotation);
+
+        for (h = 0; h < NHOSTS; h++) {
+            const unsigned long mask = expected(hosts + h);
+            struct in_addr      addr;
+            const int           first = first_in_rotation(mask, rotation);
+
+            CU_ASSERT_EQUAL(actual(hosts + h), mask);
+
+            /* The first matching entry controls the rate */
+            CU_ASSERT_NOT_EQUAL(inet_aton(hosts[h].addr, &addr), 0);
+            CU_ASSERT_EQUAL(lcf_getMaxRate(hosts[h].name, &addr, PQ_CLASS_ALL),
+                    first < 0 ? 0 : (unsigned long)first + 1);
+        }
+    }
+}
+
+static void test_compile_then_add(void)
+{
+    struct in_addr  addr;
+
+    /* Adding an entry after compilation must invalidate the compiled form */
+    add_allows(0);
+    CU_ASSERT_EQUAL(lcf_compileAcl(), 0);
+    CU_ASSERT_NOT_EQUAL(inet_aton("99.117.140.56", &addr), 0);
+    CU_ASSERT_EQUAL(lcf_getMaxRate("nowhere.org", &addr, PQ_CLASS_ALL), 0);
+
+    CU_ASSERT_PTR_NULL(lcf_addAllow(ANY,
+            lcf_newHostSet(HS_NAME, "nowhere.org", NULL), ".*", NULL, 1000));
+    CU_ASSERT_EQUAL(lcf_getMaxRate("nowhere.org", &addr, PQ_CLASS_ALL), 1000);
+}
+
+int main(
+        const int argc,
+        const char* const * argv)
+{
+    int exitCode = 1; /* failure */
+    const char* progname = basename((char*) argv[0]);
+
+    if (-1 == openulog(progname, LOG_PID, LOG_LOCAL0, "-")) {
+        (void) fprintf(stderr, "Couldn't open logging system\n");
+    }
+    else {
+        if (CUE_SUCCESS == CU_initialize_registry()) {
+            CU_Suite* testSuite = CU_add_suite(__FILE__, setup, teardown);
+
+            if (NULL != testSuite) {
+                if (CU_ADD_TEST(testSuite, test_expected) &&
+                        CU_ADD_TEST(testSuite, test_matches) &&
+                        CU_ADD_TEST(testSuite, test_compile_then_add)) {
+                    CU_basic_set_mode(CU_BRM_VERBOSE);
+                    (void) CU_basic_run_tests();
+                    exitCode = CU_get_error();
+                }
+            }
+
+            CU_cleanup_registry();
+        }
+    }
+
+    return exitCode;
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright 2013 University Corporation for Atmospheric Research. All Rights
+ * reserved. See file COPYRIGHT in the top-level source-directory for copying
+ * and redistribution conditions.
+ */
+#include "config.h"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "autoshift.h"
+#include "timestamp.h"
+#include "ulog.h"
+
+static as_Group*    group;
+
+static int setup(void)
+{
+    return 0;
+}
+
+static int teardown(void)
+{
+    return 0;
+}
+
+/*
+ * Processes data-products of a given latency for one autoshift period and then
+ * one more, which triggers the decision.
+ */
+static void process_period(
+        const unsigned  count,
+        const int       accepted,
+        const int       latency)
+{
+    timestampt  arrival;
+    unsigned    i;
+
+    for (i = 0; i < count; i++) {
+        (void)set_timestamp(&arrival);
+        arrival.tv_sec -= latency;
+        CU_ASSERT_EQUAL(as_process(accepted, 1, &arrival), 0);
+    }
+
+    (void)sleep(1);
+
+    (void)set_timestamp(&arrival);
+    arrival.tv_sec -= latency;
+    CU_ASSERT_EQUAL(as_process(accepted, 1, &arrival), 0);
+}
+
+static void test_count_below_minimum(void)
+{
+    /* Few products with known latency still let the counts decide */
+    as_setConfig(1, 1000, 10);
+    CU_ASSERT_EQUAL(as_setGroup(NULL, 0), 0);
+    CU_ASSERT_EQUAL(as_setLdmCount(2), 0);
+
+    as_init(1);
+    process_period(2, 0, 0);
+    CU_ASSERT_EQUAL(as_shouldSwitch(), 1);
+
+    as_init(1);
+    process_period(2, 1, 0);
+    CU_ASSERT_EQUAL(as_shouldSwitch(), 0);
+}
+
+static void test_latency(void)
+{
+    group = as_newGroup(2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(group);
+    as_setConfig(1, 1000, 3);
+    CU_ASSERT_EQUAL(as_setLdmCount(2), 0);
+
+    /* Publish a small latency as the other member */
+    CU_ASSERT_EQUAL(as_setGroup(group, 1), 0);
+    as_init(1);
+    process_period(3, 1, 0);
+
+    /*
+     * A slower primary member switches although the counts alone would have
+     * kept it primary
+     */
+    CU_ASSERT_EQUAL(as_setGroup(group, 0), 0);
+    as_init(1);
+    process_period(3, 1, 5);
+    CU_ASSERT_EQUAL(as_shouldSwitch(), 1);
+
+    /* Too few products for the latencies to decide: the counts do */
+    as_setConfig(1, 1000, 10);
+    as_init(1);
+    process_period(3, 1, 5);
+    CU_ASSERT_EQUAL(as_shouldSwitch(), 0);
+
+    CU_ASSERT_EQUAL(as_setGroup(NULL, 0), 0);
+    as_freeGroup(group);
+}
+
+int main(
+        const int argc,
+        const char* const * argv)
+{
+    int exitCode = 1; /* failure */
+    const char* progname = basename((char*) argv[0]);
+
+    if (-1 == openulog(progname, LOG_PID, LOG_LOCAL0, "-")) {
+        (void) fprintf(stderr, "Couldn't open logging system\n");
+    }
+    else {
+        if (CUE_SUCCESS == CU_initialize_registry()) {
+            CU_Suite* testSuite = CU_add_suite(__FILE__, setup, teardown);
+
+            if (NULL != testSuite) {
+                if (CU_ADD_TEST(testSuite, test_count_below_minimum) &&
+                        CU_ADD_TEST(testSuite, test_latency)) {
+                    CU_basic_set_mode(CU_BRM_VERBOSE);
+                    (void) CU_basic_run_tests();
+                    exitCode = CU_get_error();
+                }
+            }
+
+            CU_cleanup_registry();
+        }
+    }
+
+    return exitCode;
+}
@@ -0,0 +1,256 @@
+/**
+ * Copyright 2013 University Corporation for Atmospheric Research. All Rights
+ * reserved. See file COPYRIGHT in the top-level source-directory for copying
+ * and redistribution conditions.
+ *
+ * Tests the resumption of a prioritized subscription whose upstream LDM
+ * disconnected while normal-priority data-products were still deferred.
+ */
+#include "config.h"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "ldm.h"
+#include "pq.h"
+#include "prod_class.h"
+#include "priority.h"
+#include "timestamp.h"
+#include "ulog.h"
+
+#define HIGH_FEEDTYPE   WMO
+#define BULK_FEEDTYPE   NEXRAD3
+#define WINDOW          3
+#define NPRODS          40
+#define PQ_PATH         "test_priority.pq"
+
+static pqueue*  testPq;
+
+/*
+ * Whether a data-product has high priority: every fifth one plus a burst of
+ * them so that the reorder window fills up.
+ */
+static int isHighIndex(
+        const unsigned  i)
+{
+    return i % 5 == 4 || (i >= 20 && i <= 23);
+}
+
+static void makeSignature(
+        const unsigned  i,
+        signaturet      signature)
+{
+    (void)memset(signature, 0, sizeof(signaturet));
+    (void)memcpy(signature, &i, sizeof(i));
+}
+
+static int setup(void)
+{
+    char        data[100];
+    char        ident[32];
+    product     prod;
+    unsigned    i;
+    int         status;
+
+    (void)unlink(PQ_PATH);
+    status = pq_create(PQ_PATH, 0666, PQ_DEFAULT, 0, 1000000, NPRODS + 10,
+            &testPq);
+    if (status)
+        return -1;
+
+    (void)memset(data, 'x', sizeof(data));
+    prod.info.origin = "test_priority";
+    prod.info.ident = ident;
+    prod.info.sz = sizeof(data);
+    prod.data = data;
+
+    for (i = 0; i < NPRODS; i++) {
+        prod.info.feedtype = isHighIndex(i) ? HIGH_FEEDTYPE : BULK_FEEDTYPE;
+        (void)snprintf(ident, sizeof(ident), "product %u", i);
+        (void)set_timestamp(&prod.info.arrival);
+        prod.info.seqno = i;
+        makeSignature(i, prod.info.signature);
+
+        if (pq_insert(testPq, &prod))
+            return -1;
+    }
+
+    return prio_setConfig(HIGH_FEEDTYPE, NULL, WINDOW) ? -1 : 0;
+}
+
+static int teardown(void)
+{
+    (void)pq_close(testPq);
+    (void)unlink(PQ_PATH);
+
+    return 0;
+}
+
+/*
+ * Records the index of a data-product. Called by pq_sequence().
+ */
+static int noteIndex(
+        const prod_info* const  info,
+        const void* const       data,
+        void* const             xprod,
+        const size_t            size,
+        void* const             arg)
+{
+    int* const  sent = (int*)arg;
+    unsigned    i;
+
+    (void)memcpy(&i, info->signature, sizeof(i));
+    CU_ASSERT_FATAL(i < NPRODS);
+    sent[i] = 1;
+
+    return 0;
+}
+
+/*
+ * Sends the data-products in the order of the upstream LDM until a
+ * high-priority data-product is sent while normal-priority ones are still
+ * deferred. Returns the index of that data-product; "sent" indicates the
+ * data-products that the downstream LDM received.
+ */
+static unsigned sendUntilDisconnect(
+        int* const  sent)
+{
+    unsigned    ring[WINDOW];
+    unsigned    head = 0;
+    unsigned    count = 0;
+    unsigned    i;
+
+    (void)memset(sent, 0, NPRODS * sizeof(int));
+
+    for (i = 0; i < NPRODS; i++) {
+        if (count == WINDOW) {
+            /* As up6.c, the oldest deferred data-product makes room */
+            sent[ring[head]] = 1;
+            head = (head + 1) % WINDOW;
+            count--;
+        }
+
+        if (isHighIndex(i)) {
+            sent[i] = 1;
+
+            if (count > 0)
+                return i;
+        }
+        else {
+            ring[(head + count++) % WINDOW] = i;
+        }
+    }
+
+    CU_FAIL("No disconnection with a non-empty ring");
+    return NPRODS - 1;
+}
+
+/*
+ * Resumes after a data-product and returns the data-products that are then
+ * sent.
+ */
+static void resume(
+        const unsigned  last,
+        int* const      resent)
+{
+    signaturet  signature;
+    int         status;
+
+    (void)memset(resent, 0, NPRODS * sizeof(int));
+    makeSignature(last, signature);
+    CU_ASSERT_EQUAL_FATAL(pq_setCursorFromSignature(testPq, signature), 0);
+    CU_ASSERT_EQUAL_FATAL(prio_backUpCursor(testPq, signature, PQ_CLASS_ALL,
+            NULL), 0);
+
+    do {
+        status = pq_sequence(testPq, TV_GT, PQ_CLASS_ALL, noteIndex,
+                resent);
+    } while (0 == status);
+
+    CU_ASSERT_EQUAL(status, PQUEUE_END);
+}
+
+static void test_reconnect_with_deferred(void)
+{
+    int         sent[NPRODS];
+    int         resent[NPRODS];
+    unsigned    last = sendUntilDisconnect(sent);
+    unsigned    older = 0;
+    unsigned    i;
+
+    resume(last, resent);
+
+    for (i = 0; i < NPRODS; i++) {
+        if (!sent[i]) {
+            CU_ASSERT_TRUE(resent[i]);
+
+            if (i < last)
+                older++;
+        }
+    }
+
+    /* Guard the test itself against a vacuous comparison */
+    CU_ASSERT_TRUE(older > 0);
+    CU_ASSERT_FALSE(resent[0]);
+}
+
+static void test_resume_after_normal(void)
+{
+    int         resent[NPRODS];
+    unsigned    i;
+
+    /* Nothing older than a normal-priority resume point can be deferred */
+    resume(10, resent);
+
+    for (i = 0; i < NPRODS; i++)
+        CU_ASSERT_EQUAL(resent[i], i > 10);
+}
+
+static void test_disabled(void)
+{
+    int         resent[NPRODS];
+    unsigned    i;
+
+    CU_ASSERT_EQUAL_FATAL(prio_setConfig(NONE, NULL, WINDOW), 0);
+    resume(24, resent);
+    CU_ASSERT_EQUAL_FATAL(prio_setConfig(HIGH_FEEDTYPE, NULL, WINDOW), 0);
+
+    for (i = 0; i < NPRODS; i++)
+        CU_ASSERT_EQUAL(resent[i], i > 24);
+}
+
+int main(
+        const int argc,
+        const char* const * argv)
+{
+    int exitCode = 1; /* failure */
+    const char* progname = basename((char*) argv[0]);
+
+    if (-1 == openulog(progname, LOG_PID, LOG_LOCAL0, "-")) {
+        (void) fprintf(stderr, "Couldn't open logging system\n");
+    }
+    else {
+        if (CUE_SUCCESS == CU_initialize_registry()) {
+            CU_Suite* testSuite = CU_add_suite(__FILE__, setup, teardown);
+
+            if (NULL != testSuite) {
+                if (CU_ADD_TEST(testSuite, test_reconnect_with_deferred) &&
+                        CU_ADD_TEST(testSuite, test_resume_after_normal) &&
+                        CU_ADD_TEST(testSuite, test_disabled)) {
+                    CU_basic_set_mode(CU_BRM_VERBOSE);
+                    (void) CU_basic_run_tests();
+                    exitCode = CU_get_error();
+                }
+            }
+
+            CU_cleanup_registry();
+        }
+    }
+
+    return exitCode;
+}
@@ -0,0 +1,232 @@
+/**
+ * Copyright 2013 University Corporation for Atmospheric Research. All Rights
+ * reserved. See file COPYRIGHT in the top-level source-directory for copying
+ * and redistribution conditions.
+ *
+ * Tests the order and the staggering of the starts of downstream LDM-s and the
+ * bounded look-up of their upstream hosts. The downstream LDM-s are started
+ * with the "done" global variable set so that each one exits instead of
+ * connecting once its start-delay has elapsed.
+ */
+#include "config.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "globals.h"
+#include "hostCache.h"
+#include "ldm.h"
+#include "ldm_config_file.h"
+#include "priority.h"
+#include "timestamp.h"
+#include "ulog.h"
+
+#define LOG_PATH        "test_requester.log"
+#define PQ_PATH         "test_requester.pq"     /* mustn't exist */
+#define STAGGER         200                     /* milliseconds */
+#define RESOLVE_TIMEOUT 10                      /* as ldm_config_file.c */
+#define NHOSTS          (sizeof(hosts)/sizeof(hosts[0]))
+
+/*
+ * The REQUEST entries in the order of the configuration-file. The high-priority
+ * feedtype is WMO.  The alternate server of the high-priority subscription
+ * doesn't resolve (see RFC 6761).
+ */
+static const struct {
+    feedtypet       feedtype;
+    const char*     host;
+    unsigned        order;      /* expected order of start */
+} hosts[] = {
+    {EXP,   "127.0.0.2",            2}, /* normal-priority primary */
+    {EXP,   "127.0.0.3",            3}, /* normal-priority alternate */
+    {WMO,   "127.0.0.4",            0}, /* high-priority primary */
+    {WMO,   "unresolvable.invalid", 1}, /* high-priority alternate */
+};
+
+static unsigned delays[NHOSTS];     /* start-delays in milliseconds */
+static double   startDuration;      /* duration of lcf_startRequesters() */
+static double   runDuration;        /* until the last downstream LDM exited */
+static int      lookedUp;           /* look-up of hosts was reported? */
+
+/*
+ * Obtains the start-delays of the downstream LDM-s and whether the look-up of
+ * the upstream hosts was reported from the log file. A downstream LDM that
+ * doesn't log its start-delay has none.
+ */
+static int readLog(void)
+{
+    FILE*   file = fopen(LOG_PATH, "r");
+    char    line[512];
+
+    if (NULL == file)
+        return -1;
+
+    while (fgets(line, sizeof(line), file)) {
+        unsigned    i;
+
+        if (strstr(line, "Looked-up"))
+            lookedUp = 1;
+
+        for (i = 0; i < NHOSTS; i++) {
+            char        prefix[128];
+            const char* msg;
+
+            (void)snprintf(prefix, sizeof(prefix), "%s: Delaying start by ",
+                    hosts[i].host);
+
+            if ((msg = strstr(line, prefix)) != NULL)
+                (void)sscanf(msg + strlen(prefix), "%u", &delays[i]);
+        }
+    }
+
+    (void)fclose(file);
+
+    return 0;
+}
+
+static int setup(void)
+{
+    timestampt  start;
+    timestampt  started;
+    timestampt  stop;
+    unsigned    i;
+
+    (void)unlink(LOG_PATH);
+    if (-1 == openulog("test_requester", LOG_NOTIME, LOG_LDM, LOG_PATH))
+        return -1;
+    (void)setulogmask(LOG_UPTO(LOG_DEBUG));
+
+    setQueuePath(PQ_PATH);
+    hc_setConfig(3600, 60);
+    if (hc_init())
+        return -1;
+    lcf_setRequestStagger(STAGGER);
+    if (prio_setConfig(WMO, NULL, 64))
+        return -1;
+
+    for (i = 0; i < NHOSTS; i++) {
+        if (lcf_addRequest(hosts[i].feedtype, ".*", hosts[i].host, LDM_PORT,
+                1))
+            return -1;
+    }
+
+    (void)fflush(stdout); /* the downstream LDM-s call exit() */
+    done = 1;
+    (void)set_timestamp(&start);
+
+    if (lcf_startRequesters(LDM_PORT))
+        return -1;
+
+    (void)set_timestamp(&started);
+
+    while (wait(NULL) != -1 || EINTR == errno)
+        ;
+
+    (void)set_timestamp(&stop);
+    done = 0;
+
+    startDuration = d_diff_timestamp(&started, &start);
+    runDuration = d_diff_timestamp(&stop, &start);
+
+    return readLog();
+}
+
+static int teardown(void)
+{
+    lcf_free();
+    (void)unlink(LOG_PATH);
+
+    return 0;
+}
+
+/*
+ * Returns the index of the host whose downstream LDM started in a given
+ * position.
+ */
+static unsigned hostAt(
+        const unsigned  order)
+{
+    unsigned    i;
+
+    for (i = 0; i < NHOSTS && hosts[i].order != order; i++)
+        ;
+
+    CU_ASSERT_FATAL(i < NHOSTS);
+
+    return i;
+}
+
+static void test_high_priority_first(void)
+{
+    /* Every high-priority downstream LDM starts before every other one */
+    CU_ASSERT_TRUE(delays[hostAt(1)] < delays[hostAt(2)]);
+}
+
+static void test_primary_first(void)
+{
+    CU_ASSERT_TRUE(delays[hostAt(0)] < delays[hostAt(1)]);
+    CU_ASSERT_TRUE(delays[hostAt(2)] < delays[hostAt(3)]);
+}
+
+static void test_delay_bounds(void)
+{
+    unsigned    order;
+
+    for (order = 0; order < NHOSTS; order++) {
+        const unsigned  delay = delays[hostAt(order)];
+
+        CU_ASSERT_TRUE(delay >= order * STAGGER);
+        CU_ASSERT_TRUE(delay < (order + 1) * STAGGER);
+    }
+
+    /* The downstream LDM-s waited for their delays */
+    CU_ASSERT_TRUE(runDuration >= delays[hostAt(NHOSTS-1)] / 1000.0);
+    CU_ASSERT_TRUE(runDuration < startDuration + NHOSTS * STAGGER / 1000.0 +
+            2);
+}
+
+static void test_unresolvable_host(void)
+{
+    /*
+     * The look-up of the upstream hosts is abandoned after RESOLVE_TIMEOUT
+     * seconds, and the downstream LDM of the unresolvable host is started
+     * regardless.
+     */
+    CU_ASSERT_TRUE(startDuration < RESOLVE_TIMEOUT + 2);
+    CU_ASSERT_TRUE(lookedUp);
+    CU_ASSERT_TRUE(delays[hostAt(1)] >= STAGGER);
+}
+
+int main(
+        const int argc,
+        const char* const * argv)
+{
+    int exitCode = 1; /* failure */
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        CU_Suite* testSuite = CU_add_suite(__FILE__, setup, teardown);
+
+        if (NULL != testSuite) {
+            if (CU_ADD_TEST(testSuite, test_high_priority_first) &&
+                    CU_ADD_TEST(testSuite, test_primary_first) &&
+                    CU_ADD_TEST(testSuite, test_delay_bounds) &&
+                    CU_ADD_TEST(testSuite, test_unresolvable_host)) {
+                CU_basic_set_mode(CU_BRM_VERBOSE);
+                (void) CU_basic_run_tests();
+                exitCode = CU_get_error();
+            }
+        }
+
+        CU_cleanup_registry();
+    }
+
+    return exitCode;
+}
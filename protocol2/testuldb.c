@@ -9,6 +9,7 @@
 #   define _XOPEN_SOURCE 500
 #endif
 
+#include <arpa/inet.h>
 #include <errno.h>
 #include <libgen.h>
 #include <signal.h>
@@ -408,6 +409,241 @@ static void test_add_same_notifier(void)
     CU_ASSERT_EQUAL(get_size(), 1);
 }
 
+static void test_add_sessions(void)
+{
+    int                 status;
+    struct sockaddr_in  sockAddr = new_sock_addr();
+    const pid_t         pid = getpid();
+    prod_class_t*       allowed;
+    uldb_Iter*          iter;
+    const uldb_Entry*   entry;
+
+    clear();
+
+    status = uldb_addSession(pid, 1, 6, &sockAddr, &_clss_all, &allowed, 0, 1);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+    CU_ASSERT_EQUAL(get_size(), 1);
+
+    /* A newer session to the same host obsoletes the older one */
+    status = uldb_addSession(pid, 2, 6, &sockAddr, &_clss_all, &allowed, 0, 1);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+    CU_ASSERT_EQUAL(get_size(), 1);
+
+    status = uldb_getIterator(&iter);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    entry = uldb_iter_firstEntry(iter);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(entry);
+    CU_ASSERT_EQUAL(uldb_entry_getPid(entry), pid);
+    CU_ASSERT_EQUAL(uldb_entry_getSession(entry), 2);
+    uldb_iter_free(iter);
+
+    status = uldb_addSession(pid, 2, 6, &sockAddr, &_clss_all, &allowed, 0, 1);
+    CU_ASSERT_EQUAL(status, ULDB_EXIST);
+    log_clear();
+
+    CU_ASSERT_EQUAL(uldb_removeSession(pid, 2), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(get_size(), 0);
+}
+
+static void test_add_stripes(void)
+{
+    int                 status;
+    struct sockaddr_in  sockAddr = new_sock_addr();
+    const pid_t         pid = getpid();
+    prod_class_t*       allowed;
+
+    clear();
+
+    /* Stripes of the same request don't overlap */
+    status = uldb_addStripedSession(pid, 1, 6, &sockAddr, &_clss_all, &allowed,
+            0, 1, 0, 2);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+    status = uldb_addStripedSession(pid, 2, 6, &sockAddr, &_clss_all, &allowed,
+            0, 1, 1, 2);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+    CU_ASSERT_EQUAL(get_size(), 2);
+
+    /* A newer session for the same stripe obsoletes the older one */
+    status = uldb_addStripedSession(pid, 3, 6, &sockAddr, &_clss_all, &allowed,
+            0, 1, 1, 2);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+    CU_ASSERT_EQUAL(get_size(), 2);
+
+    status = uldb_addStripedSession(pid, 4, 6, &sockAddr, &_clss_all, &allowed,
+            0, 1, 2, 2);
+    CU_ASSERT_EQUAL(status, ULDB_ARG);
+    log_clear();
+
+    CU_ASSERT_EQUAL(uldb_removeSession(pid, 1), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(uldb_removeSession(pid, 3), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(get_size(), 0);
+}
+
+static void test_pace(void)
+{
+    int                 status;
+    struct sockaddr_in  sockAddr = new_sock_addr();
+    const pid_t         pid = getpid();
+    prod_class_t*       allowed;
+    double              delay;
+
+    clear();
+
+    status = uldb_addSession(pid, 1, 6, &sockAddr, &_clss_all, &allowed, 0, 1);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+    status = uldb_addSession(pid, 2, 6, &sockAddr, &_clss_all, &allowed, 1, 1);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    free_prod_class(allowed);
+
+    /* A full bucket doesn't delay */
+    status = uldb_pace(pid, 1, 1000, 1000, 0, &delay);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    CU_ASSERT_DOUBLE_EQUAL(delay, 0.0, 0.01);
+
+    /* The global bucket is shared */
+    status = uldb_pace(pid, 2, 1000, 1000, 0, &delay);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    CU_ASSERT_DOUBLE_EQUAL(delay, 1.0, 0.1);
+
+    /* Later reservations wait behind earlier ones */
+    status = uldb_pace(pid, 1, 500, 1000, 0, &delay);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    CU_ASSERT_DOUBLE_EQUAL(delay, 1.5, 0.1);
+
+    /* The session bucket applies even without a global limit */
+    status = uldb_pace(pid, 2, 4000, 0, 2000, &delay);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    CU_ASSERT_DOUBLE_EQUAL(delay, 1.0, 0.1);
+
+    status = uldb_pace(pid, 3, 1000, 1000, 0, &delay);
+    CU_ASSERT_EQUAL(status, ULDB_EXIST);
+    log_clear();
+
+    CU_ASSERT_EQUAL(uldb_remove(pid), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(get_size(), 0);
+}
+
+static void test_add_many_hosts(void)
+{
+    int                 status;
+    const pid_t         pid = getpid();
+    prod_class_t*       allowed;
+    struct sockaddr_in  sockAddrs[3*251];
+    const unsigned      numHosts = sizeof(sockAddrs)/sizeof(sockAddrs[0]);
+    unsigned            i;
+    uldb_Iter*          iter;
+    const uldb_Entry*   entry;
+
+    clear();
+
+    /* Many hosts whose addresses share hash-buckets */
+    for (i = 0; i < numHosts; i++) {
+        (void)memset(sockAddrs + i, 0, sizeof(sockAddrs[i]));
+        sockAddrs[i].sin_addr.s_addr = htonl(0x0a000000 + i);
+        status = uldb_addSession(pid, i + 1, 6, sockAddrs + i, &_clss_all,
+                &allowed, 0, 1);
+        CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+        free_prod_class(allowed);
+    }
+    CU_ASSERT_EQUAL(get_size(), numHosts);
+
+    /* A newer session obsoletes only the one to the same host */
+    for (i = 0; i < numHosts; i += 100) {
+        status = uldb_addSession(pid, numHosts + i + 1, 6, sockAddrs + i,
+                &_clss_all, &allowed, 0, 1);
+        CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+        free_prod_class(allowed);
+        CU_ASSERT_EQUAL(get_size(), numHosts);
+    }
+
+    status = uldb_getIterator(&iter);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    for (entry = uldb_iter_firstEntry(iter); entry != NULL;
+            entry = uldb_iter_nextEntry(iter)) {
+        const unsigned host = ntohl(
+                uldb_entry_getSockAddr(entry)->sin_addr.s_addr) - 0x0a000000;
+
+        CU_ASSERT_EQUAL(uldb_entry_getSession(entry),
+                host % 100 ? host + 1 : numHosts + host + 1);
+    }
+    uldb_iter_free(iter);
+
+    status = uldb_addSession(pid, 1 + 251, 6, sockAddrs, &_clss_all,
+            &allowed, 0, 1);
+    CU_ASSERT_EQUAL(status, ULDB_EXIST);
+    log_clear();
+
+    CU_ASSERT_EQUAL(uldb_removeSession(pid, 2), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(get_size(), numHosts - 1);
+    CU_ASSERT_EQUAL(uldb_remove(pid), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(get_size(), 0);
+}
+
+static void test_remove_and_reuse(void)
+{
+    int                 status;
+    const pid_t         pid = getpid();
+    prod_class_t*       allowed;
+    struct sockaddr_in  sockAddrs[2*251];
+    const unsigned      numHosts = sizeof(sockAddrs)/sizeof(sockAddrs[0]);
+    unsigned            i;
+    unsigned            count;
+    uldb_Iter*          iter;
+    const uldb_Entry*   entry;
+
+    clear();
+
+    for (i = 0; i < numHosts; i++) {
+        (void)memset(sockAddrs + i, 0, sizeof(sockAddrs[i]));
+        sockAddrs[i].sin_addr.s_addr = htonl(0x0a000000 + i);
+        status = uldb_addSession(pid, i + 1, 6, sockAddrs + i, &_clss_all,
+                &allowed, 0, 1);
+        CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+        free_prod_class(allowed);
+    }
+
+    /* Removed entries must vanish from lookups and iteration */
+    for (i = 0; i < numHosts; i += 2)
+        CU_ASSERT_EQUAL(uldb_removeSession(pid, i + 1), ULDB_SUCCESS);
+    CU_ASSERT_EQUAL(get_size(), numHosts / 2);
+    (void)uldb_removeSession(pid, 1);
+    log_clear();
+    CU_ASSERT_EQUAL(get_size(), numHosts / 2);
+
+    status = uldb_getIterator(&iter);
+    CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+    count = 0;
+    for (entry = uldb_iter_firstEntry(iter); entry != NULL;
+            entry = uldb_iter_nextEntry(iter)) {
+        CU_ASSERT_EQUAL(uldb_entry_getSession(entry) % 2, 0);
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, numHosts / 2);
+    uldb_iter_free(iter);
+
+    /* Additions reclaim the space of removed entries */
+    for (i = 0; i < numHosts; i += 2) {
+        status = uldb_addSession(pid, numHosts + i + 1, 6, sockAddrs + i,
+                &_clss_all, &allowed, 0, 1);
+        CU_ASSERT_EQUAL(status, ULDB_SUCCESS);
+        free_prod_class(allowed);
+    }
+    CU_ASSERT_EQUAL(get_size(), numHosts);
+
+    for (i = 0; i < numHosts; i++) {
+        const unsigned session = i % 2 ? i + 1 : numHosts + i + 1;
+
+        CU_ASSERT_EQUAL(uldb_removeSession(pid, session), ULDB_SUCCESS);
+    }
+    CU_ASSERT_EQUAL(get_size(), 0);
+}
+
 static int set_independent(
         const int   isNotifier1,
         const int   isNotifier2)
@@ -557,6 +793,11 @@ int main(
                            CU_ADD_TEST(testSuite, test_add_same_notifier) &&
                            CU_ADD_TEST(testSuite, test_add_dup_notifier) &&
                            CU_ADD_TEST(testSuite, test_add_feeder_and_notifier) &&
+                           CU_ADD_TEST(testSuite, test_add_sessions) &&
+                           CU_ADD_TEST(testSuite, test_add_stripes) &&
+                           CU_ADD_TEST(testSuite, test_pace) &&
+                           CU_ADD_TEST(testSuite, test_add_many_hosts) &&
+                           CU_ADD_TEST(testSuite, test_remove_and_reuse) &&
                            CU_ADD_TEST(testSuite, test_robustness))) {
                     CU_basic_set_mode(CU_BRM_VERBOSE);
                     (void) CU_basic_run_tests();
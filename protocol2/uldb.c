@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/time.h>
 
 /**
  * Parameters for creating the key for the shared-memory segment and read/write
@@ -43,6 +44,28 @@
 #define DEFAULT_KEY_PATH    getQueuePath()
 #define KEY_INDEX   1
 
+/**
+ * Parameters of bandwidth-pacing: the depth of a token-bucket in seconds of
+ * its rate and the interval over which the sending-rate of an entry is
+ * measured in seconds.
+ */
+#define BUCKET_DEPTH    1.0
+#define RATE_INTERVAL   10.0
+/**
+ * Number of seconds after its fair share of sending that an entry is no longer
+ * considered to be contending for the global rate.
+ */
+#define ACTIVE_INTERVAL 1.0
+/**
+ * Number of hash-buckets in each index of a segment. A prime so that
+ * consecutive IP addresses and PIDs spread evenly.
+ */
+#define NUM_BUCKETS     251
+/**
+ * Offset of a nonexistent entry in a hash-chain.
+ */
+#define NO_ENTRY        ((size_t)-1)
+
 const char* VALID_STRING = __FILE__;
 
 /**
@@ -74,19 +97,42 @@ struct uldb_Entry {
     size_t size; /* size of this structure in bytes */
     struct sockaddr_in sockAddr;
     pid_t pid;
+    unsigned session; /* session within the process or 0 if none */
     int protoVers;
     int isNotifier;
     int isPrimary;
+    unsigned stripe; /* stripe of the subscription that's sent */
+    unsigned stripeCount; /* number of stripes or 1 if not striped */
+    double tokens; /* level of the session's token-bucket in bytes */
+    double tokenTime; /* time of the last refill of the bucket or 0 */
+    double fairTime; /* end of the entry's fair share of sending or 0 */
+    double rate; /* sending-rate of the last interval in bytes/s */
+    double rateStart; /* start of the current interval or 0 */
+    double rateBytes; /* bytes sent during the current interval */
+    size_t hostNext; /* offset of next entry of same host-bucket or NO_ENTRY */
+    size_t pidNext; /* offset of next entry of same PID-bucket or NO_ENTRY */
+    int isRemoved; /* entry has been removed but its space not yet reclaimed? */
+    feedtypet feedtypes; /* union of the feedtypes of the subscription */
     EntryProdClass prodClass;
 };
 
 /**
- * The segment structure
+ * The segment structure. Entries are indexed by the IP address of the
+ * downstream host and by PID: each index is a hash-table whose chains link
+ * entries in the order of their offsets so that a chain can be traversed in
+ * the same order as the entries. A removed entry is only unlinked and marked;
+ * its space is reclaimed when the segment is compacted before an addition.
  */
 typedef struct {
     size_t entriesCapacity;
     size_t entriesSize;
+    size_t removedSize; /* bytes of removed entries not yet reclaimed */
     unsigned numEntries;
+    int isObsolete; /* segment has been replaced by a bigger one? */
+    double tokens; /* level of the global token-bucket in bytes */
+    double tokenTime; /* time of the last refill of the bucket or 0 */
+    size_t hostHeads[NUM_BUCKETS]; /* offsets of first entries by host */
+    size_t pidHeads[NUM_BUCKETS]; /* offsets of first entries by PID */
     uldb_Entry entries[1];
 } Segment;
 
@@ -183,6 +229,61 @@ static void cs_leave(
     (void)pthread_sigmask(SIG_SETMASK, origSigSet, NULL);
 }
 
+/**
+ * Returns the current time.
+ *
+ * @return              The current time in seconds since the epoch
+ */
+static double now(void)
+{
+    struct timeval tv;
+
+    (void)gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Reserves bytes from a token-bucket. A bucket is refilled at its rate up to
+ * its depth and may go into debt: the debt is the time the reserving process
+ * should wait before sending. Because later reservations queue behind the
+ * debt of earlier ones, processes that are contending for the bucket are
+ * served in turn.
+ *
+ * @param tokens        [in/out] Level of the bucket in bytes
+ * @param tokenTime     [in/out] Time of the last refill of the bucket or 0
+ * @param rate          [in] Rate of the bucket in bytes per second or 0 for
+ *                      an unlimited rate
+ * @param time          [in] The current time
+ * @param nbytes        [in] Number of bytes to reserve
+ * @return              The number of seconds to wait before sending
+ */
+static double bucket_reserve(
+        double* const   tokens,
+        double* const   tokenTime,
+        const double    rate,
+        const double    time,
+        const double    nbytes)
+{
+    if (0 >= rate)
+        return 0;
+
+    if (0 == *tokenTime) {
+        *tokens = rate * BUCKET_DEPTH;
+    }
+    else {
+        *tokens += (time - *tokenTime) * rate;
+
+        if (*tokens > rate * BUCKET_DEPTH)
+            *tokens = rate * BUCKET_DEPTH;
+    }
+
+    *tokenTime = time;
+    *tokens -= nbytes;
+
+    return 0 <= *tokens ? 0 : -*tokens / rate;
+}
+
 /**
  * Returns the smallest multiple of a base value that is greater than or equal
  * to another value.
@@ -599,19 +700,26 @@ static size_t entry_sizeof(
  *
  * @param[out] entry       Pointer to the entry.
  * @param[in]  pid         PID of the upstream LDM
+ * @param[in]  session     Session of the upstream LDM within its process or 0
+ *                         if the process serves a single downstream LDM
  * @param[in]  protoVers   Protocol version number (e.g., 5 or 6)
  * @param[in]  isNotifier  Type of the upstream LDM
  * @param[in]  isPrimary   Whether the upstream LDM is in primary transfer
  *                         mode or not
+ * @param[in]  stripe      Stripe of the subscription that's sent
+ * @param[in]  stripeCount Number of stripes of the subscription or 1
  * @param[in]  sockAddr    Socket Internet address of the downstream LDM
  * @param[in]  prodClass   Data-request of the downstream LDM
  */
 static void entry_init(
         uldb_Entry* const           entry,
         const pid_t                 pid,
+        const unsigned              session,
         const int                   protoVers,
         const int                   isNotifier,
         const int                   isPrimary,
+        const unsigned              stripe,
+        const unsigned              stripeCount,
         const struct sockaddr_in*   sockAddr,
         const prod_class* const     prodClass)
 {
@@ -621,9 +729,22 @@ static void entry_init(
 
     (void) memcpy(&entry->sockAddr, sockAddr, sizeof(*sockAddr));
     entry->pid = pid;
+    entry->session = session;
     entry->protoVers = protoVers;
     entry->isNotifier = isNotifier;
     entry->isPrimary = isPrimary;
+    entry->stripe = stripe;
+    entry->stripeCount = stripeCount;
+    entry->tokens = 0;
+    entry->tokenTime = 0;
+    entry->fairTime = 0;
+    entry->rate = 0;
+    entry->rateStart = 0;
+    entry->rateBytes = 0;
+    entry->hostNext = NO_ENTRY;
+    entry->pidNext = NO_ENTRY;
+    entry->isRemoved = 0;
+    entry->feedtypes = clss_feedtypeU(prodClass);
     entry->size = entry_sizeof_internal(epc_getSize(epc));
 }
 
@@ -639,6 +760,19 @@ static pid_t entry_getPid(
     return entry->pid;
 }
 
+/**
+ * Returns the session of an entry.
+ *
+ * @param entry     [in] Pointer to the entry
+ * @return          The session of the entry within its process or 0 if the
+ *                  process serves a single downstream LDM
+ */
+static unsigned entry_getSession(
+        const uldb_Entry* const entry)
+{
+    return entry->session;
+}
+
 /**
  * Returns the protocol version (e.g., 5 or 6) of an entry.
  *
@@ -692,6 +826,71 @@ static const struct sockaddr_in* entry_getSockAddr(
     return &entry->sockAddr;
 }
 
+/**
+ * Indicates if an entry is sending a different stripe of the same striping of
+ * a subscription than a given one. Such entries don't overlap even if their
+ * subscriptions do.
+ *
+ * @param entry         [in] Pointer to the entry
+ * @param stripe        [in] The given stripe
+ * @param stripeCount   [in] The number of stripes of the given striping or 1
+ * @retval 0            The stripes might overlap
+ * @retval 1            The stripes are disjoint
+ */
+static int entry_isOtherStripe(
+        const uldb_Entry* const entry,
+        const unsigned          stripe,
+        const unsigned          stripeCount)
+{
+    return stripeCount > 1 && entry->stripeCount == stripeCount &&
+            entry->stripe != stripe;
+}
+
+/**
+ * Accumulates bytes sent by the upstream LDM of an entry.
+ *
+ * @param entry         [in/out] Pointer to the entry
+ * @param time          [in] The current time
+ * @param nbytes        [in] Number of bytes sent
+ */
+static void entry_noteSent(
+        uldb_Entry* const entry,
+        const double      time,
+        const double      nbytes)
+{
+    if (0 == entry->rateStart)
+        entry->rateStart = time;
+
+    entry->rateBytes += nbytes;
+
+    if (time - entry->rateStart >= RATE_INTERVAL) {
+        entry->rate = entry->rateBytes / (time - entry->rateStart);
+        entry->rateStart = time;
+        entry->rateBytes = 0;
+    }
+}
+
+/**
+ * Returns the sending-rate of the upstream LDM of an entry. The rate of the
+ * current interval is used if no interval has completed or if the current one
+ * is overdue (e.g., because the upstream LDM has stopped sending).
+ *
+ * @param entry         [in] Pointer to the entry
+ * @return              The sending-rate in bytes per second
+ */
+static double entry_getRate(
+        const uldb_Entry* const entry)
+{
+    const double elapsed = now() - entry->rateStart;
+
+    if (0 == entry->rateStart || 0 >= elapsed)
+        return entry->rate;
+
+    return (0 < entry->rate && elapsed < 2 * RATE_INTERVAL)
+            ? entry->rate
+            : entry->rateBytes / elapsed;
+}
+
 #if 0
 /**
  * Returns an entry's product-class.
@@ -782,6 +981,23 @@ static int entry_isSubsetOf(
     return epc_isSubsetOf(&entry->prodClass, givenSub);
 }
 
+/**
+ * Indicates if the subscription of an entry might overlap a subscription with
+ * the given feedtypes. Entries whose feedtypes are disjoint from the given
+ * ones can be neither a subset of nor reduce such a subscription.
+ *
+ * @param entry         [in] Pointer to the entry
+ * @param feedtypes     [in] Union of the feedtypes of the given subscription
+ * @retval 0            The subscriptions can't overlap
+ * @retval 1            The subscriptions might overlap
+ */
+static int entry_mightOverlap(
+        const uldb_Entry* const entry,
+        const feedtypet         feedtypes)
+{
+    return 0 == entry->feedtypes || 0 != (entry->feedtypes & feedtypes);
+}
+
 /**
  * Removes an entry's subscription from a given subscription. The time-limits
  * of the subscriptions are ignored.
@@ -825,10 +1041,12 @@ static int entry_toString(
     }
     else {
         nbytes = snprintf(buf, size,
-                "(addr=%s, pid=%ld, vers=%d, type=%s, mode=%s, sub=(%s))",
+                "(addr=%s, pid=%ld, session=%u, vers=%d, type=%s, mode=%s, "
+                "stripe=%u/%u, rate=%.0f B/s, sub=(%s))",
                 inet_ntoa(entry->sockAddr.sin_addr), (long)entry->pid,
-                entry->protoVers, entry->isNotifier ? "notifier" : "feeder",
-                entry->isPrimary ? "primary" : "alternate",
+                entry->session, entry->protoVers, entry->isNotifier ? "notifier" : "feeder",
+                entry->isPrimary ? "primary" : "alternate", entry->stripe,
+                entry->stripeCount, entry_getRate(entry),
                 s_prod_class(NULL, 0, prodClass));
 
         free_prod_class(prodClass);
@@ -872,9 +1090,20 @@ static void seg_init(
         Segment* const segment,
         size_t nbytes)
 {
+    int i;
+
     segment->entriesCapacity = seg_entriesCapacity(nbytes);
     segment->entriesSize = 0;
+    segment->removedSize = 0;
     segment->numEntries = 0;
+    segment->isObsolete = 0;
+    segment->tokens = 0;
+    segment->tokenTime = 0;
+
+    for (i = 0; i < NUM_BUCKETS; i++) {
+        segment->hostHeads[i] = NO_ENTRY;
+        segment->pidHeads[i] = NO_ENTRY;
+    }
 }
 
 /**
@@ -929,7 +1158,12 @@ static uldb_Status seg_copy(
     else {
         (void) memmove(dest->entries, src->entries, src->entriesSize);
         dest->entriesSize = src->entriesSize;
+        dest->removedSize = src->removedSize;
         dest->numEntries = src->numEntries;
+        dest->tokens = src->tokens;
+        dest->tokenTime = src->tokenTime;
+        (void) memcpy(dest->hostHeads, src->hostHeads, sizeof(src->hostHeads));
+        (void) memcpy(dest->pidHeads, src->pidHeads, sizeof(src->pidHeads));
         status = ULDB_SUCCESS;
     }
 
@@ -985,27 +1219,27 @@ static void seg_free(
 }
 
 /**
- * Returns a pointer to the first entry in a segment.
+ * Returns a pointer to the first entry, removed or not, in a segment.
  *
  * @param segment       [in] Pointer to the segment
  * @retval NULL         No entries in the segment
  * @return              A pointer to the first entry in the segment
  */
-static const uldb_Entry* seg_firstEntry(
+static const uldb_Entry* seg_firstSlot(
         const Segment* const segment)
 {
     return segment->entriesSize == 0 ? NULL : segment->entries;
 }
 
 /**
- * Returns a pointer to the next entry in a segment.
+ * Returns a pointer to the next entry, removed or not, in a segment.
  *
  * @param segment       [in] Pointer to a segment
  * @param entry         [in] Pointer to an entry in the segment
  * @retval NULL         No more entries in the segment
  * @return              Pointer to the next entry
  */
-static const uldb_Entry* seg_nextEntry(
+static const uldb_Entry* seg_nextSlot(
         const Segment* const segment,
         const uldb_Entry* const entry)
 {
@@ -1016,6 +1250,44 @@ static const uldb_Entry* seg_nextEntry(
             NULL : nextEntry;
 }
 
+/**
+ * Returns a pointer to the first entry in a segment.
+ *
+ * @param segment       [in] Pointer to the segment
+ * @retval NULL         No entries in the segment
+ * @return              A pointer to the first entry in the segment
+ */
+static const uldb_Entry* seg_firstEntry(
+        const Segment* const segment)
+{
+    const uldb_Entry* entry = seg_firstSlot(segment);
+
+    while (NULL != entry && entry->isRemoved)
+        entry = seg_nextSlot(segment, entry);
+
+    return entry;
+}
+
+/**
+ * Returns a pointer to the next entry in a segment.
+ *
+ * @param segment       [in] Pointer to a segment
+ * @param entry         [in] Pointer to an entry in the segment
+ * @retval NULL         No more entries in the segment
+ * @return              Pointer to the next entry
+ */
+static const uldb_Entry* seg_nextEntry(
+        const Segment* const segment,
+        const uldb_Entry* const entry)
+{
+    const uldb_Entry* next = seg_nextSlot(segment, entry);
+
+    while (NULL != next && next->isRemoved)
+        next = seg_nextSlot(segment, next);
+
+    return next;
+}
+
 /**
  * Returns a pointer to the first unset entry in a segment.
  *
@@ -1028,6 +1300,328 @@ static uldb_Entry* seg_tailEntry(
     return (uldb_Entry*) (((char*) segment->entries) + segment->entriesSize);
 }
 
+/**
+ * Returns the hash-bucket of an IP address.
+ *
+ * @param sockAddr  [in] Socket Internet address
+ * @return          Index of the corresponding hash-bucket
+ */
+static unsigned seg_hostBucket(
+        const struct sockaddr_in* const sockAddr)
+{
+    return (unsigned)(ntohl(sockAddr->sin_addr.s_addr) % NUM_BUCKETS);
+}
+
+/**
+ * Returns the hash-bucket of a PID.
+ *
+ * @param pid       [in] PID
+ * @return          Index of the corresponding hash-bucket
+ */
+static unsigned seg_pidBucket(
+        const pid_t pid)
+{
+    return (unsigned)((unsigned long)pid % NUM_BUCKETS);
+}
+
+/**
+ * Returns the entry at an offset in a segment.
+ *
+ * @param segment   [in] Pointer to a segment
+ * @param offset    [in] Offset of the entry in bytes or NO_ENTRY
+ * @retval NULL     "offset" is NO_ENTRY
+ * @return          Pointer to the entry
+ */
+static uldb_Entry* seg_entryAt(
+        const Segment* const    segment,
+        const size_t            offset)
+{
+    return NO_ENTRY == offset
+            ? NULL
+            : (uldb_Entry*)((char*)segment->entries + offset);
+}
+
+/**
+ * Appends an entry to a hash-chain of a segment. The entry must follow every
+ * entry in the chain.
+ *
+ * @param segment   [in/out] Pointer to a segment
+ * @param head      [in/out] Pointer to the head of the chain
+ * @param member    [in] Offset of the link-member in an entry
+ * @param offset    [in] Offset of the entry to be appended
+ */
+static void seg_appendToChain(
+        Segment* const  segment,
+        size_t* const   head,
+        const size_t    member,
+        const size_t    offset)
+{
+    size_t* link = head;
+
+    while (NO_ENTRY != *link)
+        link = (size_t*)((char*)seg_entryAt(segment, *link) + member);
+
+    *link = offset;
+    *(size_t*)((char*)seg_entryAt(segment, offset) + member) = NO_ENTRY;
+}
+
+/**
+ * Adds an entry to the indexes of a segment. The entry must follow every
+ * indexed entry.
+ *
+ * @param segment   [in/out] Pointer to a segment
+ * @param entry     [in] Pointer to the entry in the segment
+ */
+static void seg_index(
+        Segment* const          segment,
+        const uldb_Entry* const entry)
+{
+    const size_t offset = (char*)entry - (char*)segment->entries;
+
+    seg_appendToChain(segment,
+            segment->hostHeads + seg_hostBucket(&entry->sockAddr),
+            offsetof(uldb_Entry, hostNext), offset);
+    seg_appendToChain(segment, segment->pidHeads + seg_pidBucket(entry->pid),
+            offsetof(uldb_Entry, pidNext), offset);
+}
+
+/**
+ * Rebuilds the indexes of a segment (e.g., after entries have been moved).
+ *
+ * @param segment   [in/out] Pointer to a segment
+ */
+static void seg_reindex(
+        Segment* const segment)
+{
+    size_t            hostTails[NUM_BUCKETS];
+    size_t            pidTails[NUM_BUCKETS];
+    const uldb_Entry* entry;
+    int               i;
+
+    for (i = 0; i < NUM_BUCKETS; i++) {
+        segment->hostHeads[i] = segment->pidHeads[i] = NO_ENTRY;
+        hostTails[i] = pidTails[i] = NO_ENTRY;
+    }
+
+    for (entry = seg_firstEntry(segment); NULL != entry;
+            entry = seg_nextEntry(segment, entry)) {
+        uldb_Entry* const e = (uldb_Entry*)entry; /* cast away const */
+        const size_t      offset = (char*)e - (char*)segment->entries;
+        const unsigned    hostBucket = seg_hostBucket(&e->sockAddr);
+        const unsigned    pidBucket = seg_pidBucket(e->pid);
+
+        if (NO_ENTRY == hostTails[hostBucket]) {
+            segment->hostHeads[hostBucket] = offset;
+        }
+        else {
+            seg_entryAt(segment, hostTails[hostBucket])->hostNext = offset;
+        }
+        if (NO_ENTRY == pidTails[pidBucket]) {
+            segment->pidHeads[pidBucket] = offset;
+        }
+        else {
+            seg_entryAt(segment, pidTails[pidBucket])->pidNext = offset;
+        }
+
+        e->hostNext = e->pidNext = NO_ENTRY;
+        hostTails[hostBucket] = pidTails[pidBucket] = offset;
+    }
+}
+
+/**
+ * Returns the first entry in a segment whose downstream host might have a
+ * given IP address.
+ *
+ * @param segment   [in] Pointer to a segment
+ * @param sockAddr  [in] Socket Internet address of the downstream host
+ * @retval NULL     No such entry
+ * @return          Pointer to the first such entry. The caller must still
+ *                  compare IP addresses.
+ */
+static const uldb_Entry* seg_firstHostEntry(
+        const Segment* const            segment,
+        const struct sockaddr_in* const sockAddr)
+{
+    return seg_entryAt(segment, segment->hostHeads[seg_hostBucket(sockAddr)]);
+}
+
+/**
+ * Returns the next entry in the host-chain of an entry.
+ *
+ * @param segment   [in] Pointer to a segment
+ * @param entry     [in] Pointer to an entry in the segment
+ * @retval NULL     No more entries in the chain
+ * @return          Pointer to the next entry in the chain
+ */
+static const uldb_Entry* seg_nextHostEntry(
+        const Segment* const    segment,
+        const uldb_Entry* const entry)
+{
+    return seg_entryAt(segment, entry->hostNext);
+}
+
+/**
+ * Returns the first entry of a process in a segment.
+ *
+ * @param segment   [in] Pointer to a segment
+ * @param pid       [in] PID of the process
+ * @retval NULL     No such entry
+ * @return          Pointer to the first entry of the process
+ */
+static const uldb_Entry* seg_firstPidEntry(
+        const Segment* const    segment,
+        const pid_t             pid)
+{
+    const uldb_Entry* entry;
+
+    for (entry = seg_entryAt(segment, segment->pidHeads[seg_pidBucket(pid)]);
+            NULL != entry && entry->pid != pid;
+            entry = seg_entryAt(segment, entry->pidNext))
+        ;
+
+    return entry;
+}
+
+/**
+ * Returns the next entry of the same process as a given entry.
+ *
+ * @param segment   [in] Pointer to a segment
+ * @param entry     [in] Pointer to an entry in the segment
+ * @retval NULL     No more entries of the process
+ * @return          Pointer to the next entry of the process
+ */
+static const uldb_Entry* seg_nextPidEntry(
+        const Segment* const    segment,
+        const uldb_Entry* const entry)
+{
+    const pid_t pid = entry->pid;
+    const uldb_Entry* next;
+
+    for (next = seg_entryAt(segment, entry->pidNext);
+            NULL != next && next->pid != pid;
+            next = seg_entryAt(segment, next->pidNext))
+        ;
+
+    return next;
+}
+
+/**
+ * Returns the entry of a session of a process in a segment.
+ *
+ * @param segment   [in] Pointer to a segment
+ * @param pid       [in] PID of the process
+ * @param session   [in] Session within the process or 0
+ * @retval NULL     No such entry
+ * @return          Pointer to the entry
+ */
+static const uldb_Entry* seg_findEntry(
+        const Segment* const    segment,
+        const pid_t             pid,
+        const unsigned          session)
+{
+    const uldb_Entry* entry;
+
+    for (entry = seg_firstPidEntry(segment, pid);
+            NULL != entry && entry->session != session;
+            entry = seg_nextPidEntry(segment, entry))
+        ;
+
+    return entry;
+}
+
+/**
+ * Unlinks an entry from a hash-chain of a segment.
+ *
+ * @param segment   [in/out] Pointer to a segment
+ * @param head      [in/out] Pointer to the head of the chain
+ * @param member    [in] Offset of the link-member in an entry
+ * @param offset    [in] Offset of the entry to be unlinked
+ */
+static void seg_unlinkFromChain(
+        Segment* const  segment,
+        size_t* const   head,
+        const size_t    member,
+        const size_t    offset)
+{
+    size_t* link = head;
+
+    while (NO_ENTRY != *link && offset != *link)
+        link = (size_t*)((char*)seg_entryAt(segment, *link) + member);
+
+    if (NO_ENTRY != *link)
+        *link = *(size_t*)((char*)seg_entryAt(segment, offset) + member);
+}
+
+/**
+ * Removes an entry from a segment. The entry is unlinked from the indexes and
+ * marked as removed; no other entry is moved, so pointers to them remain
+ * valid. The links of the removed entry are kept so that a traversal of a
+ * chain may continue from it.
+ *
+ * @param segment   [in/out] Pointer to a segment
+ * @param entry     [in] Pointer to an entry in the segment
+ */
+static void seg_removeEntry(
+        Segment* const          segment,
+        const uldb_Entry* const entry)
+{
+    uldb_Entry* const e = (uldb_Entry*)entry; /* cast away const */
+    const size_t      offset = (char*)e - (char*)segment->entries;
+
+    seg_unlinkFromChain(segment,
+            segment->hostHeads + seg_hostBucket(&e->sockAddr),
+            offsetof(uldb_Entry, hostNext), offset);
+    seg_unlinkFromChain(segment, segment->pidHeads + seg_pidBucket(e->pid),
+            offsetof(uldb_Entry, pidNext), offset);
+
+    e->isRemoved = 1;
+    segment->numEntries--;
+
+    if (0 == segment->numEntries) {
+        segment->entriesSize = 0;
+        segment->removedSize = 0;
+    }
+    else if (NULL == seg_nextSlot(segment, e)) {
+        segment->entriesSize -= e->size; /* last entry: reclaim at once */
+    }
+    else {
+        segment->removedSize += e->size;
+    }
+}
+
+/**
+ * Reclaims the space of removed entries by moving the remaining entries down
+ * and rebuilding the indexes. Invalidates pointers to entries.
+ *
+ * @param segment   [in/out] Pointer to a segment
+ */
+static void seg_compact(
+        Segment* const segment)
+{
+    if (0 < segment->removedSize) {
+        char*             dest = (char*)segment->entries;
+        const uldb_Entry* entry;
+        const uldb_Entry* next;
+
+        for (entry = seg_firstSlot(segment); NULL != entry; entry = next) {
+            const size_t size = entry->size;
+
+            next = seg_nextSlot(segment, entry);
+
+            if (!entry->isRemoved) {
+                if (dest != (const char*)entry)
+                    (void) memmove(dest, entry, size);
+                dest += size;
+            }
+        }
+
+        segment->entriesSize = dest - (char*)segment->entries;
+        segment->removedSize = 0;
+
+        seg_reindex(segment);
+    }
+}
+
 /**
  * Returns the number of entries in a shared-memory segment.
  *
@@ -1126,7 +1720,7 @@ static uldb_Status sm_attach(
 static uldb_Status sm_detach(
         SharedMemory* const sm)
 {
-    int status;
+    int status = ULDB_SUCCESS;
 
     if (NULL != sm->segment) {
         if (shmdt((void*)sm->segment)) {
@@ -1236,10 +1830,18 @@ static uldb_Status sm_deleteByKey(
         const key_t key)
 {
     SharedMemory sm;
-    int status = sm_init(&sm, key);
+    int status;
 
-    if (ULDB_SUCCESS == status)
-        status = sm_delete(&sm);
+    sm_clear(&sm);
+    sm.key = key;
+
+    if ((status = sm_attach(&sm)) == 0) {
+        /* Processes that have the segment attached will notice */
+        sm.segment->isObsolete = 1;
+
+        if ((status = sm_detach(&sm)) == 0)
+            status = sm_delete(&sm);
+    }
 
     return status;
 }
@@ -1348,7 +1950,18 @@ static uldb_Status sm_ensureSpaceForEntry(
 {
     int status;
     Segment* const segment = sm->segment;
-    const size_t neededCapacity = seg_getNeededCapacity(segment, size);
+    size_t neededCapacity = seg_getNeededCapacity(segment, size);
+
+    /*
+     * Removed entries are reclaimed in bulk so that removal doesn't move
+     * entries. Doing it when they occupy half the entries or the space is
+     * needed keeps the amortized cost of a removal constant.
+     */
+    if (neededCapacity > seg_getCapacity(segment) ||
+            segment->removedSize > segment->entriesSize / 2) {
+        seg_compact(segment);
+        neededCapacity = seg_getNeededCapacity(segment, size);
+    }
 
     if (neededCapacity <= seg_getCapacity(segment)) {
         status = ULDB_SUCCESS;
@@ -1360,6 +1973,9 @@ static uldb_Status sm_ensureSpaceForEntry(
             LOG_ADD0("Couldn't clone shared-memory segment");
         }
         else {
+            /* Processes that have the old segment attached will notice */
+            segment->isObsolete = 1;
+
             if ((status = sm_detach(sm)) != 0) {
                 LOG_ADD0("Couldn't detach old shared-memory");
             }
@@ -1392,30 +2008,38 @@ static uldb_Status sm_ensureSpaceForEntry(
  *
  * @param sm            [in/out] Pointer to the shared-memory structure
  * @param pid           [in] PID of the upstream LDM
+ * @param session       [in] Session of the upstream LDM or 0
  * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
  * @param isNotifier    [in] Type of the upstream LDM
  * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
  *                      mode or not
+ * @param stripe        [in] Stripe of the subscription that's sent
+ * @param stripeCount   [in] Number of stripes of the subscription or 1
  * @param sockAddr      [in] Socket Internet address of the downstream LDM
  * @param prodClass     [in] Data-request of the downstream LDM
  */
 static void sm_append(
         SharedMemory* const         sm,
         const pid_t                 pid,
+        const unsigned              session,
         const int                   protoVers,
         const int                   isNotifier,
         const int                   isPrimary,
+        const unsigned              stripe,
+        const unsigned              stripeCount,
         const struct sockaddr_in*   sockAddr,
         const prod_class* const     prodClass)
 {
     Segment* const      segment = sm->segment;
     uldb_Entry* const   entry = seg_tailEntry(segment);
 
-    entry_init(entry, pid, protoVers, isNotifier, isPrimary, sockAddr,
-            prodClass);
+    entry_init(entry, pid, session, protoVers, isNotifier, isPrimary, stripe,
+            stripeCount, sockAddr, prodClass);
 
     segment->entriesSize += entry_getSize(entry);
     segment->numEntries++;
+
+    seg_index(segment, entry);
 }
 
 /**
@@ -1424,10 +2048,13 @@ static void sm_append(
  *
  * @param sm            [in/out] Pointer to the shared-memory structure
  * @param pid           [in] PID of the upstream LDM
+ * @param session       [in] Session of the upstream LDM or 0
  * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
  * @param isNotifier    [in] Type of the upstream LDM
  * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
  *                      mode or not
+ * @param stripe        [in] Stripe of the subscription that's sent
+ * @param stripeCount   [in] Number of stripes of the subscription or 1
  * @param sockAddr      [in] Socket Internet address of the downstream LDM
  * @param prodClass     [in] Data-request of the downstream LDM
  * @retval ULDB_SUCCESS     Success
@@ -1436,9 +2063,12 @@ static void sm_append(
 static uldb_Status sm_addUpstreamLdm(
         SharedMemory* const sm,
         const pid_t pid,
+        const unsigned session,
         const int protoVers,
         const int isNotifier,
         const int isPrimary,
+        const unsigned stripe,
+        const unsigned stripeCount,
         const struct sockaddr_in* sockAddr,
         const prod_class* const prodClass)
 {
@@ -1449,7 +2079,8 @@ static uldb_Status sm_addUpstreamLdm(
         LOG_ADD0("Couldn't ensure sufficient shared-memory");
     }
     else {
-        sm_append(sm, pid, protoVers, isNotifier, isPrimary, sockAddr, prodClass);
+        sm_append(sm, pid, session, protoVers, isNotifier, isPrimary, stripe,
+                stripeCount, sockAddr, prodClass);
         status = ULDB_SUCCESS;
     }
 
@@ -1460,14 +2091,20 @@ static uldb_Status sm_addUpstreamLdm(
  * Vets a new upstream LDM. Reduces the subscription according to existing
  * subscriptions from the same downstream host and terminates every
  * previously-existing upstream LDM process that's feeding (not notifying) a
- * subset of the subscription to the same IP address.
+ * subset of the subscription to the same IP address. An obsolete session of a
+ * multi-session process isn't signaled: its entry is removed instead and the
+ * process is expected to notice (see uldb_getIterator()). Entries that send
+ * other stripes of the same striping are ignored.
  *
  * @param sm            [in/out] Pointer to shared-memory structure
  * @param myPid         [in] PID of the upstream LDM process
+ * @param mySession     [in] Session of the upstream LDM or 0
  * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
  * @param isNotifier    [in] Type of the upstream LDM process
  * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
  *                      mode or not
+ * @param stripe        [in] Stripe of the subscription that's sent
+ * @param stripeCount   [in] Number of stripes of the subscription or 1
  * @param sockAddr      [in] Socket Internet address of the downstream LDM
  * @param desired       [in] The subscription desired by the downstream LDM
  * @param allowed       [out] The allowed subscription. Equal to the desired
@@ -1476,45 +2113,70 @@ static uldb_Status sm_addUpstreamLdm(
  *                      client should free when it's no longer needed.
  * @retval 0            Success. "*allowed" is set. Might specify an empty
  *                      subscription.
- * @retval ULDB_EXIST   Entry for PID already exists. log_add() called.
+ * @retval ULDB_EXIST   Entry for PID and session already exists. log_add()
+ *                      called.
  * @retval ULDB_SYSTEM  System error. log_add() called.
  */
 static uldb_Status sm_vetUpstreamLdm(
     SharedMemory* const restrict       sm,
     const pid_t                        myPid,
+    const unsigned                     mySession,
     const int                          protoVers,
     const int                          isNotifier,
     const int                          isPrimary,
+    const unsigned                     stripe,
+    const unsigned                     stripeCount,
     const struct sockaddr_in* restrict sockAddr,
     const prod_class* const restrict   desired,
     prod_class** const restrict        allowed)
 {
     int                  status = 0; /* success */
-    const Segment* const segment = sm->segment;
+    Segment* const       segment = sm->segment;
     const uldb_Entry*    entry;
+    const uldb_Entry*    nextEntry;
     prod_class_t*        allow = dup_prod_class(desired);
 
     if (NULL == allow) {
         LOG_ADD0("Couldn't duplicate desired subscription");
         status = ULDB_SYSTEM;
     }
+    else if (seg_findEntry(segment, myPid, mySession) != NULL) {
+        if (mySession) {
+            LOG_ADD2("Entry already exists for PID %ld, session %u",
+                    myPid, mySession);
+        }
+        else {
+            LOG_ADD1("Entry already exists for PID %ld", myPid);
+        }
+        status = ULDB_EXIST;
+        free_prod_class(allow);
+    }
     else {
-        for (entry = seg_firstEntry(segment); entry != NULL ; entry =
-                seg_nextEntry(segment, entry)) {
-            if (myPid == entry->pid) {
-                LOG_ADD1("Entry already exists for PID %ld", myPid);
-                status = ULDB_EXIST;
-                break;
-            }
+        const feedtypet feedtypes = clss_feedtypeU(allow);
+
+        /*
+         * Only the entries of the downstream host's hash-chain are examined.
+         */
+        for (entry = isNotifier ? NULL : seg_firstHostEntry(segment, sockAddr);
+                entry != NULL; entry = nextEntry) {
+            nextEntry = seg_nextHostEntry(segment, entry);
 
             if (ipAddressesAreEqual(sockAddr, entry_getSockAddr(entry))
-                    && !isNotifier && !entry_isNotifier(entry)) {
+                    && !entry_isNotifier(entry)
+                    && !entry_isOtherStripe(entry, stripe, stripeCount)
+                    && entry_mightOverlap(entry, feedtypes)) {
                 if (entry_isSubsetOf(entry, allow)) {
                     char    buf[1024];
 
                     (void)entry_toString(entry, buf, sizeof(buf));
 
-                    if (kill(entry_getPid(entry), SIGTERM)) {
+                    if (entry_getSession(entry)) {
+                        seg_removeEntry(segment, entry);
+                        LOG_ADD1("Terminated obsolete upstream LDM session %s",
+                            buf);
+                        log_log(LOG_NOTICE);
+                    }
+                    else if (kill(entry_getPid(entry), SIGTERM)) {
                         LOG_SERROR1("Couldn't terminate obsolete upstream LDM %s",
                             buf);
                         log_log(LOG_WARNING);
@@ -1533,12 +2195,7 @@ static uldb_Status sm_vetUpstreamLdm(
             } /* upstream LDM matches entry */
         } /* entry loop */
 
-        if (status) {
-            free_prod_class(allow);
-        }
-        else {
-            *allowed = allow;
-        }
+        *allowed = allow;
     } /* "allow" allocated */
 
     return status;
@@ -1553,10 +2210,13 @@ static uldb_Status sm_vetUpstreamLdm(
  *
  * @param sm            [in/out] Pointer to shared-memory structure
  * @param pid           [in] PID of the upstream LDM process
+ * @param session       [in] Session of the upstream LDM or 0
  * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
  * @param isNotifier    [in] Type of the upstream LDM process
  * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
  *                      mode or not
+ * @param stripe        [in] Stripe of the subscription that's sent
+ * @param stripeCount   [in] Number of stripes of the subscription or 1
  * @param sockAddr      [in] Socket Internet address of the downstream LDM
  * @param desired       [in] The subscription desired by the downstream LDM
  * @param allowed       [out] The allowed subscription. Equal to the desired
@@ -1573,9 +2233,12 @@ static uldb_Status sm_vetUpstreamLdm(
 static uldb_Status sm_add(
     SharedMemory* const restrict       sm,
     const pid_t                        pid,
+    const unsigned                     session,
     const int                          protoVers,
     const int                          isNotifier,
     const int                          isPrimary,
+    const unsigned                     stripe,
+    const unsigned                     stripeCount,
     const struct sockaddr_in* restrict sockAddr,
     const prod_class* const restrict   desired,
     prod_class** const restrict        allowed)
@@ -1584,8 +2247,8 @@ static uldb_Status sm_add(
     prod_class* sub;
 
     if (isAntiDosEnabled()) {
-        status = sm_vetUpstreamLdm(sm, pid, protoVers, isNotifier, isPrimary,
-                sockAddr, desired, &sub);
+        status = sm_vetUpstreamLdm(sm, pid, session, protoVers, isNotifier,
+                isPrimary, stripe, stripeCount, sockAddr, desired, &sub);
     }
     else {
         if ((sub = dup_prod_class(desired)) == NULL) {
@@ -1599,8 +2262,9 @@ static uldb_Status sm_add(
 
     if (0 == status) {
         if (0 < sub->psa.psa_len) {
-            if ((status = sm_addUpstreamLdm(sm, pid, protoVers, isNotifier,
-                    isPrimary, sockAddr, sub)) != 0) {
+            if ((status = sm_addUpstreamLdm(sm, pid, session, protoVers,
+                    isNotifier, isPrimary, stripe, stripeCount, sockAddr,
+                    sub)) != 0) {
                 LOG_ADD1("Couldn't add request from %s",
                         inet_ntoa(sockAddr->sin_addr));
             }
@@ -1618,49 +2282,125 @@ static uldb_Status sm_add(
 }
 
 /**
- * Removes a PID from the shared-memory.
+ * Removes a PID or one of its sessions from the shared-memory.
  *
  * @param sm            [in/out] Pointer to the shared-memory structure
  * @param pid           [in] PID to be removed
+ * @param session       [in] Session to be removed or 0, in which case every
+ *                      entry of the PID is removed
  * @retval ULDB_SUCCESS Success
  * @retval ULDB_EXIST   No corresponding entry found. log_add() called.
  * @retVal ULDB_SYSTEM  System error. log_add() called.
  */
 static uldb_Status sm_remove(
         SharedMemory* const sm,
-        const pid_t pid)
+        const pid_t pid,
+        const unsigned session)
 {
-    int status;
+    int status = ULDB_EXIST;
     Segment* const segment = sm->segment;
     const uldb_Entry* entry;
 
-    for (entry = seg_firstEntry(segment); NULL != entry;
-            entry = seg_nextEntry(segment, entry)) {
-        if (entry->pid == pid)
-            break;
+    if (session) {
+        if ((entry = seg_findEntry(segment, pid, session)) != NULL) {
+            seg_removeEntry(segment, entry);
+            status = ULDB_SUCCESS;
+        }
     }
+    else {
+        const uldb_Entry* next;
 
-    if (NULL == entry) {
-        LOG_ADD1("Entry for PID %d not found", pid);
-        status = ULDB_EXIST;
+        /* A removed entry keeps its links; so, the chain can be followed */
+        for (entry = seg_firstPidEntry(segment, pid); NULL != entry;
+                entry = next) {
+            next = seg_nextPidEntry(segment, entry);
+            seg_removeEntry(segment, entry);
+            status = ULDB_SUCCESS;
+        }
+    }
+
+    if (status) {
+        if (session) {
+            LOG_ADD2("Entry for PID %d, session %u not found", pid, session);
+        }
+        else {
+            LOG_ADD1("Entry for PID %d not found", pid);
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Reserves bandwidth for a session of an upstream LDM process and accumulates
+ * the bytes in the session's sending-rate. Three limits apply: the global
+ * token-bucket, the session's token-bucket, and the session's fair share of
+ * the global rate (i.e., the global rate divided by the number of sessions
+ * that are contending for it). The last ensures that a session that sends
+ * large data-products doesn't get more than one that sends small ones.
+ *
+ * @param sm            [in/out] Pointer to the shared-memory structure
+ * @param pid           [in] PID of the upstream LDM process
+ * @param session       [in] Session within the process or 0
+ * @param nbytes        [in] Number of bytes to be sent
+ * @param maxRate       [in] Global rate-limit in bytes per second or 0
+ * @param sessionRate   [in] Rate-limit of the session in bytes per second or 0
+ * @param delay         [out] Number of seconds to wait before sending
+ * @retval ULDB_SUCCESS Success
+ * @retval ULDB_EXIST   No corresponding entry found. log_add() called.
+ */
+static uldb_Status sm_pace(
+        SharedMemory* const sm,
+        const pid_t         pid,
+        const unsigned      session,
+        const size_t        nbytes,
+        const unsigned long maxRate,
+        const unsigned long sessionRate,
+        double* const       delay)
+{
+    Segment* const    segment = sm->segment;
+    const double      time = now();
+    const uldb_Entry* entry;
+    uldb_Entry*       self = NULL;
+    unsigned          numActive = 0;
+
+    self = (uldb_Entry*)seg_findEntry(segment, pid, session); /* cast away const */
+
+    if (NULL == self) {
+        LOG_ADD2("Entry for PID %d, session %u not found", pid, session);
+        return ULDB_EXIST;
     }
     else {
-        unsigned entrySize = entry->size;
-        const uldb_Entry* const nextEntry = seg_nextEntry(segment, entry);
+        if (0 < maxRate) {
+            for (entry = seg_firstEntry(segment); NULL != entry;
+                    entry = seg_nextEntry(segment, entry)) {
+                if (entry != self && entry->fairTime >= time - ACTIVE_INTERVAL)
+                    numActive++;
+            }
+        }
 
-        if (NULL != nextEntry) {
-            const uldb_Entry* const tail = seg_tailEntry(segment);
+        double globalDelay = bucket_reserve(&segment->tokens,
+                &segment->tokenTime, maxRate, time, nbytes);
+        double sessionDelay = bucket_reserve(&self->tokens, &self->tokenTime,
+                sessionRate, time, nbytes);
 
-            (void) memmove((void*) entry, nextEntry,
-                    (char*) tail - (char*) nextEntry);
+        if (0 < maxRate) {
+            const double start = self->fairTime > time
+                    ? self->fairTime
+                    : time;
+
+            self->fairTime = start + nbytes * (numActive + 1.0) / maxRate;
+
+            if (start - time > globalDelay)
+                globalDelay = start - time;
         }
 
-        segment->entriesSize -= entrySize;
-        segment->numEntries--;
-        status = ULDB_SUCCESS;
+        entry_noteSent(self, time, nbytes);
+
+        *delay = globalDelay > sessionDelay ? globalDelay : sessionDelay;
     }
 
-    return status;
+    return ULDB_SUCCESS;
 }
 
 /**
@@ -1715,7 +2455,9 @@ static uldb_Status db_verifyClosed(
 
 /**
  * Locks a database. Upon successful return, the client should call db_unlock()
- * when done accessing the database.
+ * when done accessing the database. The shared-memory segment stays attached
+ * between locks and is only reattached if it has been replaced (e.g., by a
+ * bigger one) so that an uncontended lock costs no shared-memory system-calls.
  *
  * @param db                [in/out]  Pointer to a database structure
  * @param forWriting        [in] Prepare for writing or reading?
@@ -1743,10 +2485,19 @@ static uldb_Status db_lock(
             status = ULDB_SYSTEM;
         }
         else {
-            if ((status = sm_attach(&db->sharedMemory)) != 0) {
+            SharedMemory* const sm = &db->sharedMemory;
+
+            if (NULL != sm->segment && sm->segment->isObsolete
+                    && (status = sm_detach(sm)) != 0) {
+                LOG_ADD0("Couldn't detach obsolete shared-memory");
+            }
+            else if (NULL == sm->segment
+                    && (status = sm_attach(sm)) != 0) {
                 LOG_ADD0("Couldn't attach shared-memory");
-                (void) srwl_unlock(db->lock);
             }
+
+            if (status)
+                (void) srwl_unlock(db->lock);
         } /* lock is locked */
     }
 
@@ -1791,12 +2542,9 @@ static uldb_Status db_writeLock(
 static uldb_Status db_unlock(
         Database* const db)
 {
-    int status = sm_detach(&db->sharedMemory);
+    int status = ULDB_SUCCESS;
 
-    if (status) {
-        LOG_ADD0("Couldn't detach shared-memory");
-    }
-    else if (srwl_unlock(db->lock)) {
+    if (srwl_unlock(db->lock)) {
         LOG_ADD0("Couldn't unlock database");
 
         status = ULDB_SYSTEM;
@@ -1987,6 +2735,10 @@ uldb_Status uldb_close(
     if (status) {
         LOG_ADD0("Database is not open");
     }
+    else if (sm_detach(&database.sharedMemory)) {
+        LOG_ADD0("Couldn't detach shared-memory component");
+        status = ULDB_SYSTEM;
+    }
     else if (srwl_free(database.lock)) {
         LOG_ADD0("Couldn't free lock component");
         status = ULDB_SYSTEM;
@@ -2018,6 +2770,8 @@ uldb_Status uldb_delete(
 
     uldb_ensureModuleInitialized();
 
+    (void) sm_detach(&database.sharedMemory);
+
     status = uldb_getKey(path, &key);
 
     if (status) {
@@ -2039,13 +2793,13 @@ uldb_Status uldb_delete(
             if (lockStatus) {
                 if (RWL_EXIST != lockStatus) {
                     LOG_ADD0(
-                            "Couldn't delete existing semaphore-based read/write lock by IPC key");
+                            "Couldn't delete existing read/write lock by IPC key");
 
                     status = ULDB_SYSTEM;
                 }
                 else {
                     LOG_ADD0(
-                            "Semaphore-based read/write lock doesn't exist");
+                            "Read/write lock doesn't exist");
 
                     if (ULDB_SUCCESS == status)
                         status = ULDB_EXIST;
@@ -2089,14 +2843,18 @@ uldb_Status uldb_getSize(
 }
 
 /**
- * Adds an upstream LDM process to the database, if appropriate. This is a
- * potentially lengthy process. Most signals are blocked while this function
- * operates. Reduces the subscription according to existing subscriptions from
- * the same downstream host and terminates every previously-existing upstream
- * LDM process that's feeding (not notifying) a subset of the subscription to
- * the same IP address.
+ * Adds a session of an upstream LDM process to the database, if appropriate.
+ * A process that serves many downstream LDMs (e.g., an upstream LDM hub) adds
+ * one session per downstream LDM. This is a potentially lengthy process. Most
+ * signals are blocked while this function operates. Reduces the subscription
+ * according to existing subscriptions from the same downstream host and
+ * terminates every previously-existing upstream LDM process or session that's
+ * feeding (not notifying) a subset of the subscription to the same IP address.
+ * Other stripes of the same striping of a subscription don't overlap.
  *
  * @param pid           [in] PID of upstream LDM process
+ * @param session       [in] Session of the upstream LDM within the process or
+ *                      0 if the process serves a single downstream LDM
  * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
  * @param sockAddr      [in] Socket Internet address of downstream LDM
  * @param desired       [in] The subscription desired by the downstream LDM
@@ -2109,23 +2867,31 @@ uldb_Status uldb_getSize(
  * @param isNotifier    [in] Whether the upstream LDM is a notifier or a feeder
  * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
  *                      mode or not
+ * @param stripe        [in] Stripe of the subscription that's sent. Shall be
+ *                      less than "stripeCount".
+ * @param stripeCount   [in] Number of stripes into which the downstream LDM
+ *                      has divided the subscription or 1 if it hasn't.
  * @retval 0            Success. "*allowed" is set. The database is unmodified,
  *                      however, if the allowed subscription is the empty set.
  *                      The client should call "free_prod_class(*allowed)" when
  *                      the allowed subscription is no longer needed.
  * @retval ULDB_INIT    Module not initialized. log_add() called.
- * @retval ULDB_ARG     Invalid PID. log_add() called.
- * @retval ULDB_EXIST   Entry for PID already exists. log_add() called.
+ * @retval ULDB_ARG     Invalid PID or stripe. log_add() called.
+ * @retval ULDB_EXIST   Entry for PID and session already exists. log_add()
+ *                      called.
  * @retval ULDB_SYSTEM  System error. log_add() called.
  */
-uldb_Status uldb_addProcess(
+uldb_Status uldb_addStripedSession(
     const pid_t                              pid,
+    const unsigned                           session,
     const int                                protoVers,
     const struct sockaddr_in* const restrict sockAddr,
     const prod_class* const restrict         desired,
     prod_class** const restrict              allowed,
     const int                                isNotifier,
-    const int                                isPrimary)
+    const int                                isPrimary,
+    const unsigned                           stripe,
+    const unsigned                           stripeCount)
 {
     int status;
 
@@ -2133,6 +2899,10 @@ uldb_Status uldb_addProcess(
         LOG_ADD1("Invalid PID: %ld", (long)pid);
         status = ULDB_ARG;
     }
+    else if (0 == stripeCount || stripe >= stripeCount) {
+        LOG_ADD2("Invalid stripe: %u/%u", stripe, stripeCount);
+        status = ULDB_ARG;
+    }
     else {
         sigset_t    origSigSet;
 
@@ -2145,8 +2915,9 @@ uldb_Status uldb_addProcess(
         else {
             prod_class* sub = NULL;
 
-            status = sm_add(&database.sharedMemory, pid, protoVers,
-                    isNotifier, isPrimary, sockAddr, desired, &sub);
+            status = sm_add(&database.sharedMemory, pid, session, protoVers,
+                    isNotifier, isPrimary, stripe, stripeCount, sockAddr,
+                    desired, &sub);
 
             if (db_unlock(&database)) {
                 LOG_ADD0("Couldn't unlock database");
@@ -2168,18 +2939,112 @@ uldb_Status uldb_addProcess(
 }
 
 /**
- * Removes an entry. This is a potentially lengthy operation. Most signals
- * are blocked while this function operates.
+ * Adds a session of an upstream LDM process to the database, if appropriate.
+ * A process that serves many downstream LDMs (e.g., an upstream LDM hub) adds
+ * one session per downstream LDM. This is a potentially lengthy process. Most
+ * signals are blocked while this function operates. Reduces the subscription
+ * according to existing subscriptions from the same downstream host and
+ * terminates every previously-existing upstream LDM process or session that's
+ * feeding (not notifying) a subset of the subscription to the same IP address.
+ *
+ * @param pid           [in] PID of upstream LDM process
+ * @param session       [in] Session of the upstream LDM within the process or
+ *                      0 if the process serves a single downstream LDM
+ * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
+ * @param sockAddr      [in] Socket Internet address of downstream LDM
+ * @param desired       [in] The subscription desired by the downstream LDM
+ * @param allowed       [out] The allowed subscription. Equal to the desired
+ *                      subscription reduced by existing subscriptions from the
+ *                      same host. Might specify an empty subscription. Upon
+ *                      successful return, the client should call
+ *                      "free_prod_class(*allowed)" when the allowed
+ *                      subscription is no longer needed.
+ * @param isNotifier    [in] Whether the upstream LDM is a notifier or a feeder
+ * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
+ *                      mode or not
+ * @retval 0            Success. "*allowed" is set. The database is unmodified,
+ *                      however, if the allowed subscription is the empty set.
+ *                      The client should call "free_prod_class(*allowed)" when
+ *                      the allowed subscription is no longer needed.
+ * @retval ULDB_INIT    Module not initialized. log_add() called.
+ * @retval ULDB_ARG     Invalid PID. log_add() called.
+ * @retval ULDB_EXIST   Entry for PID and session already exists. log_add()
+ *                      called.
+ * @retval ULDB_SYSTEM  System error. log_add() called.
+ */
+uldb_Status uldb_addSession(
+    const pid_t                              pid,
+    const unsigned                           session,
+    const int                                protoVers,
+    const struct sockaddr_in* const restrict sockAddr,
+    const prod_class* const restrict         desired,
+    prod_class** const restrict              allowed,
+    const int                                isNotifier,
+    const int                                isPrimary)
+{
+    return uldb_addStripedSession(pid, session, protoVers, sockAddr, desired,
+            allowed, isNotifier, isPrimary, 0, 1);
+}
+
+/**
+ * Adds an upstream LDM process to the database, if appropriate. This is a
+ * potentially lengthy process. Most signals are blocked while this function
+ * operates. Reduces the subscription according to existing subscriptions from
+ * the same downstream host and terminates every previously-existing upstream
+ * LDM process that's feeding (not notifying) a subset of the subscription to
+ * the same IP address.
+ *
+ * @param pid           [in] PID of upstream LDM process
+ * @param protoVers     [in] Protocol version number (e.g., 5 or 6)
+ * @param sockAddr      [in] Socket Internet address of downstream LDM
+ * @param desired       [in] The subscription desired by the downstream LDM
+ * @param allowed       [out] The allowed subscription. Equal to the desired
+ *                      subscription reduced by existing subscriptions from the
+ *                      same host. Might specify an empty subscription. Upon
+ *                      successful return, the client should call
+ *                      "free_prod_class(*allowed)" when the allowed
+ *                      subscription is no longer needed.
+ * @param isNotifier    [in] Whether the upstream LDM is a notifier or a feeder
+ * @param isPrimary     [in] Whether the upstream LDM is in primary transfer
+ *                      mode or not
+ * @retval 0            Success. "*allowed" is set. The database is unmodified,
+ *                      however, if the allowed subscription is the empty set.
+ *                      The client should call "free_prod_class(*allowed)" when
+ *                      the allowed subscription is no longer needed.
+ * @retval ULDB_INIT    Module not initialized. log_add() called.
+ * @retval ULDB_ARG     Invalid PID. log_add() called.
+ * @retval ULDB_EXIST   Entry for PID already exists. log_add() called.
+ * @retval ULDB_SYSTEM  System error. log_add() called.
+ */
+uldb_Status uldb_addProcess(
+    const pid_t                              pid,
+    const int                                protoVers,
+    const struct sockaddr_in* const restrict sockAddr,
+    const prod_class* const restrict         desired,
+    prod_class** const restrict              allowed,
+    const int                                isNotifier,
+    const int                                isPrimary)
+{
+    return uldb_addSession(pid, 0, protoVers, sockAddr, desired, allowed,
+            isNotifier, isPrimary);
+}
+
+/**
+ * Removes a session of an upstream LDM process. This is a potentially lengthy
+ * operation. Most signals are blocked while this function operates.
  *
  * @param pid                [in] PID of upstream LDM process
+ * @param session            [in] Session within the process or 0, in which
+ *                           case every entry of the process is removed
  * @retval ULDB_SUCCESS      Success. Corresponding entry found and removed.
  * @retval ULDB_INIT         Module not initialized. log_add() called.
  * @retval ULDB_ARG          Invalid PID. log_add() called.
  * @retval ULDB_EXIST        No corresponding entry found. log_add() called.
  * @retval ULDB_SYSTEM       System error. See "errno". log_add() called.
  */
-uldb_Status uldb_remove(
-        const pid_t pid)
+uldb_Status uldb_removeSession(
+        const pid_t    pid,
+        const unsigned session)
 {
     int status;
 
@@ -2197,7 +3062,8 @@ uldb_Status uldb_remove(
             LOG_ADD0("Couldn't lock database");
         }
         else {
-            if ((status = sm_remove(&database.sharedMemory, pid)) != 0) {
+            if ((status = sm_remove(&database.sharedMemory, pid, session))
+                    != 0) {
                 LOG_ADD0("Couldn't remove process from database");
             }
 
@@ -2215,6 +3081,81 @@ uldb_Status uldb_remove(
     return status;
 }
 
+/**
+ * Removes an entry. Every session of a multi-session process is removed. This
+ * is a potentially lengthy operation. Most signals are blocked while this
+ * function operates.
+ *
+ * @param pid                [in] PID of upstream LDM process
+ * @retval ULDB_SUCCESS      Success. Corresponding entry found and removed.
+ * @retval ULDB_INIT         Module not initialized. log_add() called.
+ * @retval ULDB_ARG          Invalid PID. log_add() called.
+ * @retval ULDB_EXIST        No corresponding entry found. log_add() called.
+ * @retval ULDB_SYSTEM       System error. See "errno". log_add() called.
+ */
+uldb_Status uldb_remove(
+        const pid_t pid)
+{
+    return uldb_removeSession(pid, 0);
+}
+
+/**
+ * Reserves bandwidth for sending data to the downstream LDM of a session of an
+ * upstream LDM process. All upstream LDM processes share a global
+ * token-bucket; each session also has its own. A bucket that's overdrawn
+ * yields a delay. While several sessions are contending for the global rate,
+ * each is also delayed so that it gets no more than an equal share. The bytes
+ * are also accumulated in the session's sending-rate even if neither rate is
+ * limited.
+ *
+ * @param pid                [in] PID of the upstream LDM process
+ * @param session            [in] Session within the process or 0
+ * @param nbytes             [in] Number of bytes to be sent
+ * @param maxRate            [in] Global rate-limit in bytes per second or 0
+ *                           for no limit
+ * @param sessionRate        [in] Rate-limit of the session in bytes per second
+ *                           or 0 for no limit
+ * @param delay              [out] Number of seconds that the caller should
+ *                           wait before sending the bytes
+ * @retval ULDB_SUCCESS      Success. "*delay" is set.
+ * @retval ULDB_INIT         Module not initialized. log_add() called.
+ * @retval ULDB_EXIST        No corresponding entry found. log_add() called.
+ * @retval ULDB_SYSTEM       System error. See "errno". log_add() called.
+ */
+uldb_Status uldb_pace(
+        const pid_t         pid,
+        const unsigned      session,
+        const size_t        nbytes,
+        const unsigned long maxRate,
+        const unsigned long sessionRate,
+        double* const       delay)
+{
+    int      status;
+    sigset_t origSigSet;
+
+    uldb_ensureModuleInitialized();
+    cs_enter(&origSigSet);
+
+    if ((status = db_writeLock(&database)) != 0) {
+        LOG_ADD0("Couldn't lock database");
+    }
+    else {
+        status = sm_pace(&database.sharedMemory, pid, session, nbytes,
+                maxRate, sessionRate, delay);
+
+        if (db_unlock(&database)) {
+            LOG_ADD0("Couldn't unlock database");
+
+            if (ULDB_SUCCESS == status)
+                status = ULDB_SYSTEM;
+        }
+    } /* database is locked */
+
+    cs_leave(&origSigSet);
+
+    return status;
+}
+
 /**
  * Locks the upstream LDM database for reading. The caller should call
  * `uldb_unlock()` when the lock is no longer needed.
@@ -2365,6 +3306,19 @@ pid_t uldb_entry_getPid(
     return entry_getPid(entry);
 }
 
+/**
+ * Returns the session of an entry.
+ *
+ * @param entry     Pointer to the entry
+ * @return          The session of the entry within its process or 0 if the
+ *                  process serves a single downstream LDM
+ */
+unsigned uldb_entry_getSession(
+        const uldb_Entry* const entry)
+{
+    return entry_getSession(entry);
+}
+
 /**
  * Returns the protocol version (e.g., 5 or 6) of an entry.
  *
@@ -2419,6 +3373,19 @@ const struct sockaddr_in* uldb_entry_getSockAddr(
     return entry_getSockAddr(entry);
 }
 
+/**
+ * Returns the rate at which the upstream LDM of an entry is sending to its
+ * downstream LDM.
+ *
+ * @param entry     Pointer to the entry
+ * @return          The sending-rate in bytes per second
+ */
+double uldb_entry_getRate(
+        const uldb_Entry* const entry)
+{
+    return entry_getRate(entry);
+}
+
 /**
  * Returns the product-class of an entry.
  *
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Benchmark of the rate at which downstream LDM-s can connect to an upstream
+ * LDM server as a function of the number of upstream LDM-s that are already
+ * in the upstream LDM database (see uldb.h).  Several processes concurrently
+ * simulate connections: each adds a session to the database (which vets it
+ * against the existing sessions of the same downstream host), paces a few
+ * data-products, and removes the session.
+ *
+ * Usage: uldb_bench [-v] [-n entries] [-H hosts] [-p procs] [-c conns]
+ *                   [-P paces] [-d dir]
+ *
+ *     -v          Verbose logging.
+ *     -n entries  Maximum number of existing entries (default 1000).  The
+ *                 benchmark is run for 10, 100, ... up to this number.
+ *     -H hosts    Number of downstream hosts (default 100).
+ *     -p procs    Number of connecting processes (default 4).
+ *     -c conns    Number of connections per process (default 2000).
+ *     -P paces    Number of data-products paced per connection (default 10).
+ *     -d dir      Directory for the file that keys the database (default
+ *                 /tmp).
+ */
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "globals.h"
+#include "ldm.h"
+#include "log.h"
+#include "prod_class.h"
+#include "uldb.h"
+#include "ulog.h"
+
+#define MAX_PROCS       64
+
+/*
+ * Returns the socket Internet address of a simulated downstream host.
+ */
+static struct sockaddr_in
+hostAddr(
+    const unsigned      host)
+{
+    struct sockaddr_in  addr;
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(0x0a000000 + host);
+
+    return addr;
+}
+
+/*
+ * Returns the current time in seconds.
+ */
+static double
+now(void)
+{
+    struct timeval      tv;
+
+    (void)gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Adds the existing entries to the database.  Each has its own pattern so that
+ * no connection obsoletes it.
+ *
+ * Returns:
+ *      0       Success.
+ *      else    Failure.  Error-message logged.
+ */
+static int
+addEntries(
+    const unsigned      count,
+    const unsigned      nhosts)
+{
+    unsigned    i;
+
+    for (i = 0; i < count; i++) {
+        char                    pattern[32];
+        prod_spec               spec = {ANY, pattern};
+        prod_class_t            clss = {{0, 0}, {0, 0}, {1, &spec}};
+        const struct sockaddr_in addr = hostAddr(i % nhosts);
+        prod_class_t*           allowed;
+
+        clss.to = TS_ENDT;
+        (void)snprintf(pattern, sizeof(pattern), "^E%u", i);
+
+        if (uldb_addSession(getpid(), i + 1, 6, &addr, &clss, &allowed, 0,
+                1)) {
+            LOG_ADD1("Couldn't add entry %u", i);
+            log_log(LOG_ERR);
+            return -1;
+        }
+
+        free_prod_class(allowed);
+    }
+
+    return 0;
+}
+
+/*
+ * Simulates connections from downstream LDM-s.  Exits.
+ */
+static void
+runConnections(
+    const unsigned      nconns,
+    const unsigned      nhosts,
+    const unsigned      npaces)
+{
+    char                pattern[32];
+    prod_spec           spec = {ANY, pattern};
+    prod_class_t        clss = {{0, 0}, {0, 0}, {1, &spec}};
+    unsigned            i;
+
+    /* A distinct pattern so that concurrent sessions don't obsolete each other */
+    (void)snprintf(pattern, sizeof(pattern), "^P%d", (int)getpid());
+    clss.to = TS_ENDT;
+    srandom((unsigned)getpid());
+
+    for (i = 0; i < nconns; i++) {
+        const struct sockaddr_in addr = hostAddr((unsigned)random() % nhosts);
+        prod_class_t*   allowed;
+        unsigned        j;
+        double          delay;
+
+        if (uldb_addSession(getpid(), i + 1, 6, &addr, &clss, &allowed, 0,
+                1)) {
+            LOG_ADD0("Couldn't add session");
+            log_log(LOG_ERR);
+            _exit(1);
+        }
+
+        free_prod_class(allowed);
+
+        for (j = 0; j < npaces; j++) {
+            if (uldb_pace(getpid(), i + 1, 10000, 0, 0, &delay)) {
+                LOG_ADD0("Couldn't pace data-product");
+                log_log(LOG_ERR);
+                _exit(1);
+            }
+        }
+
+        if (uldb_removeSession(getpid(), i + 1)) {
+            LOG_ADD0("Couldn't remove session");
+            log_log(LOG_ERR);
+            _exit(1);
+        }
+    }
+
+    _exit(0);
+}
+
+/*
+ * Runs the benchmark for a number of existing entries.
+ *
+ * Returns:
+ *      -1      Failure.
+ *      else    Duration in seconds.
+ */
+static double
+run(
+    const char* const   path,
+    const unsigned      nentries,
+    const unsigned      nhosts,
+    const unsigned      nprocs,
+    const unsigned      nconns,
+    const unsigned      npaces)
+{
+    double      duration = -1;
+    int         status = uldb_delete(path);
+
+    if (status && ULDB_EXIST != status) {
+        log_log(LOG_ERR);
+        return -1;
+    }
+    log_clear();
+
+    if (uldb_create(path, 0)) {
+        LOG_ADD0("Couldn't create database");
+        log_log(LOG_ERR);
+    }
+    else {
+        if (0 == addEntries(nentries, nhosts)) {
+            pid_t       pids[MAX_PROCS];
+            unsigned    n;
+            double      start = now();
+            int         failed = 0;
+
+            (void)fflush(stdout);
+
+            for (n = 0; n < nprocs; n++) {
+                if ((pids[n] = fork()) < 0) {
+                    serror("fork() failure");
+                    break;
+                }
+                if (0 == pids[n])
+                    runConnections(nconns, nhosts, npaces);
+            }
+
+            while (n-- > 0) {
+                if (waitpid(pids[n], &status, 0) != pids[n] ||
+                        !WIFEXITED(status) || WEXITSTATUS(status))
+                    failed = 1;
+            }
+
+            if (!failed)
+                duration = now() - start;
+        }
+
+        (void)uldb_close();
+    }
+
+    (void)uldb_delete(path);
+
+    return duration;
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char* dir = "/tmp";
+    unsigned    maxEntries = 1000;
+    unsigned    nhosts = 100;
+    unsigned    nprocs = 4;
+    unsigned    nconns = 2000;
+    unsigned    npaces = 10;
+    unsigned    nentries;
+    char        path[256];
+    int         ch;
+    int         fd;
+    int         status = 0;
+
+    (void)openulog("uldb_bench", LOG_NOTIME | LOG_IDENT, LOG_LDM, "-");
+    (void)setulogmask(LOG_UPTO(LOG_WARNING));
+
+    while ((ch = getopt(argc, argv, "vn:H:p:c:P:d:")) != -1) {
+        switch (ch) {
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'n':
+            maxEntries = (unsigned)atoi(optarg);
+            break;
+        case 'H':
+            nhosts = (unsigned)atoi(optarg);
+            break;
+        case 'p':
+            nprocs = (unsigned)atoi(optarg);
+            break;
+        case 'c':
+            nconns = (unsigned)atoi(optarg);
+            break;
+        case 'P':
+            npaces = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-v] [-n entries] [-H hosts] [-p procs] "
+                    "[-c conns] [-P paces] [-d dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == nhosts || 0 == nprocs || nprocs > MAX_PROCS) {
+        (void)fprintf(stderr, "Hosts must be positive and processes must be "
+                "in 1..%d\n", MAX_PROCS);
+        return 1;
+    }
+
+    (void)snprintf(path, sizeof(path), "%s/uldb_bench-%d", dir,
+            (int)getpid());
+
+    if ((fd = open(path, O_WRONLY | O_CREAT, 0600)) < 0) {
+        serror("Couldn't create \"%s\"", path);
+        return 1;
+    }
+    (void)close(fd);
+
+    for (nentries = 10; nentries <= maxEntries; nentries *= 10) {
+        const double    duration = run(path, nentries, nhosts, nprocs, nconns,
+                npaces);
+
+        if (duration < 0) {
+            status = 1;
+            break;
+        }
+
+        (void)printf("%5u entries, %u hosts, %u processes: %u connections "
+                "in %.3f s, %.0f connections/s\n", nentries, nhosts, nprocs,
+                nprocs * nconns, duration, nprocs * nconns / duration);
+    }
+
+    (void)unlink(path);
+
+    return status;
+}
@@ -13,6 +13,7 @@
 #include <netinet/in.h>  /* sockaddr_in */
 #include <rpc/rpc.h>     /* CLIENT, clnt_stat */
 #include <signal.h>      /* sig_atomic_t */
+#include <stdint.h>      /* uint32_t */
 #include <stdlib.h>      /* NULL, malloc() */
 #include <string.h>      /* strerror() */
 #include <strings.h>     /* strncasecmp() */
@@ -29,15 +30,20 @@
 #include "ldm.h"         /* LDM version 6 client-side functions */
 #include "ldmprint.h"    /* s_prod_class(), s_prod_info() */
 #include "log.h"
+#include "pacer.h"
 #include "peer_info.h"   /* peer_info */
 #include "pq.h"          /* pq_close(), pq_open() */
+#include "priority.h"
 #include "prod_class.h"  /* clss_eq() */
 #include "rpcutil.h"     /* clnt_errmsg() */
 #include "UpFilter.h"
 #include "ulog.h"
 #include "globals.h"
 #include "remote.h"
+#include "timestamp.h"   /* set_timestamp(), d_diff_timestamp() */
 #include "uldb.h"
+#include "xfer_adapt.h"
+#include "zbatch.h"
 
 #include "up6.h"
 
@@ -45,6 +51,9 @@ typedef enum {
     FEED, NOTIFY
 } up6_mode_t;
 
+#define BATCH_MAX_DELAY   0.1    /* maximum delay of a batched product in s */
+#define STATS_LOG_INTERVAL  600 /* interval between statistics reports in s */
+
 static struct pqueue* _pq; /* the product-queue */
 static const prod_class_t* _class; /* selected product-class */
 static const signaturet* _signature; /* signature of last product */
@@ -59,6 +68,18 @@ static unsigned _interval; /* pq_suspend() interval */
 static const char* _downName; /* downstream host name */
 static time_t _lastSendTime; /* time of last activity */
 static int _flushNeeded; /* connection needs a flush? */
+static int _batchingEnabled = 1; /* batch small products if possible? */
+static int _batching; /* sending batches to downstream LDM? */
+static product_batch _batch; /* batch of data-products */
+static int _compressing; /* sending compressed batches to downstream LDM? */
+static int _batchIsWanted; /* compress the current batch? */
+static timestampt _batchStart; /* when first product was added to batch */
+static int _prioritizing; /* sending high-priority data-products first? */
+static signaturet* _deferred; /* ring of deferred data-products */
+static unsigned _deferredMax; /* capacity of "_deferred" */
+static unsigned _deferredHead; /* index of oldest deferred data-product */
+static unsigned _deferredCount; /* number of deferred data-products */
+static time_t _statsLogTime; /* time of last statistics report */
 
 typedef enum clnt_stat clnt_stat_t;
 
@@ -226,6 +247,248 @@ hereis(
          */
         _lastSendTime = time(NULL);
         _flushNeeded = 1;
+        xa_noteAsync(infop->sz);
+
+        if (ulogIsDebug())
+            udebug("%s", s_prod_info(NULL, 0, infop, 1));
+    }
+
+    return errObj;
+}
+
+/**
+ * Determines if the downstream LDM supports the HEREIS_BATCH message by
+ * synchronously sending it an empty batch.  Sets "_batching".
+ *
+ * @retval NULL     Success. "_batching" is set.
+ * @return          Error object.
+ */
+static ErrorObj*
+negotiateBatching(void)
+{
+    static struct timeval TIMEOUT = { 60, 0 };
+    product_batch         empty;
+    clnt_stat_t           stat;
+
+    (void)memset(&empty, 0, sizeof(empty));
+
+    stat = clnt_call(_clnt, HEREIS_BATCH, (xdrproc_t)xdr_product_batch,
+            (caddr_t)&empty, (xdrproc_t)xdr_void, (caddr_t)NULL, TIMEOUT);
+
+    if (RPC_SUCCESS == stat) {
+        _batching = 1;
+    }
+    else if (RPC_PROCUNAVAIL == stat) {
+        _batching = 0;
+    }
+    else {
+        return ERR_NEW2(up6_error(stat), NULL,
+                "Couldn't determine if %s accepts batched products: %s",
+                _downName, clnt_errmsg(_clnt));
+    }
+
+    uinfo("%s batched products", _batching ? "Sending" : "Not sending");
+    _lastSendTime = time(NULL);
+
+    return NULL;
+}
+
+/**
+ * Determines if the downstream LDM supports the HEREIS_ZBATCH message by
+ * synchronously sending it an empty, compressed batch.  Sets "_compressing".
+ *
+ * @retval NULL     Success. "_compressing" is set.
+ * @return          Error object.
+ */
+static ErrorObj*
+negotiateCompression(void)
+{
+    static struct timeval TIMEOUT = { 60, 0 };
+    product_zbatch        empty;
+    clnt_stat_t           stat;
+
+    (void)memset(&empty, 0, sizeof(empty));
+    empty.method = ZBATCH_ZLIB;
+
+    stat = clnt_call(_clnt, HEREIS_ZBATCH, (xdrproc_t)xdr_product_zbatch,
+            (caddr_t)&empty, (xdrproc_t)xdr_void, (caddr_t)NULL, TIMEOUT);
+
+    if (RPC_SUCCESS == stat) {
+        _compressing = 1;
+    }
+    else if (RPC_PROCUNAVAIL == stat || RPC_CANTDECODEARGS == stat) {
+        /*
+         * The downstream LDM doesn't know the message or the method.
+         */
+        _compressing = 0;
+    }
+    else {
+        return ERR_NEW2(up6_error(stat), NULL,
+                "Couldn't determine if %s accepts compressed products: %s",
+                _downName, clnt_errmsg(_clnt));
+    }
+
+    uinfo("%s compressed products", _compressing ? "Sending" : "Not sending");
+    _lastSendTime = time(NULL);
+
+    return NULL;
+}
+
+/**
+ * Asynchronously sends an XDR-encoded batch of data-products to the
+ * downstream LDM as a compressed HEREIS_ZBATCH message if that makes it
+ * smaller.  The batch is given in two parts so that the data-products needn't
+ * be copied after the batch header.
+ *
+ * @param[in] nbytes  Total size of the data of the data-products in bytes.
+ * @param[in] count   Number of data-products.
+ * @param[in] xprods  The XDR-encoded data-products.
+ * @param[in] xlen    Size of "xprods" in bytes.
+ * @retval 1          The batch was sent compressed.
+ * @retval 0          The batch wasn't sent because compression wasn't
+ *                    worthwhile. The caller should send it uncompressed.
+ * @retval -1         The batch couldn't be sent. "*errObj" is set.
+ */
+static int
+sendCompressed(
+    const unsigned    nbytes,
+    const unsigned    count,
+    const void*       xprods,
+    const size_t      xlen,
+    ErrorObj** const  errObj)
+{
+    uint32_t       hdr[2];
+    product_zbatch zbatch;
+
+    hdr[0] = htonl(nbytes);
+    hdr[1] = htonl(count);
+
+    if (zb_compress(hdr, sizeof(hdr), xprods, xlen, &zbatch)) {
+        LOG_ADD0("Sending data-products uncompressed");
+        log_log(LOG_ERR);
+        return 0;
+    }
+
+    if (zbatch.zlen >= zbatch.ulen)
+        return 0;
+
+    if (NULL == hereis_zbatch_6(&zbatch, _clnt)) {
+        *errObj = ERR_NEW1(up6_error(clnt_stat(_clnt)), NULL,
+                "HEREIS_ZBATCH: %s", clnt_errmsg(_clnt));
+        return -1;
+    }
+
+    _lastSendTime = time(NULL);
+    _flushNeeded = 1;
+    xa_noteAsync(zbatch.zlen);
+
+    udebug("Sent compressed batch: %u products, %u bytes, %lu -> %u bytes",
+            count, nbytes, (unsigned long)zbatch.ulen, zbatch.zlen);
+
+    return 1;
+}
+
+/**
+ * Asynchronously sends the batch of data-products, if any, to the downstream
+ * LDM and empties the batch.  The batch is compressed if its data-products
+ * should be and it's large enough.  Sets "_lastSendTime".
+ *
+ * @retval NULL     Success.
+ * @return          Error object. See hereis() for err_code() values.
+ */
+static ErrorObj*
+sendBatch(void)
+{
+    ErrorObj* errObj = NULL; /* success */
+
+    if (_batch.count > 0) {
+        if (_batchIsWanted &&
+                2*sizeof(uint32_t) + _batch.xlen >= zb_getThreshold() &&
+                sendCompressed(_batch.nbytes, _batch.count, _batch.xprods,
+                    _batch.xlen, &errObj)) {
+            /* sent compressed or failed */
+        }
+        else if (NULL == hereis_batch_6(&_batch, _clnt)) {
+            errObj = ERR_NEW1(up6_error(clnt_stat(_clnt)), NULL,
+                    "HEREIS_BATCH: %s", clnt_errmsg(_clnt));
+        }
+        else {
+            _lastSendTime = time(NULL);
+            _flushNeeded = 1;
+            xa_noteAsync(_batch.xlen);
+
+            udebug("Sent batch: %u products, %u bytes", _batch.count,
+                    _batch.nbytes);
+        }
+
+        _batch.count = 0;
+        _batch.nbytes = 0;
+        _batch.xlen = 0;
+    }
+
+    return errObj;
+}
+
+/**
+ * Returns the time since the first data-product was added to the batch.
+ *
+ * @return  The age of the batch in seconds.
+ */
+static double
+batchAge(void)
+{
+    timestampt now;
+
+    (void)set_timestamp(&now);
+
+    return d_diff_timestamp(&now, &_batchStart);
+}
+
+/**
+ * Adds a data-product to the batch.  The batch is sent first if the product
+ * wouldn't fit or if it shouldn't be compressed together with the product.
+ *
+ * @param[in] infop     Pointer to the metadata of the data-product.
+ * @param[in] xprod     Pointer to the XDR-encoded data-product.
+ * @param[in] size      Size of the XDR-encoded data-product in bytes.  Shall
+ *                      not be greater than BATCH_MAX_BYTES.
+ * @param[in] isWanted  Whether the data-product should be compressed.
+ * @retval NULL         Success.
+ * @return              Error object. See hereis() for err_code() values.
+ */
+static ErrorObj*
+addToBatch(
+    const prod_info* infop,
+    const void*      xprod,
+    const size_t     size,
+    const int        isWanted)
+{
+    ErrorObj* errObj = NULL; /* success */
+
+    if (_batch.xlen + size > BATCH_MAX_BYTES ||
+            _batch.count >= PRODUCT_BATCH_MAX ||
+            (_batch.count > 0 && _batchIsWanted != isWanted))
+        errObj = sendBatch();
+
+    if (NULL == errObj) {
+        if (NULL == _batch.xprods) {
+            _batch.xprods = malloc(BATCH_MAX_BYTES);
+
+            if (NULL == _batch.xprods)
+                return ERR_NEW1(UP6_SYSTEM_ERROR, NULL,
+                        "Couldn't allocate %lu-byte batch buffer",
+                        (unsigned long)BATCH_MAX_BYTES);
+        }
+
+        if (0 == _batch.count) {
+            (void)set_timestamp(&_batchStart);
+            _batchIsWanted = isWanted;
+        }
+
+        (void)memcpy(_batch.xprods + _batch.xlen, xprod, size);
+        _batch.xlen += size;
+        _batch.nbytes += infop->sz;
+        _batch.count++;
 
         if (ulogIsDebug())
             udebug("%s", s_prod_info(NULL, 0, infop, 1));
@@ -264,9 +527,12 @@ csbd(
     ErrorObj* errObj = NULL; /* success */
     comingsoon_args comingSoon;
     comingsoon_reply_t* reply;
+    timestampt start;
+    timestampt end;
 
     comingSoon.infop = (prod_info*) infop;
     comingSoon.pktsz = infop->sz;
+    (void)set_timestamp(&start);
     reply = comingsoon_6(&comingSoon, _clnt);
 
     if (NULL == reply) {
@@ -274,22 +540,42 @@ csbd(
                 "COMINGSOON: %s", clnt_errmsg(_clnt));
     }
     else {
+        (void)set_timestamp(&end);
+        xa_noteSync(&start, &end);
+        xa_noteReply(*reply != DONT_SEND);
+
         _lastSendTime = time(NULL );
         _flushNeeded = 0; /* because synchronous RPC call */
 
         if (*reply != DONT_SEND) {
-            datapkt pkt;
+            const size_t blockSize = xa_getBlockSize(infop->sz);
+            size_t       offset = 0;
+            datapkt      pkt;
 
             pkt.signaturep = (signaturet *) &infop->signature; /* not const */
             pkt.pktnum = 0;
-            pkt.data.dbuf_len = infop->sz;
-            pkt.data.dbuf_val = (void*) datap;
 
-            if (NULL == blkdata_6(&pkt, _clnt)) {
-                errObj = ERR_NEW1(up6_error(clnt_stat(_clnt)), NULL,
-                        "Error sending BLKDATA: %s", clnt_errmsg(_clnt));
-            }
-            else {
+            /*
+             * The downstream LDM accepts the data in any number of blocks.
+             */
+            do {
+                const size_t unsent = infop->sz - offset;
+
+                pkt.data.dbuf_len = unsent < blockSize ? unsent : blockSize;
+                pkt.data.dbuf_val = (char*)datap + offset;
+
+                if (NULL == blkdata_6(&pkt, _clnt)) {
+                    errObj = ERR_NEW1(up6_error(clnt_stat(_clnt)), NULL,
+                            "Error sending BLKDATA: %s", clnt_errmsg(_clnt));
+                    break;
+                }
+
+                xa_noteAsync(pkt.data.dbuf_len);
+                offset += pkt.data.dbuf_len;
+                pkt.pktnum++;
+            } while (offset < infop->sz);
+
+            if (NULL == errObj) {
                 _lastSendTime = time(NULL );
                 _flushNeeded = 1; /* because asynchronous RPC call */
 
@@ -304,6 +590,148 @@ csbd(
     return errObj;
 }
 
+/**
+ * Sends a data-product to the downstream LDM -- possibly as part of a batch.
+ *
+ * @param[in] info   Pointer to the data-product's metadata.
+ * @param[in] data   Pointer to the data-product's data.
+ * @param[in] xprod  Pointer to an XDR-encoded version of the data-product
+ *                   (data and metadata).
+ * @param[in] size   Size, in bytes, of the XDR-encoded version.
+ * @retval NULL      Success.
+ * @return           Error object. See hereis() for err_code() values.
+ */
+static ErrorObj*
+sendProduct(
+        const prod_info* const info,
+        const void* const data,
+        void* const xprod,
+        const size_t size)
+{
+    ErrorObj* errObj;
+    int isDebug = ulogIsDebug();
+
+    if (ulogIsVerbose() || isDebug)
+        err_log_and_free(ERR_NEW1(0, NULL, "sending: %s",
+                s_prod_info(NULL, 0, info, isDebug)),
+                isDebug ? ERR_DEBUG : ERR_INFO);
+
+    /*
+     * Don't exceed the global rate-limit or that of this downstream LDM.
+     */
+    pacer_pace(size);
+
+    const int isWanted = _compressing && zb_isWanted(info);
+
+    if (_batching && info->sz <= BATCH_MAX_PRODUCT &&
+            size <= BATCH_MAX_BYTES) {
+        errObj = addToBatch(info, xprod, size, isWanted);
+    }
+    else {
+        /*
+         * Preserve the order of the data-products.
+         */
+        errObj = sendBatch();
+
+        if (NULL == errObj) {
+            /*
+             * A large data-product that should be compressed is sent as
+             * a compressed batch of one.
+             */
+            if (!isWanted || size < zb_getThreshold() ||
+                    0 == sendCompressed(info->sz, 1, xprod, size,
+                        &errObj))
+                errObj = _isPrimary || xa_useHereis(info->sz)
+                    ? hereis(info, data)
+                    : csbd(info, data);
+            else if (NULL == errObj && ulogIsDebug())
+                udebug("%s", s_prod_info(NULL, 0, info, 1));
+        }
+    }
+
+    return errObj;
+}
+
+/**
+ * Defers a normal-priority data-product so that high-priority ones can be sent
+ * first.  The reorder window shall not be full.
+ *
+ * @param[in] info  Pointer to the data-product's metadata.
+ */
+static void
+deferProduct(
+        const prod_info* const info)
+{
+    assert(_deferredCount < _deferredMax);
+
+    (void)memcpy(_deferred[(_deferredHead + _deferredCount) % _deferredMax],
+            info->signature, sizeof(signaturet));
+    _deferredCount++;
+
+    if (ulogIsDebug())
+        udebug("deferring: %s", s_prod_info(NULL, 0, info, 1));
+}
+
+/**
+ * Sends a deferred data-product.  Called by pq_processProduct().
+ *
+ * @param[in] info   Pointer to the data-product's metadata.
+ * @param[in] data   Pointer to the data-product's data.
+ * @param[in] xprod  Pointer to an XDR-encoded version of the data-product.
+ * @param[in] size   Size, in bytes, of the XDR-encoded version.
+ * @param[in] arg    Pointer to pointer to error-object. Set to NULL on success.
+ * @retval 0         Always.
+ */
+static int
+sendDeferredProduct(
+        const prod_info* const info,
+        const void* const data,
+        void* const xprod,
+        const size_t size,
+        void* const arg)
+{
+    prio_noteSent(info, 0);
+    *(ErrorObj**)arg = sendProduct(info, data, xprod, size);
+
+    return 0;
+}
+
+/**
+ * Sends the oldest deferred data-product.  A deferred data-product that's no
+ * longer in the product-queue is skipped.
+ *
+ * @retval NULL     Success.
+ * @return          Error object. See hereis() for err_code() values.
+ */
+static ErrorObj*
+sendDeferred(void)
+{
+    ErrorObj*  errObj = NULL;
+    signaturet sig;
+    int        status;
+
+    assert(_deferredCount > 0);
+
+    (void)memcpy(sig, _deferred[_deferredHead], sizeof(signaturet));
+    _deferredHead = (_deferredHead + 1) % _deferredMax;
+    _deferredCount--;
+
+    status = pq_processProduct(_pq, sig, sendDeferredProduct, &errObj);
+
+    if (PQ_NOTFOUND == status) {
+        unotice("Deferred data-product %s is no longer in the product-queue",
+                s_signaturet(NULL, 0, sig));
+    }
+    else if (status && NULL == errObj) {
+        log_log(LOG_ERR);
+        errObj = ERR_NEW1(UP6_PQ, NULL,
+                "Couldn't send deferred data-product: %s",
+                pq_strerror(_pq, status));
+    }
+
+    return errObj;
+}
+
 /*
  * Transmits a data-product to a downstream LDM.  Called by pq_sequence().
  *
@@ -343,14 +771,19 @@ static int feed(
     ErrorObj** const errObj = (ErrorObj**) arg;
 
     if (upFilter_isMatch(_upFilter, info)) {
-        int isDebug = ulogIsDebug();
+        if (_prioritizing) {
+            if (!prio_isHigh(info)) {
+                /*
+                 * up6_run() ensures room in the reorder window.
+                 */
+                deferProduct(info);
+                return 0;
+            }
 
-        if (ulogIsVerbose() || isDebug)
-            err_log_and_free(ERR_NEW1(0, NULL, "sending: %s",
-                    s_prod_info(NULL, 0, info, isDebug)),
-                    isDebug ? ERR_DEBUG : ERR_INFO);
+            prio_noteSent(info, 1);
+        }
 
-        *errObj = _isPrimary ? hereis(info, data) : csbd(info, data);
+        *errObj = sendProduct(info, data, xprod, size);
     } /* product passes up-filter */
 
     return 0;
@@ -366,6 +799,11 @@ static ErrorObj*
 flushConnection(
         void)
 {
+    timestampt start;
+    timestampt end;
+
+    (void)set_timestamp(&start);
+
 #if 0
     static struct timeval ZERO_TIMEOUT = { 0, 0 };
     /*
@@ -381,6 +819,8 @@ flushConnection(
 #else
     if (nullproc_6(NULL, _clnt)) {
 #endif
+        (void)set_timestamp(&end);
+        xa_noteSync(&start, &end);
         _lastSendTime = time(NULL );
         _flushNeeded = 0;
         udebug("flushConnection() success");
@@ -470,10 +910,81 @@ static up6_error_t up6_run(
             errCode = UP6_CLIENT_FAILURE;
         }
         else {
+            _batching = 0;
+            _compressing = 0;
+            xa_reset();
+            _statsLogTime = time(NULL);
+
+            if (FEED == _mode && _isPrimary && _batchingEnabled) {
+                ErrorObj* errObj = negotiateBatching();
+
+                /*
+                 * Compressed batches are only offered to a downstream LDM
+                 * that accepts uncompressed ones.
+                 */
+                if (NULL == errObj && _batching && zb_isEnabled())
+                    errObj = negotiateCompression();
+
+                if (NULL != errObj)
+                    errCode = logFailure("Failure", errObj);
+            }
+
+            _prioritizing = 0;
+            _deferredHead = 0;
+            _deferredCount = 0;
+
+            if (FEED == _mode && prio_isEnabled()) {
+                _deferredMax = prio_getWindow();
+                _deferred = (signaturet*)malloc(
+                        _deferredMax * sizeof(signaturet));
+
+                if (NULL == _deferred) {
+                    serror("Couldn't allocate %u-product reorder window; "
+                            "not prioritizing data-products", _deferredMax);
+                }
+                else {
+                    _prioritizing = 1;
+                    uinfo("Sending high-priority data-products first: "
+                            "window=%u", _deferredMax);
+                }
+            }
+
             while (UP6_SUCCESS == errCode && exitIfDone(0)) {
                 ErrorObj*   errObj = NULL;
-                const int   err = pq_sequence(_pq, _mt, _class,
-                        _mode == FEED ? feed : notify, &errObj);
+                int         err = 0;
+
+                if (_prioritizing && _deferredCount == _deferredMax) {
+                    /*
+                     * Make room in the reorder window.
+                     */
+                    errObj = sendDeferred();
+                }
+
+                if (NULL == errObj)
+                    err = pq_sequence(_pq, _mt, _class,
+                            _mode == FEED ? feed : notify, &errObj);
+
+                if (NULL == errObj && _deferredCount > 0 &&
+                        (err == PQUEUE_END || err == EAGAIN ||
+                         err == EACCES)) {
+                    /*
+                     * No data-product is waiting in the product-queue: send
+                     * the oldest deferred one and look again so that a new,
+                     * high-priority data-product needn't wait for the rest.
+                     */
+                    errObj = sendDeferred();
+                    err = 0;
+                }
+
+                if (NULL == errObj && _batch.count > 0 &&
+                        (err || batchAge() >= BATCH_MAX_DELAY)) {
+                    /*
+                     * Don't delay the batched data-products any longer:
+                     * there's no other data-product to send or the
+                     * latency budget is spent.
+                     */
+                    errObj = sendBatch();
+                }
 
                 if (NULL != errObj) {
                     /*
@@ -502,6 +1013,14 @@ static up6_error_t up6_run(
                                     ? "End of product-queue"
                                     : "Hit a lock");
 
+                            if (time(NULL) - _statsLogTime
+                                    >= STATS_LOG_INTERVAL) {
+                                if (_prioritizing)
+                                    prio_logLatencies(LOG_INFO);
+                                xa_log(LOG_INFO);
+                                _statsLogTime = time(NULL);
+                            }
+
                             if (_interval <= timeSinceLastSend) {
                                 _flushNeeded = 1;
                             }
@@ -520,6 +1039,15 @@ static up6_error_t up6_run(
                 } /* problem in product-queue module */
             } /* pq_sequence() loop */
 
+            if (_prioritizing)
+                prio_logLatencies(LOG_NOTICE);
+            xa_log(LOG_INFO);
+
+            _deferredCount = 0;
+            _batch.count = 0;
+            _batch.nbytes = 0;
+            _batch.xlen = 0;
+
             auth_destroy(_clnt->cl_auth);
             clnt_destroy(_clnt);
 
@@ -547,6 +1075,12 @@ static void up6_destroy(
         (void) pq_close(_pq);
         _pq = NULL;
     }
+
+    free(_batch.xprods);
+    _batch.xprods = NULL;
+
+    free(_deferred);
+    _deferred = NULL;
 }
 
 /*
@@ -618,6 +1152,16 @@ static up6_error_t up6_init(
             if (err == 0) {
                 _mt = TV_GT;
                 cursorSet = 1;
+
+                /*
+                 * Resend what a prioritizing predecessor might have deferred.
+                 */
+                if (FEED == mode && (err = prio_backUpCursor(_pq, *signature,
+                        prodClass, upFilter))) {
+                    LOG_ADD1("Couldn't resume before deferred data-products: "
+                            "%s", pq_strerror(_pq, err));
+                    log_log(LOG_WARNING);
+                }
             }
             else if (PQ_NOTFOUND == err) {
                 err_log_and_free(
@@ -676,6 +1220,20 @@ static up6_error_t up6_init(
  * Begin public API.
  ******************************************************************************/
 
+/*
+ * Enables or disables the batching of small data-products into HEREIS_BATCH
+ * messages.  Batching is enabled by default but is only used when feeding a
+ * downstream LDM that supports it via HEREIS messages.
+ *
+ * Arguments:
+ *      enable          Whether or not to batch small data-products.
+ */
+void up6_setBatching(
+        const int enable)
+{
+    _batchingEnabled = enable;
+}
+
 /*
  * Constructs a new, upstream LDM object that feeds a downstream LDM. function
  * prints diagnostic messages via the ulog(3) module.  It calls exitIfDone()
@@ -12,6 +12,12 @@
 extern "C" {
 #endif
 
+/*
+ * Limits on the batching of small data-products into HEREIS_BATCH messages:
+ */
+#define BATCH_MAX_PRODUCT 16384  /* largest product that's batched in bytes */
+#define BATCH_MAX_BYTES   PRODUCT_BATCH_MAX_BYTES /* see ldm.x */
+
 typedef enum {
     UP6_SUCCESS = 0,
     UP6_CLIENT_FAILURE,
@@ -26,6 +32,10 @@ typedef enum {
     UP6_DISALLOWED
 } up6_error_t;
 
+void
+up6_setBatching(
+    const int                           enable);
+
 int
 up6_new_feeder(
     const int                           socket, 
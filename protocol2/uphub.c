@@ -0,0 +1,2911 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This module implements upstream LDM "hubs".  A hub is a single-threaded
+ * child process of the top-level LDM server that feeds or notifies many
+ * downstream LDM-s by multiplexing their connections with poll(2) instead of
+ * dedicating a forked process to each one.
+ *
+ * The top-level LDM server starts the hubs and passes to one of them, via a
+ * UNIX-domain socket, every new connection whose first request is a FEEDME or
+ * NOTIFYME.  The hub vets the request with the usual server-side functions
+ * (see "ldm_server.c"), which call uphub_addSession() if the subscription is
+ * honored.  Every other connection is handled by a forked process as before.
+ *
+ * Neither the top-level LDM server nor a hub looks up the name of a
+ * downstream host because a slow name-server would stall them.  Each hub has
+ * a child process, its resolver, that does the lookups one after the other; a
+ * connection is vetted once the name of its host has arrived.
+ *
+ * Sessions of a hub whose subscriptions have the same feedtypes, patterns,
+ * and end-time are grouped behind a single product-queue cursor once they've
+ * caught up with the product-queue, so that the queue is scanned and matched
+ * once per group rather than once per session.  A member that can't keep up is
+ * removed from its group and reads the product-queue on its own until it has
+ * caught up again.
+ *
+ * A hub is a process rather than a thread because the ulog(3), product-queue,
+ * RPC, and upstream LDM database modules aren't thread-safe.
+ */
+
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <rpc/rpc.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "abbr.h"
+#include "child_process_set.h"
+#include "globals.h"
+#include "inetutil.h"
+#include "ldm.h"
+#include "ldm_config_file.h"
+#include "ldm_xlen.h"
+#include "ldmfork.h"
+#include "ldmprint.h"
+#include "log.h"
+#include "pq.h"
+#include "priv.h"
+#include "prod_class.h"
+#include "prod_info.h"
+#include "priority.h"
+#include "remote.h"
+#include "timestamp.h"
+#include "uldb.h"
+#include "ulog.h"
+#include "up6.h"
+#include "UpFilter.h"
+#include "uphub.h"
+#include "zbatch.h"
+
+/*
+ * Limits on the output of a session:
+ */
+#define LOW_WATER       65536   /* refill output below this many bytes */
+#define HIGH_WATER      262144  /* stop filling output at this many bytes */
+#define TURN_PRODUCTS   64      /* maximum data-products per turn */
+
+#define REPLY_TIMEOUT   60      /* maximum wait for a reply in seconds */
+#define VET_INTERVAL    5       /* upstream LDM database check interval in s */
+#define MAX_RECORD      65536   /* maximum size of a received record */
+#define CALL_HDR_SIZE   44      /* record-mark plus AUTH_NONE call-header */
+#define HANDOFF_TIMEOUT 5000    /* maximum wait to pass a connection in ms */
+#define HANDOFF_TRIES   3       /* maximum attempts to pass a connection */
+#define GROUP_LAG       2       /* maximum delay of a group by a member in s */
+#define HUB_FDS         3       /* control socket, wake-up pipe, and resolver */
+
+/*
+ * Shared (with the top-level LDM server) accounting of a hub:
+ */
+typedef struct {
+    unsigned    received;       /* number of connections received */
+    unsigned    sessions;       /* number of connections being handled */
+} HubLoad;
+
+/*
+ * Top-level LDM server's information on a hub:
+ */
+typedef struct {
+    pid_t       pid;            /* process identifier */
+    int         ctl;            /* UNIX-domain socket to the hub */
+    unsigned    sent;           /* number of connections passed to the hub */
+} Hub;
+
+/*
+ * Synchronous RPC calls that a session can have outstanding:
+ */
+typedef enum {
+    CALL_NONE = 0,              /* no call outstanding */
+    CALL_PROBE,                 /* empty HEREIS_BATCH */
+    CALL_ZPROBE,                /* empty HEREIS_ZBATCH */
+    CALL_NULLPROC,              /* keep-alive */
+    CALL_COMINGSOON             /* announcement of a data-product */
+} CallType;
+
+/*
+ * Growable byte-buffer:
+ */
+typedef struct {
+    char*       buf;
+    size_t      size;           /* capacity of "buf" in bytes */
+    size_t      len;            /* number of bytes in "buf" */
+} Buf;
+
+typedef struct group    Group;
+
+/*
+ * A session with a downstream LDM:
+ */
+typedef struct {
+    Buf                 out;        /* RPC records to be written */
+    Buf                 in;         /* bytes read but not yet parsed */
+    Buf                 rec;        /* reply record being reassembled */
+    struct sockaddr_in  downAddr;   /* address of downstream host */
+    timestampt          cursor;     /* product-queue cursor */
+    char*               downName;   /* name of downstream host */
+    prod_class_t*       prodClass;  /* data-products to send */
+    UpFilter*           upFilter;   /* filter for data-products */
+    signaturet          signature;  /* last product received downstream */
+    Group*              group;      /* shared-cursor group or NULL */
+    prod_info*          csInfo;     /* metadata of announced data-product */
+    void*               csData;     /* data of announced data-product */
+    size_t              outHead;    /* index of first unwritten byte */
+    size_t              batchOff;   /* offset of open batch or SIZE_MAX */
+    time_t              lastSend;   /* time of last RPC call */
+    time_t              callTime;   /* time of outstanding call */
+    time_t              blockedSince; /* time member started delaying group */
+    u_int               callXid;    /* transaction ID of outstanding call */
+    unsigned            batchCount; /* number of products in open batch */
+    unsigned            batchBytes; /* data size of products in open batch */
+    unsigned            id;         /* session identifier */
+    CallType            call;       /* outstanding synchronous call */
+    pq_match            mt;         /* cursor matching condition */
+    int                 sock;       /* connection to downstream LDM */
+    int                 isNotifier; /* notify rather than feed? */
+    int                 isPrimary;  /* HEREIS rather than COMINGSOON? */
+    int                 batching;   /* send HEREIS_BATCH messages? */
+    int                 compressing; /* send HEREIS_ZBATCH messages? */
+    int                 batchIsWanted; /* compress the open batch? */
+    int                 atEnd;      /* at end of product-queue? */
+    int                 isDone;     /* session should be ended? */
+    int                 isListed;   /* in upstream LDM database? */
+    int                 hasSignature; /* "signature" is set? */
+    int                 inTurn;     /* member receives group's products? */
+} Session;
+
+/*
+ * Sessions that share a product-queue cursor:
+ */
+struct group {
+    prod_class_t*       prodClass;  /* common subscription */
+    Session**           members;
+    timestampt          cursor;     /* product-queue cursor */
+    unsigned            count;      /* number of members */
+    unsigned            max;        /* capacity of "members" */
+    pq_match            mt;         /* cursor matching condition */
+    int                 atEnd;      /* at end of product-queue? */
+    int                 isFull;     /* a member's output is full */
+};
+
+/*
+ * A connection on which a FEEDME or NOTIFYME request is expected:
+ */
+typedef struct {
+    SVCXPRT*    xprt;
+    time_t      start;
+    unsigned    id;                 /* identifier of the name lookup */
+    int         isNamed;            /* name has been looked up */
+    char        name[HOSTNAMELEN];  /* looked up by the resolver */
+} Handshake;
+
+/*
+ * A request to the resolver of a hub and its reply:
+ */
+typedef struct {
+    unsigned    id;                 /* identifier of the lookup */
+    in_addr_t   addr;               /* IP address in network byte order */
+} NameRequest;
+
+typedef struct {
+    unsigned    id;                 /* identifier of the lookup */
+    char        name[HOSTNAMELEN];  /* name of the host or its IP address */
+} NameReply;
+
+/*
+ * Top-level LDM server's state:
+ */
+static Hub              hubs[UPHUB_MAX_HUBS];
+static unsigned         hubCount;
+static void           (*hubChildInit)(void);
+static HubLoad*         hubLoads;   /* shared memory */
+
+/*
+ * Hub's state:
+ */
+static int              hubIndex = -1;  /* index of this hub or -1 */
+static pqueue*          hubPq;
+static Session**        sessions;
+static unsigned         sessionCount;
+static unsigned         sessionMax;
+static Handshake*       handshakes;
+static unsigned         handshakeCount;
+static unsigned         handshakeMax;
+static Group**          groups;
+static unsigned         groupCount;
+static unsigned         groupMax;
+static Session*         adoptee;        /* session added by current request */
+static unsigned         nextSessionId;
+static u_int            nextXid;
+static int              wakePipe[2] = {-1, -1};
+static int              resolverSock = -1;
+static pid_t            resolverPid = -1;
+static unsigned         nextLookupId;
+static int              lockHit;        /* a product-queue lock was hit */
+
+/******************************************************************************
+ * Buffers:
+ ******************************************************************************/
+
+/*
+ * Ensures that a buffer has room for additional bytes.
+ *
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory. log_start() called.
+ */
+static int
+buf_reserve(
+    Buf* const          buf,
+    const size_t        nbytes)
+{
+    if (buf->len + nbytes > buf->size) {
+        size_t  size = buf->size ? buf->size : 4096;
+        char*   mem;
+
+        while (size < buf->len + nbytes)
+            size *= 2;
+
+        mem = realloc(buf->buf, size);
+
+        if (NULL == mem) {
+            LOG_SERROR1("Couldn't allocate %lu-byte buffer",
+                    (unsigned long)size);
+            return ENOMEM;
+        }
+
+        buf->buf = mem;
+        buf->size = size;
+    }
+
+    return 0;
+}
+
+/*
+ * Appends bytes to a buffer.
+ *
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory. log_start() called.
+ */
+static int
+buf_append(
+    Buf* const          buf,
+    const void* const   bytes,
+    const size_t        nbytes)
+{
+    int status = buf_reserve(buf, nbytes);
+
+    if (0 == status) {
+        (void)memcpy(buf->buf + buf->len, bytes, nbytes);
+        buf->len += nbytes;
+    }
+
+    return status;
+}
+
+static void
+buf_free(
+    Buf* const          buf)
+{
+    free(buf->buf);
+    buf->buf = NULL;
+    buf->size = buf->len = 0;
+}
+
+/******************************************************************************
+ * Sessions:
+ ******************************************************************************/
+
+/*
+ * Sets the ulog(3) identifier for messages about a session.
+ */
+static void
+sess_setIdent(
+    const Session* const        sess)
+{
+    set_abbr_ident(sess->downName, sess->isNotifier ? "(noti)" : "(feed)");
+}
+
+/*
+ * Frees a session's announced data-product.
+ */
+static void
+sess_clearComingSoon(
+    Session* const      sess)
+{
+    if (sess->csInfo) {
+        pi_free(sess->csInfo);
+        sess->csInfo = NULL;
+    }
+
+    free(sess->csData);
+    sess->csData = NULL;
+}
+
+/*
+ * Removes a session from its group.  The session continues from the group's
+ * cursor on its own.  The group is freed if it becomes empty.
+ */
+static void
+group_leave(
+    Session* const      sess);
+
+/*
+ * Frees a session.  Closes its connection and removes its entry from the
+ * upstream LDM database.
+ */
+static void
+sess_free(
+    Session* const      sess)
+{
+    if (sess) {
+        if (sess->group)
+            group_leave(sess);
+
+        if (sess->sock >= 0)
+            (void)close(sess->sock);
+
+        (void)uldb_removeSession(getpid(), sess->id);
+        log_clear();
+
+        sess_clearComingSoon(sess);
+        buf_free(&sess->out);
+        buf_free(&sess->in);
+        buf_free(&sess->rec);
+        upFilter_free(sess->upFilter);
+        free_prod_class(sess->prodClass);
+        free(sess->downName);
+        free(sess);
+    }
+}
+
+/*
+ * Appends the record-mark and header of an RPC call to a session's output.
+ * Any open batch is closed first.
+ *
+ * Arguments:
+ *      sess    The session.
+ *      proc    The LDM-6 procedure.
+ *      xid     The transaction identifier.
+ * Returns:
+ *      SIZE_MAX    Out of memory. log_start() called.
+ *      else        Offset of the record-mark in the output buffer.
+ */
+static size_t
+sess_startCall(
+    Session* const      sess,
+    const u_int         proc,
+    const u_int         xid);
+
+/*
+ * Sets the record-mark of an RPC call in a session's output.
+ *
+ * Arguments:
+ *      sess    The session.
+ *      off     Offset of the record-mark from sess_startCall().
+ */
+static void
+sess_endCall(
+    Session* const      sess,
+    const size_t        off)
+{
+    uint32_t    mark = htonl(0x80000000u |
+            (uint32_t)(sess->out.len - off - sizeof(mark)));
+
+    (void)memcpy(sess->out.buf + off, &mark, sizeof(mark));
+    sess->lastSend = time(NULL);
+}
+
+/*
+ * XDR-encodes an object onto a session's output.
+ *
+ * Arguments:
+ *      sess    The session.
+ *      proc    The XDR function.
+ *      obj     The object to be encoded.
+ *      maxSize Maximum encoded size of the object in bytes.
+ * Returns:
+ *      0       Success.
+ *      else    Failure. log_start() called.
+ */
+static int
+sess_appendXdr(
+    Session* const      sess,
+    const xdrproc_t     proc,
+    void* const         obj,
+    const size_t        maxSize)
+{
+    int status = buf_reserve(&sess->out, maxSize);
+
+    if (0 == status) {
+        XDR xdrs;
+
+        xdrmem_create(&xdrs, sess->out.buf + sess->out.len, maxSize,
+                XDR_ENCODE);
+
+        if (!proc(&xdrs, obj)) {
+            LOG_START0("Couldn't XDR-encode RPC arguments");
+            status = EIO;
+        }
+        else {
+            sess->out.len += xdr_getpos(&xdrs);
+        }
+
+        xdr_destroy(&xdrs);
+    }
+
+    return status;
+}
+
+/*
+ * Replaces the arguments of the open HEREIS_BATCH message of a session with
+ * their compressed form and makes the message a HEREIS_ZBATCH message if that
+ * makes it smaller.
+ *
+ * Returns:
+ *      0       The message was replaced.
+ *      else    The message wasn't replaced.
+ */
+static int
+sess_compressBatch(
+    Session* const      sess)
+{
+    char* const     args = sess->out.buf + sess->batchOff + CALL_HDR_SIZE;
+    const size_t    len = sess->out.len - sess->batchOff - CALL_HDR_SIZE;
+    product_zbatch  zbatch;
+    uint32_t        proc = htonl(HEREIS_ZBATCH);
+
+    if (zb_compress(args, 8, args + 8, len - 8, &zbatch)) {
+        LOG_ADD0("Sending data-products uncompressed");
+        log_log(LOG_ERR);
+        return -1;
+    }
+
+    if (zbatch.zlen >= zbatch.ulen)
+        return -1;
+
+    /*
+     * The compressed arguments are smaller than the original ones and so
+     * can't cause a reallocation of the output buffer.
+     */
+    sess->out.len = sess->batchOff + CALL_HDR_SIZE;
+    (void)memcpy(sess->out.buf + sess->batchOff + 24, &proc, sizeof(proc));
+
+    if (sess_appendXdr(sess, (xdrproc_t)xdr_product_zbatch, &zbatch,
+            zbatch.zlen + 20)) {
+        log_log(LOG_ERR);
+        sess->isDone = 1;
+    }
+
+    udebug("Sent compressed batch: %u products, %u bytes, %lu -> %u bytes",
+            sess->batchCount, sess->batchBytes, (unsigned long)len,
+            zbatch.zlen);
+
+    return 0;
+}
+
+/*
+ * Closes the open HEREIS_BATCH message of a session, if any.  The message is
+ * compressed if its data-products should be and it's large enough.
+ */
+static void
+sess_closeBatch(
+    Session* const      sess)
+{
+    if (SIZE_MAX != sess->batchOff) {
+        uint32_t    args[2];
+
+        args[0] = htonl(sess->batchBytes);
+        args[1] = htonl(sess->batchCount);
+        (void)memcpy(sess->out.buf + sess->batchOff + CALL_HDR_SIZE, args,
+                sizeof(args));
+
+        if (!sess->batchIsWanted || sess->out.len - sess->batchOff -
+                CALL_HDR_SIZE < zb_getThreshold() || sess_compressBatch(sess))
+            udebug("Sent batch: %u products, %u bytes", sess->batchCount,
+                    sess->batchBytes);
+
+        sess_endCall(sess, sess->batchOff);
+
+        sess->batchOff = SIZE_MAX;
+        sess->batchCount = 0;
+        sess->batchBytes = 0;
+    }
+}
+
+static size_t
+sess_startCall(
+    Session* const      sess,
+    const u_int         proc,
+    const u_int         xid)
+{
+    uint32_t    hdr[CALL_HDR_SIZE/4];
+    size_t      off;
+
+    sess_closeBatch(sess);
+
+    off = sess->out.len;
+    hdr[0] = 0;                         /* record-mark: see sess_endCall() */
+    hdr[1] = htonl(xid);
+    hdr[2] = htonl(CALL);
+    hdr[3] = htonl(RPC_MSG_VERSION);
+    hdr[4] = htonl(LDMPROG);
+    hdr[5] = htonl(SIX);
+    hdr[6] = htonl(proc);
+    hdr[7] = htonl(AUTH_NONE);          /* credentials */
+    hdr[8] = 0;
+    hdr[9] = htonl(AUTH_NONE);          /* verifier */
+    hdr[10] = 0;
+
+    return buf_append(&sess->out, hdr, sizeof(hdr)) ? SIZE_MAX : off;
+}
+
+/*
+ * Appends a complete RPC call to a session's output.
+ *
+ * Arguments:
+ *      sess    The session.
+ *      proc    The LDM-6 procedure.
+ *      xid     The transaction identifier.
+ *      xdrProc The XDR function for the arguments or NULL.
+ *      args    The arguments. Ignored if "xdrProc" is NULL.
+ *      maxSize Maximum encoded size of the arguments in bytes.
+ * Returns:
+ *      0       Success.
+ *      else    Failure. log_start() called.
+ */
+static int
+sess_call(
+    Session* const      sess,
+    const u_int         proc,
+    const u_int         xid,
+    const xdrproc_t     xdrProc,
+    void* const         args,
+    const size_t        maxSize)
+{
+    const size_t    off = sess_startCall(sess, proc, xid);
+    int             status;
+
+    if (SIZE_MAX == off) {
+        status = ENOMEM;
+    }
+    else {
+        status = xdrProc ? sess_appendXdr(sess, xdrProc, args, maxSize) : 0;
+
+        if (status) {
+            sess->out.len = off;
+        }
+        else {
+            sess_endCall(sess, off);
+        }
+    }
+
+    return status;
+}
+
+/*
+ * Starts a synchronous RPC call on a session.  The reply will be handled by
+ * sess_handleReply().
+ */
+static int
+sess_startSyncCall(
+    Session* const      sess,
+    const CallType      type,
+    const u_int         proc,
+    const xdrproc_t     xdrProc,
+    void* const         args,
+    const size_t        maxSize)
+{
+    const u_int xid = ++nextXid;
+    int         status = sess_call(sess, proc, xid, xdrProc, args, maxSize);
+
+    if (0 == status) {
+        sess->call = type;
+        sess->callXid = xid;
+        sess->callTime = time(NULL);
+    }
+
+    return status;
+}
+
+/*
+ * Determines if the downstream LDM supports the HEREIS_BATCH message by
+ * sending it an empty batch.
+ */
+static int
+sess_probe(
+    Session* const      sess)
+{
+    product_batch   empty;
+
+    (void)memset(&empty, 0, sizeof(empty));
+
+    return sess_startSyncCall(sess, CALL_PROBE, HEREIS_BATCH,
+            (xdrproc_t)xdr_product_batch, &empty, 8);
+}
+
+/*
+ * Determines if the downstream LDM supports the HEREIS_ZBATCH message by
+ * sending it an empty, compressed batch.
+ */
+static int
+sess_zprobe(
+    Session* const      sess)
+{
+    product_zbatch  empty;
+
+    (void)memset(&empty, 0, sizeof(empty));
+    empty.method = ZBATCH_ZLIB;
+
+    return sess_startSyncCall(sess, CALL_ZPROBE, HEREIS_ZBATCH,
+            (xdrproc_t)xdr_product_zbatch, &empty, 12);
+}
+
+/*
+ * Adds an XDR-encoded data-product to the open HEREIS_BATCH message of a
+ * session -- opening a new one if necessary.
+ */
+static int
+sess_addToBatch(
+    Session* const              sess,
+    const prod_info* const      info,
+    const void* const           xprod,
+    const size_t                size,
+    const int                   isWanted)
+{
+    if (SIZE_MAX != sess->batchOff && (sess->batchCount >= PRODUCT_BATCH_MAX ||
+            sess->out.len - sess->batchOff - CALL_HDR_SIZE - 8 + size >
+            BATCH_MAX_BYTES || sess->batchIsWanted != isWanted))
+        sess_closeBatch(sess);
+
+    if (SIZE_MAX == sess->batchOff) {
+        static const uint32_t   counts[2];
+        const size_t            off = sess_startCall(sess, HEREIS_BATCH,
+                ++nextXid);
+
+        if (SIZE_MAX == off || buf_append(&sess->out, counts, sizeof(counts))) {
+            if (SIZE_MAX != off)
+                sess->out.len = off;
+
+            return ENOMEM;
+        }
+
+        sess->batchOff = off;
+        sess->batchIsWanted = isWanted;
+    }
+
+    if (buf_append(&sess->out, xprod, size))
+        return ENOMEM;
+
+    sess->batchCount++;
+    sess->batchBytes += info->sz;
+
+    return 0;
+}
+
+/*
+ * Sends a data-product to the downstream LDM of a session via a HEREIS
+ * message.  The XDR-encoded data-product is the encoded argument.
+ */
+static int
+sess_hereis(
+    Session* const      sess,
+    const void* const   xprod,
+    const size_t        size)
+{
+    const size_t    off = sess_startCall(sess, HEREIS, ++nextXid);
+
+    if (SIZE_MAX == off)
+        return ENOMEM;
+
+    if (buf_append(&sess->out, xprod, size)) {
+        sess->out.len = off;
+        return ENOMEM;
+    }
+
+    sess_endCall(sess, off);
+
+    return 0;
+}
+
+/*
+ * Sends a data-product to the downstream LDM of a session via a HEREIS_ZBATCH
+ * message that contains only that data-product.  A HEREIS message is sent
+ * instead if compression doesn't make the message smaller.
+ */
+static int
+sess_hereisCompressed(
+    Session* const              sess,
+    const prod_info* const      info,
+    const void* const           xprod,
+    const size_t                size)
+{
+    uint32_t        hdr[2];
+    product_zbatch  zbatch;
+
+    hdr[0] = htonl(info->sz);
+    hdr[1] = htonl(1);
+
+    if (zb_compress(hdr, sizeof(hdr), xprod, size, &zbatch)) {
+        LOG_ADD0("Sending data-product uncompressed");
+        log_log(LOG_ERR);
+    }
+    else if (zbatch.zlen < zbatch.ulen) {
+        return sess_call(sess, HEREIS_ZBATCH, ++nextXid,
+                (xdrproc_t)xdr_product_zbatch, &zbatch, zbatch.zlen + 20);
+    }
+
+    return sess_hereis(sess, xprod, size);
+}
+
+/*
+ * Announces a data-product to the downstream LDM of a session via a
+ * COMINGSOON message.  The data is sent by sess_handleReply() if the
+ * downstream LDM wants it.
+ */
+static int
+sess_comingSoon(
+    Session* const              sess,
+    const prod_info* const      info,
+    const void* const           data)
+{
+    comingsoon_args args;
+
+    sess->csInfo = pi_clone(info);
+    sess->csData = malloc(info->sz ? info->sz : 1);
+
+    if (NULL == sess->csInfo || NULL == sess->csData) {
+        LOG_SERROR1("Couldn't copy %u-byte data-product", info->sz);
+        sess_clearComingSoon(sess);
+        return ENOMEM;
+    }
+
+    (void)memcpy(sess->csData, data, info->sz);
+
+    args.infop = sess->csInfo;
+    args.pktsz = info->sz;
+
+    return sess_startSyncCall(sess, CALL_COMINGSOON, COMINGSOON,
+            (xdrproc_t)xdr_comingsoon_args, &args,
+            xlen_prod_info(info) + 16);
+}
+
+/*
+ * Sends the data of the announced data-product of a session via a BLKDATA
+ * message.
+ */
+static int
+sess_blkdata(
+    Session* const      sess)
+{
+    datapkt pkt;
+    int     status;
+
+    pkt.signaturep = &sess->csInfo->signature;
+    pkt.pktnum = 0;
+    pkt.data.dbuf_len = sess->csInfo->sz;
+    pkt.data.dbuf_val = sess->csData;
+
+    status = sess_call(sess, BLKDATA, ++nextXid, (xdrproc_t)xdr_datapkt, &pkt,
+            sess->csInfo->sz + sizeof(signaturet) + 32);
+
+    if (0 == status && ulogIsDebug())
+        udebug("%s", s_prod_info(NULL, 0, sess->csInfo, 1));
+
+    return status;
+}
+
+/*
+ * Sends a data-product to the downstream LDM of a session.  Called by
+ * pq_sequence().
+ *
+ * Arguments:
+ *      info    Pointer to the data-product's metadata.
+ *      data    Pointer to the data-product's data.
+ *      xprod   Pointer to the XDR-encoded data-product.
+ *      size    Size of the XDR-encoded data-product in bytes.
+ *      arg     Pointer to the session.  "isDone" is set on failure.
+ * Returns:
+ *      0       Always.
+ */
+/*ARGSUSED*/
+static int
+sess_send(
+    const prod_info* const      info,
+    const void* const           data,
+    void* const                 xprod,
+    const size_t                size,
+    void* const                 arg)
+{
+    Session* const  sess = (Session*)arg;
+
+    if (upFilter_isMatch(sess->upFilter, info)) {
+        const int   isDebug = ulogIsDebug();
+        int         status;
+
+        if (ulogIsVerbose() || isDebug) {
+            sess_setIdent(sess);
+            log_start("%s: %s", sess->isNotifier ? "notifying" : "sending",
+                    s_prod_info(NULL, 0, info, isDebug));
+            log_log(isDebug ? LOG_DEBUG : LOG_INFO);
+        }
+
+        if (sess->isNotifier) {
+            status = sess_call(sess, NOTIFICATION, ++nextXid,
+                    (xdrproc_t)xdr_prod_info, (void*)info,
+                    xlen_prod_info(info));
+        }
+        else if (sess->batching && info->sz <= BATCH_MAX_PRODUCT &&
+                size <= BATCH_MAX_BYTES) {
+            status = sess_addToBatch(sess, info, xprod, size,
+                    sess->compressing && zb_isWanted(info));
+        }
+        else if (sess->compressing && size >= zb_getThreshold() &&
+                zb_isWanted(info)) {
+            status = sess_hereisCompressed(sess, info, xprod, size);
+        }
+        else if (sess->isPrimary) {
+            status = sess_hereis(sess, xprod, size);
+        }
+        else {
+            status = sess_comingSoon(sess, info, data);
+        }
+
+        if (status) {
+            sess_setIdent(sess);
+            log_log(LOG_ERR);
+            sess->isDone = 1;
+        }
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ * Shared-cursor groups:
+ ******************************************************************************/
+
+/*
+ * Indicates if a session can be a member of a group.  A feeder that uses
+ * COMINGSOON/BLKDATA messages can't because every data-product requires a
+ * round-trip.
+ */
+static int
+sess_isGroupable(
+    const Session* const        sess)
+{
+    return !sess->isDone && (sess->isNotifier || sess->isPrimary);
+}
+
+/*
+ * Indicates if a member of a group can't accept more data-products now.
+ */
+static int
+sess_isBusy(
+    const Session* const        sess)
+{
+    return CALL_NONE != sess->call ||
+            sess->out.len - sess->outHead >= LOW_WATER;
+}
+
+/*
+ * Frees a group.  The group must be empty.
+ */
+static void
+group_free(
+    Group* const        group)
+{
+    unsigned    i;
+
+    for (i = 0; i < groupCount; i++) {
+        if (groups[i] == group) {
+            groups[i] = groups[--groupCount];
+            break;
+        }
+    }
+
+    free_prod_class(group->prodClass);
+    free(group->members);
+    free(group);
+}
+
+static void
+group_leave(
+    Session* const      sess)
+{
+    Group* const    group = sess->group;
+    unsigned        i;
+
+    for (i = 0; i < group->count; i++) {
+        if (group->members[i] == sess) {
+            group->members[i] = group->members[--group->count];
+            break;
+        }
+    }
+
+    sess->cursor = group->cursor;
+    sess->mt = TV_GT;
+    sess->atEnd = 0;
+    sess->group = NULL;
+
+    if (0 == group->count)
+        group_free(group);
+}
+
+/*
+ * Adds a session to a group.
+ *
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory. log_start() called.
+ */
+static int
+group_add(
+    Group* const        group,
+    Session* const      sess)
+{
+    if (group->count >= group->max) {
+        const unsigned  max = group->max ? 2*group->max : 8;
+        Session** const list = realloc(group->members,
+                max * sizeof(Session*));
+
+        if (NULL == list) {
+            LOG_SERROR0("Couldn't allocate group member list");
+            return ENOMEM;
+        }
+
+        group->members = list;
+        group->max = max;
+    }
+
+    group->members[group->count++] = sess;
+    sess->group = group;
+    sess->blockedSince = 0;
+    sess->inTurn = 0;
+
+    return 0;
+}
+
+/*
+ * Returns a new group whose cursor is that of a session.
+ *
+ * Returns:
+ *      NULL    Out of memory. log_start() called.
+ *      else    The new group.
+ */
+static Group*
+group_new(
+    const Session* const        sess)
+{
+    Group*  group;
+
+    if (groupCount >= groupMax) {
+        const unsigned  max = groupMax ? 2*groupMax : 16;
+        Group** const   list = realloc(groups, max * sizeof(Group*));
+
+        if (NULL == list) {
+            LOG_SERROR0("Couldn't allocate group list");
+            return NULL;
+        }
+
+        groups = list;
+        groupMax = max;
+    }
+
+    group = calloc(1, sizeof(Group));
+
+    if (NULL == group || NULL == (group->prodClass =
+            dup_prod_class(sess->prodClass))) {
+        LOG_SERROR0("Couldn't allocate group");
+        free(group);
+        return NULL;
+    }
+
+    group->cursor = sess->cursor;
+    group->mt = TV_GT;
+    group->atEnd = sess->atEnd;
+    groups[groupCount++] = group;
+
+    return group;
+}
+
+/*
+ * Adds a session that has just reached the end of the product-queue to the
+ * group for its subscription -- creating the group if necessary.  The
+ * subscriptions of a group's members have the same feedtypes, patterns, and
+ * end-time; their start-times don't matter because the members have caught
+ * up.  The session isn't added if the group is behind it because the session
+ * would receive data-products twice.
+ */
+static void
+group_join(
+    Session* const      sess)
+{
+    Group*      group = NULL;
+    unsigned    i;
+
+    for (i = 0; i < groupCount; i++) {
+        const prod_class_t* const   clss = groups[i]->prodClass;
+
+        if (tvEqual(clss->to, sess->prodClass->to) &&
+                clsspsa_eq(clss, sess->prodClass)) {
+            group = groups[i];
+            break;
+        }
+    }
+
+    if (NULL != group) {
+        if (tvCmp(group->cursor, sess->cursor, <))
+            return;
+    }
+    else if (NULL == (group = group_new(sess))) {
+        log_log(LOG_ERR);
+        return;
+    }
+
+    if (group_add(group, sess)) {
+        log_log(LOG_ERR);
+
+        if (0 == group->count)
+            group_free(group);
+    }
+    else {
+        sess_setIdent(sess);
+        udebug("Joined group of %u sessions", group->count);
+    }
+}
+
+/*
+ * Sends a data-product to every member of a group whose turn it is.  Called
+ * by pq_sequence().
+ */
+static int
+group_send(
+    const prod_info* const      info,
+    const void* const           data,
+    void* const                 xprod,
+    const size_t                size,
+    void* const                 arg)
+{
+    Group* const    group = (Group*)arg;
+    unsigned        i;
+
+    for (i = 0; i < group->count; i++) {
+        Session* const  sess = group->members[i];
+
+        if (sess->inTurn && !sess->isDone) {
+            (void)sess_send(info, data, xprod, size, sess);
+
+            if (sess->out.len - sess->outHead >= HIGH_WATER)
+                group->isFull = 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Fills the outputs of the members of a group with data-products from the
+ * product-queue -- up to a limit.  The group waits for a busy member for at
+ * most GROUP_LAG seconds; after that, the member leaves the group so that it
+ * doesn't delay the other members.
+ *
+ * Returns:
+ *      0       The group still exists.
+ *      else    The group was freed because all its members left.
+ */
+static int
+group_fill(
+    Group* const        group,
+    const time_t        now)
+{
+    int         isBlocked = 0;
+    unsigned    i;
+    unsigned    n;
+
+    if (group->atEnd)
+        return 0;
+
+    for (i = group->count; i-- > 0;) {
+        Session* const  sess = group->members[i];
+
+        sess->inTurn = 0;
+
+        if (sess->isDone)
+            continue;
+
+        if (!sess_isBusy(sess)) {
+            sess->blockedSince = 0;
+            sess->inTurn = 1;
+        }
+        else if (0 == sess->blockedSince) {
+            sess->blockedSince = now;
+            isBlocked = 1;
+        }
+        else if (now - sess->blockedSince < GROUP_LAG) {
+            isBlocked = 1;
+        }
+        else {
+            const int   isLast = 1 == group->count;
+
+            sess_setIdent(sess);
+            uinfo("Leaving group of %u sessions: can't keep up",
+                    group->count);
+            group_leave(sess);
+
+            if (isLast)
+                return 1;
+        }
+    }
+
+    if (isBlocked)
+        return 0;
+
+    group->isFull = 0;
+    pq_cset(hubPq, &group->cursor);
+
+    for (n = 0; n < TURN_PRODUCTS && !group->isFull; n++) {
+        const int   status = pq_sequence(hubPq, group->mt, group->prodClass,
+                group_send, group);
+
+        if (status) {
+            group->atEnd = 1;
+
+            if (EAGAIN == status || EACCES == status) {
+                lockHit = 1;
+            }
+            else if (PQUEUE_END != status) {
+                uerror("Product send failure: %s", strerror(status));
+
+                for (i = 0; i < group->count; i++)
+                    group->members[i]->isDone = 1;
+            }
+            break;
+        }
+    }
+
+    pq_ctimestamp(hubPq, &group->cursor);
+
+    return 0;
+}
+
+/*
+ * Indicates if a group can immediately send more data-products.
+ */
+static int
+group_isRunnable(
+    const Group* const  group)
+{
+    unsigned    i;
+
+    if (group->atEnd)
+        return 0;
+
+    for (i = 0; i < group->count; i++) {
+        if (sess_isBusy(group->members[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+/******************************************************************************
+ * Sessions (continued):
+ ******************************************************************************/
+
+/*
+ * Fills the output of a session with data-products from the product-queue --
+ * up to a limit.  A session that reaches the end of the product-queue joins
+ * the group for its subscription, if possible.
+ */
+static void
+sess_fill(
+    Session* const      sess)
+{
+    unsigned    n;
+    int         reachedEnd = 0;
+
+    pq_cset(hubPq, &sess->cursor);
+
+    for (n = 0; n < TURN_PRODUCTS && !sess->isDone &&
+            CALL_NONE == sess->call &&
+            sess->out.len - sess->outHead < HIGH_WATER; n++) {
+        const int   status = pq_sequence(hubPq, sess->mt, sess->prodClass,
+                sess_send, sess);
+
+        if (status) {
+            if (PQUEUE_END == status) {
+                sess->atEnd = 1;
+                reachedEnd = 1;
+            }
+            else if (EAGAIN == status || EACCES == status) {
+                sess->atEnd = 1;
+                lockHit = 1;
+            }
+            else {
+                sess_setIdent(sess);
+                uerror("Product send failure: %s", strerror(status));
+                sess->isDone = 1;
+            }
+            break;
+        }
+    }
+
+    pq_ctimestamp(hubPq, &sess->cursor);
+
+    if (reachedEnd && sess_isGroupable(sess))
+        group_join(sess);
+}
+
+/*
+ * Writes as much of the output of a session as possible without blocking.
+ */
+static void
+sess_write(
+    Session* const      sess)
+{
+    sess_closeBatch(sess);
+
+    while (sess->outHead < sess->out.len) {
+        const ssize_t   n = write(sess->sock, sess->out.buf + sess->outHead,
+                sess->out.len - sess->outHead);
+
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+
+            if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                sess_setIdent(sess);
+                serror("Couldn't write to downstream LDM");
+                sess->isDone = 1;
+            }
+            break;
+        }
+
+        sess->outHead += n;
+    }
+
+    if (sess->outHead == sess->out.len) {
+        sess->outHead = sess->out.len = 0;
+
+        if (sess->out.size > 4*HIGH_WATER)
+            buf_free(&sess->out); /* don't keep a large product's buffer */
+    }
+    else if (sess->outHead >= sess->out.size / 2) {
+        sess->out.len -= sess->outHead;
+        (void)memmove(sess->out.buf, sess->out.buf + sess->outHead,
+                sess->out.len);
+        sess->outHead = 0;
+    }
+}
+
+/*
+ * Handles a reply record from the downstream LDM of a session.
+ *
+ * Returns:
+ *      0       Success.
+ *      else    Failure. log_start() called.
+ */
+static int
+sess_handleReply(
+    Session* const      sess,
+    char* const         rec,
+    const size_t        len)
+{
+    XDR                 xdrs;
+    struct rpc_msg      msg;
+    comingsoon_reply_t  csReply = OK;
+    int                 status = 0;
+
+    (void)memset(&msg, 0, sizeof(msg));
+    msg.acpted_rply.ar_verf = _null_auth;
+    msg.acpted_rply.ar_results.where = (caddr_t)&csReply;
+    msg.acpted_rply.ar_results.proc = CALL_COMINGSOON == sess->call
+            ? (xdrproc_t)xdr_comingsoon_reply_t
+            : (xdrproc_t)xdr_void;
+
+    xdrmem_create(&xdrs, rec, len, XDR_DECODE);
+
+    if (!xdr_replymsg(&xdrs, &msg)) {
+        LOG_START0("Couldn't decode RPC reply");
+        status = EPROTO;
+    }
+    else if (CALL_NONE == sess->call || msg.rm_xid != sess->callXid) {
+        uwarn("Ignoring unexpected RPC reply: xid=%lu",
+                (unsigned long)msg.rm_xid);
+    }
+    else {
+        const CallType  call = sess->call;
+        struct rpc_err  err;
+
+        _seterr_reply(&msg, &err);
+        sess->call = CALL_NONE;
+
+        switch (call) {
+        case CALL_PROBE:
+            if (RPC_SUCCESS == err.re_status) {
+                sess->batching = 1;
+            }
+            else if (RPC_PROCUNAVAIL == err.re_status) {
+                sess->batching = 0;
+            }
+            else {
+                LOG_START2("Couldn't determine if %s accepts batched "
+                        "products: %s", sess->downName,
+                        clnt_sperrno(err.re_status));
+                status = EPROTO;
+                break;
+            }
+            sess_setIdent(sess);
+            uinfo("%s batched products",
+                    sess->batching ? "Sending" : "Not sending");
+            if (sess->batching && zb_isEnabled())
+                status = sess_zprobe(sess);
+            break;
+
+        case CALL_ZPROBE:
+            /*
+             * A downstream LDM that doesn't know the compression method can't
+             * decode the arguments.
+             */
+            if (RPC_SUCCESS == err.re_status) {
+                sess->compressing = 1;
+            }
+            else if (RPC_PROCUNAVAIL == err.re_status ||
+                    RPC_CANTDECODEARGS == err.re_status) {
+                sess->compressing = 0;
+            }
+            else {
+                LOG_START2("Couldn't determine if %s accepts compressed "
+                        "products: %s", sess->downName,
+                        clnt_sperrno(err.re_status));
+                status = EPROTO;
+                break;
+            }
+            sess_setIdent(sess);
+            uinfo("%s compressed products",
+                    sess->compressing ? "Sending" : "Not sending");
+            break;
+
+        case CALL_NULLPROC:
+            if (RPC_SUCCESS != err.re_status) {
+                LOG_START2("flushConnection() failure to %s: %s",
+                        sess->downName, clnt_sperrno(err.re_status));
+                status = EPROTO;
+            }
+            else {
+                udebug("flushConnection() success");
+            }
+            break;
+
+        case CALL_COMINGSOON:
+            if (RPC_SUCCESS != err.re_status) {
+                LOG_START1("COMINGSOON: %s", clnt_sperrno(err.re_status));
+                status = EPROTO;
+            }
+            else if (DONT_SEND != csReply) {
+                status = sess_blkdata(sess);
+            }
+            sess_clearComingSoon(sess);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    xdr_destroy(&xdrs);
+
+    return status;
+}
+
+/*
+ * Reads and handles replies from the downstream LDM of a session without
+ * blocking.
+ */
+static void
+sess_read(
+    Session* const      sess)
+{
+    size_t  off = 0;
+    int     status = 0;
+
+    for (;;) {
+        ssize_t n;
+
+        if ((status = buf_reserve(&sess->in, 4096)))
+            break;
+
+        n = read(sess->sock, sess->in.buf + sess->in.len,
+                sess->in.size - sess->in.len);
+
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+
+            if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                LOG_SERROR0("Couldn't read from downstream LDM");
+                status = errno;
+            }
+            break;
+        }
+
+        if (0 == n) {
+            sess_setIdent(sess);
+            uinfo("Connection with client LDM closed");
+            sess->isDone = 1;
+            break;
+        }
+
+        sess->in.len += n;
+    }
+
+    while (0 == status && sess->in.len - off >= 4) {
+        uint32_t    mark;
+        size_t      fragLen;
+
+        (void)memcpy(&mark, sess->in.buf + off, sizeof(mark));
+        mark = ntohl(mark);
+        fragLen = mark & 0x7fffffffu;
+
+        if (sess->rec.len + fragLen > MAX_RECORD) {
+            LOG_START1("RPC reply too large: %lu bytes",
+                    (unsigned long)(sess->rec.len + fragLen));
+            status = EPROTO;
+            break;
+        }
+
+        if (sess->in.len - off - 4 < fragLen)
+            break;
+
+        if ((status = buf_append(&sess->rec, sess->in.buf + off + 4, fragLen)))
+            break;
+
+        off += 4 + fragLen;
+
+        if (mark & 0x80000000u) {
+            status = sess_handleReply(sess, sess->rec.buf, sess->rec.len);
+            sess->rec.len = 0;
+        }
+    }
+
+    if (off) {
+        sess->in.len -= off;
+        (void)memmove(sess->in.buf, sess->in.buf + off, sess->in.len);
+    }
+
+    if (status) {
+        sess_setIdent(sess);
+        log_log(LOG_ERR);
+        sess->isDone = 1;
+    }
+}
+
+/*
+ * Services a session: sends a keep-alive or data-products as appropriate and
+ * writes what it can.
+ */
+static void
+sess_service(
+    Session* const      sess,
+    const time_t        now)
+{
+    if (CALL_NONE != sess->call) {
+        if (now - sess->callTime > REPLY_TIMEOUT) {
+            sess_setIdent(sess);
+            unotice("Downstream LDM didn't reply for %d seconds",
+                    REPLY_TIMEOUT);
+            sess->isDone = 1;
+            return;
+        }
+    }
+    else if (NULL == sess->group && !sess->atEnd &&
+            sess->out.len - sess->outHead < LOW_WATER) {
+        sess_fill(sess);
+    }
+    else if ((sess->group ? sess->group->atEnd : sess->atEnd) &&
+            sess->out.len == sess->outHead &&
+            now - sess->lastSend >= (time_t)interval) {
+        if (sess_startSyncCall(sess, CALL_NULLPROC, NULLPROC, NULL, NULL, 0)) {
+            sess_setIdent(sess);
+            log_log(LOG_ERR);
+            sess->isDone = 1;
+        }
+    }
+
+    if (!sess->isDone && sess->out.len > sess->outHead)
+        sess_write(sess);
+}
+
+/*
+ * Indicates if a session can immediately send more data-products.
+ */
+static int
+sess_isRunnable(
+    const Session* const        sess)
+{
+    return NULL == sess->group && !sess->isDone && !sess->atEnd &&
+            CALL_NONE == sess->call && sess->out.len - sess->outHead < LOW_WATER;
+}
+
+/******************************************************************************
+ * Hub:
+ ******************************************************************************/
+
+/*
+ * Handles SIGCONT, which is sent to the process group when a data-product is
+ * inserted into the product-queue.
+ */
+static void
+hub_wake(
+    const int           sig)
+{
+    const int   savedErrno = errno;
+    char        byte = 0;
+
+    (void)write(wakePipe[1], &byte, 1);
+    errno = savedErrno;
+}
+
+/*
+ * Updates the load of this hub that's shared with the top-level LDM server.
+ */
+static void
+hub_setLoad(void)
+{
+    hubLoads[hubIndex].sessions = sessionCount + handshakeCount;
+}
+
+/*
+ * Dispatches an RPC request on a connection that hasn't yet become a
+ * session.  Only the requests that an upstream LDM hub handles are allowed.
+ */
+static void
+hub_dispatch(
+    struct svc_req*     rqstp,
+    SVCXPRT*            xprt)
+{
+    switch (rqstp->rq_proc) {
+    case NULLPROC:
+    case FEEDME:
+    case NOTIFYME:
+        ldmprog_6(rqstp, xprt);
+        break;
+    default:
+        svcerr_noproc(xprt);
+        break;
+    }
+}
+
+/*
+ * Doubles the capacity of the list of pending connections.
+ *
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory. log_start() called.
+ */
+static int
+hub_growHandshakes(void)
+{
+    const unsigned      max = handshakeMax ? 2*handshakeMax : 64;
+    Handshake* const    list = realloc(handshakes, max * sizeof(Handshake));
+
+    if (NULL == list) {
+        LOG_SERROR0("Couldn't allocate pending-connection list");
+        return ENOMEM;
+    }
+
+    handshakes = list;
+    handshakeMax = max;
+
+    return 0;
+}
+
+/*
+ * Removes a pending connection from the list.  Doesn't destroy its transport.
+ */
+static void
+hub_removeHandshake(
+    const unsigned      i)
+{
+    handshakes[i] = handshakes[--handshakeCount];
+    hub_setLoad();
+}
+
+/*
+ * Looks up the names of hosts for the hub that forked this process until the
+ * hub closes its end of the socket or this process is terminated.  Doesn't
+ * return.
+ *
+ * Arguments:
+ *      sock    UNIX-domain socket to the hub.
+ */
+static void
+hub_runResolver(
+    const int           sock)
+{
+    setulogident("uphub-resolver");
+
+    for (;;) {
+        NameRequest         req;
+        NameReply           reply;
+        struct sockaddr_in  addr;
+
+        if (recv(sock, &req, sizeof(req), MSG_WAITALL) != sizeof(req))
+            break;
+
+        (void)memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = req.addr;
+
+        (void)memset(&reply, 0, sizeof(reply));
+        reply.id = req.id;
+        (void)strncpy(reply.name, hostbyaddr(&addr), sizeof(reply.name)-1);
+
+        if (write(sock, &reply, sizeof(reply)) != sizeof(reply))
+            break;
+    }
+
+    exit(0);
+}
+
+/*
+ * Starts the resolver of this hub.  Should be called before the hub has
+ * connections because the resolver inherits its descriptors.
+ *
+ * Arguments:
+ *      ctl     UNIX-domain socket to the top-level LDM server.  Closed in the
+ *              resolver.
+ * Returns:
+ *      0       Success.
+ *      else    System error code. Error-message logged.
+ */
+static int
+hub_startResolver(
+    const int           ctl)
+{
+    int     fds[2];
+    pid_t   pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        serror("Couldn't create socket-pair for resolver");
+        return errno;
+    }
+
+    pid = ldmfork();
+
+    if (-1 == pid) {
+        LOG_ADD0("Couldn't fork resolver of upstream LDM hub");
+        log_log(LOG_ERR);
+        (void)close(fds[0]);
+        (void)close(fds[1]);
+        return errno ? errno : EAGAIN;
+    }
+
+    if (0 == pid) {
+        (void)close(fds[0]);
+        (void)close(ctl);
+        hub_runResolver(fds[1]);
+    }
+
+    (void)close(fds[1]);
+    (void)fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    resolverSock = fds[0];
+    resolverPid = pid;
+
+    return 0;
+}
+
+/*
+ * Stops the resolver of this hub.  Idempotent.
+ */
+static void
+hub_stopResolver(void)
+{
+    if (resolverSock >= 0) {
+        (void)close(resolverSock);
+        resolverSock = -1;
+    }
+
+    if (resolverPid > 0) {
+        /* An unfinished lookup mustn't delay the hub */
+        (void)kill(resolverPid, SIGTERM);
+        (void)waitpid(resolverPid, NULL, WNOHANG);
+        resolverPid = -1;
+    }
+}
+
+/*
+ * Vets a pending connection once the name of its remote host is known.
+ * Removes the connection and destroys its transport if the host isn't
+ * allowed.
+ *
+ * Arguments:
+ *      i       Index of the pending connection.
+ *      name    Name of the remote host or its IP address.
+ */
+static void
+hub_nameHandshake(
+    const unsigned      i,
+    const char* const   name)
+{
+    Handshake* const    handshake = handshakes + i;
+    SVCXPRT* const      xprt = handshake->xprt;
+    peer_info* const    remote = get_remote();
+
+    setremote(&xprt->xp_raddr, xprt->xp_sock);
+    setRemoteName(name);
+
+    /* Access control */
+    if (!lcf_isHostOk(remote)) {
+        if (remote->printname == remote->astr) {
+            unotice("Denying connection from [%s] because not allowed",
+                    remote->astr);
+        }
+        else {
+            unotice("Denying connection from \"%s\" because not allowed",
+                    remote_name());
+        }
+
+        svc_destroy(xprt);
+        hub_removeHandshake(i);
+        return;
+    }
+
+    set_abbr_ident(remote_name(), NULL);
+    uinfo("Connection from %s", remote_name());
+
+    (void)strncpy(handshake->name, name, HOSTNAMELEN-1);
+    handshake->name[HOSTNAMELEN-1] = 0;
+    handshake->isNamed = 1;
+}
+
+/*
+ * Vets the pending connections whose names haven't arrived as if their
+ * lookups had failed, i.e., by their IP addresses.
+ */
+static void
+hub_nameByAddress(void)
+{
+    unsigned    i;
+
+    for (i = handshakeCount; i-- > 0;) {
+        if (!handshakes[i].isNamed)
+            hub_nameHandshake(i,
+                    inet_ntoa(handshakes[i].xprt->xp_raddr.sin_addr));
+    }
+}
+
+/*
+ * Receives the names that the resolver has looked up and vets the
+ * corresponding pending connections.  A name whose connection has since been
+ * removed is discarded.  If the resolver has terminated, then the pending
+ * connections and all subsequent ones are vetted by their IP addresses.
+ */
+static void
+hub_receiveNames(void)
+{
+    while (resolverSock >= 0) {
+        NameReply       reply;
+        const ssize_t   n = recv(resolverSock, &reply, sizeof(reply),
+                MSG_DONTWAIT);
+        unsigned        i;
+
+        if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno ||
+                EINTR == errno))
+            break;
+
+        if (sizeof(reply) != n) {
+            if (n < 0) {
+                serror("Couldn't receive name from resolver");
+            }
+            else {
+                uerror("Resolver terminated: using IP addresses as names");
+            }
+
+            hub_stopResolver();
+            hub_nameByAddress();
+            break;
+        }
+
+        reply.name[sizeof(reply.name)-1] = 0;
+
+        for (i = 0; i < handshakeCount; i++) {
+            if (!handshakes[i].isNamed && handshakes[i].id == reply.id) {
+                hub_nameHandshake(i, reply.name);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Starts the handling of a connection received from the top-level LDM server:
+ * the connection is pending until the resolver has looked up the name of its
+ * remote host.  Closes the socket on failure.
+ */
+static void
+hub_addHandshake(
+    const int           sock)
+{
+    struct sockaddr_in  raddr;
+    socklen_t           len = sizeof(raddr);
+    peer_info* const    remote = get_remote();
+    SVCXPRT*            xprt;
+
+    (void)memset(&raddr, 0, sizeof(raddr));
+
+    if (getpeername(sock, (struct sockaddr*)&raddr, &len)) {
+        serror("getpeername()");
+    }
+    else if (sock >= FD_SETSIZE) {
+        uerror("Too many pending connections: socket %d", sock);
+    }
+    else if (handshakeCount >= handshakeMax && hub_growHandshakes()) {
+        log_log(LOG_ERR);
+    }
+    else {
+        setremote(&raddr, sock);
+
+        xprt = svcfd_create(sock, remote->sendsz, remote->recvsz);
+
+        if (NULL == xprt) {
+            uerror("Can't create fd service.");
+        }
+        else {
+            Handshake* const    handshake = handshakes + handshakeCount;
+            NameRequest         req;
+
+            (void)memcpy(&xprt->xp_raddr, &raddr, len);
+            xprt->xp_addrlen = (int)len;
+
+            if (!svc_register(xprt, LDMPROG, SIX, hub_dispatch, 0)) {
+                uerror("unable to register LDM-6 service.");
+                svc_destroy(xprt);
+                return;
+            }
+
+            handshake->xprt = xprt;
+            handshake->start = time(NULL);
+            handshake->id = ++nextLookupId;
+            handshake->isNamed = 0;
+            handshake->name[0] = 0;
+            handshakeCount++;
+            hub_setLoad();
+
+            req.id = handshake->id;
+            req.addr = raddr.sin_addr.s_addr;
+
+            if (resolverSock < 0 ||
+                    send(resolverSock, &req, sizeof(req), MSG_DONTWAIT) !=
+                    sizeof(req)) {
+                if (resolverSock >= 0)
+                    serror("Couldn't pass IP address to resolver");
+
+                hub_nameHandshake(handshakeCount-1, remote->astr);
+            }
+
+            return;
+        }
+    }
+
+    (void)close(sock);
+}
+
+/*
+ * Adds a session to this hub.
+ *
+ * Returns:
+ *      0       Success.
+ *      ENOMEM  Out of memory. log_start() called.
+ */
+static int
+hub_addSession(
+    Session* const      sess)
+{
+    if (sessionCount >= sessionMax) {
+        const unsigned  max = sessionMax ? 2*sessionMax : 64;
+        Session** const list = realloc(sessions, max * sizeof(Session*));
+
+        if (NULL == list) {
+            LOG_SERROR0("Couldn't allocate session list");
+            return ENOMEM;
+        }
+
+        sessions = list;
+        sessionMax = max;
+    }
+
+    sessions[sessionCount++] = sess;
+    hub_setLoad();
+
+    return 0;
+}
+
+/*
+ * Indicates whether the RPC layer can read the request on a pending
+ * connection without waiting, i.e., whether the complete RPC record is in the
+ * socket's receive buffer or the connection was closed.  The record is only
+ * peeked at.  If it's incomplete, then the socket's low-water mark is raised
+ * to the size of the record's next fragment so that poll(2) doesn't report
+ * the connection again until the fragment has arrived.
+ *
+ * Returns:
+ *      1       The request can be read without waiting.
+ *      0       More of the request is expected.
+ *      -1      The request is too large.
+ */
+static int
+hub_isRequestComplete(
+    const int           sock)
+{
+    static char     buf[MAX_RECORD];
+    const ssize_t   n = recv(sock, buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT);
+    size_t          off = 0;
+    size_t          need;
+    int             lowat;
+
+    if (0 == n)
+        return 1;                       /* EOF: let the RPC layer see it */
+
+    if (n < 0)
+        return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)
+            ? 0
+            : 1;                        /* error: ditto */
+
+    for (;;) {
+        uint32_t    mark;
+
+        if (off + 4 > (size_t)n) {
+            need = off + 4;
+            break;
+        }
+
+        (void)memcpy(&mark, buf + off, 4);
+        mark = ntohl(mark);
+        need = off + 4 + (mark & 0x7fffffff);
+
+        if (need > sizeof(buf))
+            return -1;
+
+        if (need > (size_t)n)
+            break;
+
+        if (mark & 0x80000000) {
+            need = 1;                   /* last fragment is complete */
+            break;
+        }
+
+        off = need;
+    }
+
+    lowat = (int)need;
+    (void)setsockopt(sock, SOL_SOCKET, SO_RCVLOWAT, &lowat, sizeof(lowat));
+
+    return 1 == need;
+}
+
+/*
+ * Reads a request from a pending connection.  If the request created a
+ * session, then the connection is taken from the server-side transport.
+ * Does nothing until the request has completely arrived because the RPC layer
+ * would wait for it and delay every session of the hub.
+ */
+static void
+hub_serviceHandshake(
+    const unsigned      i)
+{
+    SVCXPRT* const  xprt = handshakes[i].xprt;
+    const int       sock = xprt->xp_sock;
+    const int       isComplete = hub_isRequestComplete(sock);
+
+    if (0 == isComplete)
+        return;
+
+    if (0 > isComplete) {
+        set_abbr_ident(inet_ntoa(xprt->xp_raddr.sin_addr), NULL);
+        uerror("Request from client LDM is larger than %d bytes", MAX_RECORD);
+        svc_destroy(xprt);
+        hub_removeHandshake(i);
+        return;
+    }
+
+    /*
+     * The server-side functions use the global information on the remote
+     * host, which might have been set by another connection.
+     */
+    setremote(&xprt->xp_raddr, sock);
+    setRemoteName(handshakes[i].name);
+
+    adoptee = NULL;
+    svc_getreqsock(sock);  /* calls uphub_addSession() if appropriate */
+
+    if (!FD_ISSET(sock, &svc_fdset)) {
+        /*
+         * The transport was destroyed: the connection was closed.
+         */
+        hub_removeHandshake(i);
+        sess_free(adoptee);
+    }
+    else if (NULL != adoptee) {
+        Session* const  sess = adoptee;
+        int             fd;
+
+        /*
+         * Sessions use descriptors above those usable by the RPC layer so
+         * that pending connections can continue to be handled.
+         */
+        fd = fcntl(sock, F_DUPFD, FD_SETSIZE);
+        if (fd < 0)
+            fd = dup(sock);
+
+        hub_removeHandshake(i);
+        svc_destroy(xprt); /* closes "sock" */
+
+        sess->sock = fd;
+        sess_setIdent(sess);
+
+        if (fd < 0) {
+            serror("Couldn't duplicate socket");
+            sess_free(sess);
+        }
+        else if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+            serror("fcntl(F_SETFL) failure");
+            sess_free(sess);
+        }
+        else if (hub_addSession(sess)) {
+            log_log(LOG_ERR);
+            sess_free(sess);
+        }
+        else {
+            char    buf[64];
+            char*   sig = sess->hasSignature
+                    ? s_signaturet(buf, sizeof(buf), sess->signature)
+                    : "NONE";
+
+            if (sess->isNotifier) {
+                unotice("Starting Up(%s/6): %s, SIG=%s", PACKAGE_VERSION,
+                        s_prod_class(NULL, 0, sess->prodClass), sig);
+            }
+            else {
+                unotice("Starting Up(%s/6): %s, SIG=%s, %s", PACKAGE_VERSION,
+                        s_prod_class(NULL, 0, sess->prodClass), sig,
+                        sess->isPrimary ? "Primary" : "Alternate");
+            }
+            unotice("topo:  %s %s", sess->downName,
+                    upFilter_toString(sess->upFilter));
+
+            if (!sess->isNotifier && sess->isPrimary && sess_probe(sess)) {
+                log_log(LOG_ERR);
+                sess->isDone = 1;
+            }
+        }
+    }
+
+    adoptee = NULL;
+}
+
+/*
+ * Receives a connection from the top-level LDM server.
+ *
+ * Returns:
+ *      0       Success or nothing to receive.
+ *      -1      The top-level LDM server closed its end.
+ */
+static int
+hub_receive(
+    const int           ctl)
+{
+    struct msghdr   msg;
+    struct iovec    iov;
+    char            byte;
+    union {
+        struct cmsghdr  hdr;
+        char            buf[CMSG_SPACE(sizeof(int))];
+    }               ctrl;
+    ssize_t         n;
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    (void)memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    n = recvmsg(ctl, &msg, 0);
+
+    if (0 == n)
+        return -1;
+
+    if (n < 0) {
+        if (EINTR != errno && EAGAIN != errno)
+            serror("Couldn't receive connection from LDM server");
+    }
+    else {
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+
+        hubLoads[hubIndex].received++;
+
+        if (NULL == cmsg || SOL_SOCKET != cmsg->cmsg_level ||
+                SCM_RIGHTS != cmsg->cmsg_type) {
+            uerror("Message from LDM server has no socket");
+        }
+        else {
+            int sock;
+
+            (void)memcpy(&sock, CMSG_DATA(cmsg), sizeof(sock));
+            hub_addHandshake(sock);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Ends the sessions whose entries were removed from the upstream LDM database
+ * by the vetting of a newer subscription.
+ */
+static void
+hub_vetSessions(void)
+{
+    uldb_Iter*  iter;
+
+    if (uldb_getIterator(&iter)) {
+        LOG_ADD0("Couldn't get upstream LDM database iterator");
+        log_log(LOG_ERR);
+    }
+    else {
+        const pid_t         pid = getpid();
+        const uldb_Entry*   entry;
+        unsigned            i;
+
+        for (i = 0; i < sessionCount; i++)
+            sessions[i]->isListed = 0;
+
+        for (entry = uldb_iter_firstEntry(iter); NULL != entry;
+                entry = uldb_iter_nextEntry(iter)) {
+            if (uldb_entry_getPid(entry) == pid) {
+                const unsigned  id = uldb_entry_getSession(entry);
+
+                for (i = 0; i < sessionCount; i++) {
+                    if (sessions[i]->id == id) {
+                        sessions[i]->isListed = 1;
+                        break;
+                    }
+                }
+            }
+        }
+
+        uldb_iter_free(iter);
+
+        for (i = 0; i < sessionCount; i++) {
+            if (!sessions[i]->isListed) {
+                sess_setIdent(sessions[i]);
+                unotice("Subscription superseded by a newer one");
+                sessions[i]->isDone = 1;
+            }
+        }
+    }
+}
+
+/*
+ * Runs an upstream LDM hub until the "done" global variable is set.
+ *
+ * Arguments:
+ *      ctl     UNIX-domain socket to the top-level LDM server.
+ * Returns:
+ *      0       Success.
+ *      else    Failure. Error-message logged.
+ */
+static int
+hub_run(
+    const int           ctl)
+{
+    const char* const   pqPath = getQueuePath();
+    struct rlimit       rlim;
+    struct sigaction    sigact;
+    struct pollfd*      fds = NULL;
+    unsigned            fdMax = 0;
+    time_t              lastTick = time(NULL);
+    time_t              lastVet = lastTick;
+    int                 ctlOpen = 1;
+    int                 status;
+
+    setulogident("uphub");
+
+    if ((status = hub_startResolver(ctl)))
+        return status;
+
+    /*
+     * A hub handles many connections.
+     */
+    if (0 == getrlimit(RLIMIT_NOFILE, &rlim) && rlim.rlim_cur < rlim.rlim_max) {
+        rlim.rlim_cur = rlim.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &rlim);
+    }
+
+    if ((status = pq_open(pqPath, PQ_READONLY, &hubPq))) {
+        if (PQ_CORRUPT == status) {
+            uerror("The product-queue \"%s\" is inconsistent", pqPath);
+        }
+        else {
+            uerror("Couldn't open product-queue \"%s\": %s", pqPath,
+                    strerror(status));
+        }
+        return status;
+    }
+
+    if (pipe(wakePipe)) {
+        serror("Couldn't create wake-up pipe");
+        return errno;
+    }
+    (void)fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+    (void)fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+    (void)sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = SA_RESTART;
+    sigact.sa_handler = hub_wake;
+    (void)sigaction(SIGCONT, &sigact, NULL);
+
+    unotice("Starting Up(%s/6): upstream LDM hub %d", PACKAGE_VERSION,
+            hubIndex);
+
+    while (!done) {
+        const unsigned  nfds = HUB_FDS + handshakeCount + sessionCount;
+        int             timeout = lockHit ? 10 : 1000;
+        time_t          now = time(NULL);
+        unsigned        i;
+        int             ready;
+
+        /*
+         * Give each group and then each session a turn.
+         */
+        for (i = groupCount; i-- > 0;)
+            (void)group_fill(groups[i], now);
+
+        for (i = 0; i < sessionCount; i++) {
+            Session* const  sess = sessions[i];
+
+            if (!sess->isDone)
+                sess_service(sess, now);
+
+            if (sess_isRunnable(sess))
+                timeout = 0;
+        }
+
+        /*
+         * End the sessions that are done.
+         */
+        for (i = sessionCount; i-- > 0;) {
+            if (sessions[i]->isDone) {
+                sess_setIdent(sessions[i]);
+                uinfo("Done");
+                sess_free(sessions[i]);
+                sessions[i] = sessions[--sessionCount];
+            }
+        }
+        hub_setLoad();
+
+        for (i = 0; i < groupCount; i++) {
+            if (group_isRunnable(groups[i]))
+                timeout = 0;
+        }
+
+        if (nfds > fdMax) {
+            struct pollfd*  mem = realloc(fds, 2*nfds * sizeof(struct pollfd));
+
+            if (NULL == mem) {
+                serror("Couldn't allocate poll(2) list");
+                status = ENOMEM;
+                break;
+            }
+
+            fds = mem;
+            fdMax = 2*nfds;
+        }
+
+        fds[0].fd = ctlOpen ? ctl : -1;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakePipe[0];
+        fds[1].events = POLLIN;
+        fds[2].fd = resolverSock;
+        fds[2].events = POLLIN;
+
+        /* A connection waiting for its name isn't serviced */
+        for (i = 0; i < handshakeCount; i++) {
+            fds[HUB_FDS+i].fd = handshakes[i].isNamed
+                    ? handshakes[i].xprt->xp_sock
+                    : -1;
+            fds[HUB_FDS+i].events = POLLIN;
+        }
+
+        for (i = 0; i < sessionCount; i++) {
+            const Session* const    sess = sessions[i];
+            struct pollfd* const    pfd = fds + HUB_FDS + handshakeCount + i;
+
+            pfd->fd = sess->sock;
+            pfd->events = POLLIN;
+
+            if (sess->out.len > sess->outHead)
+                pfd->events |= POLLOUT;
+        }
+
+        ready = poll(fds, nfds, timeout);
+
+        if (ready < 0) {
+            if (EINTR != errno) {
+                serror("poll() failure");
+                status = errno;
+                break;
+            }
+            continue;
+        }
+
+        now = time(NULL);
+
+        /*
+         * Handle the sessions before the pending connections because the
+         * latter can change the list of sessions.
+         */
+        for (i = 0; i < sessionCount; i++) {
+            const short revents = fds[HUB_FDS + handshakeCount + i].revents;
+            Session* const  sess = sessions[i];
+
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+                sess_read(sess);
+
+            if (!sess->isDone && (revents & POLLOUT))
+                sess_write(sess);
+        }
+
+        for (i = handshakeCount; i-- > 0;) {
+            if (fds[HUB_FDS+i].revents) {
+                hub_serviceHandshake(i);
+            }
+            else if (!handshakes[i].isNamed) {
+                if (now - handshakes[i].start > 2*(time_t)interval) {
+                    /* As if the lookup had failed */
+                    unotice("Name of [%s] not looked up within %u seconds",
+                            inet_ntoa(handshakes[i].xprt->xp_raddr.sin_addr),
+                            2*interval);
+                    hub_nameHandshake(i,
+                            inet_ntoa(handshakes[i].xprt->xp_raddr.sin_addr));
+                }
+            }
+            else if (now - handshakes[i].start > 2*(time_t)interval) {
+                set_abbr_ident(inet_ntoa(handshakes[i].xprt->xp_raddr.sin_addr),
+                        NULL);
+                unotice("Connection from client LDM silent for %u seconds",
+                        2*interval);
+                svc_destroy(handshakes[i].xprt);
+                hub_removeHandshake(i);
+            }
+        }
+
+        /*
+         * Names are received after the pending connections have been
+         * handled because vetting can remove a pending connection.
+         */
+        if (fds[2].revents)
+            hub_receiveNames();
+
+        if (fds[0].revents && hub_receive(ctl)) {
+            /*
+             * The top-level LDM server is terminating.  The hub will be
+             * terminated by a signal.
+             */
+            ctlOpen = 0;
+        }
+
+        if (fds[1].revents || lockHit || now - lastTick >= 1) {
+            char    buf[64];
+
+            while (read(wakePipe[0], buf, sizeof(buf)) > 0)
+                ;
+
+            for (i = 0; i < sessionCount; i++)
+                sessions[i]->atEnd = 0;
+            for (i = 0; i < groupCount; i++)
+                groups[i]->atEnd = 0;
+
+            lockHit = 0;
+            lastTick = now;
+        }
+
+        if (now - lastVet >= VET_INTERVAL) {
+            hub_vetSessions();
+            lastVet = now;
+        }
+    }
+
+    while (sessionCount > 0)
+        sess_free(sessions[--sessionCount]);
+
+    while (handshakeCount > 0) {
+        SVCXPRT* const  xprt = handshakes[--handshakeCount].xprt;
+
+        svc_destroy(xprt);
+    }
+
+    hub_stopResolver();
+    free(fds);
+    (void)pq_close(hubPq);
+    hubPq = NULL;
+
+    return status;
+}
+
+/*
+ * Starts an upstream LDM hub.
+ *
+ * Arguments:
+ *      index   Index of the hub.
+ *      sock    Connection that the top-level LDM server is passing to a hub
+ *              or -1.  Closed in the hub, which mustn't keep it open.
+ * Returns:
+ *      0       Success.
+ *      else    System error code. log_start() called.
+ */
+static int
+hub_start(
+    const unsigned      index,
+    const int           sock)
+{
+    int     fds[2];
+    pid_t   pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        LOG_SERROR0("Couldn't create socket-pair for upstream LDM hub");
+        return errno;
+    }
+
+    pid = ldmfork();
+
+    if (-1 == pid) {
+        LOG_ADD0("Couldn't fork upstream LDM hub");
+        (void)close(fds[0]);
+        (void)close(fds[1]);
+        return errno ? errno : EAGAIN;
+    }
+
+    if (0 == pid) {
+        /* Child process */
+        unsigned    i;
+
+        (void)close(fds[0]);
+
+        if (sock >= 0)
+            (void)close(sock);
+
+        for (i = 0; i < hubCount; i++) {
+            if (hubs[i].ctl >= 0)
+                (void)close(hubs[i].ctl);
+        }
+
+        if (hubChildInit)
+            hubChildInit();
+
+        endpriv();
+
+        hubIndex = index;
+        hubLoads[index].received = 0;
+        hubLoads[index].sessions = 0;
+
+        exit(hub_run(fds[1]) ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    /* Parent process */
+    (void)close(fds[1]);
+
+    hubs[index].pid = pid;
+    hubs[index].ctl = fds[0];
+    hubs[index].sent = 0;
+
+    if (cps_add(pid))
+        serror("Couldn't add upstream LDM hub's PID to set");
+
+    return 0;
+}
+
+/******************************************************************************
+ * Public API:
+ ******************************************************************************/
+
+/**
+ * Starts a pool of upstream LDM hubs.  Should only be called by the top-level
+ * LDM server and only once.  Each hub is a child process that's added to the
+ * set of child processes (see "child_process_set.h") and that's restarted by
+ * uphub_handOff() if it's found to have terminated.
+ *
+ * @param count         [in] Number of hubs. Shall be positive and not greater
+ *                      than UPHUB_MAX_HUBS.
+ * @param childInit     [in] Function called by each hub process immediately
+ *                      after it's forked (e.g., to close the listening socket)
+ *                      or NULL.
+ * @retval 0            Success.
+ * @retval EINVAL       "count" is invalid. log_start() called.
+ * @return              System error code. log_start() called.
+ */
+int
+uphub_startPool(
+    const unsigned      count,
+    void              (*childInit)(void))
+{
+    unsigned    i;
+
+    if (0 == count || UPHUB_MAX_HUBS < count) {
+        LOG_START2("Invalid number of upstream LDM hubs: %u (maximum is %d)",
+                count, UPHUB_MAX_HUBS);
+        return EINVAL;
+    }
+
+    hubLoads = (HubLoad*)mmap(NULL, UPHUB_MAX_HUBS * sizeof(HubLoad),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+
+    if (MAP_FAILED == hubLoads) {
+        LOG_SERROR0("Couldn't allocate shared memory for upstream LDM hubs");
+        hubLoads = NULL;
+        return errno;
+    }
+
+    (void)memset(hubLoads, 0, UPHUB_MAX_HUBS * sizeof(HubLoad));
+    hubChildInit = childInit;
+
+    for (i = 0; i < count; i++)
+        hubs[i].ctl = -1;
+
+    hubCount = count;
+
+    for (i = 0; i < count; i++) {
+        const int   status = hub_start(i, -1);
+
+        if (status)
+            return status;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the number of upstream LDM hubs.
+ *
+ * @return  The number of hubs. Zero if uphub_startPool() hasn't been called.
+ */
+unsigned
+uphub_getHubCount(void)
+{
+    return hubCount;
+}
+
+/**
+ * Returns the total number of downstream LDM-s that the upstream LDM hubs are
+ * feeding or notifying or will shortly be vetting.
+ *
+ * @return  The total number of sessions of all hubs.
+ */
+unsigned
+uphub_getSessionCount(void)
+{
+    unsigned    count = 0;
+    unsigned    i;
+
+    for (i = 0; i < hubCount; i++)
+        count += hubLoads[i].sessions + (hubs[i].sent - hubLoads[i].received);
+
+    return count;
+}
+
+/**
+ * Returns the kind of the first request on a new connection without consuming
+ * it.  Doesn't block.
+ *
+ * @param sock          [in] The connected socket. Should be ready for
+ *                      reading.
+ * @retval UPHUB_REQ_HUB    The request can be handled by a hub.
+ * @retval UPHUB_REQ_OTHER  The request must be handled by a dedicated process
+ *                          (this includes an incomplete request).
+ * @retval UPHUB_REQ_CLOSED The remote host closed the connection.
+ */
+uphub_Request
+uphub_getRequestType(
+    const int           sock)
+{
+    /*
+     * Record-mark, transaction ID, message type, RPC version, program,
+     * version, and procedure:
+     */
+    uint32_t    hdr[7];
+    ssize_t     n = recv(sock, hdr, sizeof(hdr), MSG_PEEK | MSG_DONTWAIT);
+
+    if (0 == n)
+        return UPHUB_REQ_CLOSED;
+
+    if (sizeof(hdr) != n)
+        return UPHUB_REQ_OTHER;
+
+    return (CALL == ntohl(hdr[2]) && RPC_MSG_VERSION == ntohl(hdr[3]) &&
+            LDMPROG == ntohl(hdr[4]) && SIX == ntohl(hdr[5]) &&
+            (FEEDME == ntohl(hdr[6]) || NOTIFYME == ntohl(hdr[6])))
+        ? UPHUB_REQ_HUB
+        : UPHUB_REQ_OTHER;
+}
+
+/**
+ * Passes a new connection to the least-loaded upstream LDM hub.  The caller
+ * should close the socket on success.  Makes at most HANDOFF_TRIES attempts.
+ *
+ * @param sock          [in] The connected socket.
+ * @retval 0            Success.
+ * @return              System error code. The connection wasn't passed.
+ *                      log_start() called.
+ */
+int
+uphub_handOff(
+    const int           sock)
+{
+    int         status = ENOENT;
+    int         attempt;
+
+    if (0 == hubCount) {
+        LOG_START0("No upstream LDM hubs");
+        return status;
+    }
+
+    for (attempt = 0; attempt < HANDOFF_TRIES; attempt++) {
+        struct msghdr   msg;
+        struct iovec    iov;
+        struct cmsghdr* cmsg;
+        char            byte = 0;
+        union {
+            struct cmsghdr  hdr;
+            char            buf[CMSG_SPACE(sizeof(int))];
+        }               ctrl;
+        unsigned        best = 0;
+        unsigned        minLoad = UINT_MAX;
+        unsigned        i;
+
+        for (i = 0; i < hubCount; i++) {
+            const unsigned  load = hubLoads[i].sessions +
+                    (hubs[i].sent - hubLoads[i].received);
+
+            if (load < minLoad) {
+                minLoad = load;
+                best = i;
+            }
+        }
+
+        iov.iov_base = &byte;
+        iov.iov_len = 1;
+        (void)memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        (void)memcpy(CMSG_DATA(cmsg), &sock, sizeof(int));
+
+        if (sendmsg(hubs[best].ctl, &msg, MSG_DONTWAIT) == 1) {
+            hubs[best].sent++;
+            status = 0;
+            break;
+        }
+
+        status = errno;
+
+        if (EAGAIN == status || EWOULDBLOCK == status) {
+            /*
+             * The hub is busy and hasn't drained its control socket.  Wait a
+             * bounded time for it rather than dropping the connection.
+             */
+            struct pollfd   pfd;
+
+            pfd.fd = hubs[best].ctl;
+            pfd.events = POLLOUT;
+
+            if (attempt + 1 < HANDOFF_TRIES &&
+                    poll(&pfd, 1, HANDOFF_TIMEOUT) == 1 &&
+                    !(pfd.revents & (POLLERR | POLLHUP)))
+                continue;
+
+            LOG_START1("Upstream LDM hub %u isn't accepting connections",
+                    best);
+            break;
+        }
+
+        if (EPIPE != status && ECONNRESET != status &&
+                ECONNREFUSED != status) {
+            LOG_SERROR1("Couldn't pass connection to upstream LDM hub %u",
+                    best);
+            break;
+        }
+
+        /*
+         * The hub terminated.  Start another one in its place.
+         */
+        unotice("Restarting terminated upstream LDM hub %u (PID %ld)", best,
+                (long)hubs[best].pid);
+        (void)close(hubs[best].ctl);
+        hubs[best].ctl = -1;
+        hubLoads[best].received = 0;
+        hubLoads[best].sessions = 0;
+
+        if ((status = hub_start(best, sock)))
+            break;
+
+        status = EPIPE;
+    }
+
+    if (status && EPIPE == status)
+        LOG_START0("Couldn't pass connection to upstream LDM hub");
+
+    return status;
+}
+
+/**
+ * Returns a new session identifier for a downstream LDM if this process is an
+ * upstream LDM hub.
+ *
+ * @retval 0            This process isn't an upstream LDM hub.
+ * @return              Identifier for the next session of this hub.
+ */
+unsigned
+uphub_newSessionId(void)
+{
+    if (hubIndex < 0)
+        return 0;
+
+    if (0 == ++nextSessionId)
+        nextSessionId = 1;
+
+    return nextSessionId;
+}
+
+/**
+ * Adds a session with a downstream LDM to this upstream LDM hub.  Should only
+ * be called during the vetting of a FEEDME or NOTIFYME request by an upstream
+ * LDM hub after the reply has been sent.  The connection will be taken from
+ * the server-side transport after the request has been dispatched.
+ *
+ * @param xprt          [in] Server-side transport of the request.
+ * @param id            [in] Session identifier from uphub_newSessionId().
+ * @param downName      [in] Name of the downstream host. Caller may free.
+ * @param downAddr      [in] Address of the downstream host.
+ * @param prodClass     [in] Class of data-products to send. Caller may free.
+ * @param signature     [in] Signature of the last data-product received by
+ *                      the downstream LDM or NULL. Caller may free.
+ * @param upFilter      [in] Filter for the data-products. Upon success, the
+ *                      hub is responsible for it and the caller must not free
+ *                      it.
+ * @param isNotifier    [in] Whether to notify rather than feed.
+ * @param isPrimary     [in] Whether to use HEREIS rather than
+ *                      COMINGSOON/BLKDATA messages when feeding.
+ * @retval 0            Success.
+ * @return              Error code. log_start() called.
+ */
+int
+uphub_addSession(
+    SVCXPRT* const                  xprt,
+    const unsigned                  id,
+    const char* const               downName,
+    const struct sockaddr_in* const downAddr,
+    const prod_class_t* const       prodClass,
+    const signaturet* const         signature,
+    UpFilter* const                 upFilter,
+    const int                       isNotifier,
+    const int                       isPrimary)
+{
+    Session*    sess;
+    int         status;
+
+    if (hubIndex < 0 || NULL != adoptee) {
+        LOG_START0("Not an upstream LDM hub or session already added");
+        return EINVAL;
+    }
+
+    sess = calloc(1, sizeof(Session));
+
+    if (NULL == sess) {
+        LOG_SERROR0("Couldn't allocate session");
+        return ENOMEM;
+    }
+
+    sess->sock = -1;
+    sess->id = id;
+    sess->downAddr = *downAddr;
+    sess->batchOff = SIZE_MAX;
+    sess->isNotifier = isNotifier;
+    sess->isPrimary = isPrimary;
+    sess->lastSend = time(NULL);
+    sess->mt = TV_GT;
+    sess->downName = strdup(downName);
+    sess->prodClass = dup_prod_class(prodClass);
+
+    if (NULL == sess->downName || NULL == sess->prodClass) {
+        LOG_SERROR0("Couldn't copy session parameters");
+        status = ENOMEM;
+    }
+    else {
+        int cursorSet = 0;
+
+        status = 0;
+
+        if (NULL != signature) {
+            int err = pq_setCursorFromSignature(hubPq, *signature);
+
+            (void)memcpy(sess->signature, *signature, sizeof(signaturet));
+            sess->hasSignature = 1;
+
+            if (0 == err) {
+                sess->mt = TV_GT;
+                cursorSet = 1;
+
+                /*
+                 * Resend what a prioritizing upstream LDM process might have
+                 * deferred.
+                 */
+                if (!isNotifier && (err = prio_backUpCursor(hubPq, *signature,
+                        prodClass, upFilter))) {
+                    LOG_ADD1("Couldn't resume before deferred data-products: "
+                            "%s", pq_strerror(hubPq, err));
+                    log_log(LOG_WARNING);
+                }
+            }
+            else if (PQ_NOTFOUND == err) {
+                unotice("Data-product with signature %s wasn't found in "
+                        "product-queue", s_signaturet(NULL, 0, *signature));
+            }
+            else {
+                LOG_START2("Couldn't set product-queue cursor from signature "
+                        "(%s): %s", s_signaturet(NULL, 0, *signature),
+                        pq_strerror(hubPq, err));
+                status = err;
+            }
+        }
+
+        if (0 == status && !cursorSet) {
+            int err = pq_cClassSet(hubPq, &sess->mt, sess->prodClass);
+
+            if (err) {
+                LOG_START2("Couldn't set product-queue cursor from "
+                        "product-class (%s): %s",
+                        s_prod_class(NULL, 0, sess->prodClass),
+                        pq_strerror(hubPq, err));
+                status = err;
+            }
+        }
+
+        if (0 == status) {
+            pq_ctimestamp(hubPq, &sess->cursor);
+            sess->upFilter = upFilter;
+            adoptee = sess;
+
+            return 0;
+        }
+    }
+
+    free_prod_class(sess->prodClass);
+    free(sess->downName);
+    free(sess);
+
+    return status;
+}
@@ -0,0 +1,152 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This header-file specifies the API for upstream LDM "hubs": child processes
+ * of the top-level LDM server that each feed or notify many downstream LDM-s
+ * over their own connections rather than a forked process per connection.
+ */
+
+#ifndef UPHUB_H
+#define UPHUB_H
+
+#include <netinet/in.h>
+#include <rpc/rpc.h>
+
+#include "ldm.h"
+#include "UpFilter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Maximum number of upstream LDM hubs.
+ */
+#define UPHUB_MAX_HUBS  64
+
+/*
+ * Kinds of requests that can arrive on a new connection.
+ */
+typedef enum {
+    UPHUB_REQ_HUB = 0,  /**< FEEDME or NOTIFYME: can be handled by a hub */
+    UPHUB_REQ_OTHER,    /**< Anything else: must be handled by a process */
+    UPHUB_REQ_CLOSED    /**< The connection was closed by the remote host */
+} uphub_Request;
+
+/**
+ * Starts a pool of upstream LDM hubs.  Should only be called by the top-level
+ * LDM server and only once.  Each hub is a child process that's added to the
+ * set of child processes (see "child_process_set.h") and that's restarted by
+ * uphub_handOff() if it's found to have terminated.
+ *
+ * @param count         [in] Number of hubs. Shall be positive and not greater
+ *                      than UPHUB_MAX_HUBS.
+ * @param childInit     [in] Function called by each hub process immediately
+ *                      after it's forked (e.g., to close the listening socket)
+ *                      or NULL.
+ * @retval 0            Success.
+ * @retval EINVAL       "count" is invalid. log_start() called.
+ * @return              System error code. log_start() called.
+ */
+int
+uphub_startPool(
+    const unsigned      count,
+    void              (*childInit)(void));
+
+/**
+ * Returns the number of upstream LDM hubs.
+ *
+ * @return  The number of hubs. Zero if uphub_startPool() hasn't been called.
+ */
+unsigned
+uphub_getHubCount(void);
+
+/**
+ * Returns the total number of downstream LDM-s that the upstream LDM hubs are
+ * feeding or notifying or will shortly be vetting.
+ *
+ * @return  The total number of sessions of all hubs.
+ */
+unsigned
+uphub_getSessionCount(void);
+
+/**
+ * Returns the kind of the first request on a new connection without consuming
+ * it.  Doesn't block.
+ *
+ * @param sock          [in] The connected socket. Should be ready for
+ *                      reading.
+ * @retval UPHUB_REQ_HUB    The request can be handled by a hub.
+ * @retval UPHUB_REQ_OTHER  The request must be handled by a dedicated process
+ *                          (this includes an incomplete request).
+ * @retval UPHUB_REQ_CLOSED The remote host closed the connection.
+ */
+uphub_Request
+uphub_getRequestType(
+    const int           sock);
+
+/**
+ * Passes a new connection to the least-loaded upstream LDM hub, which looks
+ * up the name of the remote host without delaying the caller or its other
+ * sessions.  Gives up after a bounded number of attempts, in which case the
+ * caller should serve the connection itself.  The caller should close the
+ * socket on success.
+ *
+ * @param sock          [in] The connected socket.
+ * @retval 0            Success.
+ * @return              System error code. The connection wasn't passed.
+ *                      log_start() called.
+ */
+int
+uphub_handOff(
+    const int           sock);
+
+/**
+ * Returns a new session identifier for a downstream LDM if this process is an
+ * upstream LDM hub.
+ *
+ * @retval 0            This process isn't an upstream LDM hub.
+ * @return              Identifier for the next session of this hub.
+ */
+unsigned
+uphub_newSessionId(void);
+
+/**
+ * Adds a session with a downstream LDM to this upstream LDM hub.  Should only
+ * be called during the vetting of a FEEDME or NOTIFYME request by an upstream
+ * LDM hub after the reply has been sent.  The connection will be taken from
+ * the server-side transport after the request has been dispatched.
+ *
+ * @param xprt          [in] Server-side transport of the request.
+ * @param id            [in] Session identifier from uphub_newSessionId().
+ * @param downName      [in] Name of the downstream host. Caller may free.
+ * @param downAddr      [in] Address of the downstream host.
+ * @param prodClass     [in] Class of data-products to send. Caller may free.
+ * @param signature     [in] Signature of the last data-product received by
+ *                      the downstream LDM or NULL. Caller may free.
+ * @param upFilter      [in] Filter for the data-products. Upon success, the
+ *                      hub is responsible for it and the caller must not free
+ *                      it.
+ * @param isNotifier    [in] Whether to notify rather than feed.
+ * @param isPrimary     [in] Whether to use HEREIS rather than
+ *                      COMINGSOON/BLKDATA messages when feeding.
+ * @retval 0            Success.
+ * @return              Error code. log_start() called.
+ */
+int
+uphub_addSession(
+    SVCXPRT* const                  xprt,
+    const unsigned                  id,
+    const char* const               downName,
+    const struct sockaddr_in* const downAddr,
+    const prod_class_t* const       prodClass,
+    const signaturet* const         signature,
+    UpFilter* const                 upFilter,
+    const int                       isNotifier,
+    const int                       isPrimary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,733 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Loopback benchmark of feeding many downstream LDM-s -- both by upstream LDM
+ * hubs and by an upstream LDM process per connection.  The downstream LDM-s
+ * are simulated by a single process that counts the received data-products.
+ *
+ * Usage: uphub_bench [-lv] [-c conns] [-H nhubs] [-n count] [-s size]
+ *                    [-d dir]
+ *
+ *     -l        Live: insert the data-products after the downstream LDM-s
+ *               have subscribed rather than before.  Timing starts with the
+ *               first received data-product.
+ *     -v        Verbose logging.
+ *     -c conns  Number of downstream LDM-s (default 1000).
+ *     -H nhubs  Number of upstream LDM hubs (default 2).
+ *     -n count  Number of data-products (default 1000).
+ *     -s size   Size of each data-product in bytes (default 1000).
+ *     -d dir    Directory for the temporary product-queue (default /tmp).
+ */
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <regex.h>
+#include <rpc/rpc.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "globals.h"
+#include "ldm.h"
+#include "ldm_config_file.h"
+#include "log.h"
+#include "pattern.h"
+#include "pq.h"
+#include "timestamp.h"
+#include "uldb.h"
+#include "ulog.h"
+#include "up6.h"
+#include "uphub.h"
+#include "UpFilter.h"
+
+/*
+ * A simulated downstream LDM:
+ */
+typedef struct {
+    char*       buf;            /* received bytes */
+    size_t      size;           /* capacity of "buf" */
+    size_t      len;            /* number of bytes in "buf" */
+    int         sock;
+} Down;
+
+static prod_spec        allSpec = {ANY, ".*"};
+static prod_class_t     allClass = {{0, 0}, {0, 0}, {1, &allSpec}};
+static int              listenSock = -1;
+
+/*
+ * Inserts data-products into a product-queue.
+ *
+ * Arguments:
+ *      path    Pathname of the product-queue.
+ *      slots   Number of data-products for which to create the
+ *              product-queue or 0 to open the existing product-queue.
+ *      first   Sequence number of the first data-product.
+ *      count   Number of data-products.
+ *      size    Size of each data-product in bytes.
+ */
+static int
+fillQueue(
+    const char* const   path,
+    const unsigned      slots,
+    const unsigned      first,
+    const unsigned      count,
+    const unsigned      size)
+{
+    pqueue*     pq;
+    char*       data = malloc(size);
+    char        ident[32];
+    product     prod;
+    unsigned    i;
+    int         status;
+
+    if (NULL == data)
+        return ENOMEM;
+
+    status = slots
+            ? pq_create(path, 0666, PQ_DEFAULT, 0,
+                    (off_t)slots * (size + 256) + 1000000, slots + 100, &pq)
+            : pq_open(path, PQ_DEFAULT, &pq);
+    if (status) {
+        uerror("Couldn't open product-queue \"%s\": %s", path,
+                strerror(status));
+        free(data);
+        return status;
+    }
+
+    (void)memset(data, 'x', size);
+    prod.info.origin = "uphub_bench";
+    prod.info.feedtype = EXP;
+    prod.info.ident = ident;
+    prod.info.sz = size;
+    prod.data = data;
+
+    for (i = first; i < first + count && 0 == status; i++) {
+        (void)set_timestamp(&prod.info.arrival);
+        prod.info.seqno = i;
+        (void)snprintf(ident, sizeof(ident), "product %u", i);
+        (void)memset(prod.info.signature, 0, sizeof(signaturet));
+        (void)memcpy(prod.info.signature, &i, sizeof(i));
+
+        status = pq_insert(pq, &prod);
+        if (status)
+            uerror("Couldn't insert product %u: %s", i, strerror(status));
+    }
+
+    (void)pq_close(pq);
+    free(data);
+
+    return status;
+}
+
+/*
+ * Sends a FEEDME request for everything on a connection.
+ */
+static int
+sendFeedme(
+    const int           sock)
+{
+    char        buf[512];
+    uint32_t    hdr[11];
+    feedpar_t   feedPar;
+    XDR         xdrs;
+    size_t      len;
+
+    hdr[1] = htonl(1);                  /* transaction ID */
+    hdr[2] = htonl(CALL);
+    hdr[3] = htonl(RPC_MSG_VERSION);
+    hdr[4] = htonl(LDMPROG);
+    hdr[5] = htonl(SIX);
+    hdr[6] = htonl(FEEDME);
+    hdr[7] = hdr[8] = hdr[9] = hdr[10] = 0;
+    (void)memcpy(buf, hdr, sizeof(hdr));
+
+    feedPar.prod_class = &allClass;
+    feedPar.max_hereis = UINT_MAX;
+    xdrmem_create(&xdrs, buf + sizeof(hdr), sizeof(buf) - sizeof(hdr),
+            XDR_ENCODE);
+    if (!xdr_feedpar_t(&xdrs, &feedPar)) {
+        uerror("Couldn't encode FEEDME");
+        return -1;
+    }
+    len = sizeof(hdr) + xdr_getpos(&xdrs);
+    xdr_destroy(&xdrs);
+
+    hdr[0] = htonl(0x80000000u | (uint32_t)(len - 4));
+    (void)memcpy(buf, hdr, 4);
+
+    return write(sock, buf, len) == (ssize_t)len ? 0 : -1;
+}
+
+/*
+ * Replies successfully to an RPC call.
+ */
+static void
+reply(
+    const int           sock,
+    const uint32_t      xid)
+{
+    uint32_t    msg[7];
+
+    msg[0] = htonl(0x80000000u | 24);
+    msg[1] = xid;                       /* network byte-order */
+    msg[2] = htonl(REPLY);
+    msg[3] = htonl(MSG_ACCEPTED);
+    msg[4] = msg[5] = 0;                /* AUTH_NONE verifier */
+    msg[6] = htonl(SUCCESS);
+
+    (void)write(sock, msg, sizeof(msg));
+}
+
+/*
+ * Handles a complete RPC record received by a simulated downstream LDM.
+ *
+ * Returns:
+ *      The number of data-products in the record.
+ */
+static unsigned
+handleRecord(
+    Down* const         down,
+    const char*         rec,
+    const size_t        len)
+{
+    uint32_t    words[8];
+    size_t      off;
+    uint32_t    proc;
+
+    if (len < 24)
+        return 0;
+
+    (void)memcpy(words, rec, 24);
+
+    if (htonl(CALL) != words[1])
+        return 0;                       /* reply to FEEDME */
+
+    proc = ntohl(words[5]);
+    off = 24;                           /* credentials */
+    (void)memcpy(words, rec + off + 4, 4);
+    off += 8 + ((ntohl(words[0]) + 3) & ~3u);
+    (void)memcpy(words, rec + off + 4, 4); /* verifier */
+    off += 8 + ((ntohl(words[0]) + 3) & ~3u);
+
+    switch (proc) {
+    case NULLPROC:
+        reply(down->sock, *(uint32_t*)rec);
+        break;
+    case HEREIS:
+        return 1;
+    case HEREIS_BATCH: {
+        uint32_t    count;
+
+        (void)memcpy(&count, rec + off + 4, 4);
+        count = ntohl(count);
+
+        if (0 == count)
+            reply(down->sock, *(uint32_t*)rec); /* batching probe */
+
+        return count;
+    }
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Reads from a simulated downstream LDM's connection.
+ *
+ * Returns:
+ *      -1      The connection was closed or failed.
+ *      else    The number of data-products received.
+ */
+static int
+readDown(
+    Down* const         down)
+{
+    unsigned    nprods = 0;
+    size_t      off = 0;
+    ssize_t     n;
+
+    if (down->size - down->len < 65536) {
+        down->size = down->size ? 2*down->size : 1048576;
+        down->buf = realloc(down->buf, down->size);
+
+        if (NULL == down->buf) {
+            serror("realloc()");
+            return -1;
+        }
+    }
+
+    n = read(down->sock, down->buf + down->len, down->size - down->len);
+
+    if (n <= 0)
+        return -1;
+
+    down->len += n;
+
+    /*
+     * Reassembles records in place by removing the record-marks of
+     * intermediate fragments.
+     */
+    for (;;) {
+        size_t      recLen = 0;
+        size_t      pos = off;
+        int         complete = 0;
+
+        while (down->len - pos >= 4) {
+            uint32_t    mark;
+            size_t      fragLen;
+
+            (void)memcpy(&mark, down->buf + pos, 4);
+            mark = ntohl(mark);
+            fragLen = mark & 0x7fffffffu;
+
+            if (down->len - pos - 4 < fragLen)
+                break;
+
+            /* Remove the record-mark */
+            (void)memmove(down->buf + off + recLen,
+                    down->buf + pos + 4, fragLen);
+            recLen += fragLen;
+            pos += 4 + fragLen;
+
+            if (mark & 0x80000000u) {
+                complete = 1;
+                break;
+            }
+        }
+
+        if (!complete) {
+            /*
+             * Restore the unconsumed bytes after the consumed fragments.
+             */
+            if (recLen) {
+                uint32_t    mark = htonl((uint32_t)recLen);
+
+                (void)memmove(down->buf + off + 4 + recLen, down->buf + pos,
+                        down->len - pos);
+                (void)memmove(down->buf + off + 4, down->buf + off, recLen);
+                (void)memcpy(down->buf + off, &mark, 4);
+                down->len = off + 4 + recLen + (down->len - pos);
+            }
+            break;
+        }
+
+        nprods += handleRecord(down, down->buf + off, recLen);
+        (void)memmove(down->buf + off, down->buf + pos, down->len - pos);
+        down->len -= pos - off;
+    }
+
+    return nprods;
+}
+
+/*
+ * Runs the simulated downstream LDM-s until they've received all the
+ * data-products.  Doesn't return.
+ *
+ * Arguments:
+ *      addr            Address of the upstream LDM server.
+ *      conns           Number of downstream LDM-s.
+ *      count           Number of data-products.
+ *      feedme          Whether to send a FEEDME request.
+ *      live            Whether to start timing with the first data-product.
+ *      fd              Pipe on which to write the duration of the transfer.
+ */
+static void
+runDownstreams(
+    const struct sockaddr_in* const     addr,
+    const unsigned                      conns,
+    const unsigned                      count,
+    const int                           feedme,
+    const int                           live,
+    const int                           fd)
+{
+    Down*           downs = calloc(conns, sizeof(Down));
+    struct pollfd*  fds = calloc(conns, sizeof(struct pollfd));
+    unsigned long   total = 0;
+    unsigned long   expected = (unsigned long)conns * count;
+    unsigned        open = conns;
+    timestampt      start;
+    timestampt      stop;
+    double          duration = -1;
+    unsigned        i;
+
+    if (NULL == downs || NULL == fds) {
+        serror("calloc()");
+        exit(1);
+    }
+
+    (void)set_timestamp(&start);
+
+    for (i = 0; i < conns; i++) {
+        struct sockaddr_in  local;
+        int                 sock = socket(AF_INET, SOCK_STREAM, 0);
+
+        /*
+         * Each downstream LDM has its own IP address so that the upstream
+         * LDM database doesn't consider the subscriptions to be duplicates.
+         */
+        (void)memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + i);
+
+        if (sock < 0 || bind(sock, (struct sockaddr*)&local, sizeof(local)) ||
+                connect(sock, (struct sockaddr*)addr, sizeof(*addr)) ||
+                (feedme && sendFeedme(sock))) {
+            serror("Couldn't connect downstream LDM %u", i);
+            exit(1);
+        }
+
+        downs[i].sock = sock;
+        fds[i].fd = sock;
+        fds[i].events = POLLIN;
+    }
+
+    while (total < expected && open > 0) {
+        int ready = poll(fds, conns, 30000);
+
+        if (ready <= 0) {
+            uerror("Transfer stalled: %lu of %lu products", total, expected);
+            break;
+        }
+
+        for (i = 0; i < conns; i++) {
+            if (fds[i].revents) {
+                const int   n = readDown(downs + i);
+
+                if (n < 0) {
+                    (void)close(fds[i].fd);
+                    fds[i].fd = -1;
+                    open--;
+                }
+                else {
+                    if (live && 0 == total && n > 0)
+                        (void)set_timestamp(&start);
+
+                    total += n;
+                }
+            }
+        }
+    }
+
+    if (total >= expected) {
+        (void)set_timestamp(&stop);
+        duration = d_diff_timestamp(&stop, &start);
+    }
+
+    (void)write(fd, &duration, sizeof(duration));
+    exit(0);
+}
+
+/*
+ * Closes the listening socket in an upstream LDM hub.
+ */
+static void
+initHub(void)
+{
+    (void)close(listenSock);
+}
+
+/*
+ * Runs the upstream side until terminated: either a pool of upstream LDM hubs
+ * or an upstream LDM process per connection.  Doesn't return.
+ */
+static void
+runUpstream(
+    const unsigned      conns,
+    const unsigned      nhubs,
+    const char* const   pqPath)
+{
+    unsigned    i;
+
+    (void)setpgid(0, 0);
+
+    if (nhubs && uphub_startPool(nhubs, initHub)) {
+        log_log(LOG_ERR);
+        exit(1);
+    }
+
+    for (i = 0; i < conns; i++) {
+        struct sockaddr_in  addr;
+        socklen_t           len = sizeof(addr);
+        int                 sock = accept(listenSock, (struct sockaddr*)&addr,
+                &len);
+
+        if (sock < 0) {
+            serror("accept() failure");
+            exit(1);
+        }
+
+        if (nhubs) {
+            struct pollfd   pfd;
+
+            pfd.fd = sock;
+            pfd.events = POLLIN;
+
+            if (poll(&pfd, 1, 30000) != 1 ||
+                    uphub_getRequestType(sock) != UPHUB_REQ_HUB) {
+                uerror("No FEEDME from downstream LDM");
+                exit(1);
+            }
+
+            if (uphub_handOff(sock)) {
+                log_log(LOG_ERR);
+                exit(1);
+            }
+        }
+        else {
+            pid_t   pid = fork();
+
+            if (pid < 0) {
+                serror("fork() failure");
+                exit(1);
+            }
+
+            if (0 == pid) {
+                UpFilter*   upFilter;
+                Pattern*    pat;
+                ErrorObj*   errObj;
+
+                (void)close(listenSock);
+
+                if ((errObj = upFilter_new(&upFilter)) ||
+                        (errObj = pat_new(&pat, ".*", 0)) ||
+                        (errObj = upFilter_addComponent(upFilter, ANY, pat,
+                                NULL))) {
+                    err_log_and_free(errObj, ERR_FAILURE);
+                    exit(1);
+                }
+
+                exit(up6_new_feeder(sock, "localhost", &addr, &allClass, NULL,
+                        pqPath, 30, upFilter, 1));
+            }
+        }
+
+        (void)close(sock);
+    }
+
+    for (;;)
+        (void)pause();
+}
+
+/*
+ * Feeds the downstream LDM-s once.
+ *
+ * Returns:
+ *      -1      Failure.
+ *      else    Duration of the transfer in seconds.
+ */
+static double
+transfer(
+    const char* const   pqPath,
+    const unsigned      conns,
+    const unsigned      count,
+    const unsigned      size,
+    const unsigned      nhubs,
+    const int           live,
+    const unsigned      first)
+{
+    struct sockaddr_in  addr;
+    socklen_t           len = sizeof(addr);
+    double              duration = -1;
+    int                 fds[2];
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listenSock = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (listenSock < 0 ||
+            bind(listenSock, (struct sockaddr*)&addr, sizeof(addr)) ||
+            listen(listenSock, SOMAXCONN) ||
+            getsockname(listenSock, (struct sockaddr*)&addr, &len) ||
+            pipe(fds)) {
+        serror("Couldn't create listening socket");
+    }
+    else {
+        pid_t   upPid = fork();
+
+        if (0 == upPid) {
+            (void)close(fds[0]);
+            runUpstream(conns, nhubs, pqPath);
+        }
+        else if (upPid > 0) {
+            pid_t   downPid = fork();
+
+            if (0 == downPid) {
+                (void)close(fds[0]);
+                (void)close(listenSock);
+                runDownstreams(&addr, conns, count, nhubs > 0, live, fds[1]);
+            }
+
+            (void)close(fds[1]);
+
+            if (downPid > 0 && live) {
+                /*
+                 * Give the downstream LDM-s time to subscribe.  The upstream
+                 * side is in its own process-group, so it's notified
+                 * explicitly of the new data-products.
+                 */
+                (void)sleep(2);
+
+                if (fillQueue(pqPath, 0, first, count, size) == 0)
+                    (void)kill(-upPid, SIGCONT);
+            }
+
+            if (downPid < 0 ||
+                    read(fds[0], &duration, sizeof(duration)) !=
+                    sizeof(duration))
+                duration = -1;
+
+            (void)close(fds[0]);
+            (void)kill(-upPid, SIGTERM);
+            (void)waitpid(upPid, NULL, 0);
+            if (downPid > 0)
+                (void)waitpid(downPid, NULL, 0);
+            while (waitpid(-1, NULL, WNOHANG) > 0)
+                ;
+        }
+    }
+
+    if (listenSock >= 0)
+        (void)close(listenSock);
+
+    return duration;
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    const char* dir = "/tmp";
+    unsigned    conns = 1000;
+    unsigned    nhubs = 2;
+    unsigned    count = 1000;
+    unsigned    size = 1000;
+    char        pqPath[256];
+    regex_t     rgx;
+    host_set*   hsp;
+    ErrorObj*   errObj;
+    struct rlimit   rlim;
+    int         ch;
+    int         live = 0;
+    int         mode;
+    int         status = 0;
+
+    (void)openulog("uphub_bench", LOG_NOTIME | LOG_IDENT, LOG_LDM, "-");
+    (void)setulogmask(LOG_UPTO(LOG_WARNING));
+
+    while ((ch = getopt(argc, argv, "lvc:H:n:s:d:")) != -1) {
+        switch (ch) {
+        case 'l':
+            live = 1;
+            break;
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'c':
+            conns = (unsigned)atoi(optarg);
+            break;
+        case 'H':
+            nhubs = (unsigned)atoi(optarg);
+            break;
+        case 'n':
+            count = (unsigned)atoi(optarg);
+            break;
+        case 's':
+            size = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr, "Usage: %s [-lv] [-c conns] [-H nhubs] "
+                    "[-n count] [-s size] [-d dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == conns || 0 == nhubs || 0 == count || 0 == size) {
+        (void)fprintf(stderr, "Arguments must be positive\n");
+        return 1;
+    }
+
+    if (0 == getrlimit(RLIMIT_NOFILE, &rlim)) {
+        rlim.rlim_cur = rlim.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &rlim);
+    }
+
+    (void)signal(SIGPIPE, SIG_IGN);
+    (void)snprintf(pqPath, sizeof(pqPath), "%s/uphub_bench-%d.pq", dir,
+            (int)getpid());
+    setQueuePath(pqPath);
+
+    allClass.to = TS_ENDT;
+
+    /*
+     * Allow everything to the loopback addresses.
+     */
+    if (regcomp(&rgx, "^127\\.", REG_EXTENDED | REG_NOSUB) ||
+            NULL == (hsp = lcf_newHostSet(HS_REGEXP, strdup("^127\\."),
+                    &rgx)) ||
+            (errObj = lcf_addAllow(ANY, hsp, ".*", NULL, 0))) {
+        uerror("Couldn't add ALLOW entry");
+        return 1;
+    }
+
+    if (fillQueue(pqPath, 2*count, 0, live ? 0 : count, size))
+        return 1;
+
+    /*
+     * The upstream LDM database is associated with the product-queue.
+     */
+    (void)uldb_delete(NULL);
+    log_clear();
+    if (uldb_create(NULL, conns * 1024 + 65536)) {
+        log_log(LOG_ERR);
+        (void)unlink(pqPath);
+        return 1;
+    }
+
+    for (mode = 0; mode <= 1; mode++) {
+        const unsigned  hubs = 0 == mode ? nhubs : 0;
+        double          duration;
+
+        (void)fflush(stdout);           /* children call exit() */
+        if (live)
+            (void)set_timestamp(&allClass.from); /* skip earlier products */
+        duration = transfer(pqPath, conns, count, size, hubs, live,
+                mode * count);
+
+        if (duration < 0) {
+            status = 1;
+        }
+        else {
+            (void)printf("%-7s%s %u downstreams x %u products of %u bytes: "
+                    "%.3f s, %.0f products/s\n",
+                    hubs ? "hubs" : "forked", live ? " (live)" : "", conns,
+                    count, size, duration,
+                    (double)conns * count / duration);
+        }
+    }
+
+    (void)uldb_delete(NULL);
+    (void)unlink(pqPath);
+
+    return status;
+}
@@ -9,8 +9,12 @@
  * minimizing the use of malloc(3) when XDR-decoding product-data.
  */
 
+#include "config.h"
+
+#include <rpc/rpc.h>
 #include <stdlib.h>
 
+#include "ldm.h"
 #include "ulog.h"
 
 #include "xdr_data.h"
@@ -19,6 +23,11 @@
 static char*    buf = NULL;
 static size_t   max = 0;
 static size_t   used = 0;
+static char*    ext = NULL;         /* client-supplied buffer or NULL */
+static size_t   extMax = 0;         /* size of client-supplied buffer */
+static size_t   extUsed = 0;        /* bytes handed out of "ext" */
+static xd_ProductBufferFunc productBufferFunc = NULL;
+static xd_BatchBufferFunc batchBufferFunc = NULL;
 
 
 /*
@@ -34,6 +43,8 @@ static size_t   used = 0;
 void*
 xd_getBuffer(size_t size)
 {
+    ext = NULL;
+
     if (NULL == buf || size > max) {
         free(buf);
 
@@ -66,6 +77,26 @@ xd_getNextSegment(size_t size)
     void*               next;
     const size_t        newMax = used + size;
 
+    if (NULL != ext) {
+        if (extUsed + size <= extMax) {
+            next = ext + extUsed;
+            extUsed += size;
+
+            return next;
+        }
+
+        /*
+         * The segment doesn't fit in the client-supplied buffer.  Decode it
+         * into the internal buffer so that the client can detect the
+         * overrun and reject the segment.
+         */
+        udebug("xd_getNextSegment(): %lu-byte segment overruns "
+            "%lu-byte external buffer", (unsigned long)size,
+            (unsigned long)(extMax - extUsed));
+        ext = NULL;
+        return xd_getNextSegment(size);
+    }
+
     if (NULL != buf && newMax <= max) {
         next = buf + used;
         used += size;
@@ -95,5 +126,115 @@ xd_getNextSegment(size_t size)
 void
 xd_reset()
 {
+    ext = NULL;
     used = 0;
 }
+
+
+/*
+ * Makes subsequent calls to xd_getNextSegment() return pointers that advance
+ * through a client-supplied buffer rather than the internal one until either
+ * xd_getBuffer() or xd_reset() is called.  This allows data to be decoded
+ * directly into its final location (e.g., a product-queue region).  A segment
+ * that would overrun the client-supplied buffer is returned from the internal
+ * buffer instead and ends the use of the client-supplied buffer.
+ *
+ * Arguments:
+ *      extBuf  Pointer to the client-supplied buffer.
+ *      size    Size of the client-supplied buffer in bytes.
+ */
+void
+xd_setExternal(void* extBuf, size_t size)
+{
+    ext = extBuf;
+    extMax = size;
+    extUsed = 0;
+}
+
+
+/*
+ * Sets the function that xd_getProductBuffer() will call to obtain the buffer
+ * into which the data of a product will be decoded.
+ *
+ * Arguments:
+ *      func    Pointer to the function or NULL to always use the internal
+ *              buffer.  The function is given the metadata of the product and
+ *              returns a pointer to a buffer of at least "info->sz" bytes or
+ *              NULL if the internal buffer should be used.
+ */
+void
+xd_setProductBufferFunc(xd_ProductBufferFunc func)
+{
+    productBufferFunc = func;
+}
+
+
+/*
+ * Returns the buffer into which the data of a product will be decoded: the
+ * one from the function set by xd_setProductBufferFunc(), if any, or the
+ * internal buffer otherwise.
+ *
+ * Arguments:
+ *      info    Pointer to the metadata of the product.
+ * Returns:
+ *      NULL    Failure.
+ *      else    Pointer to a buffer of at least "info->sz" bytes.
+ */
+void*
+xd_getProductBuffer(const struct prod_info* info)
+{
+    if (NULL != productBufferFunc) {
+        void*   extBuf = productBufferFunc(info);
+
+        if (NULL != extBuf) {
+            ext = NULL;
+            return extBuf;
+        }
+    }
+
+    return xd_getBuffer(info->sz);
+}
+
+
+/*
+ * Sets the function that xd_getBatchBuffer() will call to obtain the buffer
+ * into which the data of a batch of products will be decoded.
+ *
+ * Arguments:
+ *      func    Pointer to the function or NULL to always use the internal
+ *              buffer.  The function is given the total size of the data and
+ *              returns a pointer to a buffer of at least that many bytes or
+ *              NULL if the internal buffer should be used.
+ */
+void
+xd_setBatchBufferFunc(xd_BatchBufferFunc func)
+{
+    batchBufferFunc = func;
+}
+
+
+/*
+ * Returns the buffer into which the data of a batch of products will be
+ * decoded: the one from the function set by xd_setBatchBufferFunc(), if any,
+ * or the internal buffer otherwise.
+ *
+ * Arguments:
+ *      size    The total size of the data in bytes.
+ * Returns:
+ *      NULL    Failure.
+ *      else    Pointer to a buffer of at least "size" bytes.
+ */
+void*
+xd_getBatchBuffer(size_t size)
+{
+    if (NULL != batchBufferFunc && size > 0) {
+        void*   extBuf = batchBufferFunc(size);
+
+        if (NULL != extBuf) {
+            ext = NULL;
+            return extBuf;
+        }
+    }
+
+    return xd_getBuffer(size);
+}
@@ -5,7 +5,7 @@
 /* $Id: xdr_data.h,v 1.1.2.1.10.1 2005/09/27 16:40:59 steve Exp $ */
 
 #ifndef _XDR_DATA_H
-#define	__XDR_DATA_H
+#define	_XDR_DATA_H
 
 #include <stdlib.h>
 
@@ -16,6 +16,19 @@ extern "C" {
 void*	xd_getBuffer(size_t size);
 void*	xd_getNextSegment(size_t size);
 void	xd_reset();
+void	xd_setExternal(void* extBuf, size_t size);
+
+struct prod_info;
+
+typedef void*	(*xd_ProductBufferFunc)(const struct prod_info* info);
+
+void	xd_setProductBufferFunc(xd_ProductBufferFunc func);
+void*	xd_getProductBuffer(const struct prod_info* info);
+
+typedef void*	(*xd_BatchBufferFunc)(size_t size);
+
+void	xd_setBatchBufferFunc(xd_BatchBufferFunc func);
+void*	xd_getBatchBuffer(size_t size);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,283 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This module adapts the way an upstream LDM sends data-products to a
+ * downstream LDM to the measured round-trip time and delivery rate of the
+ * connection.
+ *
+ * A downstream LDM in alternate transfer-mode expects duplicates and so is
+ * sent COMINGSOON/BLKDATA messages, which let it decline a duplicate at the
+ * cost of a round-trip per data-product.  On a long path, that round-trip
+ * costs more than sending a small duplicate would: a data-product is sent via
+ * HEREIS instead if its size, weighted by the fraction of data-products that
+ * the downstream LDM has been declining, takes less time to send than a
+ * round-trip.  The BLKDATA blocks of a large data-product are sized to the
+ * bandwidth-delay product of the connection.
+ *
+ * The round-trip time is the minimum, and the delivery rate the maximum, over
+ * a sliding window of the samples taken from synchronous RPC calls.  The
+ * registry parameter /server/adaptive-transfer turns the adaptation off, which
+ * restores the fixed transfer-mode and block-size.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "ldm.h"
+#include "log.h"
+#include "registry.h"
+#include "timestamp.h"
+#include "ulog.h"
+#include "xfer_adapt.h"
+
+#define WINDOW          30.0    /* duration of a measurement window in s */
+#define DUP_WEIGHT      16      /* weight of the duplicate-fraction average */
+#define MIN_DUP         0.01    /* minimum duplicate-fraction */
+#define MAX_BLOCK       (MAX_RPC_BUF_NEEDED - DATAPKT_RPC_OVERHEAD)
+
+/*
+ * The extreme of a measurement over a sliding window: the extremes of the
+ * current and previous windows are kept.
+ */
+typedef struct {
+    double      value[2];       /* current, previous; negative if unset */
+    double      start;          /* start of the current window */
+} Windowed;
+
+static unsigned         xaIsEnabled;
+static int              xaIsSet;
+static Windowed         xaRtt;          /* minimum round-trip time in s */
+static Windowed         xaRate;         /* maximum delivery rate in B/s */
+static double           xaDupFraction;  /* fraction declined as duplicates */
+static size_t           xaSinceSync;    /* bytes sent since last sync call */
+static timestampt       xaLastSync;     /* end of last sync call */
+static int              xaHaveSync;     /* "xaLastSync" is set? */
+
+/*
+ * Resets a windowed measurement.
+ */
+static void
+win_reset(
+    Windowed* const     win)
+{
+    win->value[0] = win->value[1] = -1;
+    win->start = 0;
+}
+
+/*
+ * Adds a sample to a windowed measurement.
+ *
+ * Arguments:
+ *      win             The windowed measurement.
+ *      time            The time of the sample in seconds.
+ *      sample          The sample.
+ *      isMin           Whether the minimum (rather than the maximum) is kept.
+ */
+static void
+win_add(
+    Windowed* const     win,
+    const double        time,
+    const double        sample,
+    const int           isMin)
+{
+    if (time - win->start >= WINDOW) {
+        win->value[1] = win->value[0];
+        win->value[0] = -1;
+        win->start = time;
+    }
+
+    if (win->value[0] < 0 ||
+            (isMin ? sample < win->value[0] : sample > win->value[0]))
+        win->value[0] = sample;
+}
+
+/*
+ * Returns the extreme of a windowed measurement.
+ *
+ * Returns:
+ *      <0              The measurement is unset.
+ *      else            The extreme over the current and previous windows.
+ */
+static double
+win_get(
+    const Windowed* const       win,
+    const int                   isMin)
+{
+    const double        cur = win->value[0];
+    const double        prev = win->value[1];
+
+    if (cur < 0)
+        return prev;
+    if (prev < 0)
+        return cur;
+
+    return isMin
+        ? (cur < prev ? cur : prev)
+        : (cur > prev ? cur : prev);
+}
+
+/*
+ * Returns the data-product size below which HEREIS is used.
+ */
+static double
+xa_getThreshold(void)
+{
+    const double        rtt = win_get(&xaRtt, 1);
+    const double        rate = win_get(&xaRate, 0);
+
+    if (rtt < 0 || rate <= 0)
+        return 0;
+
+    return rtt * rate /
+        (xaDupFraction > MIN_DUP ? xaDupFraction : MIN_DUP);
+}
+
+/*
+ * Obtains the setting from the registry if it hasn't been set.
+ */
+static void
+xa_ensureConfig(void)
+{
+    if (!xaIsSet) {
+        xaIsEnabled = reg_getBoolOrDefault(REG_ADAPTIVE_TRANSFER, 1);
+        xaIsSet = 1;
+    }
+}
+
+/*
+ * Enables or disables adaptation instead of obtaining the setting from the
+ * registry.
+ */
+void
+xa_setConfig(
+    const int           enable)
+{
+    xaIsEnabled = enable;
+    xaIsSet = 1;
+}
+
+/*
+ * Indicates if adaptation is enabled.
+ */
+int
+xa_isEnabled(void)
+{
+    xa_ensureConfig();
+
+    return xaIsEnabled;
+}
+
+/*
+ * Forgets everything that's been measured.
+ */
+void
+xa_reset(void)
+{
+    win_reset(&xaRtt);
+    win_reset(&xaRate);
+    xaDupFraction = 1;          /* assume the worst until told otherwise */
+    xaSinceSync = 0;
+    xaHaveSync = 0;
+}
+
+/*
+ * Accumulates bytes that have been sent asynchronously.
+ */
+void
+xa_noteAsync(
+    const size_t        nbytes)
+{
+    xaSinceSync += nbytes;
+}
+
+/*
+ * Measures the connection from a synchronous RPC call.
+ */
+void
+xa_noteSync(
+    const timestampt* const     start,
+    const timestampt* const     end)
+{
+    const double        time = end->tv_sec + end->tv_usec / 1e6;
+
+    win_add(&xaRtt, time, d_diff_timestamp(end, start), 1);
+
+    if (xaHaveSync && xaSinceSync > 0) {
+        /*
+         * Everything sent since the previous reply has now been received:
+         * the sample can underestimate but not overestimate the rate.
+         */
+        const double    interval = d_diff_timestamp(end, &xaLastSync);
+
+        if (interval > 0)
+            win_add(&xaRate, time, xaSinceSync / interval, 0);
+    }
+
+    xaLastSync = *end;
+    xaHaveSync = 1;
+    xaSinceSync = 0;
+}
+
+/*
+ * Accumulates the reply of the downstream LDM to a COMINGSOON message.
+ */
+void
+xa_noteReply(
+    const int           wanted)
+{
+    xaDupFraction += ((wanted ? 0.0 : 1.0) - xaDupFraction) / DUP_WEIGHT;
+}
+
+/*
+ * Indicates whether a data-product should be sent via HEREIS to a downstream
+ * LDM that's in alternate transfer-mode.
+ */
+int
+xa_useHereis(
+    const size_t        size)
+{
+    return xa_isEnabled() && size < xa_getThreshold();
+}
+
+/*
+ * Returns the size of the BLKDATA blocks in which to send a data-product.
+ */
+size_t
+xa_getBlockSize(
+    const size_t        size)
+{
+    const double        rtt = win_get(&xaRtt, 1);
+    const double        rate = win_get(&xaRate, 0);
+    double              block;
+
+    if (!xa_isEnabled() || rtt < 0 || rate <= 0)
+        return size;
+
+    block = rtt * rate;
+
+    if (block < DBUFMAX)
+        block = DBUFMAX;
+    if (block > MAX_BLOCK)
+        block = MAX_BLOCK;
+
+    return size < block ? size : (size_t)block;
+}
+
+/*
+ * Logs the measurements.
+ */
+void
+xa_log(
+    const int           level)
+{
+    const double        rtt = win_get(&xaRtt, 1);
+    const double        rate = win_get(&xaRate, 0);
+
+    if (xa_isEnabled() && rtt >= 0)
+        ulog(level, "Connection: RTT %.3f ms, rate %.0f B/s, "
+                "duplicates %.0f%%, HEREIS below %.0f bytes, "
+                "%lu-byte blocks",
+                rtt * 1e3, rate > 0 ? rate : 0.0, xaDupFraction * 100,
+                xa_getThreshold(), (unsigned long)xa_getBlockSize(MAX_BLOCK));
+}
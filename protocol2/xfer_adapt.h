@@ -0,0 +1,121 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This header-file specifies the API for the module that adapts the way an
+ * upstream LDM sends data-products to a downstream LDM to the connection:
+ * whether a data-product is sent via HEREIS or COMINGSOON/BLKDATA messages
+ * and the size of the BLKDATA blocks.
+ */
+
+#ifndef XFER_ADAPT_H
+#define XFER_ADAPT_H
+
+#include <stddef.h>
+
+#include "timestamp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enables or disables adaptation instead of obtaining the setting from the
+ * registry.
+ *
+ * @param enable        [in] Whether or not to adapt.
+ */
+void
+xa_setConfig(
+    const int           enable);
+
+/**
+ * Indicates if adaptation is enabled.
+ *
+ * @retval 0    Adaptation is disabled.
+ * @retval 1    Adaptation is enabled.
+ */
+int
+xa_isEnabled(void);
+
+/**
+ * Forgets everything that's been measured.  Should be called at the start of
+ * each connection.
+ */
+void
+xa_reset(void);
+
+/**
+ * Accumulates bytes that have been sent asynchronously (e.g., via HEREIS or
+ * BLKDATA messages).
+ *
+ * @param nbytes        [in] Number of bytes sent.
+ */
+void
+xa_noteAsync(
+    const size_t        nbytes);
+
+/**
+ * Measures the connection from a synchronous RPC call (e.g., COMINGSOON or
+ * NULLPROC).  Because the reply means that everything sent before the call
+ * has been received, the call yields both a round-trip time and a delivery
+ * rate.
+ *
+ * @param start         [in] When the call was made.
+ * @param end           [in] When the reply was received.
+ */
+void
+xa_noteSync(
+    const timestampt* const     start,
+    const timestampt* const     end);
+
+/**
+ * Accumulates the reply of the downstream LDM to a COMINGSOON message.
+ *
+ * @param wanted        [in] Whether the downstream LDM wanted the
+ *                      data-product (i.e., it isn't a duplicate).
+ */
+void
+xa_noteReply(
+    const int           wanted);
+
+/**
+ * Indicates whether a data-product should be sent via a HEREIS message rather
+ * than COMINGSOON/BLKDATA messages to a downstream LDM that's in alternate
+ * transfer-mode (i.e., that expects duplicates).  HEREIS is chosen when the
+ * expected cost of sending a duplicate is less than the round-trip of the
+ * COMINGSOON message that would avoid it.
+ *
+ * @param size          [in] Size of the data-product in bytes.
+ * @retval 0            Use COMINGSOON/BLKDATA.
+ * @retval 1            Use HEREIS.
+ */
+int
+xa_useHereis(
+    const size_t        size);
+
+/**
+ * Returns the size of the BLKDATA blocks in which to send a data-product:
+ * about one bandwidth-delay product of the connection but no smaller than
+ * DBUFMAX and no larger than what fits in the RPC send-buffer.
+ *
+ * @param size          [in] Size of the data-product in bytes.
+ * @return              The size of a block in bytes.
+ */
+size_t
+xa_getBlockSize(
+    const size_t        size);
+
+/**
+ * Logs the measurements and the resulting HEREIS threshold and block size.
+ *
+ * @param level         [in] The ulog(3) logging-level (e.g., LOG_INFO).
+ */
+void
+xa_log(
+    const int           level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
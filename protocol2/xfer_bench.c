@@ -0,0 +1,443 @@
+/*
+ * Copyright 2014 University Corporation for Atmospheric Research.
+ * All rights reserved.
+ * See file "COPYRIGHT" in the top-level source-directory for conditions.
+ *
+ * Benchmark of the transfer of data-products from an upstream LDM-6 to a
+ * downstream LDM-6 over a simulated long link for a range of data-product
+ * sizes.  Each size is transferred three ways: in primary transfer-mode (via
+ * HEREIS messages), in alternate transfer-mode with the fixed choice of
+ * COMINGSOON/BLKDATA messages, and in alternate transfer-mode with the choice
+ * adapted to the link (see xfer_adapt.h).  Some of the data-products are put
+ * into the downstream product-queue beforehand so that they're duplicates.
+ * The link is a relay process that delays both directions by half the
+ * round-trip time and limits the rate of the upstream-to-downstream direction.
+ *
+ * Usage: xfer_bench [-v] [-b bytes] [-n count] [-r rate] [-t rtt] [-p dups]
+ *                   [-d dir] [size ...]
+ *
+ *     -v            Verbose logging.
+ *     -b bytes      Maximum number of bytes transferred per size (default
+ *                   20000000).
+ *     -n count      Maximum number of data-products per size (default 200).
+ *     -r rate       Rate of the link in bytes per second (default 10000000).
+ *     -t rtt        Round-trip time of the link in milliseconds (default 40).
+ *     -p dups       Fraction of data-products that are duplicates (default
+ *                   0.1).
+ *     -d dir        Directory for the temporary product-queues (default
+ *                   /tmp).
+ *     size ...      Sizes of the data-products in bytes (default 1000 10000
+ *                   100000 1000000).
+ */
+#include "config.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ldm.h"
+#include "timestamp.h"
+#include "ulog.h"
+#include "xfer_adapt.h"
+#include "bench_util.h"
+
+#define CHUNK   65536           /* maximum size of a relayed chunk */
+
+typedef enum {
+    PRIMARY,                    /* HEREIS */
+    FIXED,                      /* COMINGSOON/BLKDATA */
+    ADAPTIVE                    /* adapted to the link */
+} Mode;
+
+static const char*      modeNames[] = {"primary", "alternate", "adaptive"};
+
+/*
+ * The data-products of a product-queue:
+ */
+typedef struct {
+    unsigned            count;
+    unsigned            size;
+    double              dups;           /* fraction of duplicates or -1 */
+} Fill;
+
+/*
+ * The configuration of a transfer:
+ */
+typedef struct {
+    Mode                mode;
+    unsigned            rate;           /* bytes per second */
+    double              rtt;            /* round-trip time in seconds */
+} Transfer;
+
+/*
+ * A chunk of relayed bytes that's in transit.
+ */
+typedef struct chunk {
+    struct chunk*       next;
+    double              due;            /* when to deliver it */
+    size_t              len;
+    char                data[CHUNK];
+} Chunk;
+
+/*
+ * One direction of the link.
+ */
+typedef struct {
+    Chunk*              head;
+    Chunk*              tail;
+    size_t              bytes;          /* bytes in transit */
+    double              depart;         /* when the last chunk departed */
+    int                 from;
+    int                 to;
+} Direction;
+
+/*
+ * Returns the current time in seconds.
+ */
+static double
+now(void)
+{
+    timestampt  ts;
+
+    (void)set_timestamp(&ts);
+
+    return ts.tv_sec + ts.tv_usec / 1e6;
+}
+
+/*
+ * Indicates whether a data-product is one of the duplicates.  The last
+ * data-product never is so that its arrival ends the transfer.
+ */
+static int
+isDuplicate(
+    const unsigned      i,
+    const unsigned      count,
+    const double        dups)
+{
+    return i < count - 1 && (unsigned)((i + 1) * dups) != (unsigned)(i * dups);
+}
+
+/*
+ * Makes the data-products random and distinguishes them by size.  Skips the
+ * ones that aren't duplicates if only those are wanted.  Called by
+ * bench_fillQueue().
+ */
+static int
+setProduct(
+    product* const      prod,
+    const unsigned      index,
+    void* const         arg)
+{
+    const Fill* const   fill = (Fill*)arg;
+
+    if (0 == index) {
+        char* const     data = prod->data;
+        unsigned        i;
+
+        for (i = 0; i < fill->size; i++)
+            data[i] = (char)rand();
+    }
+
+    (void)memcpy(prod->info.signature + sizeof(index), &fill->size,
+            sizeof(fill->size));
+
+    return fill->dups >= 0 && !isDuplicate(index, fill->count, fill->dups);
+}
+
+/*
+ * Configures the upstream LDM.  Called by bench_transfer().
+ */
+static void
+setUp(
+    void* const arg)
+{
+    xa_setConfig(ADAPTIVE == ((Transfer*)arg)->mode);
+}
+
+/*
+ * Reads a chunk from one end of the link and puts it in transit.
+ */
+static int
+dir_read(
+    Direction* const    dir,
+    const double        rate,
+    const double        delay)
+{
+    Chunk*      chunk = malloc(sizeof(Chunk));
+    ssize_t     n;
+    double      time = now();
+
+    if (NULL == chunk)
+        return -1;
+
+    n = read(dir->from, chunk->data, CHUNK);
+
+    if (n <= 0) {
+        free(chunk);
+        return -1;
+    }
+
+    if (rate > 0) {
+        dir->depart = (dir->depart > time ? dir->depart : time) + n / rate;
+        time = dir->depart;
+    }
+
+    chunk->len = n;
+    chunk->due = time + delay;
+    chunk->next = NULL;
+
+    if (NULL == dir->tail) {
+        dir->head = chunk;
+    }
+    else {
+        dir->tail->next = chunk;
+    }
+
+    dir->tail = chunk;
+    dir->bytes += n;
+
+    return 0;
+}
+
+/*
+ * Delivers the chunks that are due to the other end of the link.
+ */
+static int
+dir_write(
+    Direction* const    dir,
+    const double        time)
+{
+    while (NULL != dir->head && dir->head->due <= time) {
+        Chunk*  chunk = dir->head;
+
+        if (write(dir->to, chunk->data, chunk->len) != (ssize_t)chunk->len)
+            return -1;
+
+        dir->head = chunk->next;
+        if (NULL == dir->head)
+            dir->tail = NULL;
+        dir->bytes -= chunk->len;
+        free(chunk);
+    }
+
+    return 0;
+}
+
+/*
+ * Relays bytes between the upstream LDM and the downstream LDM, delaying both
+ * directions by half the round-trip time and limiting the rate of the
+ * upstream-to-downstream direction, until a connection is closed.  The bytes
+ * in transit upstream-to-downstream are limited to twice the bandwidth-delay
+ * product so that the sender sees the link's rate.  Called by bench_transfer()
+ * in the relay process.  Doesn't return.
+ */
+/*ARGSUSED*/
+static void
+runRelay(
+    const int           upSock,
+    const int           downSock,
+    const int           pipeFd,
+    void* const         arg)
+{
+    const unsigned      rate = ((Transfer*)arg)->rate;
+    const double        rtt = ((Transfer*)arg)->rtt;
+    const size_t        maxBytes = 2 * rate * rtt + 2 * CHUNK;
+    const int           on = 1;
+    Direction           dirs[2];
+    struct pollfd       fds[2];
+
+    /*
+     * The relay delivers what it received when it's due rather than adding
+     * delays of its own.
+     */
+    (void)setsockopt(downSock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    (void)memset(dirs, 0, sizeof(dirs));
+    dirs[0].from = upSock;
+    dirs[0].to = downSock;
+    dirs[1].from = downSock;
+    dirs[1].to = upSock;
+    fds[0].fd = upSock;
+    fds[1].fd = downSock;
+
+    for (;;) {
+        double  time = now();
+        double  next = -1;
+        int     timeout;
+        int     i;
+
+        for (i = 0; i < 2; i++) {
+            if (dir_write(&dirs[i], time))
+                exit(0);
+
+            if (NULL != dirs[i].head && (next < 0 || dirs[i].head->due < next))
+                next = dirs[i].head->due;
+        }
+
+        timeout = next < 0 ? -1 : (int)((next - time) * 1e3) + 1;
+        fds[0].events = dirs[0].bytes < maxBytes ? POLLIN : 0;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, timeout) < 0) {
+            if (EINTR == errno)
+                continue;
+            break;
+        }
+
+        if (fds[0].revents && dir_read(&dirs[0], rate, rtt / 2))
+            break;
+        if (fds[1].revents && dir_read(&dirs[1], 0, rtt / 2))
+            break;
+    }
+
+    exit(0);
+}
+
+int
+main(
+    int         argc,
+    char**      argv)
+{
+    static unsigned     defaultSizes[] = {1000, 10000, 100000, 1000000};
+    const char*         dir = "/tmp";
+    unsigned long       maxBytes = 20000000;
+    unsigned            maxCount = 200;
+    double              dups = 0.1;
+    unsigned*           sizes = defaultSizes;
+    unsigned            sizeCount = sizeof(defaultSizes) / sizeof(*sizes);
+    char                upPath[256];
+    char                downPath[256];
+    Transfer            transfer;
+    BenchConfig         config;
+    unsigned            i;
+    int                 ch;
+    int                 status = 0;
+
+    bench_init("xfer_bench", LOG_NOTICE);
+    transfer.rate = 10000000;
+    transfer.rtt = 0.04;
+
+    while ((ch = getopt(argc, argv, "vb:n:r:t:p:d:")) != -1) {
+        switch (ch) {
+        case 'v':
+            (void)setulogmask(LOG_UPTO(LOG_INFO));
+            break;
+        case 'b':
+            maxBytes = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            maxCount = (unsigned)atoi(optarg);
+            break;
+        case 'r':
+            transfer.rate = (unsigned)atoi(optarg);
+            break;
+        case 't':
+            transfer.rtt = atof(optarg) / 1e3;
+            break;
+        case 'p':
+            dups = atof(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            (void)fprintf(stderr,
+                    "Usage: %s [-v] [-b bytes] [-n count] [-r rate] [-t rtt] "
+                    "[-p dups] [-d dir] [size ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == maxBytes || 0 == maxCount || 0 == transfer.rate ||
+            transfer.rtt < 0 || dups < 0 || dups >= 1) {
+        (void)fprintf(stderr, "Bytes, count, and rate must be positive, "
+                "rtt non-negative, and dups in [0,1)\n");
+        return 1;
+    }
+
+    if (optind < argc) {
+        sizeCount = argc - optind;
+        sizes = malloc(sizeCount * sizeof(*sizes));
+
+        if (NULL == sizes)
+            return 1;
+
+        for (i = 0; i < sizeCount; i++) {
+            sizes[i] = (unsigned)atoi(argv[optind + i]);
+
+            if (0 == sizes[i]) {
+                (void)fprintf(stderr, "Sizes must be positive\n");
+                return 1;
+            }
+        }
+    }
+
+    bench_setPath(upPath, sizeof(upPath), dir, "xfer_bench", "up");
+    bench_setPath(downPath, sizeof(downPath), dir, "xfer_bench", "down");
+
+    (void)memset(&config, 0, sizeof(config));
+    config.setUp = setUp;
+    config.relay = runRelay;
+    config.arg = &transfer;
+
+    srand(1);
+
+    for (i = 0; i < sizeCount && 0 == status; i++) {
+        Fill    fill;
+
+        fill.size = sizes[i];
+        fill.count = maxBytes / fill.size;
+
+        if (fill.count > maxCount)
+            fill.count = maxCount;
+        if (fill.count < 2)
+            fill.count = 2;
+
+        fill.dups = -1;
+        config.count = fill.count;
+
+        if (bench_fillQueue(upPath, fill.count, fill.size, "xfer_bench",
+                    setProduct, &fill)) {
+            status = 1;
+            break;
+        }
+
+        for (transfer.mode = PRIMARY; transfer.mode <= ADAPTIVE;
+                transfer.mode++) {
+            BenchResult result;
+
+            /* The duplicates are in the downstream product-queue already */
+            fill.dups = dups;
+
+            if (bench_fillQueue(downPath, fill.count, fill.size, "xfer_bench",
+                        setProduct, &fill)) {
+                status = 1;
+                break;
+            }
+
+            config.primary = PRIMARY == transfer.mode;
+
+            if (bench_transfer(upPath, downPath, &config, &result)) {
+                status = 1;
+            }
+            else {
+                (void)printf("%-9s %4u products of %7u bytes at %u bytes/s, "
+                        "RTT %.0f ms: %7.3f s, %8.1f products/s\n",
+                        modeNames[transfer.mode], fill.count, fill.size,
+                        transfer.rate, transfer.rtt * 1e3, result.duration,
+                        fill.count / result.duration);
+            }
+
+            (void)unlink(downPath);
+        }
+
+        (void)unlink(upPath);
+    }
+
+    return status;
+}
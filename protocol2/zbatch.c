@@ -0,0 +1,201 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This module compresses batches of data-products for HEREIS_ZBATCH messages.
+ * An upstream LDM compresses the data-products whose feedtypes are in the
+ * configured set once the downstream LDM has shown that it supports the
+ * message.  The set is the registry parameter /server/compression/feedtypes
+ * and the smallest encoded size worth compressing is
+ * /server/compression/threshold.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "atofeedt.h"
+#include "ldm.h"
+#include "log.h"
+#include "registry.h"
+#include "ulog.h"
+#include "zbatch.h"
+
+#define DEFAULT_THRESHOLD       1024    /* default minimum size in bytes */
+
+static feedtypet        zbFeedtypes = NONE;
+static unsigned         zbThreshold = DEFAULT_THRESHOLD;
+static int              zbIsSet;
+static Bytef*           zbBuf;          /* compressed bytes */
+static size_t           zbSize;         /* capacity of "zbBuf" */
+static z_stream         zbStrm;         /* reused compression state */
+static int              zbStrmInit;     /* "zbStrm" is initialized? */
+
+/*
+ * Obtains the configuration from the registry if it hasn't been set.
+ */
+static void
+zb_ensureConfig(void)
+{
+    if (!zbIsSet) {
+        char* const str = reg_getStringOrDefault(REG_COMPRESSION_FEEDTYPES,
+                "NONE");
+
+        zbFeedtypes = NONE;
+
+        if (NULL != str) {
+            const int   status = strfeedtypet(str, &zbFeedtypes);
+
+            if (status) {
+                uerror("Invalid compression feedtypes \"%s\": %s", str,
+                        strfeederr(status));
+                zbFeedtypes = NONE;
+            }
+
+            free(str);
+        }
+
+        zbThreshold = reg_getUintOrDefault(REG_COMPRESSION_THRESHOLD,
+                DEFAULT_THRESHOLD);
+        zbIsSet = 1;
+    }
+}
+
+/*
+ * Sets the configuration instead of obtaining it from the registry.
+ *
+ * Arguments:
+ *      feedtypes       Feedtypes of the data-products to compress. NONE
+ *                      disables compression.
+ *      threshold       Minimum size, in bytes, of an XDR-encoded data-product
+ *                      or batch of data-products to compress.
+ */
+void
+zb_setConfig(
+    const feedtypet     feedtypes,
+    const unsigned      threshold)
+{
+    zbFeedtypes = feedtypes;
+    zbThreshold = threshold;
+    zbIsSet = 1;
+}
+
+/*
+ * Indicates if compression is enabled for any feedtype.
+ */
+int
+zb_isEnabled(void)
+{
+    zb_ensureConfig();
+
+    return NONE != zbFeedtypes;
+}
+
+/*
+ * Indicates if a data-product should be compressed.
+ */
+int
+zb_isWanted(
+    const prod_info* const      info)
+{
+    zb_ensureConfig();
+
+    return 0 != (info->feedtype & zbFeedtypes);
+}
+
+/*
+ * Returns the minimum size, in bytes, of an XDR-encoded data-product or batch
+ * of data-products to compress.
+ */
+unsigned
+zb_getThreshold(void)
+{
+    zb_ensureConfig();
+
+    return zbThreshold;
+}
+
+/*
+ * Compresses the encoding of a batch of data-products.  The encoding is given
+ * in two parts so that the products needn't be copied after the batch header.
+ * The compressed bytes are valid until the next call.
+ *
+ * Arguments:
+ *      hdr             The first part of the encoding.
+ *      hdrLen          The size of "hdr" in bytes.
+ *      body            The second part of the encoding.
+ *      bodyLen         The size of "body" in bytes.
+ *      zbatch          The compressed batch.  Upon success, "method", "ulen",
+ *                      "zlen", and "zdata" are set.  The caller should compare
+ *                      "zlen" to "ulen" to decide if compression was
+ *                      worthwhile.
+ * Returns:
+ *      0               Success.
+ *      ENOMEM          Out of memory.  log_start() called.
+ *      EIO             Compression failure.  log_start() called.
+ */
+int
+zb_compress(
+    const void* const   hdr,
+    const size_t        hdrLen,
+    const void* const   body,
+    const size_t        bodyLen,
+    product_zbatch*     zbatch)
+{
+    const size_t    need = compressBound(hdrLen + bodyLen);
+    z_stream* const strm = &zbStrm;
+    int             status;
+
+    if (need > zbSize) {
+        Bytef* const    buf = realloc(zbBuf, need);
+
+        if (NULL == buf) {
+            LOG_SERROR1("Couldn't allocate %lu-byte compression buffer",
+                    (unsigned long)need);
+            return ENOMEM;
+        }
+
+        zbBuf = buf;
+        zbSize = need;
+    }
+
+    if (!zbStrmInit) {
+        if (deflateInit(strm, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            LOG_START1("deflateInit() failure: %s",
+                    strm->msg ? strm->msg : "");
+            return EIO;
+        }
+
+        zbStrmInit = 1;
+    }
+    else if (deflateReset(strm) != Z_OK) {
+        LOG_START0("deflateReset() failure");
+        return EIO;
+    }
+
+    strm->next_out = zbBuf;
+    strm->avail_out = zbSize;
+    strm->next_in = (Bytef*)hdr;
+    strm->avail_in = hdrLen;
+    status = deflate(strm, Z_NO_FLUSH);
+
+    if (Z_OK == status) {
+        strm->next_in = (Bytef*)body;
+        strm->avail_in = bodyLen;
+        status = deflate(strm, Z_FINISH);
+    }
+
+    if (Z_STREAM_END != status) {
+        LOG_START1("deflate() failure: %s", strm->msg ? strm->msg : "");
+        return EIO;
+    }
+
+    zbatch->method = ZBATCH_ZLIB;
+    zbatch->ulen = hdrLen + bodyLen;
+    zbatch->zlen = strm->total_out;
+    zbatch->zdata = (char*)zbBuf;
+
+    return 0;
+}
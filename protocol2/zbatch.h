@@ -0,0 +1,88 @@
+/*
+ * See file ../COPYRIGHT for copying and redistribution conditions.
+ *
+ * This header-file specifies the API for the compression of data-products
+ * into HEREIS_ZBATCH messages by an upstream LDM.
+ */
+
+#ifndef ZBATCH_H
+#define ZBATCH_H
+
+#include <stddef.h>
+
+#include "ldm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets the configuration instead of obtaining it from the registry.
+ *
+ * @param feedtypes     [in] Feedtypes of the data-products to compress. NONE
+ *                      disables compression.
+ * @param threshold     [in] Minimum size, in bytes, of an XDR-encoded
+ *                      data-product or batch of data-products to compress.
+ */
+void
+zb_setConfig(
+    const feedtypet     feedtypes,
+    const unsigned      threshold);
+
+/**
+ * Indicates if compression is enabled for any feedtype.
+ *
+ * @retval 0    Compression is disabled.
+ * @retval 1    Compression is enabled.
+ */
+int
+zb_isEnabled(void);
+
+/**
+ * Indicates if a data-product should be compressed.
+ *
+ * @param info          [in] Metadata of the data-product.
+ * @retval 0            The data-product shouldn't be compressed.
+ * @retval 1            The data-product should be compressed.
+ */
+int
+zb_isWanted(
+    const prod_info* const      info);
+
+/**
+ * Returns the minimum size, in bytes, of an XDR-encoded data-product or batch
+ * of data-products to compress.
+ *
+ * @return  The compression threshold in bytes.
+ */
+unsigned
+zb_getThreshold(void);
+
+/**
+ * Compresses the XDR-encoding of a batch of data-products.  The encoding is
+ * given in two parts so that the data-products needn't be copied after the
+ * batch header.  The compressed bytes are valid until the next call.
+ *
+ * @param hdr           [in] The first part of the encoding.
+ * @param hdrLen        [in] The size of "hdr" in bytes.
+ * @param body          [in] The second part of the encoding.
+ * @param bodyLen       [in] The size of "body" in bytes.
+ * @param zbatch        [out] The compressed batch. Upon success, "method",
+ *                      "ulen", "zlen", and "zdata" are set.
+ * @retval 0            Success.
+ * @retval ENOMEM       Out of memory. log_start() called.
+ * @retval EIO          Compression failure. log_start() called.
+ */
+int
+zb_compress(
+    const void* const   hdr,
+    const size_t        hdrLen,
+    const void* const   body,
+    const size_t        bodyLen,
+    product_zbatch*     zbatch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1119,6 +1119,133 @@ RegStatus reg_getUint(
     return getValue(path, value,  &uintStruct);
 }
 
+/*
+ * Logs the failure to obtain a value from the registry and the default value
+ * that will be used instead.  A missing value is logged as informational, so
+ * that a registry that predates the parameter doesn't add a notice to every
+ * connection; any other failure is logged as an error.
+ *
+ * Arguments:
+ *      path            Pointer to the absolute path name of the value.
+ *      status          The status returned by the registry.
+ *      defaultValue    Pointer to the string representation of the default
+ *                      value.
+ */
+static void
+logDefault(
+    const char* const   path,
+    const RegStatus     status,
+    const char* const   defaultValue)
+{
+    if (ENOENT == status) {
+        log_clear();
+        uinfo("Registry parameter \"%s\" not set: using %s", path,
+                defaultValue);
+    }
+    else {
+        log_log(LOG_ERR);
+        uerror("Couldn't get registry parameter \"%s\": using %s", path,
+                defaultValue);
+    }
+}
+
+/*
+ * Returns a value from the registry as a string or a default value.  The
+ * failure to obtain the value is logged.
+ *
+ * Arguments:
+ *      path            Pointer to the absolute path name of the value to be
+ *                      returned.  Shall not be NULL. Shall not contain a space.
+ *      defaultValue    Pointer to the value to use if the registry value can't
+ *                      be obtained or NULL.
+ * Returns:
+ *      NULL            The value couldn't be obtained and "defaultValue" is
+ *                      NULL, or out of memory (logged).
+ *      else            Pointer to the value or to a copy of "defaultValue".
+ *                      The client should call "free()" when the value is no
+ *                      longer needed.
+ */
+char* reg_getStringOrDefault(
+    const char* const   path,
+    const char* const   defaultValue)
+{
+    char*               value;
+    const RegStatus     status = reg_getString(path, &value);
+
+    if (0 == status)
+        return value;
+
+    logDefault(path, status, NULL == defaultValue ? "no value" : defaultValue);
+
+    if (NULL == defaultValue)
+        return NULL;
+
+    value = strdup(defaultValue);
+    if (NULL == value)
+        serror("Couldn't copy default value \"%s\"", defaultValue);
+
+    return value;
+}
+
+/*
+ * Returns a value from the registry as a boolean or a default value.  The
+ * failure to obtain the value is logged.
+ *
+ * Arguments:
+ *      path            Pointer to the absolute path name of the value to be
+ *                      returned.  Shall not be NULL. Shall not contain a space.
+ *      defaultValue    The value to use if the registry value can't be
+ *                      obtained.
+ * Returns:
+ *      The value or "defaultValue".
+ */
+unsigned reg_getBoolOrDefault(
+    const char* const   path,
+    const unsigned      defaultValue)
+{
+    unsigned            value;
+    const RegStatus     status = reg_getBool(path, &value);
+
+    if (0 == status)
+        return value;
+
+    logDefault(path, status, defaultValue ? "TRUE" : "FALSE");
+
+    return defaultValue;
+}
+
+/*
+ * Returns a value from the registry as an unsigned integer or a default value.
+ * The failure to obtain the value is logged.
+ *
+ * Arguments:
+ *      path            Pointer to the absolute path name of the value to be
+ *                      returned.  Shall not be NULL. Shall not contain a space.
+ *      defaultValue    The value to use if the registry value can't be
+ *                      obtained.
+ * Returns:
+ *      The value or "defaultValue".
+ */
+unsigned reg_getUintOrDefault(
+    const char* const   path,
+    const unsigned      defaultValue)
+{
+    unsigned            value;
+    const RegStatus     status = reg_getUint(path, &value);
+
+    if (0 == status)
+        return value;
+
+    {
+        char    buf[24];
+
+        (void)snprintf(buf, sizeof(buf), "%u", defaultValue);
+        logDefault(path, status, buf);
+    }
+
+    return defaultValue;
+}
+
 /*
  * Returns a value from the registry as a time.
  *
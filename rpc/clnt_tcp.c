@@ -58,6 +58,7 @@ static char sccsid[] = "@(#)clnt_tcp.c 1.37 87/10/05 Copyr 1984 Sun Micro";
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <errno.h>
 #include <unistd.h>
@@ -329,6 +330,52 @@ writetcp(
 	return (len);
 }
 
+/*
+ * Like writetcp() but gathers the data from several buffers.  If more data
+ * will soon follow, then the last, partial segment is held back (as it would
+ * be if the data had been left in the XDR buffer) so that an asynchronous
+ * call and the next call can share a segment.
+ */
+static int
+writevtcp(
+	register struct ct_data *ct,
+	struct iovec* iov,
+	int iovcnt,
+	int more)
+{
+	register int i, cnt, len = 0;
+	struct msghdr msg;
+	int flags = 0;
+
+#ifdef MSG_MORE
+	if (more)
+		flags = MSG_MORE;
+#endif
+	for (i = 0; i < iovcnt; i++)
+		len += (int)iov[i].iov_len;
+
+	for (cnt = len; cnt > 0; cnt -= i) {
+		register int rem;
+
+		(void)memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iovcnt;
+		if ((i = (int)sendmsg(ct->ct_sock, &msg, flags)) == -1) {
+			ct->ct_error.re_errno = errno;
+			ct->ct_error.re_status = RPC_CANTSEND;
+			return (-1);
+		}
+		/* skip what was written */
+		for (rem = i; iovcnt > 0 && rem >= (int)iov->iov_len; iovcnt--)
+			rem -= (int)(iov++)->iov_len;
+		if (iovcnt > 0) {
+			iov->iov_base = (char*)iov->iov_base + rem;
+			iov->iov_len -= rem;
+		}
+	}
+	return (len);
+}
+
 static struct clnt_ops tcp_ops = {
 	clnttcp_call,
 	clnttcp_abort,
@@ -453,6 +500,8 @@ clnttcp_create(
 	    (char*)ct,
 	    (int (*)(void*, char*, int))readtcp,
 	    (int (*)(void*, char*, int))writetcp);
+	xdrrec_setwritev(&(ct->ct_xdrs),
+	    (int (*)(void*, struct iovec*, int, int))writevtcp);
 	h->cl_ops = &tcp_ops;
 	h->cl_private = (char*) ct;
 	h->cl_auth = authnone_create();
@@ -376,6 +376,17 @@ extern void   xdrrec_create(
 	    char* buf,
 	    int len));
 
+/* write large opaque data without copying it */
+struct iovec;
+#define xdrrec_setwritev	my_xdrrec_setwritev
+extern void   xdrrec_setwritev(
+	XDR *xdrs,
+	int (*writevit)(	/* like writev, but pass it a tcp_handle */
+	    void* handle,
+	    struct iovec* iov,
+	    int iovcnt,
+	    int more));
+
 /* make end of xdr record */
 #define xdrrec_endofrecord	my_xdrrec_endofrecord
 extern bool_t xdrrec_endofrecord(XDR *xdrs, bool_t sendnow);
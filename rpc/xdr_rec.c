@@ -56,6 +56,7 @@ static char sccsid[] = "@(#)xdr_rec.c 1.21 87/08/11 Copyr 1984 Sun Micro";
 #include <stdlib.h>
 #include <strings.h>
 #include <sys/types.h>
+#include <sys/uio.h>	/* struct iovec */
 #include <unistd.h>
 
 #include "types.h"
@@ -102,6 +103,14 @@ static struct  xdr_ops xdrrec_ops = {
 
 #define LAST_FRAG ((uint32_t)(1ul << 31))
 
+/*
+ * Opaque data at least this long is written from the caller's memory by the
+ * gather-write function, if there is one, rather than being copied into the
+ * output buffer.  The write is deferred until the output buffer is flushed so
+ * that the data and the bytes around it are sent by one system call.
+ */
+#define DIRECT_MIN 8192
+
 typedef struct rec_strm {
 	char* tcp_handle;
 	char* the_buffer;
@@ -109,9 +118,13 @@ typedef struct rec_strm {
 	 * out-goung bits
 	 */
 	int (*writeit)(void* handle, char* buf, int len);
+	int (*writevit)(void* handle, struct iovec* iov, int iovcnt, int more);
 	char* out_base;	/* output buffer (points to frag header) */
 	char* out_finger;	/* next output position */
 	char* out_boundry;	/* data cannot up to this address */
+	char* out_split;	/* where "out_direct" goes in the output */
+	char* out_direct;	/* deferred opaque data or NULL */
+	unsigned direct_len;	/* length of "out_direct" */
 	uint32_t *frag_header;	/* beginning of current fragment */
 	bool_t frag_sent;	/* true if buffer sent in middle of record */
 	/*
@@ -138,7 +151,8 @@ static bool_t	fill_input_buf(RECSTREAM *rstrm);
 static bool_t
 flush_out(
 	register RECSTREAM *rstrm,
-	bool_t eor)
+	bool_t eor,
+	bool_t sendnow)	/* FALSE => the transport may wait for more */
 {
 	register uint32_t eormask = (uint32_t)((eor == TRUE) ? LAST_FRAG : 0);
 	register uint32_t len = (uint32_t)((rstrm->out_finger - 
@@ -146,8 +160,22 @@ flush_out(
 
 	*(rstrm->frag_header) = (uint32_t)htonl(len | eormask);
 	len = (uint32_t)(rstrm->out_finger - rstrm->out_base);
-	if ((*(rstrm->writeit))(rstrm->tcp_handle, rstrm->out_base, (int)len)
-		!= (int)len)
+	if (rstrm->out_direct != NULL) {
+		struct iovec iov[3];
+
+		iov[0].iov_base = rstrm->out_base;
+		iov[0].iov_len = (size_t)(rstrm->out_split - rstrm->out_base);
+		iov[1].iov_base = rstrm->out_direct;
+		iov[1].iov_len = rstrm->direct_len;
+		iov[2].iov_base = rstrm->out_split;
+		iov[2].iov_len = (size_t)(rstrm->out_finger - rstrm->out_split);
+		len += rstrm->direct_len;
+		rstrm->out_direct = NULL;
+		if ((*(rstrm->writevit))(rstrm->tcp_handle, iov, 3, !sendnow)
+			!= (int)len)
+			return (FALSE);
+	} else if ((*(rstrm->writeit))(rstrm->tcp_handle, rstrm->out_base,
+		(int)len) != (int)len)
 		return (FALSE);
 	rstrm->frag_header = (uint32_t*)rstrm->out_base;
 	rstrm->out_finger = (char*)rstrm->out_base + sizeof(uint32_t);
@@ -271,6 +299,8 @@ xdrrec_create(
 	rstrm->tcp_handle = tcp_handle;
 	rstrm->readit = readit;
 	rstrm->writeit = writeit;
+	rstrm->writevit = NULL;
+	rstrm->out_direct = NULL;
 
 	rstrm->frag_header = (uint32_t*)rstrm->out_base;
 	rstrm->out_boundry = rstrm->out_base + sendsize;
@@ -285,6 +315,27 @@ xdrrec_create(
 }
 
 
+/*
+ * Set the gather-write function of an xdrrec handle.  Like writev, but
+ * passed the tcp_handle of xdrrec_create and whether more data will soon
+ * follow (in which case the transport may hold a partial packet, as it would
+ * if the data were still in the output buffer).  Large opaque data is then
+ * written directly from the caller's memory (e.g., a memory-mapped file)
+ * instead of being copied into the output buffer; the memory must remain
+ * valid until the record is ended.  Writevit may modify the iovec array.
+ */
+void
+xdrrec_setwritev(
+	XDR *xdrs,
+	int (*writevit)(	/* like writev, but pass it a tcp_handle */
+	    void* handle, struct iovec* iov, int iovcnt, int more))
+{
+	register RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
+
+	rstrm->writevit = writevit;
+}
+
+
 /*
  * The routines defined below are the xdr ops which will go into the
  * xdr handle filled in by xdrrec_create.
@@ -328,7 +379,7 @@ xdrrec_putlong(
 		 */
 		rstrm->out_finger -= sizeof(uint32_t);
 		rstrm->frag_sent = TRUE;
-		if (! flush_out(rstrm, FALSE))
+		if (! flush_out(rstrm, FALSE, FALSE))
 			return (FALSE);
 		dest_lp = ((uint32_t *)(rstrm->out_finger));
 		rstrm->out_finger += sizeof(uint32_t);
@@ -374,6 +425,26 @@ xdrrec_putbytes(
 	register RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
 	register int current;
 
+	if (len >= DIRECT_MIN && rstrm->writevit != NULL) {
+		/*
+		 * End the current fragment with the data and start another.
+		 */
+		if ((rstrm->out_direct != NULL || rstrm->out_finger +
+		    sizeof(uint32_t) > rstrm->out_boundry) &&
+		    ! flush_out(rstrm, FALSE, FALSE))
+			return (FALSE);
+		*(rstrm->frag_header) = (uint32_t)htonl((uint32_t)
+		    (rstrm->out_finger - (char*)rstrm->frag_header -
+		    sizeof(uint32_t)) + len);
+		rstrm->out_split = rstrm->out_finger;
+		rstrm->out_direct = addr;
+		rstrm->direct_len = len;
+		rstrm->frag_header = (uint32_t*)rstrm->out_finger;
+		rstrm->out_finger += sizeof(uint32_t);
+		rstrm->frag_sent = TRUE;
+		return (TRUE);
+	}
+
 	while (len != 0) {
 		current = (int)(rstrm->out_boundry - rstrm->out_finger);
 		current = (len < current) ? (int)len : current;
@@ -383,7 +454,7 @@ xdrrec_putbytes(
 		len -= current;
 		if (rstrm->out_finger == rstrm->out_boundry) {
 			rstrm->frag_sent = TRUE;
-			if (! flush_out(rstrm, FALSE))
+			if (! flush_out(rstrm, FALSE, FALSE))
 				return (FALSE);
 		}
 	}
@@ -559,7 +630,7 @@ xdrrec_endofrecord(
 		    (rstrm->out_finger + sizeof(uint32_t) >=
 		    rstrm->out_boundry)) {
 		rstrm->frag_sent = FALSE;
-		return (flush_out(rstrm, TRUE));
+		return (flush_out(rstrm, TRUE, sendnow));
 	}
 	len = (uint32_t)(rstrm->out_finger - (char*)rstrm->frag_header -
 	   sizeof(uint32_t));
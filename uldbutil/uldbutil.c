@@ -131,16 +131,31 @@ int main(
                         const struct sockaddr_in* sockAddr =
                                 uldb_entry_getSockAddr(entry);
                         char buf[2048];
+                        char id[32];
+                        const unsigned session = uldb_entry_getSession(entry);
                         const char* const type =
                                 uldb_entry_isNotifier(entry) ?
                                         "notifier" : "feeder";
 
+                        /*
+                         * A session of a multi-session upstream LDM process
+                         * is identified as "<pid>:<session>".
+                         */
+                        if (session) {
+                            (void) snprintf(id, sizeof(id), "%ld:%u",
+                                    (long) uldb_entry_getPid(entry), session);
+                        }
+                        else {
+                            (void) snprintf(id, sizeof(id), "%ld",
+                                    (long) uldb_entry_getPid(entry));
+                        }
+
                         (void) s_prod_class(buf, sizeof(buf), prodClass);
-                        (void) printf("%ld %d %s %s %s %s\n",
-                                (long) uldb_entry_getPid(entry),
+                        (void) printf("%s %d %s %s %s %s %.0f\n", id,
                                 uldb_entry_getProtocolVersion(entry), type,
                                 hostbyaddr(sockAddr), buf,
-                                uldb_entry_isPrimary(entry) ? "primary" : "alternate");
+                                uldb_entry_isPrimary(entry) ? "primary" : "alternate",
+                                uldb_entry_getRate(entry));
                         free_prod_class(prodClass);
                     } /* "prodClass" allocated */
                 } /* entry loop */